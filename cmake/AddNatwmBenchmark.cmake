@@ -0,0 +1,53 @@
+# AddNatwmBenchmark
+# -----------------
+#
+# Function which adds a benchmark executable
+#
+# Benchmarks are not registered with CTest since their output is meant to be
+# read by a human. They are all added to the `bench` target which builds and
+# runs them
+#
+# Example
+# -------
+# add_natwm_benchmark(example-bench
+#                     SOURCES example-bench.c
+#                     LINK_LIBRARIES common
+#
+
+if (NOT TARGET bench)
+    add_custom_target(bench)
+endif()
+
+function(ADD_NATWM_BENCHMARK _TARGET_NAME)
+    set(multi_value_arguments
+        SOURCES
+        LINK_LIBRARIES
+    )
+
+    cmake_parse_arguments(_add_natwm_benchmark
+        ""
+        ""
+        "${multi_value_arguments}"
+        ${ARGN}
+    )
+
+    if (NOT DEFINED _add_natwm_benchmark_SOURCES)
+        message(FATAL_ERROR "No sources provided for target ${_TARGET_NAME}")
+    endif()
+
+    add_executable(${_TARGET_NAME} ${_add_natwm_benchmark_SOURCES})
+
+    if (DEFINED _add_natwm_benchmark_LINK_LIBRARIES)
+        target_link_libraries(${_TARGET_NAME}
+            PRIVATE ${_add_natwm_benchmark_LINK_LIBRARIES}
+        )
+    endif()
+
+    add_custom_target(run_${_TARGET_NAME}
+        COMMAND ${_TARGET_NAME}
+        DEPENDS ${_TARGET_NAME}
+        COMMENT "Running ${_TARGET_NAME}"
+    )
+
+    add_dependencies(bench run_${_TARGET_NAME})
+endfunction(ADD_NATWM_BENCHMARK)
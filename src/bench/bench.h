@@ -0,0 +1,41 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/**
+ * Small helpers shared between the benchmarks
+ *
+ * Benchmarks print their results to stdout and are meant to be compared by a
+ * human. They should be run against a release build.
+ */
+
+// Results are written here so the compiler can't optimize benchmarked work
+// away
+static volatile uintptr_t bench_sink = 0;
+
+// Current monotonic time in nanoseconds
+static inline uint64_t bench_now(void)
+{
+        struct timespec time;
+
+        clock_gettime(CLOCK_MONOTONIC, &time);
+
+        return ((uint64_t)time.tv_sec * 1000000000ULL) + (uint64_t)time.tv_nsec;
+}
+
+// Mark a value as used
+static inline void bench_consume(uintptr_t value)
+{
+        bench_sink ^= value;
+}
+
+static inline double bench_ns_per_op(uint64_t start, uint64_t end, size_t operations)
+{
+        return (double)(end - start) / (double)operations;
+}
@@ -0,0 +1,138 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <common/string.h>
+#include <core/config/config.h>
+
+#include "bench.h"
+
+/**
+ * Measures parsing of long and deeply nested configuration arrays
+ *
+ * - long: a single array of numbers, one per line like a long rule list
+ * - nested: arrays nested DEPTH levels deep, where every level holds
+ *   ARRAY_BENCH_WIDTH numbers followed by the next level
+ *
+ * Each configuration is parsed ARRAY_BENCH_ROUNDS times. The time is also
+ * reported per byte of input, which stays flat as the input grows when
+ * parsing is linear
+ */
+
+#define ARRAY_BENCH_ROUNDS 16
+#define ARRAY_BENCH_WIDTH 100
+
+static const size_t LONG_LENGTHS[] = {1000, 10000, 100000};
+static const size_t NESTED_DEPTHS[] = {1, 2, 5, 10};
+
+static void append_or_exit(struct string_builder *builder, const char *string)
+{
+        if (string_builder_append(builder, string) != NO_ERROR) {
+                exit(EXIT_FAILURE);
+        }
+}
+
+static char *create_long_config(size_t length, size_t *size)
+{
+        struct string_builder builder;
+
+        string_builder_init(&builder);
+
+        append_or_exit(&builder, "rules = [\n");
+
+        for (size_t i = 0; i < length; ++i) {
+                if (string_builder_append_format(&builder, "\t%zu,\n", i) != NO_ERROR) {
+                        exit(EXIT_FAILURE);
+                }
+        }
+
+        append_or_exit(&builder, "]\n");
+
+        return string_builder_finish(&builder, size);
+}
+
+static void append_nested(struct string_builder *builder, size_t depth)
+{
+        append_or_exit(builder, "[");
+
+        for (size_t i = 0; i < ARRAY_BENCH_WIDTH; ++i) {
+                if (string_builder_append_format(builder, "%zu, ", i) != NO_ERROR) {
+                        exit(EXIT_FAILURE);
+                }
+        }
+
+        if (depth > 1) {
+                append_nested(builder, depth - 1);
+        }
+
+        append_or_exit(builder, "]");
+}
+
+static char *create_nested_config(size_t depth, size_t *size)
+{
+        struct string_builder builder;
+
+        string_builder_init(&builder);
+
+        append_or_exit(&builder, "nested = ");
+        append_nested(&builder, depth);
+        append_or_exit(&builder, "\n");
+
+        return string_builder_finish(&builder, size);
+}
+
+static void run(const char *name, size_t parameter, const char *config, size_t size)
+{
+        uint64_t start = bench_now();
+
+        for (size_t i = 0; i < ARRAY_BENCH_ROUNDS; ++i) {
+                struct map *map = config_read_string(config, size);
+
+                if (map == NULL) {
+                        exit(EXIT_FAILURE);
+                }
+
+                bench_consume((uintptr_t)map);
+
+                config_destroy(map);
+        }
+
+        uint64_t end = bench_now();
+        double ns_per_parse = bench_ns_per_op(start, end, ARRAY_BENCH_ROUNDS);
+
+        printf("%-8s %-10zu %-12zu %-16.1f %-8.2f\n",
+               name,
+               parameter,
+               size,
+               ns_per_parse / 1000.0,
+               ns_per_parse / (double)size);
+}
+
+int main(void)
+{
+        printf("Config arrays - %u parses each\n", ARRAY_BENCH_ROUNDS);
+        printf("%-8s %-10s %-12s %-16s %-8s\n", "array", "size", "bytes", "us/parse", "ns/byte");
+
+        for (size_t i = 0; i < sizeof(LONG_LENGTHS) / sizeof(LONG_LENGTHS[0]); ++i) {
+                size_t size = 0;
+                char *config = create_long_config(LONG_LENGTHS[i], &size);
+
+                run("long", LONG_LENGTHS[i], config, size);
+
+                free(config);
+        }
+
+        for (size_t i = 0; i < sizeof(NESTED_DEPTHS) / sizeof(NESTED_DEPTHS[0]); ++i) {
+                size_t size = 0;
+                char *config = create_nested_config(NESTED_DEPTHS[i], &size);
+
+                run("nested", NESTED_DEPTHS[i], config, size);
+
+                free(config);
+        }
+
+        return EXIT_SUCCESS;
+}
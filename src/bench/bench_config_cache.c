@@ -0,0 +1,181 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <common/logger.h>
+#include <common/string.h>
+#include <core/config/cache.h>
+#include <core/config/config.h>
+
+#include "bench.h"
+
+/**
+ * Measures the time until a configuration file is ready to use
+ *
+ * - parse: map and parse the file, which is how every start worked before
+ *   the cache
+ * - first: the first start with a new file, which parses it and saves the
+ *   cache
+ * - cached: later starts, which load the cache instead of parsing
+ *
+ * Configurations hold CACHE_BENCH_SECTION_ITEMS items per section, a mix of
+ * variables, strings, numbers, booleans and arrays. Only loading is timed,
+ * destroying the configuration afterwards is not
+ */
+
+#define CACHE_BENCH_ROUNDS 16
+#define CACHE_BENCH_SECTION_ITEMS 5
+
+static const size_t SECTION_COUNTS[] = {100, 1000, 10000, 50000};
+
+// Formats use the section index up to twice
+static void append_format_or_exit(struct string_builder *builder, const char *format, size_t i)
+{
+        if (string_builder_append_format(builder, format, i, i) != NO_ERROR) {
+                exit(EXIT_FAILURE);
+        }
+}
+
+static char *create_config(size_t section_count, size_t *size)
+{
+        struct string_builder builder;
+
+        string_builder_init(&builder);
+
+        for (size_t i = 0; i < section_count; ++i) {
+                append_format_or_exit(&builder, "$color_%zu = \"#%06zx\"\n", i);
+                append_format_or_exit(&builder, "section_%zu.color = $color_%zu\n", i);
+                append_format_or_exit(&builder, "section_%zu.name = \"Section\"\n", i);
+                append_format_or_exit(&builder, "section_%zu.width = %zu\n", i);
+                append_format_or_exit(&builder, "section_%zu.sticky = true\n", i);
+                append_format_or_exit(&builder, "section_%zu.offsets = [0, 0, 20, %zu]\n", i);
+        }
+
+        return string_builder_finish(&builder, size);
+}
+
+static void write_config(const char *path, const char *config, size_t size)
+{
+        FILE *file = fopen(path, "w");
+
+        if (file == NULL || fwrite(config, 1, size, file) != size || fclose(file) != 0) {
+                exit(EXIT_FAILURE);
+        }
+}
+
+static double time_parse(const char *path)
+{
+        uint64_t total = 0;
+
+        for (size_t i = 0; i < CACHE_BENCH_ROUNDS; ++i) {
+                uint64_t start = bench_now();
+                int fd = open(path, O_RDONLY);
+                struct map *map = config_read_fd(fd);
+
+                close(fd);
+
+                total += bench_now() - start;
+
+                if (map == NULL) {
+                        exit(EXIT_FAILURE);
+                }
+
+                bench_consume((uintptr_t)map);
+
+                config_destroy(map);
+        }
+
+        return bench_ns_per_op(0, total, CACHE_BENCH_ROUNDS);
+}
+
+static double time_initialize(const char *path, const char *cache_path, size_t rounds)
+{
+        uint64_t total = 0;
+
+        for (size_t i = 0; i < rounds; ++i) {
+                if (cache_path != NULL) {
+                        unlink(cache_path);
+                }
+
+                uint64_t start = bench_now();
+                struct map *map = config_initialize_path(path);
+
+                total += bench_now() - start;
+
+                if (map == NULL) {
+                        exit(EXIT_FAILURE);
+                }
+
+                bench_consume((uintptr_t)map);
+
+                config_destroy(map);
+        }
+
+        return bench_ns_per_op(0, total, rounds);
+}
+
+int main(void)
+{
+        char path[] = "/tmp/natwm_bench_config_XXXXXX";
+        int fd = mkstemp(path);
+
+        if (fd < 0) {
+                return EXIT_FAILURE;
+        }
+
+        close(fd);
+
+        char *cache_path = config_cache_path(path);
+
+        if (cache_path == NULL) {
+                return EXIT_FAILURE;
+        }
+
+        initialize_logger(false);
+        set_logging_quiet(natwm_logger, true);
+
+        printf("Time to config - %u loads each\n", CACHE_BENCH_ROUNDS);
+        printf("%-10s %-12s %-12s %-12s %-12s %-8s\n",
+               "sections",
+               "bytes",
+               "parse (ms)",
+               "first (ms)",
+               "cached (ms)",
+               "speedup");
+
+        for (size_t i = 0; i < sizeof(SECTION_COUNTS) / sizeof(SECTION_COUNTS[0]); ++i) {
+                size_t size = 0;
+                char *config = create_config(SECTION_COUNTS[i], &size);
+
+                write_config(path, config, size);
+
+                double parse_ns = time_parse(path);
+                double first_ns = time_initialize(path, cache_path, CACHE_BENCH_ROUNDS);
+
+                // The last first load left a cache behind
+                double cached_ns = time_initialize(path, NULL, CACHE_BENCH_ROUNDS);
+
+                printf("%-10zu %-12zu %-12.3f %-12.3f %-12.3f %-8.2f\n",
+                       SECTION_COUNTS[i],
+                       size,
+                       parse_ns / 1000000.0,
+                       first_ns / 1000000.0,
+                       cached_ns / 1000000.0,
+                       parse_ns / cached_ns);
+
+                free(config);
+        }
+
+        unlink(path);
+        unlink(cache_path);
+        free(cache_path);
+        destroy_logger(natwm_logger);
+
+        return EXIT_SUCCESS;
+}
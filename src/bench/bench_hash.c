@@ -0,0 +1,236 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <common/map.h>
+
+#include "bench.h"
+
+/**
+ * Compares the map hashing functions on the kinds of keys natwm uses
+ *
+ * - config: keys shaped like configuration keys ("section.item")
+ * - window: 4 byte X window ids, allocated in runs from a few client id bases
+ *
+ * Throughput is reported per hash and as MB/s of key data. Distribution is
+ * measured by reducing each hash to a bucket in a table of the next power of 2
+ * above the key count (the way the map does) and reporting the chi-squared
+ * statistic divided by the number of buckets, which should be close to 1 for
+ * a good hash, along with the fullest bucket
+ */
+
+#define HASH_BENCH_KEY_COUNT 4096
+#define HASH_BENCH_ROUNDS 512
+#define HASH_BENCH_KEY_SIZE 48
+#define HASH_BENCH_SEED 0x5eed
+
+static const char *config_sections[] = {
+        "window",
+        "window.focused",
+        "window.unfocused",
+        "window.urgent",
+        "workspace",
+        "monitor",
+        "button",
+        "theme",
+};
+
+static const char *config_items[] = {
+        "border_width",
+        "border_color",
+        "background_color",
+        "offsets",
+        "names",
+        "count",
+        "sticky",
+        "mouse_modifier",
+};
+
+struct key_set {
+        const char *name;
+        const void **keys;
+        size_t *sizes;
+        size_t count;
+        size_t total_bytes;
+};
+
+static void key_set_init(struct key_set *set, const char *name)
+{
+        set->name = name;
+        set->keys = malloc(sizeof(void *) * HASH_BENCH_KEY_COUNT);
+        set->sizes = malloc(sizeof(size_t) * HASH_BENCH_KEY_COUNT);
+        set->count = HASH_BENCH_KEY_COUNT;
+        set->total_bytes = 0;
+
+        if (set->keys == NULL || set->sizes == NULL) {
+                exit(EXIT_FAILURE);
+        }
+}
+
+static void create_config_keys(struct key_set *set)
+{
+        size_t section_count = sizeof(config_sections) / sizeof(config_sections[0]);
+        size_t item_count = sizeof(config_items) / sizeof(config_items[0]);
+
+        key_set_init(set, "config");
+
+        for (size_t i = 0; i < set->count; ++i) {
+                char *key = malloc(HASH_BENCH_KEY_SIZE);
+
+                if (key == NULL) {
+                        exit(EXIT_FAILURE);
+                }
+
+                snprintf(key,
+                         HASH_BENCH_KEY_SIZE,
+                         "%s_%zu.%s",
+                         config_sections[i % section_count],
+                         i / (section_count * item_count),
+                         config_items[(i / section_count) % item_count]);
+
+                set->keys[i] = key;
+                set->sizes[i] = strlen(key);
+                set->total_bytes += set->sizes[i];
+        }
+}
+
+static void create_window_keys(struct key_set *set)
+{
+        key_set_init(set, "window");
+
+        for (size_t i = 0; i < set->count; ++i) {
+                uint32_t *key = malloc(sizeof(uint32_t));
+
+                if (key == NULL) {
+                        exit(EXIT_FAILURE);
+                }
+
+                // X hands every client a resource id base, windows created by
+                // a client are numbered from it
+                *key = (uint32_t)(((i % 16) + 1) << 21U) | (uint32_t)(i / 16);
+
+                set->keys[i] = key;
+                set->sizes[i] = sizeof(uint32_t);
+                set->total_bytes += sizeof(uint32_t);
+        }
+}
+
+static void key_set_destroy(struct key_set *set)
+{
+        for (size_t i = 0; i < set->count; ++i) {
+                free((void *)set->keys[i]);
+        }
+
+        free(set->keys);
+        free(set->sizes);
+}
+
+static double time_hash(map_hash_function_t function, const struct key_set *set)
+{
+        uint32_t result = 0;
+        uint64_t start = bench_now();
+
+        for (size_t round = 0; round < HASH_BENCH_ROUNDS; ++round) {
+                for (size_t i = 0; i < set->count; ++i) {
+                        result ^= function(set->keys[i], set->sizes[i], HASH_BENCH_SEED);
+                }
+        }
+
+        uint64_t end = bench_now();
+
+        bench_consume(result);
+
+        return bench_ns_per_op(start, end, set->count * HASH_BENCH_ROUNDS);
+}
+
+static void measure_distribution(map_hash_function_t function, const struct key_set *set,
+                                 double *chi_squared, uint32_t *max_load)
+{
+        size_t bucket_count = 1;
+
+        while (bucket_count < set->count) {
+                bucket_count <<= 1U;
+        }
+
+        uint32_t *buckets = calloc(bucket_count, sizeof(uint32_t));
+
+        if (buckets == NULL) {
+                exit(EXIT_FAILURE);
+        }
+
+        for (size_t i = 0; i < set->count; ++i) {
+                uint32_t hash = function(set->keys[i], set->sizes[i], HASH_BENCH_SEED);
+
+                ++buckets[hash & (bucket_count - 1)];
+        }
+
+        double expected = (double)set->count / (double)bucket_count;
+        double sum = 0.0;
+
+        *max_load = 0;
+
+        for (size_t i = 0; i < bucket_count; ++i) {
+                double difference = (double)buckets[i] - expected;
+
+                sum += (difference * difference) / expected;
+
+                if (buckets[i] > *max_load) {
+                        *max_load = buckets[i];
+                }
+        }
+
+        *chi_squared = sum / (double)bucket_count;
+
+        free(buckets);
+}
+
+static void run(const char *name, map_hash_function_t function, const struct key_set *set)
+{
+        double ns_per_hash = time_hash(function, set);
+        double bytes_per_key = (double)set->total_bytes / (double)set->count;
+        double chi_squared = 0.0;
+        uint32_t max_load = 0;
+
+        measure_distribution(function, set, &chi_squared, &max_load);
+
+        printf("%-8s %-10s %-14.2f %-10.1f %-12.3f %-8u\n",
+               set->name,
+               name,
+               ns_per_hash,
+               (bytes_per_key * 1000.0) / ns_per_hash,
+               chi_squared,
+               max_load);
+}
+
+int main(void)
+{
+        struct key_set config_keys;
+        struct key_set window_keys;
+
+        create_config_keys(&config_keys);
+        create_window_keys(&window_keys);
+
+        printf("Hash functions - %u keys, %u rounds\n", HASH_BENCH_KEY_COUNT, HASH_BENCH_ROUNDS);
+        printf("%-8s %-10s %-14s %-10s %-12s %-8s\n",
+               "keys",
+               "hash",
+               "ns/hash",
+               "MB/s",
+               "chi2/bucket",
+               "max");
+
+        run("murmur3", map_hash_murmur3, &config_keys);
+        run("wyhash", map_hash_wyhash, &config_keys);
+        run("murmur3", map_hash_murmur3, &window_keys);
+        run("wyhash", map_hash_wyhash, &window_keys);
+        run("integer", map_hash_integer, &window_keys);
+
+        key_set_destroy(&config_keys);
+        key_set_destroy(&window_keys);
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,156 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <common/map.h>
+
+#include "bench.h"
+
+/**
+ * Compares lookups in the robin hood map against the group probing map
+ *
+ * Both maps are filled to a fixed length at a range of load factors, then
+ * timed for successful lookups (hits) and unsuccessful lookups (misses) of
+ * string keys
+ */
+
+#define MAP_BENCH_LENGTH (1U << 16U)
+#define MAP_BENCH_LOOKUPS (1U << 22U)
+#define MAP_BENCH_KEY_SIZE 32
+
+static const double LOAD_FACTORS[] = {0.2, 0.35, 0.5, 0.65, 0.75};
+
+static char **create_keys(const char *prefix, size_t count)
+{
+        char **keys = malloc(sizeof(char *) * count);
+
+        if (keys == NULL) {
+                return NULL;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+                keys[i] = malloc(MAP_BENCH_KEY_SIZE);
+
+                if (keys[i] == NULL) {
+                        exit(EXIT_FAILURE);
+                }
+
+                snprintf(keys[i], MAP_BENCH_KEY_SIZE, "%s.item_%zu", prefix, i);
+        }
+
+        return keys;
+}
+
+static void destroy_keys(char **keys, size_t count)
+{
+        for (size_t i = 0; i < count; ++i) {
+                free(keys[i]);
+        }
+
+        free(keys);
+}
+
+// Grow a map until it reaches length, then insert or delete keys until the
+// requested load factor is reached
+static struct map *create_map(bool use_groups, char **keys, uint32_t length, double load_factor)
+{
+        struct map *map = map_init();
+
+        if (map == NULL) {
+                return NULL;
+        }
+
+        map_set_setting_flag(map, MAP_FLAG_NO_LOCKING);
+
+        if (use_groups && map_enable_group_probing(map) != 0) {
+                map_destroy(map);
+
+                return NULL;
+        }
+
+        size_t target = (size_t)(load_factor * length);
+        size_t inserted = 0;
+
+        while (map->length < length) {
+                map_insert(map, keys[inserted], keys[inserted]);
+
+                ++inserted;
+        }
+
+        map_set_setting_flag(map, MAP_FLAG_IGNORE_THRESHOLDS);
+
+        for (; inserted < target; ++inserted) {
+                map_insert(map, keys[inserted], keys[inserted]);
+        }
+
+        while (inserted > target) {
+                --inserted;
+
+                map_delete(map, keys[inserted]);
+        }
+
+        return map;
+}
+
+static double time_lookups(const struct map *map, char **keys, size_t key_count)
+{
+        uint64_t start = bench_now();
+
+        for (size_t i = 0; i < MAP_BENCH_LOOKUPS; ++i) {
+                const struct map_entry *entry = map_get(map, keys[i % key_count]);
+
+                bench_consume((uintptr_t)entry);
+        }
+
+        return bench_ns_per_op(start, bench_now(), MAP_BENCH_LOOKUPS);
+}
+
+int main(void)
+{
+        char **keys = create_keys("config", MAP_BENCH_LENGTH);
+        char **missing_keys = create_keys("missing", MAP_BENCH_LENGTH);
+
+        if (keys == NULL || missing_keys == NULL) {
+                return EXIT_FAILURE;
+        }
+
+        printf("Map lookups - %u slots, %u lookups per run (ns/op)\n",
+               MAP_BENCH_LENGTH,
+               MAP_BENCH_LOOKUPS);
+        printf("%-12s %-14s %-14s %-14s %-14s\n",
+               "load factor",
+               "robin (hit)",
+               "group (hit)",
+               "robin (miss)",
+               "group (miss)");
+
+        for (size_t i = 0; i < sizeof(LOAD_FACTORS) / sizeof(LOAD_FACTORS[0]); ++i) {
+                double load_factor = LOAD_FACTORS[i];
+                size_t present = (size_t)(load_factor * MAP_BENCH_LENGTH);
+                struct map *robin_map = create_map(false, keys, MAP_BENCH_LENGTH, load_factor);
+                struct map *group_map = create_map(true, keys, MAP_BENCH_LENGTH, load_factor);
+
+                if (robin_map == NULL || group_map == NULL) {
+                        return EXIT_FAILURE;
+                }
+
+                printf("%-12.2f %-14.2f %-14.2f %-14.2f %-14.2f\n",
+                       load_factor,
+                       time_lookups(robin_map, keys, present),
+                       time_lookups(group_map, keys, present),
+                       time_lookups(robin_map, missing_keys, MAP_BENCH_LENGTH),
+                       time_lookups(group_map, missing_keys, MAP_BENCH_LENGTH));
+
+                map_destroy(robin_map);
+                map_destroy(group_map);
+        }
+
+        destroy_keys(keys, MAP_BENCH_LENGTH);
+        destroy_keys(missing_keys, MAP_BENCH_LENGTH);
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,185 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <common/map.h>
+
+#include "bench.h"
+
+/**
+ * Compares lookups in a live map against the same map after map_freeze
+ *
+ * The keys are shaped like configuration keys ("section.item") and the map
+ * is the size of a large configuration file. Lookups cycle over every key so
+ * the whole table is touched
+ */
+
+#define FREEZE_BENCH_KEY_COUNT 1000
+#define FREEZE_BENCH_LOOKUPS (1U << 22U)
+#define FREEZE_BENCH_KEY_SIZE 48
+
+static char **create_keys(const char *prefix, size_t count)
+{
+        char **keys = malloc(sizeof(char *) * count);
+
+        if (keys == NULL) {
+                return NULL;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+                keys[i] = malloc(FREEZE_BENCH_KEY_SIZE);
+
+                if (keys[i] == NULL) {
+                        exit(EXIT_FAILURE);
+                }
+
+                snprintf(keys[i],
+                         FREEZE_BENCH_KEY_SIZE,
+                         "%s_%zu.border_color_%zu",
+                         prefix,
+                         i / 16,
+                         i % 16);
+        }
+
+        return keys;
+}
+
+static void destroy_keys(char **keys, size_t count)
+{
+        for (size_t i = 0; i < count; ++i) {
+                free(keys[i]);
+        }
+
+        free(keys);
+}
+
+static struct map *create_map(char **keys, size_t count)
+{
+        struct map *map = map_init();
+
+        if (map == NULL) {
+                return NULL;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+                map_insert(map, keys[i], keys[i]);
+        }
+
+        return map;
+}
+
+// Bytes used by the map itself, not counting keys and values
+static size_t map_footprint(const struct map *map)
+{
+        size_t size = sizeof(struct map) + (map->length * sizeof(struct map_entry));
+
+        if (map->frozen != NULL) {
+                size += sizeof(struct map_frozen) + (map->frozen->bucket_count * sizeof(uint32_t));
+        }
+
+        return size;
+}
+
+static double time_prehashed_lookups(const struct map *map, const struct map_key_handle *handles,
+                                     size_t key_count)
+{
+        uint64_t start = bench_now();
+
+        for (size_t i = 0; i < FREEZE_BENCH_LOOKUPS; ++i) {
+                const struct map_entry *entry = map_get_prehashed(map, &handles[i % key_count]);
+
+                bench_consume((uintptr_t)entry);
+        }
+
+        return bench_ns_per_op(start, bench_now(), FREEZE_BENCH_LOOKUPS);
+}
+
+static double time_lookups(const struct map *map, char **keys, size_t key_count)
+{
+        uint64_t start = bench_now();
+
+        for (size_t i = 0; i < FREEZE_BENCH_LOOKUPS; ++i) {
+                const struct map_entry *entry = map_get(map, keys[i % key_count]);
+
+                bench_consume((uintptr_t)entry);
+        }
+
+        return bench_ns_per_op(start, bench_now(), FREEZE_BENCH_LOOKUPS);
+}
+
+int main(void)
+{
+        char **keys = create_keys("workspace", FREEZE_BENCH_KEY_COUNT);
+        char **missing_keys = create_keys("monitor", FREEZE_BENCH_KEY_COUNT);
+
+        if (keys == NULL || missing_keys == NULL) {
+                return EXIT_FAILURE;
+        }
+
+        struct map *live_map = create_map(keys, FREEZE_BENCH_KEY_COUNT);
+        struct map *frozen_map = create_map(keys, FREEZE_BENCH_KEY_COUNT);
+
+        if (live_map == NULL || frozen_map == NULL) {
+                return EXIT_FAILURE;
+        }
+
+        // Each map has it's own hash seed, so each needs it's own handles
+        size_t handles_size = sizeof(struct map_key_handle) * FREEZE_BENCH_KEY_COUNT;
+        struct map_key_handle *live_handles = malloc(handles_size);
+        struct map_key_handle *frozen_handles = malloc(handles_size);
+
+        if (live_handles == NULL || frozen_handles == NULL) {
+                return EXIT_FAILURE;
+        }
+
+        for (size_t i = 0; i < FREEZE_BENCH_KEY_COUNT; ++i) {
+                map_key_handle_init(live_map, keys[i], &live_handles[i]);
+                map_key_handle_init(frozen_map, keys[i], &frozen_handles[i]);
+        }
+
+        uint64_t freeze_start = bench_now();
+
+        if (map_freeze(frozen_map) != NO_ERROR) {
+                fprintf(stderr, "Failed to freeze map\n");
+
+                return EXIT_FAILURE;
+        }
+
+        uint64_t freeze_end = bench_now();
+
+        printf("Frozen map - %u keys, %u lookups per run\n",
+               FREEZE_BENCH_KEY_COUNT,
+               FREEZE_BENCH_LOOKUPS);
+        printf("Freezing took %.2f us\n", (double)(freeze_end - freeze_start) / 1000.0);
+        printf("%-8s %-14s %-14s %-18s %-14s\n",
+               "map",
+               "hit (ns/op)",
+               "miss (ns/op)",
+               "prehashed (ns/op)",
+               "bytes");
+        printf("%-8s %-14.2f %-14.2f %-18.2f %-14zu\n",
+               "live",
+               time_lookups(live_map, keys, FREEZE_BENCH_KEY_COUNT),
+               time_lookups(live_map, missing_keys, FREEZE_BENCH_KEY_COUNT),
+               time_prehashed_lookups(live_map, live_handles, FREEZE_BENCH_KEY_COUNT),
+               map_footprint(live_map));
+        printf("%-8s %-14.2f %-14.2f %-18.2f %-14zu\n",
+               "frozen",
+               time_lookups(frozen_map, keys, FREEZE_BENCH_KEY_COUNT),
+               time_lookups(frozen_map, missing_keys, FREEZE_BENCH_KEY_COUNT),
+               time_prehashed_lookups(frozen_map, frozen_handles, FREEZE_BENCH_KEY_COUNT),
+               map_footprint(frozen_map));
+
+        map_destroy(live_map);
+        map_destroy(frozen_map);
+
+        free(live_handles);
+        free(frozen_handles);
+        destroy_keys(keys, FREEZE_BENCH_KEY_COUNT);
+        destroy_keys(missing_keys, FREEZE_BENCH_KEY_COUNT);
+
+        return EXIT_SUCCESS;
+}
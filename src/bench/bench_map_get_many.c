@@ -0,0 +1,153 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <common/map.h>
+
+#include "bench.h"
+
+/**
+ * Compares map_get_many against calling map_get for each key
+ *
+ * Maps are filled with string keys, from one small enough to stay in cache
+ * to one far larger than L2. Keys are looked up in a random order, in groups
+ * of MANY_BENCH_GROUP_SIZE keys. The lookups use the inserted key pointers so
+ * no key comparisons take place, leaving the cache misses on the entries
+ * array as the main cost
+ */
+
+#define MANY_BENCH_LOOKUPS (1U << 22U)
+#define MANY_BENCH_GROUP_SIZE 64
+#define MANY_BENCH_KEY_SIZE 32
+
+static const uint32_t KEY_COUNTS[] = {1U << 10U, 1U << 14U, 1U << 18U, 1U << 21U};
+
+static char **create_keys(size_t count)
+{
+        char **keys = malloc(sizeof(char *) * count);
+
+        if (keys == NULL) {
+                exit(EXIT_FAILURE);
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+                keys[i] = malloc(MANY_BENCH_KEY_SIZE);
+
+                if (keys[i] == NULL) {
+                        exit(EXIT_FAILURE);
+                }
+
+                snprintf(keys[i], MANY_BENCH_KEY_SIZE, "client_%zu.window", i);
+        }
+
+        return keys;
+}
+
+static void destroy_keys(char **keys, size_t count)
+{
+        for (size_t i = 0; i < count; ++i) {
+                free(keys[i]);
+        }
+
+        free(keys);
+}
+
+// A random lookup order, so every lookup is likely to miss the cache once the
+// map is large enough
+static const void **create_lookups(char **keys, size_t count)
+{
+        const void **lookups = malloc(sizeof(void *) * MANY_BENCH_LOOKUPS);
+
+        if (lookups == NULL) {
+                exit(EXIT_FAILURE);
+        }
+
+        uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+        for (size_t i = 0; i < MANY_BENCH_LOOKUPS; ++i) {
+                // xorshift64
+                state ^= state << 13U;
+                state ^= state >> 7U;
+                state ^= state << 17U;
+
+                lookups[i] = keys[state % count];
+        }
+
+        return lookups;
+}
+
+static double time_get(const struct map *map, const void **lookups)
+{
+        uint64_t start = bench_now();
+
+        for (size_t i = 0; i < MANY_BENCH_LOOKUPS; ++i) {
+                const struct map_entry *entry = map_get(map, lookups[i]);
+
+                bench_consume((uintptr_t)entry->value);
+        }
+
+        return bench_ns_per_op(start, bench_now(), MANY_BENCH_LOOKUPS);
+}
+
+static double time_get_many(const struct map *map, const void **lookups)
+{
+        struct map_entry *results[MANY_BENCH_GROUP_SIZE];
+        uint64_t start = bench_now();
+
+        for (size_t i = 0; i < MANY_BENCH_LOOKUPS; i += MANY_BENCH_GROUP_SIZE) {
+                map_get_many(map, &lookups[i], MANY_BENCH_GROUP_SIZE, results);
+
+                for (size_t j = 0; j < MANY_BENCH_GROUP_SIZE; ++j) {
+                        bench_consume((uintptr_t)results[j]->value);
+                }
+        }
+
+        return bench_ns_per_op(start, bench_now(), MANY_BENCH_LOOKUPS);
+}
+
+int main(void)
+{
+        printf("Batched lookups - %u lookups in groups of %u\n",
+               MANY_BENCH_LOOKUPS,
+               MANY_BENCH_GROUP_SIZE);
+        printf("%-10s %-14s %-16s %-18s %-8s\n",
+               "keys",
+               "table (KiB)",
+               "map_get (ns/op)",
+               "map_get_many (ns/op)",
+               "speedup");
+
+        for (size_t i = 0; i < sizeof(KEY_COUNTS) / sizeof(KEY_COUNTS[0]); ++i) {
+                uint32_t count = KEY_COUNTS[i];
+                char **keys = create_keys(count);
+                struct map *map = map_init();
+
+                if (map == NULL) {
+                        return EXIT_FAILURE;
+                }
+
+                for (size_t j = 0; j < count; ++j) {
+                        map_insert(map, keys[j], keys[j]);
+                }
+
+                const void **lookups = create_lookups(keys, count);
+                double get_ns = time_get(map, lookups);
+                double get_many_ns = time_get_many(map, lookups);
+
+                printf("%-10u %-14zu %-16.2f %-18.2f %-8.2f\n",
+                       count,
+                       (map->length * sizeof(struct map_entry)) / 1024,
+                       get_ns,
+                       get_many_ns,
+                       get_ns / get_many_ns);
+
+                free(lookups);
+                map_destroy(map);
+                destroy_keys(keys, count);
+        }
+
+        return EXIT_SUCCESS;
+}
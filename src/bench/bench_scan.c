@@ -0,0 +1,238 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <common/scan.h>
+
+#include "bench.h"
+
+/**
+ * Compares the scan kernels against the byte at a time loops they replaced
+ *
+ * The input is a large generated configuration file. Each test walks the
+ * whole buffer the way the config parser does:
+ *
+ * - lines: find every new line, one after another
+ * - spaces: skip the indentation and blank space at the start of each line
+ * - classify: count the structural characters (the lexer's view of the file)
+ *
+ * Results are reported as MB/s of configuration processed
+ */
+
+#define SCAN_BENCH_SIZE (4U << 20U)
+#define SCAN_BENCH_ROUNDS 16
+
+static const char *config_lines[] = {
+        "# Window settings\n",
+        "window.border_width = 2\n",
+        "window.focused.border_color = \"#ffffff\"\n",
+        "\n",
+        "workspace.names = [\"one\", \"two\", \"three\", \"four\", \"five\"]\n",
+        "    monitor.offsets = [\n",
+        "        [0, 0, 0, 0],\n",
+        "        [10, 10, 10, 10],\n",
+        "    ]\n",
+        "$variable = \"some longer value used by several items\"\n",
+};
+
+static char *create_config(size_t *length)
+{
+        size_t line_count = sizeof(config_lines) / sizeof(config_lines[0]);
+        char *buffer = malloc(SCAN_BENCH_SIZE + 1);
+        size_t used = 0;
+
+        if (buffer == NULL) {
+                exit(EXIT_FAILURE);
+        }
+
+        for (size_t i = 0;; ++i) {
+                const char *line = config_lines[i % line_count];
+                size_t line_length = strlen(line);
+
+                if (used + line_length > SCAN_BENCH_SIZE) {
+                        break;
+                }
+
+                memcpy(buffer + used, line, line_length);
+
+                used += line_length;
+        }
+
+        buffer[used] = '\0';
+        *length = used;
+
+        return buffer;
+}
+
+static size_t lines_loop(const char *buffer, size_t length)
+{
+        size_t count = 0;
+        size_t offset = 0;
+
+        while (offset < length) {
+                while (offset < length && buffer[offset] != '\n') {
+                        ++offset;
+                }
+
+                ++offset;
+                ++count;
+        }
+
+        return count;
+}
+
+static size_t lines_scan(const char *buffer, size_t length)
+{
+        size_t count = 0;
+        size_t offset = 0;
+
+        while (offset < length) {
+                offset += scan_find_char(buffer + offset, length - offset, '\n') + 1;
+
+                ++count;
+        }
+
+        return count;
+}
+
+static size_t spaces_loop(const char *buffer, size_t length)
+{
+        size_t skipped = 0;
+        size_t offset = 0;
+
+        while (offset < length) {
+                size_t start = offset;
+
+                while (offset < length && isspace((unsigned char)buffer[offset])) {
+                        ++offset;
+                }
+
+                skipped += offset - start;
+
+                // Jump to the next line
+                while (offset < length && buffer[offset] != '\n') {
+                        ++offset;
+                }
+        }
+
+        return skipped;
+}
+
+static size_t spaces_scan(const char *buffer, size_t length)
+{
+        size_t skipped = 0;
+        size_t offset = 0;
+
+        while (offset < length) {
+                size_t count = scan_find_first_nonspace(buffer + offset, length - offset);
+
+                skipped += count;
+                offset += count;
+                offset += scan_find_char(buffer + offset, length - offset, '\n');
+        }
+
+        return skipped;
+}
+
+static size_t classify_loop(const char *buffer, size_t length)
+{
+        size_t count = 0;
+
+        for (size_t i = 0; i < length; ++i) {
+                switch (buffer[i]) {
+                case '\n':
+                case '=':
+                case ',':
+                case '[':
+                case ']':
+                case '"':
+                case '#':
+                        ++count;
+                        break;
+                default:
+                        break;
+                }
+        }
+
+        return count;
+}
+
+static size_t classify_scan(const char *buffer, size_t length)
+{
+        size_t count = 0;
+
+        for (size_t offset = 0; offset < length; offset += SCAN_BLOCK_SIZE) {
+                struct scan_masks masks;
+
+                scan_block(buffer + offset, length - offset, &masks);
+
+                uint32_t structural = masks.new_line | masks.equal | masks.comma
+                        | masks.array_start | masks.array_end | masks.quote | masks.comment;
+
+                count += (size_t)__builtin_popcount(structural);
+        }
+
+        return count;
+}
+
+static double time_mb_per_second(size_t (*function)(const char *, size_t), const char *buffer,
+                                 size_t length, size_t *result)
+{
+        uint64_t start = bench_now();
+
+        for (size_t round = 0; round < SCAN_BENCH_ROUNDS; ++round) {
+                *result = function(buffer, length);
+
+                bench_consume(*result);
+        }
+
+        double seconds = (double)(bench_now() - start) / 1e9;
+
+        return ((double)length * SCAN_BENCH_ROUNDS) / (seconds * 1e6);
+}
+
+static void run(const char *name, size_t (*loop)(const char *, size_t),
+                size_t (*scan)(const char *, size_t), const char *buffer, size_t length)
+{
+        size_t loop_result = 0;
+        size_t scan_result = 0;
+        double loop_mb = time_mb_per_second(loop, buffer, length, &loop_result);
+        double scan_mb = time_mb_per_second(scan, buffer, length, &scan_result);
+
+        if (loop_result != scan_result) {
+                fprintf(stderr,
+                        "%s: results differ (%zu != %zu)\n",
+                        name,
+                        loop_result,
+                        scan_result);
+
+                exit(EXIT_FAILURE);
+        }
+
+        printf("%-10s %-16.1f %-16.1f %-8.2f\n", name, loop_mb, scan_mb, scan_mb / loop_mb);
+}
+
+int main(void)
+{
+        size_t length = 0;
+        char *buffer = create_config(&length);
+
+        printf("Byte scanning - %zu KiB config, %u rounds, %s kernels\n",
+               length / 1024,
+               SCAN_BENCH_ROUNDS,
+               scan_backend_name());
+        printf("%-10s %-16s %-16s %-8s\n", "test", "loop (MB/s)", "scan (MB/s)", "speedup");
+
+        run("lines", lines_loop, lines_scan, buffer, length);
+        run("spaces", spaces_loop, spaces_scan, buffer, length);
+        run("classify", classify_loop, classify_scan, buffer, length);
+
+        free(buffer);
+
+        return EXIT_SUCCESS;
+}
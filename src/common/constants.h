@@ -9,11 +9,25 @@
 #define ATTR_NONNULL __attribute__((__nonnull__))
 #define ATTR_PURE __attribute__((__pure__))
 #define ATTR_INLINE inline __attribute__((always_inline))
+#define ATTR_FORMAT_PRINTF(format_index, args_index)                                               \
+        __attribute__((__format__(__printf__, format_index, args_index)))
+#define PREFETCH_READ(address) __builtin_prefetch((address), 0, 3)
 #else
 #define ATTR_CONT
 #define ATTR_NONNULL
 #define ATTR_PURE
 #define ATTR_INLINE inline
+#define ATTR_FORMAT_PRINTF(format_index, args_index)
+#define PREFETCH_READ(address) (void)(address)
+#endif
+
+// Hint to the CPU that the caller is spinning while waiting on another thread
+#if (defined __clang__ || defined __GNUC__) && (defined __x86_64__ || defined __i386__)
+#define CPU_RELAX() __builtin_ia32_pause()
+#elif (defined __clang__ || defined __GNUC__) && defined __aarch64__
+#define CPU_RELAX() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define CPU_RELAX() (void)0
 #endif
 
 #define UNUSED_FUNCTION_PARAM(param) (void)(param)
@@ -32,6 +46,8 @@
 #define SUPPORTING_WINDOW_CLASS_NAME "supporting_window\0" NATWM_VERSION_STRING
 #define RESIZE_HELPER_WINDOW_CLASS_NAME "resize_helper_window\0" NATWM_VERSION_STRING
 
+#define NATWM_RELOAD_ATOM_NAME "_NATWM_RELOAD"
+
 #define NATWM_WORKSPACE_COUNT 10
 
 #define NATWM_WORKSPACE_NAME_MAX_LEN 50
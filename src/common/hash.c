@@ -2,6 +2,8 @@
 // Licensed under BSD-3-Clause
 // Refer to the license.txt file included in the root of the project
 
+#include <string.h>
+
 #include "hash.h"
 #include "constants.h"
 
@@ -73,3 +75,140 @@ ATTR_CONST uint32_t hash_murmur3_32(const void *data, size_t len, uint32_t seed)
 
         return hash;
 }
+
+// wyhash secret, the default parameters used by the reference implementation
+static const uint64_t wyhash_secret[4] = {
+        0x2d358dccaa6c78a5ULL,
+        0x8bb84b93962eacc9ULL,
+        0x4b33a62ed433d4a3ULL,
+        0x4d5a2da51de1aa47ULL,
+};
+
+// Multiply two 64 bit integers, leaving the low half of the 128 bit product
+// in a and the high half in b
+static ATTR_INLINE void wyhash_multiply(uint64_t *a, uint64_t *b)
+{
+#if defined(__SIZEOF_INT128__)
+        __extension__ typedef unsigned __int128 wyhash_uint128;
+
+        wyhash_uint128 product = (wyhash_uint128)*a * *b;
+
+        *a = (uint64_t)product;
+        *b = (uint64_t)(product >> 64U);
+#else
+        uint64_t a_high = *a >> 32U;
+        uint64_t a_low = (uint32_t)*a;
+        uint64_t b_high = *b >> 32U;
+        uint64_t b_low = (uint32_t)*b;
+        uint64_t high_high = a_high * b_high;
+        uint64_t high_low = a_high * b_low;
+        uint64_t low_high = a_low * b_high;
+        uint64_t low_low = a_low * b_low;
+        uint64_t middle = (low_low >> 32U) + (uint32_t)high_low + (uint32_t)low_high;
+
+        *a = (middle << 32U) | (uint32_t)low_low;
+        *b = high_high + (high_low >> 32U) + (low_high >> 32U) + (middle >> 32U);
+#endif
+}
+
+static ATTR_INLINE uint64_t wyhash_mix(uint64_t a, uint64_t b)
+{
+        wyhash_multiply(&a, &b);
+
+        return a ^ b;
+}
+
+// Reads use the native byte order, hashes are not meant to be stored or shared
+// between machines
+static ATTR_INLINE uint64_t wyhash_read64(const uint8_t *p)
+{
+        uint64_t value = 0;
+
+        memcpy(&value, p, sizeof(value));
+
+        return value;
+}
+
+static ATTR_INLINE uint64_t wyhash_read32(const uint8_t *p)
+{
+        uint32_t value = 0;
+
+        memcpy(&value, p, sizeof(value));
+
+        return value;
+}
+
+// Read 1 to 3 bytes
+static ATTR_INLINE uint64_t wyhash_read_small(const uint8_t *p, size_t len)
+{
+        return ((uint64_t)p[0] << 16U) | ((uint64_t)p[len >> 1U] << 8U) | p[len - 1];
+}
+
+/**
+ * A 64 bit hash based on wyhash (final version 4)
+ *
+ * Originally written by Wang Yi https://github.com/wangyi-fudan/wyhash
+ *
+ * The reference implementation is public domain (The Unlicense).
+ *
+ * Keys of up to 16 bytes are hashed without a loop using at most four
+ * overlapping reads, which makes this much faster than murmur3 for the short
+ * keys used throughout natwm
+ */
+ATTR_PURE uint64_t hash_wyhash_64(const void *data, size_t len, uint64_t seed)
+{
+        const uint8_t *p = (const uint8_t *)data;
+        uint64_t a = 0;
+        uint64_t b = 0;
+
+        seed ^= wyhash_mix(seed ^ wyhash_secret[0], wyhash_secret[1]);
+
+        if (len <= 16) {
+                if (len >= 4) {
+                        size_t offset = (len >> 3U) << 2U;
+
+                        a = (wyhash_read32(p) << 32U) | wyhash_read32(p + offset);
+                        b = (wyhash_read32(p + len - 4) << 32U)
+                            | wyhash_read32(p + len - 4 - offset);
+                } else if (len > 0) {
+                        a = wyhash_read_small(p, len);
+                }
+        } else {
+                size_t remaining = len;
+
+                if (remaining > 48) {
+                        uint64_t seed_one = seed;
+                        uint64_t seed_two = seed;
+
+                        do {
+                                seed = wyhash_mix(wyhash_read64(p) ^ wyhash_secret[1],
+                                                  wyhash_read64(p + 8) ^ seed);
+                                seed_one = wyhash_mix(wyhash_read64(p + 16) ^ wyhash_secret[2],
+                                                      wyhash_read64(p + 24) ^ seed_one);
+                                seed_two = wyhash_mix(wyhash_read64(p + 32) ^ wyhash_secret[3],
+                                                      wyhash_read64(p + 40) ^ seed_two);
+                                p += 48;
+                                remaining -= 48;
+                        } while (remaining > 48);
+
+                        seed ^= seed_one ^ seed_two;
+                }
+
+                while (remaining > 16) {
+                        seed = wyhash_mix(wyhash_read64(p) ^ wyhash_secret[1],
+                                          wyhash_read64(p + 8) ^ seed);
+                        p += 16;
+                        remaining -= 16;
+                }
+
+                a = wyhash_read64(p + remaining - 16);
+                b = wyhash_read64(p + remaining - 8);
+        }
+
+        a ^= wyhash_secret[1];
+        b ^= seed;
+
+        wyhash_multiply(&a, &b);
+
+        return wyhash_mix(a ^ wyhash_secret[0] ^ len, b ^ wyhash_secret[1]);
+}
@@ -7,4 +7,47 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "constants.h"
+
 uint32_t hash_murmur3_32(const void *data, size_t len, uint32_t seed);
+uint64_t hash_wyhash_64(const void *data, size_t len, uint64_t seed);
+
+/**
+ * Mix the bits of a 32 bit integer
+ *
+ * This is the finalizer used by murmur3. It is a bijection so distinct keys
+ * never collide before they are reduced to a bucket index
+ */
+static ATTR_INLINE uint32_t hash_uint32(uint32_t key)
+{
+        key ^= key >> 16;
+        key *= 0x85ebca6b;
+        key ^= key >> 13;
+        key *= 0xc2b2ae35;
+        key ^= key >> 16;
+
+        return key;
+}
+
+/**
+ * Mix the bits of a 64 bit integer
+ *
+ * This is the 64 bit finalizer used by murmur3 and like hash_uint32 it is a
+ * bijection
+ */
+static ATTR_INLINE uint64_t hash_uint64(uint64_t key)
+{
+        key ^= key >> 33U;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33U;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33U;
+
+        return key;
+}
+
+// Reduce a 64 bit hash to 32 bits keeping entropy from both halves
+static ATTR_INLINE uint32_t hash_fold_64(uint64_t hash)
+{
+        return (uint32_t)(hash ^ (hash >> 32U));
+}
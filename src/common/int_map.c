@@ -0,0 +1,240 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "constants.h"
+#include "hash.h"
+#include "int_map.h"
+
+static uint32_t get_initial_index(uint32_t length, uint32_t key)
+{
+        return hash_uint32(key) & (length - 1);
+}
+
+// Place an entry into an entries array using robin hood hashing
+//
+// The caller must make sure the key is not already present and that there
+// is a free slot
+static void int_map_place(struct int_map_entry *entries, uint32_t length,
+                          struct int_map_entry entry)
+{
+        uint32_t index = get_initial_index(length, entry.key);
+
+        entry.distance = 1;
+
+        for (;;) {
+                struct int_map_entry *current = &entries[index];
+
+                if (current->distance == 0) {
+                        *current = entry;
+
+                        return;
+                }
+
+                // Take from the rich and give to the poor
+                if (current->distance < entry.distance) {
+                        struct int_map_entry temp = *current;
+
+                        *current = entry;
+
+                        entry = temp;
+                }
+
+                index = (index + 1) & (length - 1);
+                entry.distance += 1;
+        }
+}
+
+// Find the index of a key
+//
+// Probing stops once we find an entry which is closer to it's initial bucket
+// than we would be
+static enum natwm_error int_map_search(const struct int_map *map, uint32_t key, uint32_t *result)
+{
+        uint32_t index = get_initial_index(map->length, key);
+
+        for (uint32_t distance = 1; distance <= map->entries[index].distance; ++distance) {
+                if (map->entries[index].key == key) {
+                        *result = index;
+
+                        return NO_ERROR;
+                }
+
+                index = (index + 1) & (map->length - 1);
+        }
+
+        return NOT_FOUND_ERROR;
+}
+
+static enum natwm_error int_map_resize(struct int_map *map, uint32_t new_length)
+{
+        struct int_map_entry *new_entries = calloc(new_length, sizeof(struct int_map_entry));
+
+        if (new_entries == NULL) {
+                return MEMORY_ALLOCATION_ERROR;
+        }
+
+        for (uint32_t i = 0; i < map->length; ++i) {
+                if (map->entries[i].distance == 0) {
+                        continue;
+                }
+
+                int_map_place(new_entries, new_length, map->entries[i]);
+        }
+
+        free(map->entries);
+
+        map->length = new_length;
+        map->resize_count += 1;
+        map->entries = new_entries;
+
+        return NO_ERROR;
+}
+
+struct int_map *int_map_create(void)
+{
+        struct int_map *map = malloc(sizeof(struct int_map));
+
+        if (map == NULL) {
+                return NULL;
+        }
+
+        map->length = INT_MAP_MIN_LENGTH;
+        map->count = 0;
+        map->resize_count = 0;
+        map->entries = calloc(map->length, sizeof(struct int_map_entry));
+
+        if (map->entries == NULL) {
+                free(map);
+
+                return NULL;
+        }
+
+        return map;
+}
+
+// Insert a value into the map. If the key is already present the value is
+// replaced
+enum natwm_error int_map_insert(struct int_map *map, uint32_t key, void *value)
+{
+        uint32_t index = 0;
+
+        if (int_map_search(map, key, &index) == NO_ERROR) {
+                map->entries[index].value = value;
+
+                return NO_ERROR;
+        }
+
+        // Keep the load factor below 0.75
+        if ((map->count + 1) * 4 >= map->length * 3) {
+                enum natwm_error err = int_map_resize(map, map->length * 2);
+
+                if (err != NO_ERROR) {
+                        return err;
+                }
+        }
+
+        struct int_map_entry entry = {
+                .key = key,
+                .distance = 1,
+                .value = value,
+        };
+
+        int_map_place(map->entries, map->length, entry);
+
+        map->count += 1;
+
+        return NO_ERROR;
+}
+
+void *int_map_get(const struct int_map *map, uint32_t key)
+{
+        uint32_t index = 0;
+
+        if (int_map_search(map, key, &index) != NO_ERROR) {
+                return NULL;
+        }
+
+        return map->entries[index].value;
+}
+
+bool int_map_contains(const struct int_map *map, uint32_t key)
+{
+        uint32_t index = 0;
+
+        return int_map_search(map, key, &index) == NO_ERROR;
+}
+
+// Remove a key from the map using backward shift deletion
+enum natwm_error int_map_delete(struct int_map *map, uint32_t key)
+{
+        uint32_t index = 0;
+        enum natwm_error err = int_map_search(map, key, &index);
+
+        if (err != NO_ERROR) {
+                return err;
+        }
+
+        uint32_t next_index = (index + 1) & (map->length - 1);
+
+        while (map->entries[next_index].distance > 1) {
+                map->entries[index] = map->entries[next_index];
+                map->entries[index].distance -= 1;
+
+                index = next_index;
+                next_index = (next_index + 1) & (map->length - 1);
+        }
+
+        map->entries[index].key = 0;
+        map->entries[index].distance = 0;
+        map->entries[index].value = NULL;
+
+        map->count -= 1;
+
+        return NO_ERROR;
+}
+
+// Collect the same statistics as map_get_stats. The map only ever grows and
+// resizes are not timed
+void int_map_get_stats(const struct int_map *map, struct map_stats *stats)
+{
+        uint64_t dib_total = 0;
+
+        memset(stats, 0, sizeof(struct map_stats));
+
+        stats->entry_count = map->count;
+        stats->length = map->length;
+        stats->resize_up_count = map->resize_count;
+        stats->bytes_allocated
+                = sizeof(struct int_map) + (map->length * sizeof(struct int_map_entry));
+
+        for (uint32_t i = 0; i < map->length; ++i) {
+                if (map->entries[i].distance == 0) {
+                        continue;
+                }
+
+                uint32_t dib = map->entries[i].distance - 1;
+
+                stats->dib_histogram[MIN(dib, MAP_STATS_HISTOGRAM_SIZE - 1)] += 1;
+                stats->max_dib = MAX(stats->max_dib, dib);
+
+                dib_total += dib;
+        }
+
+        if (map->count > 0) {
+                stats->mean_dib = (double)dib_total / map->count;
+        }
+}
+
+void int_map_destroy(struct int_map *map)
+{
+        if (map == NULL) {
+                return;
+        }
+
+        free(map->entries);
+        free(map);
+}
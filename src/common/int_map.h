@@ -0,0 +1,50 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <common/error.h>
+#include <common/map.h>
+
+/**
+ * A hash map specialized for 32 bit integer keys (for instance xcb_window_t)
+ *
+ * Unlike struct map the key is stored inline in the entry, hashed with an
+ * integer mixer and compared directly, so there are no function pointers
+ * involved in a lookup.
+ *
+ * Collisions are resolved using robin hood hashing with linear probing, and
+ * deletion uses backward shifting so there are no tombstones. The distance
+ * from the initial bucket is stored in the entry (offset by one so that 0
+ * marks an empty slot).
+ *
+ * Values are pointers to void and are never free'd by the map. Since NULL is
+ * returned for missing keys, NULL values should not be stored.
+ */
+
+#define INT_MAP_MIN_LENGTH 8
+
+struct int_map_entry {
+        uint32_t key;
+        uint32_t distance; // Distance from initial bucket + 1, 0 when empty
+        void *value;
+};
+
+struct int_map {
+        uint32_t length; // Length of the map (power of 2)
+        uint32_t count;
+        uint32_t resize_count;
+        struct int_map_entry *entries;
+};
+
+struct int_map *int_map_create(void);
+enum natwm_error int_map_insert(struct int_map *map, uint32_t key, void *value);
+void *int_map_get(const struct int_map *map, uint32_t key);
+bool int_map_contains(const struct int_map *map, uint32_t key);
+enum natwm_error int_map_delete(struct int_map *map, uint32_t key);
+void int_map_get_stats(const struct int_map *map, struct map_stats *stats);
+void int_map_destroy(struct int_map *map);
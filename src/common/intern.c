@@ -0,0 +1,331 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "constants.h"
+#include "hash.h"
+#include "intern.h"
+
+// Fixed so the hash of a string is the same for the life of the process.
+// Maps keyed by interned strings mix in their own seed
+#define INTERN_HASH_SEED 0x696e7465726e6564ULL
+
+#define INTERN_TABLE_MIN_CAPACITY 64
+
+// Interned strings are packed into chunks so they never move
+struct intern_chunk {
+        struct intern_chunk *next;
+        size_t used;
+        size_t size;
+        // Aligned for the interned_string headers stored in it
+        uint64_t data[];
+};
+
+// The slot array of the table. Readers look strings up without taking the
+// table lock, so an array which has been replaced by a bigger one is kept
+// until intern_destroy in case a reader is still probing it
+struct intern_slots {
+        struct intern_slots *previous;
+        size_t capacity;
+        struct interned_string *slots[];
+};
+
+// An open addressing table of pointers to the interned strings. The table is
+// kept at most half full
+//
+// Only writers take the table lock. A string is completely written before
+// the slot pointing to it is stored, and a grown slot array is completely
+// filled before it replaces the current one, so a reader always probes a
+// consistent array. A reader racing an insert may miss the new string, the
+// same as if it had looked a moment earlier
+struct intern_table {
+        struct intern_slots *slots;
+        size_t count;
+        struct intern_chunk *chunks;
+};
+
+static struct intern_table table = {
+        .slots = NULL,
+        .count = 0,
+        .chunks = NULL,
+};
+
+static pthread_mutex_t table_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static struct interned_string *get_header(const char *interned)
+{
+        return (struct interned_string *)(uintptr_t)(interned
+                                                     - offsetof(struct interned_string, string));
+}
+
+static uint64_t hash_string(const char *string, size_t length)
+{
+        return hash_wyhash_64(string, length, INTERN_HASH_SEED);
+}
+
+// Find the slot holding a string, or the empty slot it would go in
+static struct interned_string **table_find_slot(struct intern_slots *slots, const char *string,
+                                                size_t length, uint64_t hash)
+{
+        size_t mask = slots->capacity - 1;
+
+        for (size_t index = (size_t)hash & mask;; index = (index + 1) & mask) {
+                struct interned_string *entry
+                        = __atomic_load_n(&slots->slots[index], __ATOMIC_ACQUIRE);
+
+                if (entry == NULL) {
+                        return &slots->slots[index];
+                }
+
+                if (entry->hash == hash && entry->length == length
+                    && memcmp(entry->string, string, length) == 0) {
+                        return &slots->slots[index];
+                }
+        }
+}
+
+static int table_grow(void)
+{
+        struct intern_slots *old_slots = table.slots;
+        size_t new_capacity
+                = (old_slots == NULL) ? INTERN_TABLE_MIN_CAPACITY : old_slots->capacity * 2;
+        struct intern_slots *new_slots = calloc(
+                1, sizeof(struct intern_slots) + new_capacity * sizeof(struct interned_string *));
+
+        if (new_slots == NULL) {
+                return -1;
+        }
+
+        new_slots->previous = old_slots;
+        new_slots->capacity = new_capacity;
+
+        size_t old_capacity = (old_slots == NULL) ? 0 : old_slots->capacity;
+
+        for (size_t i = 0; i < old_capacity; ++i) {
+                struct interned_string *entry = old_slots->slots[i];
+
+                if (entry != NULL) {
+                        *table_find_slot(new_slots, entry->string, entry->length, entry->hash)
+                                = entry;
+                }
+        }
+
+        __atomic_store_n(&table.slots, new_slots, __ATOMIC_RELEASE);
+
+        return 0;
+}
+
+// Reserve space for a string in the current chunk, or start a new chunk.
+// Strings which are too big for a chunk get a chunk of their own
+static struct interned_string *chunk_alloc(size_t length)
+{
+        size_t size = sizeof(struct interned_string) + length + 1;
+
+        // Keep every header 8 byte aligned
+        size = (size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+
+        struct intern_chunk *chunk = table.chunks;
+
+        if (chunk == NULL || chunk->size - chunk->used < size) {
+                size_t chunk_size = MAX(size, (size_t)INTERN_CHUNK_SIZE);
+
+                chunk = malloc(sizeof(struct intern_chunk) + chunk_size);
+
+                if (chunk == NULL) {
+                        return NULL;
+                }
+
+                chunk->used = 0;
+                chunk->size = chunk_size;
+
+                // An oversized chunk is full straight away, so keep the
+                // current chunk at the head for the strings which follow
+                if (chunk_size > INTERN_CHUNK_SIZE && table.chunks != NULL) {
+                        chunk->next = table.chunks->next;
+                        table.chunks->next = chunk;
+                } else {
+                        chunk->next = table.chunks;
+                        table.chunks = chunk;
+                }
+        }
+
+        struct interned_string *result
+                = (struct interned_string *)(void *)((char *)chunk->data + chunk->used);
+
+        chunk->used += size;
+
+        return result;
+}
+
+static const char *intern_locked(const char *string, size_t length)
+{
+        uint64_t hash = hash_string(string, length);
+
+        if (table.slots != NULL) {
+                struct interned_string **slot = table_find_slot(table.slots, string, length, hash);
+
+                if (*slot != NULL) {
+                        return (*slot)->string;
+                }
+        }
+
+        if ((table.slots == NULL || (table.count + 1) * 2 > table.slots->capacity)
+            && table_grow() != 0) {
+                return NULL;
+        }
+
+        struct interned_string *entry = chunk_alloc(length);
+
+        if (entry == NULL) {
+                return NULL;
+        }
+
+        entry->hash = hash;
+        entry->length = length;
+
+        memcpy(entry->string, string, length);
+
+        entry->string[length] = '\0';
+
+        struct interned_string **slot = table_find_slot(table.slots, string, length, hash);
+
+        __atomic_store_n(slot, entry, __ATOMIC_RELEASE);
+
+        table.count += 1;
+
+        return entry->string;
+}
+
+/**
+ * Get the canonical copy of a string, adding it to the table if needed
+ *
+ * NULL is returned if the string could not be added
+ */
+const char *intern_string(const char *string)
+{
+        return intern_string_n(string, strlen(string));
+}
+
+/**
+ * Intern the first length bytes of string, which does not need to be null
+ * terminated
+ */
+const char *intern_string_n(const char *string, size_t length)
+{
+        pthread_mutex_lock(&table_mutex);
+
+        const char *result = intern_locked(string, length);
+
+        pthread_mutex_unlock(&table_mutex);
+
+        return result;
+}
+
+/**
+ * Get the canonical copy of a string without adding it
+ *
+ * If the string has never been interned NULL is returned. Since nothing is
+ * added this can be used to look up keys which might not exist. Lookups
+ * don't take the table lock
+ */
+const char *intern_find(const char *string)
+{
+        return intern_find_n(string, strlen(string));
+}
+
+const char *intern_find_n(const char *string, size_t length)
+{
+        struct intern_slots *slots = __atomic_load_n(&table.slots, __ATOMIC_ACQUIRE);
+
+        if (slots == NULL) {
+                return NULL;
+        }
+
+        struct interned_string *entry = __atomic_load_n(
+                table_find_slot(slots, string, length, hash_string(string, length)),
+                __ATOMIC_ACQUIRE);
+
+        return (entry == NULL) ? NULL : entry->string;
+}
+
+size_t intern_get_length(const char *interned)
+{
+        return get_header(interned)->length;
+}
+
+uint64_t intern_get_hash(const char *interned)
+{
+        return get_header(interned)->hash;
+}
+
+size_t intern_get_count(void)
+{
+        pthread_mutex_lock(&table_mutex);
+
+        size_t count = table.count;
+
+        pthread_mutex_unlock(&table_mutex);
+
+        return count;
+}
+
+/**
+ * Free every interned string
+ *
+ * Any pointers returned by the intern functions are invalid afterwards. This
+ * is only meant to be called when the program exits
+ */
+void intern_destroy(void)
+{
+        pthread_mutex_lock(&table_mutex);
+
+        struct intern_chunk *chunk = table.chunks;
+
+        while (chunk != NULL) {
+                struct intern_chunk *next = chunk->next;
+
+                free(chunk);
+
+                chunk = next;
+        }
+
+        struct intern_slots *slots = table.slots;
+
+        while (slots != NULL) {
+                struct intern_slots *previous = slots->previous;
+
+                free(slots);
+
+                slots = previous;
+        }
+
+        table.slots = NULL;
+        table.count = 0;
+        table.chunks = NULL;
+
+        pthread_mutex_unlock(&table_mutex);
+}
+
+// The hash is mixed with the map seed so maps still get their own layout
+uint32_t intern_map_hash(const void *key, size_t size, uint64_t seed)
+{
+        UNUSED_FUNCTION_PARAM(size);
+
+        return hash_fold_64(hash_uint64(intern_get_hash(key) ^ seed));
+}
+
+size_t intern_map_key_size(const void *key)
+{
+        return intern_get_length(key);
+}
+
+bool intern_map_key_compare(const void *one, const void *two, size_t key_size)
+{
+        UNUSED_FUNCTION_PARAM(key_size);
+
+        return one == two;
+}
@@ -0,0 +1,46 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A process wide table of interned strings
+ *
+ * Interning a string returns a canonical copy of it. Every string with the
+ * same contents gets the same pointer back, so interned strings can be
+ * compared with == and each distinct string is only stored once. The length
+ * and hash of an interned string are stored next to it and can be read back
+ * without walking the string
+ *
+ * Interned strings are never freed while the program runs, they stay valid
+ * until intern_destroy is called at exit. Interning is thread safe, and
+ * intern_find never takes the lock which interning new strings does
+ */
+
+#define INTERN_CHUNK_SIZE 4096
+
+struct interned_string {
+        uint64_t hash;
+        size_t length;
+        char string[]; // Null terminated
+};
+
+const char *intern_string(const char *string);
+const char *intern_string_n(const char *string, size_t length);
+const char *intern_find(const char *string);
+const char *intern_find_n(const char *string, size_t length);
+size_t intern_get_length(const char *interned);
+uint64_t intern_get_hash(const char *interned);
+size_t intern_get_count(void);
+void intern_destroy(void);
+
+// Functions for maps keyed by interned strings. Every key passed to such a
+// map, including lookups, must be interned
+uint32_t intern_map_hash(const void *key, size_t size, uint64_t seed);
+size_t intern_map_key_size(const void *key);
+bool intern_map_key_compare(const void *one, const void *two, size_t key_size);
@@ -208,3 +208,93 @@ void list_empty(struct list *list)
 {
         clear_list(list, false);
 }
+
+void intrusive_list_init(struct intrusive_list *list)
+{
+        list->head = NULL;
+        list->tail = NULL;
+        list->size = 0;
+}
+
+void list_link_init(struct list_link *link)
+{
+        link->next = NULL;
+        link->previous = NULL;
+}
+
+void intrusive_list_insert(struct intrusive_list *list, struct list_link *link)
+{
+        link->previous = NULL;
+        link->next = list->head;
+
+        if (list->head == NULL) {
+                list->tail = link;
+        } else {
+                list->head->previous = link;
+        }
+
+        list->head = link;
+
+        ++list->size;
+}
+
+void intrusive_list_insert_end(struct intrusive_list *list, struct list_link *link)
+{
+        link->next = NULL;
+        link->previous = list->tail;
+
+        if (list->tail == NULL) {
+                list->head = link;
+        } else {
+                list->tail->next = link;
+        }
+
+        list->tail = link;
+
+        ++list->size;
+}
+
+void intrusive_list_move_to_head(struct intrusive_list *list, struct list_link *link)
+{
+        if (link->previous == NULL) {
+                return;
+        }
+
+        intrusive_list_remove(list, link);
+        intrusive_list_insert(list, link);
+}
+
+void intrusive_list_move_to_tail(struct intrusive_list *list, struct list_link *link)
+{
+        if (link->next == NULL) {
+                return;
+        }
+
+        intrusive_list_remove(list, link);
+        intrusive_list_insert_end(list, link);
+}
+
+void intrusive_list_remove(struct intrusive_list *list, struct list_link *link)
+{
+        if (link->previous == NULL) {
+                list->head = link->next;
+        } else {
+                link->previous->next = link->next;
+        }
+
+        if (link->next == NULL) {
+                list->tail = link->previous;
+        } else {
+                link->next->previous = link->previous;
+        }
+
+        link->next = NULL;
+        link->previous = NULL;
+
+        --list->size;
+}
+
+bool intrusive_list_is_empty(const struct intrusive_list *list)
+{
+        return list->size == 0;
+}
@@ -22,6 +22,44 @@ struct list {
 #define LIST_FOR_EACH(list, item)                                                                  \
         for (struct node * (item) = (list)->head; (item) != NULL; (item) = (item)->next)
 
+/**
+ * Intrusive variant of the list
+ *
+ * Instead of the list allocating a node which points at the data, the data
+ * embeds a struct list_link and the link is placed in the list directly. No
+ * memory is allocated by the list and anything holding a pointer to the data
+ * can unlink or move it in O(1)
+ *
+ * INTRUSIVE_LIST_ENTRY gets back to the struct containing a link
+ */
+
+struct list_link {
+        struct list_link *next;
+        struct list_link *previous;
+};
+
+struct intrusive_list {
+        struct list_link *head;
+        struct list_link *tail;
+        size_t size;
+};
+
+// Get a pointer to the struct of type which contains member at pointer
+#define CONTAINER_OF(pointer, type, member)                                                        \
+        ((type *)(void *)((char *)(pointer) - offsetof(type, member)))
+
+#define INTRUSIVE_LIST_ENTRY(link, type, member) CONTAINER_OF(link, type, member)
+
+#define INTRUSIVE_LIST_FOR_EACH(list, link)                                                        \
+        for (struct list_link * (link) = (list)->head; (link) != NULL; (link) = (link)->next)
+
+// Iterate a list while allowing the current link to be removed or free'd
+#define INTRUSIVE_LIST_FOR_EACH_SAFE(list, link, next_link)                                        \
+        for (struct list_link * (link) = (list)->head,                                             \
+                                * (next_link) = ((link) != NULL) ? (link)->next : NULL;            \
+             (link) != NULL;                                                                       \
+             (link) = (next_link), (next_link) = ((link) != NULL) ? (link)->next : NULL)
+
 struct node *node_create(const void *data);
 struct list *list_create(void);
 
@@ -40,3 +78,12 @@ bool list_is_empty(const struct list *list);
 void node_destroy(struct node *node);
 void list_destroy(struct list *list);
 void list_empty(struct list *list);
+
+void intrusive_list_init(struct intrusive_list *list);
+void list_link_init(struct list_link *link);
+void intrusive_list_insert(struct intrusive_list *list, struct list_link *link);
+void intrusive_list_insert_end(struct intrusive_list *list, struct list_link *link);
+void intrusive_list_move_to_head(struct intrusive_list *list, struct list_link *link);
+void intrusive_list_move_to_tail(struct intrusive_list *list, struct list_link *link);
+void intrusive_list_remove(struct intrusive_list *list, struct list_link *link);
+bool intrusive_list_is_empty(const struct intrusive_list *list);
@@ -2,7 +2,11 @@
 // Licensed under BSD-3-Clause
 // Refer to the license.txt file included in the root of the project
 
+#include <inttypes.h>
+#include <stdio.h>
+
 #include "logger.h"
+#include "map.h"
 
 struct logger *natwm_logger = NULL;
 
@@ -14,3 +18,44 @@ void initialize_logger(bool verbose)
                 set_logging_min_level(natwm_logger, LEVEL_TRACE);
         }
 }
+
+void log_map_stats(const char *name, const struct map_stats *stats)
+{
+        char histogram[MAP_STATS_HISTOGRAM_SIZE * 12] = {0};
+        size_t offset = 0;
+
+        for (size_t i = 0; i < MAP_STATS_HISTOGRAM_SIZE && offset < sizeof(histogram); ++i) {
+                int written = snprintf(histogram + offset,
+                                       sizeof(histogram) - offset,
+                                       "%s%" PRIu32,
+                                       (i == 0) ? "" : " ",
+                                       stats->dib_histogram[i]);
+
+                if (written < 0) {
+                        break;
+                }
+
+                offset += (size_t)written;
+        }
+
+        LOG_DEBUG(natwm_logger,
+                  "%s: %" PRIu32 " entries in %" PRIu32 " slots using %zu bytes",
+                  name,
+                  stats->entry_count,
+                  stats->length,
+                  stats->bytes_allocated);
+        LOG_DEBUG(natwm_logger,
+                  "%s: DIB max %" PRIu32 " mean %.2f histogram [%s]",
+                  name,
+                  stats->max_dib,
+                  stats->mean_dib,
+                  histogram);
+        LOG_DEBUG(natwm_logger,
+                  "%s: %" PRIu32 " resizes up, %" PRIu32 " down, %" PRIu64 " ns resizing, %" PRIu32
+                  " tombstones",
+                  name,
+                  stats->resize_up_count,
+                  stats->resize_down_count,
+                  stats->resize_time_ns,
+                  stats->tombstone_count);
+}
@@ -7,6 +7,9 @@
 #include <clog.h>
 #include <stdbool.h>
 
+struct map_stats;
+
 extern struct logger *natwm_logger;
 
 void initialize_logger(bool verbose);
+void log_map_stats(const char *name, const struct map_stats *stats);
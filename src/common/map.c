@@ -3,26 +3,98 @@
 // Refer to the license.txt file included in the root of the project
 
 #include <assert.h>
+#include <sched.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include <common/constants.h>
 #include <common/error.h>
 #include <common/hash.h>
 #include "map.h"
 
-static const int EMPTY_ENTRY = 1;
+static pthread_once_t map_seed_once = PTHREAD_ONCE_INIT;
+static uint64_t map_seed_base = 0;
+static uint64_t map_seed_counter = 0;
+
+// Seed shared by every map in the process. Read from the system random source
+// when available, falling back to the time and pid
+static void map_seed_base_init(void)
+{
+        FILE *file = fopen("/dev/urandom", "rb");
+
+        if (file != NULL) {
+                size_t bytes_read = fread(&map_seed_base, 1, sizeof(map_seed_base), file);
+
+                fclose(file);
+
+                if (bytes_read == sizeof(map_seed_base)) {
+                        return;
+                }
+        }
+
+        struct timespec time;
+
+        clock_gettime(CLOCK_MONOTONIC, &time);
+
+        map_seed_base = hash_uint64((uint64_t)time.tv_nsec ^ ((uint64_t)time.tv_sec << 32U)
+                                    ^ (uint64_t)getpid());
+}
+
+// Every map gets a distinct seed. Re-inserting the entries of one map into
+// another in iteration order can otherwise cluster badly when both maps place
+// keys identically
+static uint64_t map_random_seed(void)
+{
+        pthread_once(&map_seed_once, map_seed_base_init);
+
+        uint64_t count = __atomic_add_fetch(&map_seed_counter, 1, __ATOMIC_RELAXED);
 
-// Forward declarations
-static enum natwm_error map_insert_entry(struct map *map, struct map_entry *entry);
+        return hash_uint64(map_seed_base + count);
+}
 
 // Default map hashing function
-// Uses Murmur v3 32bit
-static ATTR_CONST uint32_t default_hash_function(const void *key, size_t size)
+uint32_t map_hash_wyhash(const void *key, size_t size, uint64_t seed)
 {
-        // TODO: Should thought be put into a seed for the hash
-        return hash_murmur3_32(key, size, 0);
+        return hash_fold_64(hash_wyhash_64(key, size, seed));
+}
+
+// Murmur v3 32bit, the default hashing function in earlier versions
+uint32_t map_hash_murmur3(const void *key, size_t size, uint64_t seed)
+{
+        return hash_murmur3_32(key, size, hash_fold_64(seed));
+}
+
+// Hashing function for keys which point to a 4 or 8 byte integer
+//
+// 4 byte keys are mixed with a bijection, so distinct keys never share a hash.
+// Other sizes fall back to map_hash_wyhash
+uint32_t map_hash_integer(const void *key, size_t size, uint64_t seed)
+{
+        if (size == sizeof(uint32_t)) {
+                uint32_t value = 0;
+
+                memcpy(&value, key, sizeof(value));
+
+                return hash_uint32(value ^ (uint32_t)seed);
+        }
+
+        if (size == sizeof(uint64_t)) {
+                uint64_t value = 0;
+
+                memcpy(&value, key, sizeof(value));
+
+                return hash_fold_64(hash_uint64(value ^ seed));
+        }
+
+        return map_hash_wyhash(key, size, seed);
 }
 
 // Default key size function
@@ -45,28 +117,47 @@ static bool default_key_compare_function(const void *one, const void *two, size_
         return false;
 }
 
+// Key of old entries which have already been moved by an incremental resize
+static const char migrated_key_marker = 0;
+#define MIGRATED_KEY ((const void *)&migrated_key_marker)
+
 // Given a map_entry determine if it holds valid data and is present
 static bool is_entry_present(const struct map_entry *entry)
 {
-        if (entry != NULL && entry->key != NULL && entry->value != &EMPTY_ENTRY) {
-                return true;
+        return entry->key != NULL;
+}
+
+// Given a map_entry determine if it has been moved by an incremental resize
+static bool is_entry_migrated(const struct map_entry *entry)
+{
+        return entry->key == MIGRATED_KEY;
+}
+
+// Current monotonic time in nanoseconds, used to time resizes when
+// MAP_FLAG_COLLECT_STATS is set
+static uint64_t get_time_ns(const struct map *map)
+{
+        if (!(map->setting_flags & MAP_FLAG_COLLECT_STATS)) {
+                return 0;
         }
 
-        return false;
+        struct timespec time;
+
+        clock_gettime(CLOCK_MONOTONIC, &time);
+
+        return ((uint64_t)time.tv_sec * 1000000000ULL) + (uint64_t)time.tv_nsec;
 }
 
-// Given a map_entry and it's current index find the distance from the initial
+// Given a hash and it's current index find the distance from the initial
 // bucket
-static uint32_t get_dib(const struct map *map, const struct map_entry *entry,
-                        uint32_t current_index)
+//
+// The length of the map is always a power of two so the wrap around can be
+// handled by masking
+static uint32_t get_dib(uint32_t length, uint32_t hash, uint32_t current_index)
 {
-        uint32_t initial_index = entry->hash % map->length;
+        uint32_t initial_index = hash & (length - 1);
 
-        if (current_index < initial_index) {
-                return (map->length - current_index) + initial_index;
-        }
-
-        return current_index - initial_index;
+        return (current_index - initial_index) & (length - 1);
 }
 
 // Attempt to lock the map
@@ -101,419 +192,1779 @@ static int map_unlock(struct map *map)
         return 0;
 }
 
-// Use the robin hood hashing method to probe the map for a sutable location to
-// place the provided entry
-static enum natwm_error map_probe(struct map *map, struct map_entry *entry, uint32_t initial_index)
+// Free data which readers may still be looking at
+//
+// When concurrent reads are enabled the data is kept on the retired list and
+// free'd by a later writer once no readers are active. If the retired list
+// can't grow the data is leaked rather than risking a use after free
+static void map_release(const struct map *map, void *data, map_entry_free_function_t function)
 {
-        // As we probe through the map these will continually get updated
-        uint32_t probe_position = initial_index;
-        struct map_entry *insert_entry = entry;
+        if (data == NULL) {
+                return;
+        }
 
-        for (size_t i = 0; i < map->length; ++i) {
-                if (probe_position >= map->length) {
-                        probe_position = 0;
-                }
+        if (map->retired == NULL) {
+                function(data);
 
-                struct map_entry *current_entry = map->entries[probe_position];
+                return;
+        }
 
-                if (!is_entry_present(current_entry)) {
-                        // Insert here
-                        map->entries[probe_position] = insert_entry;
+        struct map_retire_list *list = map->retired;
 
-                        return NO_ERROR;
+        if (list->length == list->capacity) {
+                size_t capacity = MAX(list->capacity * 2, MAP_RETIRE_MIN_CAPACITY);
+                struct map_retired *items
+                        = realloc(list->items, capacity * sizeof(struct map_retired));
+
+                if (items == NULL) {
+                        return;
                 }
 
-                uint32_t insert_dib = get_dib(map, insert_entry, probe_position);
+                list->items = items;
+                list->capacity = capacity;
+        }
 
-                uint32_t current_dib = get_dib(map, current_entry, probe_position);
+        list->items[list->length].data = data;
+        list->items[list->length].free_function = function;
 
-                // If the current entry has a lower dib then the entry we are
-                // trying to insert then we swap the entries
-                if (current_dib < insert_dib) {
-                        map->entries[probe_position] = insert_entry;
+        list->length += 1;
+}
 
-                        insert_entry = current_entry;
-                }
+// Free everything on the retired list
+static void map_reclaim(struct map *map)
+{
+        struct map_retire_list *list = map->retired;
 
-                // Keep probing
-                probe_position += 1;
+        for (size_t i = 0; i < list->length; ++i) {
+                list->items[i].free_function(list->items[i].data);
         }
 
-        return CAPACITY_ERROR;
+        list->length = 0;
 }
 
-static enum natwm_error map_search(const struct map *map, const void *key, uint32_t *index)
+// Wait before retrying a read which raced a write. Spin for a while, since
+// writes are short, and then give up the CPU so a writer which was preempted
+// in the middle of a write can finish
+static void map_read_backoff(uint32_t *spin_count)
 {
-        if (key == NULL || index == NULL) {
-                return GENERIC_ERROR;
-        }
+        if (*spin_count < MAP_READ_SPIN_LIMIT) {
+                ++*spin_count;
 
-        // Initialize index with initial bucket index
-        size_t key_size = map->key_size_function(key);
-        uint32_t current_index = map->hash_function(key, key_size) % map->length;
+                CPU_RELAX();
 
-        for (size_t i = 0; i <= map->length; ++i) {
-                if ((current_index) >= map->length) {
-                        current_index = 0;
-                }
+                return;
+        }
 
-                struct map_entry *entry = map->entries[current_index];
+        sched_yield();
+}
 
-                if (!is_entry_present(entry)
-                    || !map->key_compare_function(key, entry->key, key_size)) {
-                        current_index += 1;
+// Read sections the current thread is inside of, across all maps. Only the
+// outermost map_read_begin of a thread waits for a draining writer, and a
+// thread which writes from inside a read section never waits for itself
+static __thread uint32_t read_depth = 0;
 
-                        continue;
-                }
+// Wait for every active reader to finish and free the retired list
+//
+// New readers hold off while the map is draining, so this only waits for the
+// readers which were already active and can't be starved by readers which
+// keep overlapping each other
+static void map_drain_readers(struct map *map)
+{
+        uint32_t spin_count = 0;
 
-                *index = current_index;
+        __atomic_store_n(&map->draining, 1, __ATOMIC_SEQ_CST);
 
-                return NO_ERROR;
+        while (__atomic_load_n(&map->reader_count, __ATOMIC_SEQ_CST) > 0) {
+                map_read_backoff(&spin_count);
         }
 
-        return NOT_FOUND_ERROR;
+        map_reclaim(map);
+
+        __atomic_store_n(&map->draining, 0, __ATOMIC_SEQ_CST);
 }
 
-// Handle load factor for inserting/removing values
-static int get_resize_direction(const struct map *map, double new_size)
+// Mark the map as being modified for concurrent readers
+//
+// Only maps with concurrent reads lock for the whole write, since their
+// readers never take the lock. Every other map only locks while it resizes
+static void map_write_begin(struct map *map)
 {
-        if (map->setting_flags & MAP_FLAG_IGNORE_THRESHOLDS) {
-                return 0;
+        if (map->retired == NULL) {
+                return;
         }
 
-        double load_factor = new_size / map->length;
+        map_lock(map);
 
-        if (load_factor >= MAP_LOAD_FACTOR_HIGH) {
-                return MAP_RESIZE_UP;
+        // Odd sequence numbers tell readers that a write is in progress
+        __atomic_store_n(&map->sequence, map->sequence + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void map_write_end(struct map *map)
+{
+        if (map->retired == NULL) {
+                return;
         }
 
-        if (load_factor <= MAP_LOAD_FACTOR_LOW) {
-                if (map->setting_flags & MAP_FLAG_IGNORE_THRESHOLDS_EMPTY) {
-                        return 0;
-                }
+        __atomic_store_n(&map->sequence, map->sequence + 1, __ATOMIC_SEQ_CST);
 
-                return MAP_RESIZE_DOWN;
+        // Anything retired during this write (or earlier) is no longer
+        // reachable from the map. Readers which start after this point can't
+        // see it, so it is safe to free once the current readers are gone.
+        // Once too much has piled up the writer waits for them
+        if (__atomic_load_n(&map->reader_count, __ATOMIC_SEQ_CST) == 0) {
+                map_reclaim(map);
+        } else if (map->retired->length >= MAP_RETIRE_MAX_LENGTH && read_depth == 0) {
+                map_drain_readers(map);
         }
 
-        // Should never happen
-        return 0;
+        map_unlock(map);
 }
 
-// Resizes the map either to a smaller size or a larger size
+// Use the robin hood hashing method to probe an entries array for a sutable
+// location to place the provided entry
 //
-// resize_direction == 1 -> Increase size
-// resize_direction == -1 -> Decrease size
-static enum natwm_error map_resize(struct map *map, int resize_direction)
+// The entry is copied into the array, so the caller must make sure that the
+// key is not already present
+static enum natwm_error map_probe(struct map_entry *entries, uint32_t length,
+                                  struct map_entry entry)
 {
-        uint32_t new_length = map->length;
-
-        if (resize_direction == 1) {
-                new_length = map->length * 2;
-        } else if (resize_direction == -1) {
-                new_length = map->length / 2;
-        } else {
-                return GENERIC_ERROR;
-        }
+        // As we probe through the map these will continually get updated
+        uint32_t probe_position = entry.hash & (length - 1);
+        uint32_t insert_dib = 0;
 
-        struct map_entry **new_entries = calloc(new_length, sizeof(struct map_entry *));
+        for (uint32_t i = 0; i < length; ++i) {
+                struct map_entry *current_entry = &entries[probe_position];
 
-        if (new_entries == NULL) {
-                return MEMORY_ALLOCATION_ERROR;
-        }
+                if (!is_entry_present(current_entry)) {
+                        // Insert here
+                        *current_entry = entry;
 
-        map_lock(map);
-        map->event_flags |= EVENT_FLAG_RESIZING_MAP;
+                        return NO_ERROR;
+                }
 
-        // Cache old entries
-        size_t old_entries_size = sizeof(struct map_entry *) * map->length;
-        struct map_entry **old_entries = malloc(old_entries_size);
-        size_t old_length = map->length;
+                uint32_t current_dib = get_dib(length, current_entry->hash, probe_position);
 
-        if (old_entries == NULL) {
-                // Need to free newly initialized entries array
-                free(new_entries);
+                // If the current entry has a lower dib then the entry we are
+                // trying to insert then we swap the entries
+                if (current_dib < insert_dib) {
+                        struct map_entry temp = *current_entry;
 
-                return MEMORY_ALLOCATION_ERROR;
-        }
+                        *current_entry = entry;
 
-        memcpy(old_entries, map->entries, old_entries_size);
+                        entry = temp;
+                        insert_dib = current_dib;
+                }
 
-        // Need to free the old entries array
-        free(map->entries);
+                // Keep probing
+                probe_position = (probe_position + 1) & (length - 1);
+                insert_dib += 1;
+        }
 
-        // Set new attributes
-        map->length = new_length;
-        map->bucket_count = 0;
-        map->entries = new_entries;
+        return CAPACITY_ERROR;
+}
 
-        for (size_t i = 0; i < old_length; ++i) {
-                struct map_entry *entry = old_entries[i];
+// The 7 bit hash fragment which is stored in the control byte of a slot
+static ATTR_INLINE uint8_t get_control_fragment(uint32_t hash)
+{
+        return (uint8_t)(hash & 0x7F);
+}
 
-                if (!is_entry_present(entry)) {
-                        // Nothing here
+// The group which probing starts at for a given hash
+static ATTR_INLINE uint32_t get_initial_group(uint32_t hash, uint32_t group_count)
+{
+        return (hash >> 7) & (group_count - 1);
+}
 
-                        continue;
-                }
+// Returns a bitmask with a bit set for every control byte in the group which
+// is equal to value
+static ATTR_INLINE uint32_t group_match(const uint8_t *group, uint8_t value)
+{
+#if defined(__SSE2__)
+        __m128i control = _mm_loadu_si128((const __m128i *)(const void *)group);
+        __m128i match = _mm_cmpeq_epi8(control, _mm_set1_epi8((char)value));
 
-                enum natwm_error error = map_insert_entry(map, entry);
+        return (uint32_t)_mm_movemask_epi8(match);
+#else
+        uint32_t mask = 0;
 
-                if (error != NO_ERROR) {
-                        return error;
+        for (uint32_t i = 0; i < MAP_GROUP_WIDTH; ++i) {
+                if (group[i] == value) {
+                        mask |= 1U << i;
                 }
         }
 
-        // Get rid of the cache array
-        // Actual entries are stored in the new map->entries array
-        free(old_entries);
-
-        map->event_flags &= (unsigned int)~EVENT_FLAG_RESIZING_MAP;
-        map_unlock(map);
-
-        return NO_ERROR;
+        return mask;
+#endif
 }
 
-// Inserts a pre-hashed entry into the map
-static enum natwm_error map_insert_entry(struct map *map, struct map_entry *entry)
+// Returns a bitmask with a bit set for every control byte in the group which
+// is either empty or deleted. Both have the high bit set.
+static ATTR_INLINE uint32_t group_match_free(const uint8_t *group)
 {
-        // Get the new initial idex
-        uint32_t initial_index = entry->hash % map->length;
-        struct map_entry *present_entry = map->entries[initial_index];
-        bool is_hash_collision = is_entry_present(present_entry);
-        size_t key_size = map->key_size_function(entry->key);
+#if defined(__SSE2__)
+        __m128i control = _mm_loadu_si128((const __m128i *)(const void *)group);
 
-        // If there is a collision with the same key overwrite it
-        if (is_hash_collision
-            && map->key_compare_function(entry->key, present_entry->key, key_size)) {
-                map_entry_destroy(map, present_entry);
+        return (uint32_t)_mm_movemask_epi8(control);
+#else
+        uint32_t mask = 0;
 
-                map->entries[initial_index] = entry;
-
-                return NO_ERROR;
+        for (uint32_t i = 0; i < MAP_GROUP_WIDTH; ++i) {
+                if (group[i] & 0x80) {
+                        mask |= 1U << i;
+                }
         }
 
-        // Now we need to increase map->bucket_count
-        int resize_direction = get_resize_direction(map, map->bucket_count + 1.0);
-
-        if (resize_direction != 0) {
-                enum natwm_error resize_error = map_resize(map, resize_direction);
+        return mask;
+#endif
+}
 
-                if (resize_error != NO_ERROR) {
-                        return resize_error;
-                }
+// Index of the lowest set bit of a non-zero mask
+static ATTR_INLINE uint32_t mask_lowest_bit(uint32_t mask)
+{
+#if defined __clang__ || defined __GNUC__
+        return (uint32_t)__builtin_ctz(mask);
+#else
+        uint32_t index = 0;
 
-                // Insert with the new size
-                return map_insert_entry(map, entry);
+        while (!(mask & 1U)) {
+                mask >>= 1U;
+                ++index;
         }
 
-        if (!is_hash_collision) {
-                // No collision - just insert here
-                if (map->entries[initial_index] != NULL
-                    && map->entries[initial_index]->value == &EMPTY_ENTRY) {
-                        // We previously had a value here - delete it and
-                        // replace
-                        map_entry_destroy(map, map->entries[initial_index]);
-                }
-
-                map->entries[initial_index] = entry;
-                map->bucket_count += 1;
+        return index;
+#endif
+}
 
-                return NO_ERROR;
-        }
+// Find the first empty or deleted slot in the probe sequence of a hash
+//
+// Groups are probed using triangular steps, since the number of groups is a
+// power of two this will visit every group
+static enum natwm_error group_find_free_slot(const uint8_t *control, uint32_t length,
+                                             uint32_t hash, uint32_t *index)
+{
+        uint32_t group_count = length / MAP_GROUP_WIDTH;
+        uint32_t group = get_initial_group(hash, group_count);
 
-        if ((map->bucket_count + 1) > map->length) {
-                map_entry_destroy(map, entry);
+        for (uint32_t i = 0; i < group_count; ++i) {
+                uint32_t free_mask = group_match_free(control + (group * MAP_GROUP_WIDTH));
 
-                return CAPACITY_ERROR;
-        }
+                if (free_mask != 0) {
+                        *index = (group * MAP_GROUP_WIDTH) + mask_lowest_bit(free_mask);
 
-        // Handle collision
-        enum natwm_error error = map_probe(map, entry, initial_index);
+                        return NO_ERROR;
+                }
 
-        if (error != NO_ERROR) {
-                return error;
+                group = (group + i + 1) & (group_count - 1);
         }
 
-        map->bucket_count += 1;
-
-        return NO_ERROR;
+        return CAPACITY_ERROR;
 }
 
-// Given a hash, key, and value construct a map entry
-enum natwm_error entry_init(uint32_t hash, const void *key, void *value, struct map_entry **dest)
+// Place an entry into the first free slot of it's probe sequence
+static enum natwm_error group_probe(struct map_entry *entries, uint8_t *control, uint32_t length,
+                                    struct map_entry entry, bool *used_tombstone)
 {
-        if (key == NULL || dest == NULL) {
-                return GENERIC_ERROR;
-        }
-
-        *dest = malloc(sizeof(struct map_entry));
+        uint32_t index = 0;
+        enum natwm_error err = group_find_free_slot(control, length, entry.hash, &index);
 
-        if (*dest == NULL) {
-                return MEMORY_ALLOCATION_ERROR;
+        if (err != NO_ERROR) {
+                return err;
         }
 
-        (*dest)->hash = hash;
-        (*dest)->key = key;
-        (*dest)->value = value;
+        SET_IF_NON_NULL(used_tombstone, control[index] == MAP_CONTROL_DELETED);
+
+        control[index] = get_control_fragment(entry.hash);
+        entries[index] = entry;
 
         return NO_ERROR;
 }
 
-void map_entry_destroy(const struct map *map, struct map_entry *entry)
+// Search the control bytes of a group probing map for a key
+//
+// The full key compare only happens for slots where the hash fragment
+// matches. Probing stops at the first group containing an empty slot since
+// the key would have been placed there.
+static enum natwm_error group_search(const struct map *map, const void *key, size_t key_size,
+                                     uint32_t hash, uint32_t *index)
 {
-        if (is_entry_present(entry)) {
-                if (map->setting_flags & MAP_FLAG_FREE_ENTRY_KEY) {
-                        free((void *)entry->key);
-                }
+        uint32_t group_count = map->length / MAP_GROUP_WIDTH;
+        uint32_t group = get_initial_group(hash, group_count);
+        uint8_t fragment = get_control_fragment(hash);
 
-                if (map->setting_flags & MAP_FLAG_USE_FREE) {
-                        free(entry->value);
-                }
+        for (uint32_t i = 0; i < group_count; ++i) {
+                const uint8_t *control = map->control + (group * MAP_GROUP_WIDTH);
+                uint32_t matches = group_match(control, fragment);
+
+                while (matches != 0) {
+                        uint32_t slot = (group * MAP_GROUP_WIDTH) + mask_lowest_bit(matches);
+                        const struct map_entry *entry = &map->entries[slot];
 
-                if (map->setting_flags & MAP_FLAG_USE_FREE_FUNC) {
-                        if (map->free_function == NULL) {
-                                free(entry);
+                        if (entry->hash == hash
+                            && (entry->key == key
+                                || map->key_compare_function(key, entry->key, key_size))) {
+                                *index = slot;
 
-                                return;
+                                return NO_ERROR;
                         }
 
-                        map->free_function(entry->value);
+                        // Clear the lowest bit
+                        matches &= matches - 1;
                 }
+
+                if (group_match(control, MAP_CONTROL_EMPTY) != 0) {
+                        break;
+                }
+
+                group = (group + i + 1) & (group_count - 1);
         }
 
-        free(entry);
+        return NOT_FOUND_ERROR;
 }
 
-// Initialize a map
-struct map *map_init(void)
+// Search a robin hood entries array for a key which has already been hashed
+//
+// Since entries are placed using robin hood hashing we can stop searching as
+// soon as we reach an entry which is closer to it's initial bucket than we
+// are to ours
+static enum natwm_error entries_search(const struct map *map, const struct map_entry *entries,
+                                       uint32_t length, const void *key, size_t key_size,
+                                       uint32_t hash, uint32_t *index)
 {
-        struct map *map = malloc(sizeof(struct map));
+        uint32_t current_index = hash & (length - 1);
 
-        if (map == NULL) {
-                return NULL;
-        }
+        for (uint32_t dib = 0; dib < length; ++dib) {
+                const struct map_entry *entry = &entries[current_index];
 
-        map->length = MAP_MIN_LENGTH;
-        map->bucket_count = 0;
-        map->entries = calloc(map->length, sizeof(struct map_entry));
+                if (!is_entry_present(entry) || get_dib(length, entry->hash, current_index) < dib) {
+                        break;
+                }
 
-        if (map->entries == NULL) {
-                return NULL;
-        }
+                if (entry->hash == hash && !is_entry_migrated(entry)
+                    && (entry->key == key
+                        || map->key_compare_function(key, entry->key, key_size))) {
+                        *index = current_index;
 
-        if (pthread_mutex_init(&map->mutex, NULL) != 0) {
-                return NULL;
-        }
+                        return NO_ERROR;
+                }
 
-        map->hash_function = default_hash_function;
-        map->key_size_function = default_key_size_function;
-        map->key_compare_function = default_key_compare_function;
-        map->free_function = NULL;
-        map->setting_flags = MAP_FLAG_IGNORE_THRESHOLDS_EMPTY;
-        map->event_flags = EVENT_FLAG_NORMAL;
+                current_index = (current_index + 1) & (length - 1);
+        }
 
-        return map;
+        return NOT_FOUND_ERROR;
 }
 
-// Destroys a map and it's entries
-//
-// Note: If the value stored in the entires has nested items which need to be
-// free'd then there will be memory leaks if this function is used since we are
-// only dealing with the top level. map_destroy_func allows for customizing the
-// free'ing of entries
-void map_destroy(struct map *map)
+// Search the current entries of the map for a key which has already been
+// hashed
+static enum natwm_error map_search_hashed(const struct map *map, const void *key, size_t key_size,
+                                          uint32_t hash, uint32_t *index)
 {
-        if (map == NULL) {
-                return;
-        }
-
-        // Delete entries
-        for (size_t i = 0; i < map->length; ++i) {
-                map_entry_destroy(map, map->entries[i]);
+        if (map->setting_flags & MAP_FLAG_GROUP_PROBING) {
+                return group_search(map, key, key_size, hash, index);
         }
 
-        free(map->entries);
-        free(map);
+        return entries_search(map, map->entries, map->length, key, key_size, hash, index);
 }
 
-// Insert an entry into a map
-enum natwm_error map_insert(struct map *map, const void *key, void *value)
+// Search the entries which are waiting to be migrated by an incremental
+// resize
+static enum natwm_error map_search_old(const struct map *map, const void *key, size_t key_size,
+                                       uint32_t hash, uint32_t *index)
 {
-        if (key == NULL) {
-                return GENERIC_ERROR;
+        if (map->old_entries == NULL) {
+                return NOT_FOUND_ERROR;
         }
 
-        struct map_entry *entry = NULL;
-        size_t key_size = map->key_size_function(key);
-        uint32_t hash = map->hash_function(key, key_size);
-        enum natwm_error error = entry_init(hash, key, value, &entry);
+        return entries_search(map, map->old_entries, map->old_length, key, key_size, hash, index);
+}
 
-        if (error != NO_ERROR) {
-                return error;
-        }
+// Map a 32 bit value onto [0, range) without a division
+static ATTR_INLINE uint32_t reduce_range(uint32_t value, uint32_t range)
+{
+        return (uint32_t)(((uint64_t)value * range) >> 32);
+}
+
+// The bucket of a frozen map which decides the displacement of a hash
+static ATTR_INLINE uint32_t frozen_bucket(const struct map_frozen *frozen, uint32_t hash)
+{
+        return reduce_range(hash ^ frozen->salt, frozen->bucket_count);
+}
+
+// The slot a hash lands in for a given displacement
+//
+// The hash is already well mixed, multiplying by an odd constant is enough to
+// make the slots of different displacements independent of each other
+static ATTR_INLINE uint32_t frozen_slot(uint32_t hash, uint32_t displacement, uint32_t length)
+{
+        return reduce_range((hash ^ ((displacement + 1) * 0x9E3779B9U)) * 0x85EBCA6BU, length);
+}
+
+// Look up a key in a frozen map. This is always a single probe
+static enum natwm_error frozen_search(const struct map *map, const struct map_key_handle *handle,
+                                      uint32_t *index)
+{
+        const struct map_frozen *frozen = map->frozen;
+
+        if (map->length == 0) {
+                return NOT_FOUND_ERROR;
+        }
+
+        uint32_t displacement = frozen->displacements[frozen_bucket(frozen, handle->hash)];
+        uint32_t slot = frozen_slot(handle->hash, displacement, map->length);
+        const struct map_entry *entry = &map->entries[slot];
+
+        if (entry->hash == handle->hash
+            && (entry->key == handle->key
+                || map->key_compare_function(handle->key, entry->key, handle->size))) {
+                *index = slot;
+
+                return NO_ERROR;
+        }
+
+        return NOT_FOUND_ERROR;
+}
+
+// Find the entry holding a key
+//
+// While an incremental resize is in progress the key may still live in the
+// old entries, in which case in_old is set
+static enum natwm_error map_search(const struct map *map, const struct map_key_handle *handle,
+                                   uint32_t *index, bool *in_old)
+{
+        if (handle->key == NULL || index == NULL) {
+                return GENERIC_ERROR;
+        }
+
+        *in_old = false;
+
+        if (map->frozen != NULL) {
+                return frozen_search(map, handle, index);
+        }
+
+        if (map_search_hashed(map, handle->key, handle->size, handle->hash, index) == NO_ERROR) {
+                return NO_ERROR;
+        }
+
+        if (map_search_old(map, handle->key, handle->size, handle->hash, index) == NO_ERROR) {
+                *in_old = true;
+
+                return NO_ERROR;
+        }
+
+        return NOT_FOUND_ERROR;
+}
+
+// The smallest length the map can be resized to
+static uint32_t get_min_length(const struct map *map)
+{
+        if (map->setting_flags & MAP_FLAG_GROUP_PROBING) {
+                return MAP_GROUP_WIDTH;
+        }
+
+        return MAP_MIN_LENGTH;
+}
+
+// Handle load factor for inserting/removing values
+static int get_resize_direction(const struct map *map, double new_size)
+{
+        if (map->setting_flags & MAP_FLAG_IGNORE_THRESHOLDS) {
+                return 0;
+        }
+
+        double load_factor = new_size / map->length;
+
+        if (load_factor >= MAP_LOAD_FACTOR_HIGH) {
+                return MAP_RESIZE_UP;
+        }
+
+        if (load_factor <= MAP_LOAD_FACTOR_LOW) {
+                if (map->setting_flags & MAP_FLAG_IGNORE_THRESHOLDS_EMPTY
+                    || map->length <= get_min_length(map)) {
+                        return 0;
+                }
+
+                return MAP_RESIZE_DOWN;
+        }
+
+        // Should never happen
+        return 0;
+}
+
+// Re-place every entry of the map into newly allocated arrays of new_length
+//
+// A single new entries array (and control byte array when group probing) is
+// allocated and the present entries are re-placed into it. The entries
+// themselves are copied so no other allocations are needed. Any tombstones
+// are dropped in the process
+static enum natwm_error map_rehash(struct map *map, uint32_t new_length)
+{
+        bool use_groups = map->setting_flags & MAP_FLAG_GROUP_PROBING;
+        uint8_t *new_control = NULL;
+        struct map_entry *new_entries = calloc(new_length, sizeof(struct map_entry));
+
+        if (new_entries == NULL) {
+                return MEMORY_ALLOCATION_ERROR;
+        }
+
+        if (use_groups) {
+                new_control = malloc(new_length);
+
+                if (new_control == NULL) {
+                        free(new_entries);
+
+                        return MEMORY_ALLOCATION_ERROR;
+                }
+
+                memset(new_control, MAP_CONTROL_EMPTY, new_length);
+        }
+
+        map->event_flags |= EVENT_FLAG_RESIZING_MAP;
+
+        for (uint32_t i = 0; i < map->length; ++i) {
+                const struct map_entry *entry = &map->entries[i];
+
+                if (!is_entry_present(entry)) {
+                        // Nothing here
+                        continue;
+                }
+
+                enum natwm_error error = GENERIC_ERROR;
+
+                if (use_groups) {
+                        error = group_probe(new_entries, new_control, new_length, *entry, NULL);
+                } else {
+                        error = map_probe(new_entries, new_length, *entry);
+                }
+
+                if (error != NO_ERROR) {
+                        // The old entries are still intact
+                        free(new_entries);
+                        free(new_control);
+
+                        map->event_flags &= (unsigned int)~EVENT_FLAG_RESIZING_MAP;
+
+                        return error;
+                }
+        }
+
+        map_release(map, map->entries, free);
+        map_release(map, map->control, free);
+
+        map->length = new_length;
+        map->entries = new_entries;
+        map->control = new_control;
+        map->tombstone_count = 0;
+
+        map->event_flags &= (unsigned int)~EVENT_FLAG_RESIZING_MAP;
+
+        return NO_ERROR;
+}
+
+// Move up to max_slots slots from the old entries into the current entries
+//
+// Migrated slots are not emptied. The entry keeps it's hash (so the robin hood
+// search of the old entries still works) but it's key is replaced with a
+// marker which never matches
+static void map_migrate(struct map *map, uint32_t max_slots)
+{
+        map->migrated_last = 0;
+
+        if (map->old_entries == NULL) {
+                return;
+        }
+
+        uint64_t start = get_time_ns(map);
+        uint32_t moved = 0;
+
+        while (map->migrate_remaining > 0 && moved < max_slots) {
+                struct map_entry *entry = &map->old_entries[map->migrate_index];
+
+                if (is_entry_present(entry) && !is_entry_migrated(entry)) {
+                        // The current entries always have room for every
+                        // entry in the map so this can't fail
+                        map_probe(map->entries, map->length, *entry);
+
+                        entry->key = MIGRATED_KEY;
+                        entry->value = NULL;
+                }
+
+                map->migrate_index += 1;
+                map->migrate_remaining -= 1;
+
+                ++moved;
+        }
+
+        map->migrated_last = moved;
+        map->resize_time_ns += get_time_ns(map) - start;
+
+        if (map->migrate_remaining == 0) {
+                free(map->old_entries);
+
+                map->old_entries = NULL;
+                map->old_length = 0;
+                map->event_flags &= (unsigned int)~EVENT_FLAG_RESIZING_MAP;
+        }
+}
+
+// Start an incremental resize to new_length
+//
+// The current entries become the old entries and are moved across a few
+// slots at a time by subsequent inserts and deletes. If a previous resize is
+// still in progress it is finished first
+static enum natwm_error map_begin_migration(struct map *map, uint32_t new_length)
+{
+        if (map->old_entries != NULL) {
+                map_migrate(map, map->migrate_remaining);
+        }
+
+        struct map_entry *new_entries = calloc(new_length, sizeof(struct map_entry));
+
+        if (new_entries == NULL) {
+                return MEMORY_ALLOCATION_ERROR;
+        }
+
+        map->old_entries = map->entries;
+        map->old_length = map->length;
+        map->migrate_index = 0;
+        map->migrate_remaining = map->length;
+
+        map->entries = new_entries;
+        map->length = new_length;
+
+        map->event_flags |= EVENT_FLAG_RESIZING_MAP;
+
+        return NO_ERROR;
+}
+
+// Resizes the map either to a smaller size or a larger size
+//
+// resize_direction == 1 -> Increase size
+// resize_direction == -1 -> Decrease size
+static enum natwm_error map_resize(struct map *map, int resize_direction)
+{
+        uint32_t new_length = 0;
+
+        if (resize_direction == 1) {
+                new_length = map->length * 2;
+                map->resize_up_count += 1;
+        } else if (resize_direction == -1) {
+                new_length = map->length / 2;
+                map->resize_down_count += 1;
+        } else {
+                return GENERIC_ERROR;
+        }
+
+        // Maps with concurrent reads already hold the lock for the whole write
+        bool is_locked = map->retired == NULL && map_lock(map) == 0;
+        enum natwm_error err = NO_ERROR;
+
+        if (map->setting_flags & MAP_FLAG_INCREMENTAL_RESIZE) {
+                err = map_begin_migration(map, new_length);
+        } else {
+                uint64_t start = get_time_ns(map);
+
+                err = map_rehash(map, new_length);
+
+                map->resize_time_ns += get_time_ns(map) - start;
+        }
+
+        if (is_locked) {
+                map_unlock(map);
+        }
+
+        return err;
+}
+
+// Place a new entry into a group probing map
+//
+// Tombstones count towards the load of the map. If they are what pushes the
+// map over the high load factor the map is rehashed in place instead of grown
+static enum natwm_error map_insert_group_entry(struct map *map, struct map_entry entry)
+{
+        if (get_resize_direction(map, map->bucket_count + map->tombstone_count + 1.0)
+            == MAP_RESIZE_UP) {
+                enum natwm_error err = NO_ERROR;
+
+                if (get_resize_direction(map, map->bucket_count + 1.0) == MAP_RESIZE_UP) {
+                        err = map_resize(map, MAP_RESIZE_UP);
+                } else {
+                        // Group probing maps never have concurrent reads, so
+                        // the lock isn't held yet
+                        map_lock(map);
+
+                        err = map_rehash(map, map->length);
+
+                        map_unlock(map);
+                }
+
+                if (err != NO_ERROR) {
+                        return err;
+                }
+        }
+
+        if ((map->bucket_count + 1) > map->length) {
+                return CAPACITY_ERROR;
+        }
+
+        bool used_tombstone = false;
+        enum natwm_error err
+                = group_probe(map->entries, map->control, map->length, entry, &used_tombstone);
+
+        if (err != NO_ERROR) {
+                return err;
+        }
+
+        if (used_tombstone) {
+                map->tombstone_count -= 1;
+        }
+
+        map->bucket_count += 1;
+
+        return NO_ERROR;
+}
+
+// Inserts a pre-hashed entry into the map
+static enum natwm_error map_insert_entry(struct map *map, struct map_entry entry, size_t key_size)
+{
+        uint32_t present_index = 0;
+
+        map_migrate(map, MAP_MIGRATE_STEP);
+
+        // If the key is already present overwrite it
+        if (map_search_hashed(map, entry.key, key_size, entry.hash, &present_index) == NO_ERROR) {
+                map_entry_destroy(map, &map->entries[present_index]);
+
+                map->entries[present_index] = entry;
+
+                return NO_ERROR;
+        }
+
+        if (map_search_old(map, entry.key, key_size, entry.hash, &present_index) == NO_ERROR) {
+                map_entry_destroy(map, &map->old_entries[present_index]);
+
+                map->old_entries[present_index] = entry;
+
+                return NO_ERROR;
+        }
+
+        if (map->setting_flags & MAP_FLAG_GROUP_PROBING) {
+                return map_insert_group_entry(map, entry);
+        }
+
+        // Now we need to increase map->bucket_count
+        int resize_direction = get_resize_direction(map, map->bucket_count + 1.0);
+
+        if (resize_direction != 0) {
+                enum natwm_error resize_error = map_resize(map, resize_direction);
+
+                if (resize_error != NO_ERROR) {
+                        return resize_error;
+                }
+        }
+
+        if ((map->bucket_count + 1) > map->length) {
+                return CAPACITY_ERROR;
+        }
+
+        enum natwm_error error = map_probe(map->entries, map->length, entry);
+
+        if (error != NO_ERROR) {
+                return error;
+        }
+
+        map->bucket_count += 1;
+
+        return NO_ERROR;
+}
+
+// Release the key and value held by an entry (based on the map settings) and
+// mark the entry as empty
+void map_entry_destroy(const struct map *map, struct map_entry *entry)
+{
+        if (!is_entry_present(entry)) {
+                return;
+        }
+
+        if (map->setting_flags & MAP_FLAG_FREE_ENTRY_KEY) {
+                map_release(map, (void *)entry->key, free);
+        }
+
+        if (map->setting_flags & MAP_FLAG_USE_FREE) {
+                map_release(map, entry->value, free);
+        }
+
+        if (map->setting_flags & MAP_FLAG_USE_FREE_FUNC && map->free_function != NULL) {
+                map_release(map, entry->value, map->free_function);
+        }
+
+        entry->hash = 0;
+        entry->key = NULL;
+        entry->value = NULL;
+}
+
+// Initialize a map
+struct map *map_init(void)
+{
+        struct map *map = malloc(sizeof(struct map));
+
+        if (map == NULL) {
+                return NULL;
+        }
+
+        map->length = MAP_MIN_LENGTH;
+        map->bucket_count = 0;
+        map->entries = calloc(map->length, sizeof(struct map_entry));
+        map->control = NULL;
+        map->tombstone_count = 0;
+        map->old_entries = NULL;
+        map->old_length = 0;
+        map->migrate_index = 0;
+        map->migrate_remaining = 0;
+        map->migrated_last = 0;
+        map->sequence = 0;
+        map->reader_count = 0;
+        map->draining = 0;
+        map->retired = NULL;
+        map->frozen = NULL;
+        map->resize_up_count = 0;
+        map->resize_down_count = 0;
+        map->resize_time_ns = 0;
+        map->seed = map_random_seed();
+
+        if (map->entries == NULL) {
+                free(map);
+
+                return NULL;
+        }
+
+        if (pthread_mutex_init(&map->mutex, NULL) != 0) {
+                free(map->entries);
+                free(map);
+
+                return NULL;
+        }
+
+        map->hash_function = map_hash_wyhash;
+        map->key_size_function = default_key_size_function;
+        map->key_compare_function = default_key_compare_function;
+        map->free_function = NULL;
+        map->setting_flags = MAP_FLAG_IGNORE_THRESHOLDS_EMPTY;
+        map->event_flags = EVENT_FLAG_NORMAL;
+
+        return map;
+}
+
+// Destroys a map and it's entries
+//
+// Note: If the value stored in the entires has nested items which need to be
+// free'd then there will be memory leaks if this function is used since we are
+// only dealing with the top level. map_destroy_func allows for customizing the
+// free'ing of entries
+void map_destroy(struct map *map)
+{
+        if (map == NULL) {
+                return;
+        }
+
+        // Delete entries
+        for (uint32_t i = 0; i < map->length; ++i) {
+                map_entry_destroy(map, &map->entries[i]);
+        }
+
+        for (uint32_t i = 0; i < map->old_length; ++i) {
+                if (!is_entry_migrated(&map->old_entries[i])) {
+                        map_entry_destroy(map, &map->old_entries[i]);
+                }
+        }
+
+        if (map->retired != NULL) {
+                map_reclaim(map);
+
+                free(map->retired->items);
+                free(map->retired);
+
+                // Anything released from now on can be free'd right away
+                map->retired = NULL;
+        }
+
+        if (map->frozen != NULL) {
+                free(map->frozen->displacements);
+                free(map->frozen);
+        }
+
+        pthread_mutex_destroy(&map->mutex);
+
+        free(map->entries);
+        free(map->old_entries);
+        free(map->control);
+        free(map);
+}
+
+// Compute the size and hash of a key ahead of time
+//
+// The handle can be used with the *_prehashed functions of any map sharing
+// the same hash function, seed and key size function. The key itself is not
+// copied and must outlive the handle
+enum natwm_error map_key_handle_init(const struct map *map, const void *key,
+                                     struct map_key_handle *handle)
+{
+        if (key == NULL) {
+                return GENERIC_ERROR;
+        }
+
+        handle->key = key;
+        handle->size = map->key_size_function(key);
+        handle->hash = map->hash_function(key, handle->size, map->seed);
+
+        return NO_ERROR;
+}
+
+// Insert an entry into a map
+enum natwm_error map_insert(struct map *map, const void *key, void *value)
+{
+        struct map_key_handle handle;
+        enum natwm_error err = map_key_handle_init(map, key, &handle);
+
+        if (err != NO_ERROR) {
+                return err;
+        }
+
+        return map_insert_prehashed(map, &handle, value);
+}
+
+// Insert an entry using a key which has already been hashed
+//
+// If the key is inserted the map holds on to handle->key, not the handle
+enum natwm_error map_insert_prehashed(struct map *map, const struct map_key_handle *handle,
+                                      void *value)
+{
+        if (handle->key == NULL || map->frozen != NULL) {
+                return GENERIC_ERROR;
+        }
+
+        struct map_entry entry = {
+                .hash = handle->hash,
+                .key = handle->key,
+                .value = value,
+        };
+
+        map_write_begin(map);
+
+        enum natwm_error err = map_insert_entry(map, entry, handle->size);
+
+        map_write_end(map);
+
+        return err;
+}
+
+struct map_entry *map_get(const struct map *map, const void *key)
+{
+        struct map_key_handle handle;
+
+        if (map_key_handle_init(map, key, &handle) != NO_ERROR) {
+                return NULL;
+        }
+
+        return map_get_prehashed(map, &handle);
+}
+
+// Find an entry using a key which has already been hashed
+//
+// Entries whose key is the same pointer as handle->key match without calling
+// the key compare function
+struct map_entry *map_get_prehashed(const struct map *map, const struct map_key_handle *handle)
+{
+        uint32_t index = 0;
+        bool in_old = false;
+
+        if (map_search(map, handle, &index, &in_old) != NO_ERROR) {
+                return NULL;
+        }
+
+        if (in_old) {
+                return &map->old_entries[index];
+        }
+
+        return &map->entries[index];
+}
+
+// Prefetch the memory the first probe for a hash will touch
+static void map_prefetch(const struct map *map, uint32_t hash)
+{
+        if (map->frozen != NULL) {
+                if (map->length == 0) {
+                        return;
+                }
+
+                // The slot depends on the displacement, which is what misses
+                PREFETCH_READ(&map->frozen->displacements[frozen_bucket(map->frozen, hash)]);
+
+                return;
+        }
+
+        if (map->setting_flags & MAP_FLAG_GROUP_PROBING) {
+                uint32_t group = get_initial_group(hash, map->length / MAP_GROUP_WIDTH);
+
+                PREFETCH_READ(map->control + (group * MAP_GROUP_WIDTH));
+
+                return;
+        }
+
+        PREFETCH_READ(&map->entries[hash & (map->length - 1)]);
+}
+
+// Find the entries of many keys
+//
+// Keys are handled in batches of MAP_GET_MANY_BATCH. All keys in a batch are
+// hashed and their initial buckets prefetched before any of them are searched,
+// so the cache misses of a batch overlap instead of being paid one after the
+// other. This only pays off once the map no longer fits in cache
+//
+// results[i] is set to the entry of keys[i], or NULL when it is missing.
+// Returns the number of keys which were found
+size_t map_get_many(const struct map *map, const void **keys, size_t count,
+                    struct map_entry **results)
+{
+        struct map_key_handle handles[MAP_GET_MANY_BATCH];
+        size_t found = 0;
+
+        for (size_t start = 0; start < count; start += MAP_GET_MANY_BATCH) {
+                size_t batch_size = MIN(count - start, MAP_GET_MANY_BATCH);
+
+                // Hashing reads the keys, which can miss as well
+                for (size_t i = 0; i < batch_size; ++i) {
+                        PREFETCH_READ(keys[start + i]);
+                }
+
+                for (size_t i = 0; i < batch_size; ++i) {
+                        if (map_key_handle_init(map, keys[start + i], &handles[i]) != NO_ERROR) {
+                                continue;
+                        }
+
+                        map_prefetch(map, handles[i].hash);
+                }
+
+                for (size_t i = 0; i < batch_size; ++i) {
+                        results[start + i] = NULL;
+
+                        if (keys[start + i] == NULL) {
+                                continue;
+                        }
+
+                        results[start + i] = map_get_prehashed(map, &handles[i]);
+
+                        if (results[start + i] != NULL) {
+                                ++found;
+                        }
+                }
+        }
+
+        return found;
+}
+
+// Remove the entry at dest_index using backward shift deletion
+//
+// Following entries are shifted back until we reach an empty slot or an entry
+// which is already in it's initial bucket
+static void entries_backward_shift(struct map_entry *entries, uint32_t length,
+                                   uint32_t dest_index)
+{
+        uint32_t swap_index = (dest_index + 1) & (length - 1);
+
+        for (uint32_t i = 1; i < length; ++i) {
+                struct map_entry *swap_entry = &entries[swap_index];
+
+                if (!is_entry_present(swap_entry)
+                    || get_dib(length, swap_entry->hash, swap_index) == 0) {
+                        break;
+                }
+
+                // Shift the entry back into the empty slot
+                entries[dest_index] = *swap_entry;
+
+                swap_entry->hash = 0;
+                swap_entry->key = NULL;
+                swap_entry->value = NULL;
+
+                // Update values
+                dest_index = swap_index;
+                swap_index = (swap_index + 1) & (length - 1);
+        }
+}
+
+// Delete an entry from the map using backward shift deletion. The key and
+// value are released based on the map settings
+static enum natwm_error map_delete_entry(struct map *map, const struct map_key_handle *handle)
+{
+        uint32_t dest_index = 0;
+        bool in_old = false;
+
+        map_migrate(map, MAP_MIGRATE_STEP);
+
+        enum natwm_error err = map_search(map, handle, &dest_index, &in_old);
+
+        if (err != NO_ERROR) {
+                return err;
+        }
+
+        if (in_old) {
+                struct map_entry *entry = &map->old_entries[dest_index];
+                uint32_t hash = entry->hash;
+
+                // A backward shift could move an entry which hasn't been
+                // migrated yet behind migrate_index, and it would never be
+                // moved. Marking the slot as migrated keeps every probe
+                // sequence of the old entries intact instead
+                map_entry_destroy(map, entry);
+
+                entry->hash = hash;
+                entry->key = MIGRATED_KEY;
+
+                map->bucket_count -= 1;
+
+                return NO_ERROR;
+        }
+
+        map_entry_destroy(map, &map->entries[dest_index]);
+
+        if (map->setting_flags & MAP_FLAG_GROUP_PROBING) {
+                const uint8_t *group = map->control + (dest_index - (dest_index % MAP_GROUP_WIDTH));
+
+                // If the group still has an empty slot then no probe sequence
+                // ever continued past this group, so the slot can be emptied.
+                // Otherwise we need to leave a tombstone
+                if (group_match(group, MAP_CONTROL_EMPTY) != 0) {
+                        map->control[dest_index] = MAP_CONTROL_EMPTY;
+                } else {
+                        map->control[dest_index] = MAP_CONTROL_DELETED;
+                        map->tombstone_count += 1;
+                }
+
+                map->bucket_count -= 1;
+
+                return NO_ERROR;
+        }
+
+        entries_backward_shift(map->entries, map->length, dest_index);
+
+        map->bucket_count -= 1;
+
+        return NO_ERROR;
+}
+
+// Halve the map once a delete takes it below MAP_LOAD_FACTOR_LOW. Maps only
+// shrink when MAP_FLAG_IGNORE_THRESHOLDS_EMPTY has been removed
+//
+// The entry is already gone at this point, so a failed shrink leaves the map
+// at its current length and the delete still succeeds
+static void map_shrink(struct map *map)
+{
+        if (get_resize_direction(map, map->bucket_count) != MAP_RESIZE_DOWN) {
+                return;
+        }
+
+        map_resize(map, MAP_RESIZE_DOWN);
+}
+
+enum natwm_error map_delete(struct map *map, const void *key)
+{
+        struct map_key_handle handle;
+        enum natwm_error err = map_key_handle_init(map, key, &handle);
+
+        if (err != NO_ERROR) {
+                return err;
+        }
+
+        if (map->frozen != NULL) {
+                return GENERIC_ERROR;
+        }
+
+        map_write_begin(map);
+
+        err = map_delete_entry(map, &handle);
+
+        if (err == NO_ERROR) {
+                map_shrink(map);
+        }
 
-        return map_insert_entry(map, entry);
+        map_write_end(map);
+
+        return err;
 }
 
-struct map_entry *map_get(const struct map *map, const void *key)
+// Find the value of a key while another thread may be writing to the map
+//
+// This never takes the map lock. The read is retried if a writer modified
+// the map in the meantime, and anything a writer releases stays allocated
+// until there are no readers left. To keep using a value which the map will
+// free on delete, wrap the read and the use in map_read_begin/map_read_end.
+//
+// Without concurrent reads enabled this is the same as map_get
+enum natwm_error map_read_value(struct map *map, const void *key, void **value)
 {
-        uint32_t index = 0;
+        if (key == NULL || value == NULL) {
+                return GENERIC_ERROR;
+        }
 
-        if (map_search(map, key, &index) != NO_ERROR) {
-                return NULL;
+        if (map->retired == NULL) {
+                struct map_entry *entry = map_get(map, key);
+
+                if (entry == NULL) {
+                        return NOT_FOUND_ERROR;
+                }
+
+                *value = entry->value;
+
+                return NO_ERROR;
+        }
+
+        size_t key_size = map->key_size_function(key);
+        uint32_t hash = map->hash_function(key, key_size, map->seed);
+        enum natwm_error err = NOT_FOUND_ERROR;
+        uint32_t spin_count = 0;
+
+        map_read_begin(map);
+
+        for (;; map_read_backoff(&spin_count)) {
+                uint32_t sequence = __atomic_load_n(&map->sequence, __ATOMIC_SEQ_CST);
+
+                if (sequence & 1) {
+                        // A write is in progress
+                        continue;
+                }
+
+                const struct map_entry *entries = __atomic_load_n(&map->entries, __ATOMIC_ACQUIRE);
+                uint32_t length = __atomic_load_n(&map->length, __ATOMIC_ACQUIRE);
+
+                // Make sure entries and length belong together before
+                // indexing into entries
+                if (__atomic_load_n(&map->sequence, __ATOMIC_ACQUIRE) != sequence) {
+                        continue;
+                }
+
+                uint32_t index = 0;
+                void *found = NULL;
+
+                err = entries_search(map, entries, length, key, key_size, hash, &index);
+
+                if (err == NO_ERROR) {
+                        found = entries[index].value;
+                }
+
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+                if (__atomic_load_n(&map->sequence, __ATOMIC_RELAXED) == sequence) {
+                        if (err == NO_ERROR) {
+                                *value = found;
+                        }
+
+                        break;
+                }
         }
 
-        return map->entries[index];
+        map_read_end(map);
+
+        return err;
 }
 
-// TODO: Add resize when threshold goes below MAP_LOAD_FACTOR_LOW
-enum natwm_error map_delete(struct map *map, const void *key)
+// Mark the start of a section where values read from the map are used
+//
+// Readers only delay free'ing, they never block writers. Once
+// MAP_RETIRE_MAX_LENGTH allocations are waiting to be free'd a writer waits for
+// the active readers, and new readers hold off until it is done
+void map_read_begin(struct map *map)
 {
-        uint32_t dest_index = 0;
-        enum natwm_error err = map_search(map, key, &dest_index);
+        uint32_t spin_count = 0;
 
-        if (err != NO_ERROR) {
-                return err;
+        for (;; map_read_backoff(&spin_count)) {
+                __atomic_add_fetch(&map->reader_count, 1, __ATOMIC_SEQ_CST);
+
+                if (read_depth > 0 || __atomic_load_n(&map->draining, __ATOMIC_SEQ_CST) == 0) {
+                        break;
+                }
+
+                // A writer is waiting for the readers before this one
+                __atomic_sub_fetch(&map->reader_count, 1, __ATOMIC_SEQ_CST);
+        }
+
+        ++read_depth;
+}
+
+void map_read_end(struct map *map)
+{
+        --read_depth;
+
+        __atomic_sub_fetch(&map->reader_count, 1, __ATOMIC_SEQ_CST);
+}
+
+// Allow map_read_value to be used from other threads while this map is being
+// modified
+//
+// Writers are serialized by the map lock, readers are lock free. Not
+// supported together with group probing, incremental resizing or
+// MAP_FLAG_NO_LOCKING
+int map_enable_concurrent_reads(struct map *map)
+{
+        if (map->setting_flags
+            & (MAP_FLAG_GROUP_PROBING | MAP_FLAG_INCREMENTAL_RESIZE | MAP_FLAG_NO_LOCKING
+               | MAP_FLAG_FROZEN)) {
+                return -1;
+        }
+
+        if (map->retired != NULL) {
+                return 0;
+        }
+
+        struct map_retire_list *retired = malloc(sizeof(struct map_retire_list));
+
+        if (retired == NULL) {
+                return -1;
+        }
+
+        retired->length = 0;
+        retired->capacity = 0;
+        retired->items = NULL;
+
+        map->retired = retired;
+
+        map_set_setting_flag(map, MAP_FLAG_CONCURRENT_READS);
+
+        return 0;
+}
+
+// Try to find a displacement for every bucket of a frozen map using salt
+//
+// Keys are grouped by bucket and the buckets are handled from largest to
+// smallest. For each bucket displacements are tried in order until every key
+// of the bucket lands in a distinct free slot (this is the CHD algorithm)
+static enum natwm_error frozen_build(const struct map_entry *items, uint32_t count,
+                                     struct map_frozen *frozen, struct map_entry *slots)
+{
+        enum natwm_error err = MEMORY_ALLOCATION_ERROR;
+        uint32_t *bucket_sizes = calloc(frozen->bucket_count + 1, sizeof(uint32_t));
+        uint32_t *bucket_starts = calloc(frozen->bucket_count + 1, sizeof(uint32_t));
+        uint32_t *order = malloc(sizeof(uint32_t) * count);
+        uint32_t *positions = malloc(sizeof(uint32_t) * count);
+
+        if (bucket_sizes == NULL || bucket_starts == NULL || order == NULL || positions == NULL) {
+                goto free_and_return;
+        }
+
+        uint32_t max_bucket_size = 0;
+
+        for (uint32_t i = 0; i < count; ++i) {
+                uint32_t bucket = frozen_bucket(frozen, items[i].hash);
+
+                bucket_sizes[bucket] += 1;
+
+                max_bucket_size = MAX(max_bucket_size, bucket_sizes[bucket]);
+        }
+
+        // Group the keys by bucket
+        for (uint32_t i = 0; i < frozen->bucket_count; ++i) {
+                bucket_starts[i + 1] = bucket_starts[i] + bucket_sizes[i];
         }
 
-        uint32_t swap_index = dest_index + 1;
+        for (uint32_t i = 0; i < count; ++i) {
+                uint32_t bucket = frozen_bucket(frozen, items[i].hash);
+
+                order[bucket_starts[bucket]] = i;
+                bucket_starts[bucket] += 1;
+        }
+
+        for (uint32_t i = 0; i < frozen->bucket_count; ++i) {
+                bucket_starts[i] -= bucket_sizes[i];
+        }
+
+        err = CAPACITY_ERROR;
+
+        for (uint32_t size = max_bucket_size; size > 0; --size) {
+                for (uint32_t bucket = 0; bucket < frozen->bucket_count; ++bucket) {
+                        if (bucket_sizes[bucket] != size) {
+                                continue;
+                        }
+
+                        const uint32_t *keys = &order[bucket_starts[bucket]];
+                        bool placed = false;
+
+                        for (uint32_t d = 0; d < MAP_FROZEN_MAX_DISPLACEMENT && !placed; ++d) {
+                                placed = true;
+
+                                for (uint32_t k = 0; k < size && placed; ++k) {
+                                        positions[k] = frozen_slot(items[keys[k]].hash, d, count);
+
+                                        if (is_entry_present(&slots[positions[k]])) {
+                                                placed = false;
+                                        }
+
+                                        for (uint32_t j = 0; j < k && placed; ++j) {
+                                                placed = positions[j] != positions[k];
+                                        }
+                                }
+
+                                if (placed) {
+                                        frozen->displacements[bucket] = d;
+                                }
+                        }
+
+                        if (!placed) {
+                                goto free_and_return;
+                        }
 
-        for (size_t i = 1; i < map->length; ++i) {
-                if (swap_index >= map->length) {
-                        swap_index = 0;
+                        for (uint32_t k = 0; k < size; ++k) {
+                                slots[positions[k]] = items[keys[k]];
+                        }
                 }
+        }
 
-                struct map_entry *swap_entry = map->entries[swap_index];
+        err = NO_ERROR;
 
-                if (!is_entry_present(swap_entry)) {
-                        break;
+free_and_return:
+        free(bucket_sizes);
+        free(bucket_starts);
+        free(order);
+        free(positions);
+
+        return err;
+}
+
+// Replace the entries of a map with the slots of it's perfect hash
+static void frozen_install(struct map *map, struct map_frozen *frozen, struct map_entry *slots,
+                           uint32_t count)
+{
+        // Only the arrays are replaced, the keys and values now live in slots
+        free(map->entries);
+        free(map->control);
+
+        map->entries = slots;
+        map->length = count;
+        map->control = NULL;
+        map->tombstone_count = 0;
+        map->frozen = frozen;
+
+        map_set_setting_flag(map, MAP_FLAG_FROZEN);
+}
+
+// Turn the map into a read only map using a minimal perfect hash
+//
+// Every key gets a slot of it's own in a single array of exactly
+// bucket_count entries, so a lookup is one probe and one key compare.
+// Afterwards inserts and deletes fail and the map can only be destroyed.
+//
+// If no perfect hash can be found (for instance when two keys share the same
+// 32 bit hash) an error is returned and the map is left as it was
+enum natwm_error map_freeze(struct map *map)
+{
+        if (map->frozen != NULL) {
+                return NO_ERROR;
+        }
+
+        if (map->setting_flags & MAP_FLAG_CONCURRENT_READS) {
+                return GENERIC_ERROR;
+        }
+
+        // Make sure every entry is in the current entries array
+        map_migrate(map, map->migrate_remaining);
+
+        uint32_t count = map->bucket_count;
+        struct map_frozen *frozen = malloc(sizeof(struct map_frozen));
+        struct map_entry *items = malloc(sizeof(struct map_entry) * (count + 1));
+        struct map_entry *slots = NULL;
+
+        if (frozen == NULL || items == NULL) {
+                goto allocation_error;
+        }
+
+        frozen->bucket_count = (count / MAP_FROZEN_BUCKET_SIZE) + 1;
+        frozen->displacements = calloc(frozen->bucket_count, sizeof(uint32_t));
+
+        if (frozen->displacements == NULL) {
+                goto allocation_error;
+        }
+
+        if (posix_memalign((void **)&slots, MAP_FROZEN_ALIGNMENT,
+                           sizeof(struct map_entry) * (count + 1))
+            != 0) {
+                slots = NULL;
+
+                goto allocation_error;
+        }
+
+        for (uint32_t i = 0, j = 0; i < map->length; ++i) {
+                if (is_entry_present(&map->entries[i])) {
+                        items[j++] = map->entries[i];
                 }
+        }
 
-                uint32_t swap_dib = get_dib(map, swap_entry, swap_index);
+        enum natwm_error err = CAPACITY_ERROR;
 
-                if (swap_dib == 0) {
+        // A different salt regroups the keys, which is usually enough to get
+        // past a bucket which couldn't be placed
+        for (uint32_t salt = 0; salt < MAP_FROZEN_MAX_ATTEMPTS && err != NO_ERROR; ++salt) {
+                frozen->salt = hash_uint32(salt);
+
+                memset(slots, 0, sizeof(struct map_entry) * count);
+
+                err = frozen_build(items, count, frozen, slots);
+
+                if (err == MEMORY_ALLOCATION_ERROR) {
                         break;
                 }
+        }
 
-                // We need to swap
-                struct map_entry *temp = map->entries[dest_index];
-                map->entries[dest_index] = swap_entry;
-                map->entries[swap_index] = temp;
+        free(items);
 
-                // Update values
-                dest_index += 1;
-                swap_index += 1;
+        if (err != NO_ERROR) {
+                free(frozen->displacements);
+                free(frozen);
+                free(slots);
+
+                return err;
         }
 
-        // Delete the resulting entry
-        struct map_entry *delete_entry = map->entries[dest_index];
+        frozen_install(map, frozen, slots, count);
 
-        // Mark entry as deleted
-        delete_entry->key = NULL;
-        delete_entry->value = (void *)&EMPTY_ENTRY;
+        return NO_ERROR;
 
-        map->bucket_count -= 1;
+allocation_error:
+        if (frozen != NULL) {
+                free(frozen->displacements);
+        }
+
+        free(frozen);
+        free(items);
+        free(slots);
+
+        return MEMORY_ALLOCATION_ERROR;
+}
+
+// Freeze the map using the perfect hash found by an earlier map_freeze, for
+// instance one saved to disk along with the keys
+//
+// No search takes place, every key goes straight into the slot it's
+// displacement gives it. The map must hold the same keys, hashed with the same
+// seed, as the map the layout came from. Otherwise INVALID_INPUT_ERROR is
+// returned and the map is left as it was
+enum natwm_error map_freeze_with_layout(struct map *map, uint32_t salt,
+                                        const uint32_t *displacements, uint32_t bucket_count)
+{
+        if (map->frozen != NULL) {
+                return NO_ERROR;
+        }
+
+        if (map->setting_flags & MAP_FLAG_CONCURRENT_READS) {
+                return GENERIC_ERROR;
+        }
+
+        // Make sure every entry is in the current entries array
+        map_migrate(map, map->migrate_remaining);
+
+        uint32_t count = map->bucket_count;
+
+        if (bucket_count != (count / MAP_FROZEN_BUCKET_SIZE) + 1) {
+                return INVALID_INPUT_ERROR;
+        }
+
+        enum natwm_error err = MEMORY_ALLOCATION_ERROR;
+        struct map_frozen *frozen = malloc(sizeof(struct map_frozen));
+        struct map_entry *slots = NULL;
+
+        if (frozen == NULL) {
+                return MEMORY_ALLOCATION_ERROR;
+        }
+
+        frozen->salt = salt;
+        frozen->bucket_count = bucket_count;
+        frozen->displacements = malloc(sizeof(uint32_t) * bucket_count);
+
+        if (frozen->displacements == NULL
+            || posix_memalign((void **)&slots, MAP_FROZEN_ALIGNMENT,
+                              sizeof(struct map_entry) * (count + 1))
+                    != 0) {
+                slots = NULL;
+
+                goto free_and_return;
+        }
+
+        memcpy(frozen->displacements, displacements, sizeof(uint32_t) * bucket_count);
+        memset(slots, 0, sizeof(struct map_entry) * (count + 1));
+
+        err = INVALID_INPUT_ERROR;
+
+        for (uint32_t i = 0; i < map->length; ++i) {
+                const struct map_entry *entry = &map->entries[i];
+
+                if (!is_entry_present(entry)) {
+                        continue;
+                }
+
+                uint32_t displacement = displacements[frozen_bucket(frozen, entry->hash)];
+                uint32_t slot = frozen_slot(entry->hash, displacement, count);
+
+                if (displacement >= MAP_FROZEN_MAX_DISPLACEMENT || is_entry_present(&slots[slot])) {
+                        goto free_and_return;
+                }
+
+                slots[slot] = *entry;
+        }
+
+        frozen_install(map, frozen, slots, count);
 
         return NO_ERROR;
+
+free_and_return:
+        free(frozen->displacements);
+        free(frozen);
+        free(slots);
+
+        return err;
+}
+
+// Number of probes a group probing lookup needs before reaching the group
+// of slot, counted the same way as a robin hood DIB
+static uint32_t get_group_probe_length(const struct map *map, uint32_t hash, uint32_t slot)
+{
+        uint32_t group_count = map->length / MAP_GROUP_WIDTH;
+        uint32_t group = get_initial_group(hash, group_count);
+        uint32_t target = slot / MAP_GROUP_WIDTH;
+
+        for (uint32_t i = 0; i < group_count; ++i) {
+                if (group == target) {
+                        return i;
+                }
+
+                group = (group + i + 1) & (group_count - 1);
+        }
+
+        return group_count;
+}
+
+static void add_dib(struct map_stats *stats, uint32_t dib, uint64_t *dib_total)
+{
+        stats->dib_histogram[MIN(dib, MAP_STATS_HISTOGRAM_SIZE - 1)] += 1;
+        stats->max_dib = MAX(stats->max_dib, dib);
+
+        *dib_total += dib;
+}
+
+// Collect statistics about the current state of the map
+//
+// The DIB histogram is built by walking every slot, so this is O(length).
+// resize_time_ns is only tracked when MAP_FLAG_COLLECT_STATS is set
+void map_get_stats(const struct map *map, struct map_stats *stats)
+{
+        uint64_t dib_total = 0;
+
+        memset(stats, 0, sizeof(struct map_stats));
+
+        stats->entry_count = map->bucket_count;
+        stats->length = map->length;
+        stats->resize_up_count = map->resize_up_count;
+        stats->resize_down_count = map->resize_down_count;
+        stats->resize_time_ns = map->resize_time_ns;
+        stats->tombstone_count = map->tombstone_count;
+
+        for (uint32_t i = 0; i < map->length; ++i) {
+                const struct map_entry *entry = &map->entries[i];
+
+                if (!is_entry_present(entry)) {
+                        continue;
+                }
+
+                if (map->frozen != NULL) {
+                        add_dib(stats, 0, &dib_total);
+                } else if (map->setting_flags & MAP_FLAG_GROUP_PROBING) {
+                        add_dib(stats, get_group_probe_length(map, entry->hash, i), &dib_total);
+                } else {
+                        add_dib(stats, get_dib(map->length, entry->hash, i), &dib_total);
+                }
+        }
+
+        for (uint32_t i = 0; i < map->old_length; ++i) {
+                const struct map_entry *entry = &map->old_entries[i];
+
+                if (is_entry_present(entry) && !is_entry_migrated(entry)) {
+                        add_dib(stats, get_dib(map->old_length, entry->hash, i), &dib_total);
+                }
+        }
+
+        if (stats->entry_count > 0) {
+                stats->mean_dib = (double)dib_total / stats->entry_count;
+        }
+
+        stats->bytes_allocated = sizeof(struct map) + (map->length * sizeof(struct map_entry))
+                + (map->old_length * sizeof(struct map_entry));
+
+        if (map->control != NULL) {
+                stats->bytes_allocated += map->length;
+        }
+
+        if (map->frozen != NULL) {
+                stats->bytes_allocated += sizeof(struct map_frozen)
+                        + (map->frozen->bucket_count * sizeof(uint32_t));
+        }
+
+        if (map->retired != NULL) {
+                stats->bytes_allocated += sizeof(struct map_retire_list)
+                        + (map->retired->capacity * sizeof(struct map_retired));
+        }
+}
+
+// Switch the map to group probing
+//
+// This must be done before any entries are inserted. The map is grown to at
+// least MAP_GROUP_WIDTH slots and a control byte array is allocated.
+int map_enable_group_probing(struct map *map)
+{
+        if (map->bucket_count > 0
+            || map->setting_flags & (MAP_FLAG_INCREMENTAL_RESIZE | MAP_FLAG_CONCURRENT_READS)) {
+                return -1;
+        }
+
+        if (map->setting_flags & MAP_FLAG_GROUP_PROBING) {
+                return 0;
+        }
+
+        uint32_t length = MAX(map->length, MAP_GROUP_WIDTH);
+        struct map_entry *entries = calloc(length, sizeof(struct map_entry));
+        uint8_t *control = malloc(length);
+
+        if (entries == NULL || control == NULL) {
+                free(entries);
+                free(control);
+
+                return -1;
+        }
+
+        memset(control, MAP_CONTROL_EMPTY, length);
+
+        free(map->entries);
+
+        map->length = length;
+        map->entries = entries;
+        map->control = control;
+        map->tombstone_count = 0;
+
+        map_set_setting_flag(map, MAP_FLAG_GROUP_PROBING);
+
+        return 0;
+}
+
+// Spread the work of resizing the map across operations
+//
+// Instead of re-placing every entry at once when the map grows, the old
+// entries are kept around and each insert and delete moves at least
+// MAP_MIGRATE_STEP slots across. Lookups check both sets of entries until
+// the migration has finished. Not supported together with group probing
+int map_enable_incremental_resize(struct map *map)
+{
+        if (map->setting_flags & (MAP_FLAG_GROUP_PROBING | MAP_FLAG_CONCURRENT_READS)) {
+                return -1;
+        }
+
+        map_set_setting_flag(map, MAP_FLAG_INCREMENTAL_RESIZE);
+
+        return 0;
 }
 
 // Set a hashing function for use when inserting and re-hashing entries
@@ -529,6 +1980,21 @@ int map_set_hash_function(struct map *map, map_hash_function_t function)
         return 0;
 }
 
+// Set the seed passed to the hashing function
+//
+// Maps are seeded randomly, this is only needed when placement has to be
+// reproducible or when key handles are shared between maps
+int map_set_hash_seed(struct map *map, uint64_t seed)
+{
+        if (map->bucket_count > 0) {
+                return -1;
+        }
+
+        map->seed = seed;
+
+        return 0;
+}
+
 // Set the key sizing function.
 int map_set_key_size_function(struct map *map, map_key_size_function_t function)
 {
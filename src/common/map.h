@@ -15,26 +15,62 @@
  *
  * The implementation details are as follows:
  *
- * The hash mamapp uses the 32 bit version of the murmur hash v3 by default
+ * The hash map uses a 64 bit hash based on wyhash by default (see
+ * map_hash_wyhash). Every map draws a random seed in map_init so the layout of
+ * one map says nothing about the layout of another, and colliding keys can't
+ * be crafted ahead of time. map_set_hash_function selects a different hash,
+ * such as map_hash_integer for maps keyed by integers
  *
  * Collisions are resolved using open addressing with the robin hood hashing
  * algorithm - probing linearly
  *
+ * Entries are stored inline in a single contiguous array. An empty slot is
+ * represented by an entry with a NULL key, so no per-entry allocation takes
+ * place and probing never leaves the entries array
+ *
  * Deletion is performed using Emmanuel Goossaert's backward shift deletion
  * algorithm
  *
+ * Optionally (see map_enable_group_probing) a control byte is kept for each
+ * slot holding 7 bits of the entry hash. Lookups then probe groups of
+ * MAP_GROUP_WIDTH slots at once (using SSE2 when available) and only compare
+ * keys whose hash fragment matches. In this mode entries are placed without
+ * robin hood swapping and deletes leave a tombstone in the control bytes
+ *
+ * Once a map stops changing it can be frozen (see map_freeze). The entries
+ * are then re-placed using a minimal perfect hash so every lookup is a single
+ * probe
+ *
  * The table implements bi-directional resizing using high+low load-factors
  *
+ * Optionally (see map_enable_incremental_resize) resizing is spread across
+ * inserts and deletes, which bounds the work done by a single operation to
+ * MAP_MIGRATE_STEP slots
+ *
+ * Optionally (see map_enable_concurrent_reads) other threads can look up
+ * values with map_read_value while the map is modified. Writers are
+ * serialized by the map lock and bump a sequence number which lock free
+ * readers use to detect and retry reads which raced a write. Memory released
+ * by writers is only free'd once no readers are active. Other maps only take
+ * the lock while they resize
+ *
  * After resize a re-hash is performed to amortize the keys across the new
  * map size
  *
+ * Keys can be hashed ahead of time with map_key_handle_init and used with
+ * the *_prehashed functions. Keys which are the same pointer compare equal
+ * without calling the key compare function
+ *
+ * Many keys can be looked up at once with map_get_many, which overlaps the
+ * cache misses of their initial buckets
+ *
  * Keys are pointers to char
  *
  * Values are pointers to void
  */
 
-// Function which takes a key and returns a hash
-typedef uint32_t (*map_hash_function_t)(const void *key, size_t size);
+// Function which takes a key and the seed of the map and returns a hash
+typedef uint32_t (*map_hash_function_t)(const void *key, size_t size, uint64_t seed);
 
 // Function for finding the size of a supplied key
 typedef size_t (*map_key_size_function_t)(const void *key);
@@ -50,6 +86,23 @@ typedef void (*map_entry_free_function_t)(void *data);
 #define MAP_LOAD_FACTOR_LOW 0.2
 #define MAP_RESIZE_UP 1
 #define MAP_RESIZE_DOWN -1
+#define MAP_RETIRE_MIN_CAPACITY 8
+#define MAP_RETIRE_MAX_LENGTH 256 // Retired allocations before a writer waits for readers
+#define MAP_STATS_HISTOGRAM_SIZE 16 // The last bucket counts every larger DIB
+#define MAP_GET_MANY_BATCH 16 // Keys hashed and prefetched together by map_get_many
+
+// Frozen maps
+#define MAP_FROZEN_BUCKET_SIZE 4 // Average keys per displacement bucket
+#define MAP_FROZEN_MAX_DISPLACEMENT (1U << 16U)
+#define MAP_FROZEN_MAX_ATTEMPTS 8
+#define MAP_FROZEN_ALIGNMENT 64
+#define MAP_MIGRATE_STEP 8 // Slots migrated per insert/delete (incremental resize)
+#define MAP_READ_SPIN_LIMIT 64 // Retries map_read_value spins for before yielding
+
+// Group probing
+#define MAP_GROUP_WIDTH 16
+#define MAP_CONTROL_EMPTY 0x80
+#define MAP_CONTROL_DELETED 0xFE
 
 enum map_settings {
         MAP_FLAG_KEY_IGNORE_CASE = 1 << 0, // Ignore casing for keys
@@ -59,6 +112,11 @@ enum map_settings {
         MAP_FLAG_IGNORE_THRESHOLDS = 1 << 4, // Ignore load factors
         MAP_FLAG_IGNORE_THRESHOLDS_EMPTY = 1 << 5, // Ignore low_load_factor
         MAP_FLAG_NO_LOCKING = 1 << 6, // Don't try to be thread safe
+        MAP_FLAG_GROUP_PROBING = 1 << 7, // Probe using control byte groups
+        MAP_FLAG_INCREMENTAL_RESIZE = 1 << 8, // Migrate entries a few at a time
+        MAP_FLAG_CONCURRENT_READS = 1 << 9, // Allow lock free map_read_value
+        MAP_FLAG_FROZEN = 1 << 10, // Read only, uses a perfect hash
+        MAP_FLAG_COLLECT_STATS = 1 << 11, // Time resizes for map_get_stats
 };
 
 enum map_events {
@@ -68,6 +126,9 @@ enum map_events {
 };
 
 // Represents an entry in the hash map
+//
+// Pointers to entries (as returned by map_get) are only valid until the next
+// insert or delete since entries move around inside the entries array
 struct map_entry {
         // Tradeoff: Getting DIB from hash instead of storing DIB in entry
         // Pro: Smaller entry memory footprint
@@ -77,11 +138,68 @@ struct map_entry {
         void *value;
 };
 
+// A key along with it's size and hash, computed once with map_key_handle_init
+struct map_key_handle {
+        const void *key;
+        size_t size;
+        uint32_t hash;
+};
+
+// Memory released by a writer which concurrent readers may still access
+struct map_retired {
+        void *data;
+        map_entry_free_function_t free_function;
+};
+
+struct map_retire_list {
+        size_t length;
+        size_t capacity;
+        struct map_retired *items;
+};
+
+// Perfect hash of a frozen map. Each bucket of keys stores the displacement
+// which moves all of it's keys into distinct slots
+struct map_frozen {
+        uint32_t salt;
+        uint32_t bucket_count;
+        uint32_t *displacements;
+};
+
+// Snapshot of how well a map is performing, see map_get_stats
+struct map_stats {
+        uint32_t entry_count;
+        uint32_t length;
+        uint32_t dib_histogram[MAP_STATS_HISTOGRAM_SIZE];
+        uint32_t max_dib;
+        double mean_dib;
+        uint32_t resize_up_count;
+        uint32_t resize_down_count;
+        uint64_t resize_time_ns;
+        uint32_t tombstone_count;
+        size_t bytes_allocated; // Memory owned by the map, not counting keys or values
+};
+
 // Represents a hash map
 struct map {
-        uint32_t length; // Length of the map (power of 2)
+        uint32_t length; // Length of the map (power of 2 unless frozen)
         uint32_t bucket_count;
-        struct map_entry **entries;
+        struct map_entry *entries; // Array of length entries
+        uint8_t *control; // Control bytes (only used when group probing)
+        uint32_t tombstone_count; // Deleted control bytes
+        struct map_entry *old_entries; // Entries left to migrate (incremental resize)
+        uint32_t old_length;
+        uint32_t migrate_index; // Next old slot to migrate
+        uint32_t migrate_remaining; // Old slots left to migrate
+        uint32_t migrated_last; // Slots migrated by the last insert or delete
+        uint32_t sequence; // Odd while a write is in progress (concurrent reads)
+        uint32_t reader_count; // Active concurrent readers
+        uint32_t draining; // New readers wait while a writer frees the retired list
+        struct map_retire_list *retired; // Only allocated for concurrent reads
+        struct map_frozen *frozen; // Only allocated once frozen
+        uint32_t resize_up_count;
+        uint32_t resize_down_count;
+        uint64_t resize_time_ns; // Only tracked with MAP_FLAG_COLLECT_STATS
+        uint64_t seed; // Passed to the hash function, random unless set
         pthread_mutex_t mutex;
         map_hash_function_t hash_function;
         map_key_size_function_t key_size_function;
@@ -91,16 +209,39 @@ struct map {
         enum map_events event_flags;
 };
 
-enum natwm_error entry_init(uint32_t hash, const void *key, void *value, struct map_entry **dest);
 void map_entry_destroy(const struct map *map, struct map_entry *entry);
 
+uint32_t map_hash_wyhash(const void *key, size_t size, uint64_t seed);
+uint32_t map_hash_murmur3(const void *key, size_t size, uint64_t seed);
+uint32_t map_hash_integer(const void *key, size_t size, uint64_t seed);
+
 struct map *map_init(void);
 void map_destroy(struct map *map);
 enum natwm_error map_insert(struct map *map, const void *key, void *value);
 struct map_entry *map_get(const struct map *map, const void *key);
+size_t map_get_many(const struct map *map, const void **keys, size_t count,
+                    struct map_entry **results);
 enum natwm_error map_delete(struct map *map, const void *key);
 
+enum natwm_error map_key_handle_init(const struct map *map, const void *key,
+                                     struct map_key_handle *handle);
+enum natwm_error map_insert_prehashed(struct map *map, const struct map_key_handle *handle,
+                                      void *value);
+struct map_entry *map_get_prehashed(const struct map *map, const struct map_key_handle *handle);
+
+enum natwm_error map_read_value(struct map *map, const void *key, void **value);
+void map_read_begin(struct map *map);
+void map_read_end(struct map *map);
+
+int map_enable_group_probing(struct map *map);
+int map_enable_incremental_resize(struct map *map);
+int map_enable_concurrent_reads(struct map *map);
+enum natwm_error map_freeze(struct map *map);
+enum natwm_error map_freeze_with_layout(struct map *map, uint32_t salt,
+                                        const uint32_t *displacements, uint32_t bucket_count);
+void map_get_stats(const struct map *map, struct map_stats *stats);
 int map_set_hash_function(struct map *map, map_hash_function_t function);
+int map_set_hash_seed(struct map *map, uint64_t seed);
 int map_set_key_size_function(struct map *map, map_key_size_function_t function);
 int map_set_key_compare_function(struct map *map, map_key_compare_function_t function);
 void map_set_entry_free_function(struct map *map, map_entry_free_function_t function);
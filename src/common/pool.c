@@ -0,0 +1,136 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdlib.h>
+
+#include "pool.h"
+
+// Keep the objects after the chunk header aligned
+#define POOL_CHUNK_HEADER_SIZE                                                                     \
+        (((sizeof(struct pool_chunk) + POOL_ALIGNMENT - 1) / POOL_ALIGNMENT) * POOL_ALIGNMENT)
+
+static size_t align_object_size(size_t object_size)
+{
+        if (object_size < sizeof(struct pool_free_object)) {
+                object_size = sizeof(struct pool_free_object);
+        }
+
+        return ((object_size + POOL_ALIGNMENT - 1) / POOL_ALIGNMENT) * POOL_ALIGNMENT;
+}
+
+// Allocate a new chunk and place it's objects on the free list
+//
+// The objects are linked in address order so consecutive allocations are
+// next to each other
+static int pool_grow(struct pool *pool)
+{
+        struct pool_chunk *chunk
+                = malloc(POOL_CHUNK_HEADER_SIZE + (pool->object_size * pool->chunk_length));
+
+        if (chunk == NULL) {
+                return -1;
+        }
+
+        char *objects = (char *)chunk + POOL_CHUNK_HEADER_SIZE;
+
+        for (size_t i = pool->chunk_length; i > 0; --i) {
+                char *slot = objects + ((i - 1) * pool->object_size);
+                struct pool_free_object *object = (struct pool_free_object *)(void *)slot;
+
+                object->next = pool->free_list;
+                pool->free_list = object;
+        }
+
+        chunk->next = pool->chunks;
+        pool->chunks = chunk;
+
+        ++pool->chunk_count;
+
+        return 0;
+}
+
+struct pool *pool_create(size_t object_size, size_t chunk_length)
+{
+        if (object_size == 0) {
+                return NULL;
+        }
+
+        struct pool *pool = malloc(sizeof(struct pool));
+
+        if (pool == NULL) {
+                return NULL;
+        }
+
+        pool->object_size = align_object_size(object_size);
+        pool->chunk_length = (chunk_length == 0) ? POOL_DEFAULT_CHUNK_LENGTH : chunk_length;
+        pool->used_count = 0;
+        pool->chunk_count = 0;
+        pool->chunks = NULL;
+        pool->free_list = NULL;
+
+        return pool;
+}
+
+// Get an uninitialized object from the pool
+void *pool_alloc(struct pool *pool)
+{
+        if (pool->free_list == NULL && pool_grow(pool) != 0) {
+                return NULL;
+        }
+
+        struct pool_free_object *object = pool->free_list;
+
+        pool->free_list = object->next;
+
+        ++pool->used_count;
+
+        return object;
+}
+
+// Return an object allocated by pool_alloc to the pool
+void pool_free(struct pool *pool, void *object)
+{
+        if (object == NULL) {
+                return;
+        }
+
+        struct pool_free_object *free_object = (struct pool_free_object *)object;
+
+        free_object->next = pool->free_list;
+        pool->free_list = free_object;
+
+        --pool->used_count;
+}
+
+// Free every object in the pool at once
+//
+// The pool can still be used afterwards
+void pool_release(struct pool *pool)
+{
+        struct pool_chunk *chunk = pool->chunks;
+
+        while (chunk != NULL) {
+                struct pool_chunk *next = chunk->next;
+
+                free(chunk);
+
+                chunk = next;
+        }
+
+        pool->used_count = 0;
+        pool->chunk_count = 0;
+        pool->chunks = NULL;
+        pool->free_list = NULL;
+}
+
+void pool_destroy(struct pool *pool)
+{
+        if (pool == NULL) {
+                return;
+        }
+
+        pool_release(pool);
+
+        free(pool);
+}
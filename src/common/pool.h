@@ -0,0 +1,48 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * A pool of fixed size objects
+ *
+ * Objects are carved out of chunks which hold chunk_length objects each, so
+ * a single malloc serves many allocations and objects allocated together sit
+ * next to each other in memory. Free'd objects are kept on a free list and
+ * handed out again before a new chunk is allocated.
+ *
+ * Chunks are only returned to the system by pool_release, which frees every
+ * object in the pool at once, and pool_destroy.
+ *
+ * Objects are aligned to POOL_ALIGNMENT bytes. A pool is not thread safe
+ */
+
+#define POOL_ALIGNMENT sizeof(void *)
+#define POOL_DEFAULT_CHUNK_LENGTH 64
+
+struct pool_chunk {
+        struct pool_chunk *next;
+};
+
+// Free objects are linked through their own memory
+struct pool_free_object {
+        struct pool_free_object *next;
+};
+
+struct pool {
+        size_t object_size; // Requested size rounded up to POOL_ALIGNMENT
+        size_t chunk_length; // Objects per chunk
+        size_t used_count; // Objects currently handed out
+        size_t chunk_count;
+        struct pool_chunk *chunks;
+        struct pool_free_object *free_list;
+};
+
+struct pool *pool_create(size_t object_size, size_t chunk_length);
+void *pool_alloc(struct pool *pool);
+void pool_free(struct pool *pool, void *object);
+void pool_release(struct pool *pool);
+void pool_destroy(struct pool *pool);
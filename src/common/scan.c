@@ -0,0 +1,521 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdbool.h>
+#include <string.h>
+
+#if (defined __clang__ || defined __GNUC__) && (defined __x86_64__ || defined __i386__)
+#define SCAN_HAS_X86_KERNELS 1
+#define ATTR_TARGET(name) __attribute__((target(name)))
+#include <immintrin.h>
+#endif
+
+#include "constants.h"
+#include "scan.h"
+
+// Every backend classifies full blocks, partial blocks are padded first
+struct scan_kernels {
+        const char *name;
+        void (*full_block)(const char *block, struct scan_masks *masks);
+        uint32_t (*full_block_char)(const char *block, char needle);
+        uint32_t (*full_block_space)(const char *block);
+};
+
+static ATTR_INLINE bool scalar_is_space(char c)
+{
+        return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static void scalar_full_block(const char *block, struct scan_masks *masks)
+{
+        memset(masks, 0, sizeof(struct scan_masks));
+
+        for (uint32_t i = 0; i < SCAN_BLOCK_SIZE; ++i) {
+                uint32_t bit = 1U << i;
+
+                switch (block[i]) {
+                case '\n':
+                        masks->new_line |= bit;
+                        break;
+                case '=':
+                        masks->equal |= bit;
+                        break;
+                case ',':
+                        masks->comma |= bit;
+                        break;
+                case '[':
+                        masks->array_start |= bit;
+                        break;
+                case ']':
+                        masks->array_end |= bit;
+                        break;
+                case '"':
+                        masks->quote |= bit;
+                        break;
+                case '#':
+                        masks->comment |= bit;
+                        break;
+                default:
+                        break;
+                }
+
+                if (scalar_is_space(block[i])) {
+                        masks->space |= bit;
+                }
+        }
+}
+
+static uint32_t scalar_full_block_char(const char *block, char needle)
+{
+        uint32_t mask = 0;
+
+        for (uint32_t i = 0; i < SCAN_BLOCK_SIZE; ++i) {
+                if (block[i] == needle) {
+                        mask |= 1U << i;
+                }
+        }
+
+        return mask;
+}
+
+static uint32_t scalar_full_block_space(const char *block)
+{
+        uint32_t mask = 0;
+
+        for (uint32_t i = 0; i < SCAN_BLOCK_SIZE; ++i) {
+                if (scalar_is_space(block[i])) {
+                        mask |= 1U << i;
+                }
+        }
+
+        return mask;
+}
+
+#if defined SCAN_HAS_X86_KERNELS
+
+// The block is handled as two 16 byte halves, each giving 16 bits of the mask
+struct block_halves {
+        __m128i low;
+        __m128i high;
+};
+
+static ATTR_INLINE ATTR_TARGET("sse2") struct block_halves sse2_load_halves(const char *block)
+{
+        struct block_halves halves = {
+                .low = _mm_loadu_si128((const __m128i *)(const void *)block),
+                .high = _mm_loadu_si128((const __m128i *)(const void *)(block + 16)),
+        };
+
+        return halves;
+}
+
+static ATTR_INLINE uint32_t sse2_combine_masks(int low, int high)
+{
+        return (uint32_t)low | ((uint32_t)high << 16U);
+}
+
+static ATTR_INLINE ATTR_TARGET("sse2") uint32_t sse2_equal_mask(struct block_halves halves,
+                                                               char value)
+{
+        __m128i needle = _mm_set1_epi8(value);
+
+        return sse2_combine_masks(_mm_movemask_epi8(_mm_cmpeq_epi8(halves.low, needle)),
+                                  _mm_movemask_epi8(_mm_cmpeq_epi8(halves.high, needle)));
+}
+
+// See the AVX2 version
+static ATTR_INLINE ATTR_TARGET("sse2") int sse2_half_space_mask(__m128i bytes)
+{
+        __m128i shifted = _mm_sub_epi8(bytes, _mm_set1_epi8('\t'));
+        __m128i in_range = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(4)), shifted);
+        __m128i is_space = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '));
+
+        return _mm_movemask_epi8(_mm_or_si128(in_range, is_space));
+}
+
+static ATTR_INLINE ATTR_TARGET("sse2") uint32_t sse2_space_mask(struct block_halves halves)
+{
+        return sse2_combine_masks(sse2_half_space_mask(halves.low),
+                                  sse2_half_space_mask(halves.high));
+}
+
+static ATTR_TARGET("sse2") void sse2_full_block(const char *block, struct scan_masks *masks)
+{
+        struct block_halves halves = sse2_load_halves(block);
+
+        masks->new_line = sse2_equal_mask(halves, '\n');
+        masks->equal = sse2_equal_mask(halves, '=');
+        masks->comma = sse2_equal_mask(halves, ',');
+        masks->array_start = sse2_equal_mask(halves, '[');
+        masks->array_end = sse2_equal_mask(halves, ']');
+        masks->quote = sse2_equal_mask(halves, '"');
+        masks->comment = sse2_equal_mask(halves, '#');
+        masks->space = sse2_space_mask(halves);
+}
+
+static ATTR_TARGET("sse2") uint32_t sse2_full_block_char(const char *block, char needle)
+{
+        return sse2_equal_mask(sse2_load_halves(block), needle);
+}
+
+static ATTR_TARGET("sse2") uint32_t sse2_full_block_space(const char *block)
+{
+        return sse2_space_mask(sse2_load_halves(block));
+}
+
+static ATTR_INLINE ATTR_TARGET("avx2") uint32_t avx2_equal_mask(__m256i bytes, char value)
+{
+        __m256i matches = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(value));
+
+        return (uint32_t)_mm256_movemask_epi8(matches);
+}
+
+// ' ' or '\t' through '\r'. Subtracting '\t' moves the range to 0 - 4, which
+// is then tested with an unsigned minimum
+static ATTR_INLINE ATTR_TARGET("avx2") uint32_t avx2_space_mask(__m256i bytes)
+{
+        __m256i shifted = _mm256_sub_epi8(bytes, _mm256_set1_epi8('\t'));
+        __m256i clamped = _mm256_min_epu8(shifted, _mm256_set1_epi8(4));
+        __m256i in_range = _mm256_cmpeq_epi8(clamped, shifted);
+
+        return (uint32_t)_mm256_movemask_epi8(in_range) | avx2_equal_mask(bytes, ' ');
+}
+
+static ATTR_TARGET("avx2") void avx2_full_block(const char *block, struct scan_masks *masks)
+{
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(const void *)block);
+
+        masks->new_line = avx2_equal_mask(bytes, '\n');
+        masks->equal = avx2_equal_mask(bytes, '=');
+        masks->comma = avx2_equal_mask(bytes, ',');
+        masks->array_start = avx2_equal_mask(bytes, '[');
+        masks->array_end = avx2_equal_mask(bytes, ']');
+        masks->quote = avx2_equal_mask(bytes, '"');
+        masks->comment = avx2_equal_mask(bytes, '#');
+        masks->space = avx2_space_mask(bytes);
+}
+
+static ATTR_TARGET("avx2") uint32_t avx2_full_block_char(const char *block, char needle)
+{
+        return avx2_equal_mask(_mm256_loadu_si256((const __m256i *)(const void *)block), needle);
+}
+
+static ATTR_TARGET("avx2") uint32_t avx2_full_block_space(const char *block)
+{
+        return avx2_space_mask(_mm256_loadu_si256((const __m256i *)(const void *)block));
+}
+
+#endif
+
+// Indexed by enum scan_backend. Backends which can't be built for the target
+// have no kernels
+static const struct scan_kernels backend_kernels[SCAN_BACKEND_COUNT] = {
+        [SCAN_BACKEND_SCALAR] = {
+                .name = "scalar",
+                .full_block = scalar_full_block,
+                .full_block_char = scalar_full_block_char,
+                .full_block_space = scalar_full_block_space,
+        },
+#if defined SCAN_HAS_X86_KERNELS
+        [SCAN_BACKEND_SSE2] = {
+                .name = "sse2",
+                .full_block = sse2_full_block,
+                .full_block_char = sse2_full_block_char,
+                .full_block_space = sse2_full_block_space,
+        },
+        [SCAN_BACKEND_AVX2] = {
+                .name = "avx2",
+                .full_block = avx2_full_block,
+                .full_block_char = avx2_full_block_char,
+                .full_block_space = avx2_full_block_space,
+        },
+#else
+        [SCAN_BACKEND_SSE2] = {
+                .name = "sse2",
+        },
+        [SCAN_BACKEND_AVX2] = {
+                .name = "avx2",
+        },
+#endif
+};
+
+// Chosen on first use, see scan_get_kernels
+static const struct scan_kernels *active_kernels = NULL;
+
+/**
+ * Check if a backend was built and the CPU running natwm can use it
+ */
+bool scan_backend_is_supported(enum scan_backend backend)
+{
+        if (backend >= SCAN_BACKEND_COUNT || backend_kernels[backend].full_block == NULL) {
+                return false;
+        }
+
+        switch (backend) {
+#if defined SCAN_HAS_X86_KERNELS
+        case SCAN_BACKEND_SSE2:
+                __builtin_cpu_init();
+
+                return __builtin_cpu_supports("sse2") != 0;
+        case SCAN_BACKEND_AVX2:
+                __builtin_cpu_init();
+
+                return __builtin_cpu_supports("avx2") != 0;
+#endif
+        default:
+                return true;
+        }
+}
+
+// The widest supported backend
+static const struct scan_kernels *select_kernels(void)
+{
+        for (size_t i = SCAN_BACKEND_COUNT; i > 0; --i) {
+                if (scan_backend_is_supported((enum scan_backend)(i - 1))) {
+                        return &backend_kernels[i - 1];
+                }
+        }
+
+        return &backend_kernels[SCAN_BACKEND_SCALAR];
+}
+
+static const struct scan_kernels *scan_get_kernels(void)
+{
+        const struct scan_kernels *kernels = __atomic_load_n(&active_kernels, __ATOMIC_RELAXED);
+
+        if (kernels == NULL) {
+                // Threads racing here all select the same kernels
+                kernels = select_kernels();
+
+                __atomic_store_n(&active_kernels, kernels, __ATOMIC_RELAXED);
+        }
+
+        return kernels;
+}
+
+/**
+ * Use a specific backend instead of the widest one the CPU supports
+ *
+ * This lets the tests and benchmarks run every backend on one machine. It
+ * must not be called while other threads are scanning
+ */
+enum natwm_error scan_set_backend(enum scan_backend backend)
+{
+        if (!scan_backend_is_supported(backend)) {
+                return INVALID_INPUT_ERROR;
+        }
+
+        __atomic_store_n(&active_kernels, &backend_kernels[backend], __ATOMIC_RELAXED);
+
+        return NO_ERROR;
+}
+
+// Bits for the first length bytes of a block
+static ATTR_INLINE uint32_t length_mask(size_t length)
+{
+        return (length >= SCAN_BLOCK_SIZE) ? UINT32_MAX : (1U << length) - 1U;
+}
+
+// Copy a partial block into a zero filled buffer so the full block kernels
+// can be used without reading past the end of the input
+static ATTR_INLINE const char *pad_block(const char *block, size_t length,
+                                         char buffer[SCAN_BLOCK_SIZE])
+{
+        memset(buffer, 0, SCAN_BLOCK_SIZE);
+        memcpy(buffer, block, length);
+
+        return buffer;
+}
+
+static ATTR_INLINE uint32_t highest_bit(uint32_t mask)
+{
+#if defined __clang__ || defined __GNUC__
+        return 31U - (uint32_t)__builtin_clz(mask);
+#else
+        uint32_t bit = 31U;
+
+        while ((mask & (1U << bit)) == 0) {
+                --bit;
+        }
+
+        return bit;
+#endif
+}
+
+static ATTR_INLINE uint32_t population_count(uint32_t mask)
+{
+#if defined __clang__ || defined __GNUC__
+        return (uint32_t)__builtin_popcount(mask);
+#else
+        uint32_t count = 0;
+
+        for (; mask != 0; mask &= mask - 1U) {
+                ++count;
+        }
+
+        return count;
+#endif
+}
+
+const char *scan_backend_name(void)
+{
+        return scan_get_kernels()->name;
+}
+
+/**
+ * Classify the first length bytes of block, up to SCAN_BLOCK_SIZE
+ *
+ * Bits for bytes past length are always clear
+ */
+void scan_block(const char *block, size_t length, struct scan_masks *masks)
+{
+        const struct scan_kernels *kernels = scan_get_kernels();
+
+        if (length >= SCAN_BLOCK_SIZE) {
+                kernels->full_block(block, masks);
+
+                return;
+        }
+
+        char buffer[SCAN_BLOCK_SIZE];
+
+        // The padding is '\0', which isn't part of any class
+        kernels->full_block(pad_block(block, length, buffer), masks);
+}
+
+static ATTR_INLINE uint32_t block_char(const struct scan_kernels *kernels, const char *block,
+                                       size_t length, char needle)
+{
+        if (length >= SCAN_BLOCK_SIZE) {
+                return kernels->full_block_char(block, needle);
+        }
+
+        char buffer[SCAN_BLOCK_SIZE];
+
+        return kernels->full_block_char(pad_block(block, length, buffer), needle)
+                & length_mask(length);
+}
+
+static ATTR_INLINE uint32_t block_space(const struct scan_kernels *kernels, const char *block,
+                                        size_t length)
+{
+        if (length >= SCAN_BLOCK_SIZE) {
+                return kernels->full_block_space(block);
+        }
+
+        char buffer[SCAN_BLOCK_SIZE];
+
+        return kernels->full_block_space(pad_block(block, length, buffer));
+}
+
+uint32_t scan_block_char(const char *block, size_t length, char needle)
+{
+        return block_char(scan_get_kernels(), block, length, needle);
+}
+
+/**
+ * Find the index of the first needle in data
+ *
+ * If there is no needle length is returned
+ */
+size_t scan_find_char(const char *data, size_t length, char needle)
+{
+        const struct scan_kernels *kernels = scan_get_kernels();
+
+        for (size_t offset = 0; offset < length; offset += SCAN_BLOCK_SIZE) {
+                uint32_t mask = block_char(kernels, data + offset, length - offset, needle);
+
+                if (mask != 0) {
+                        return offset + scan_mask_first_index(mask);
+                }
+        }
+
+        return length;
+}
+
+/**
+ * Find the index of the last needle in data
+ *
+ * If there is no needle length is returned
+ */
+size_t scan_find_last_char(const char *data, size_t length, char needle)
+{
+        const struct scan_kernels *kernels = scan_get_kernels();
+        size_t offset = length;
+
+        while (offset > 0) {
+                size_t block_length = MIN(offset, (size_t)SCAN_BLOCK_SIZE);
+
+                offset -= block_length;
+
+                uint32_t mask = block_char(kernels, data + offset, block_length, needle);
+
+                if (mask != 0) {
+                        return offset + highest_bit(mask);
+                }
+        }
+
+        return length;
+}
+
+size_t scan_count_char(const char *data, size_t length, char needle)
+{
+        const struct scan_kernels *kernels = scan_get_kernels();
+        size_t count = 0;
+
+        for (size_t offset = 0; offset < length; offset += SCAN_BLOCK_SIZE) {
+                count += population_count(
+                        block_char(kernels, data + offset, length - offset, needle));
+        }
+
+        return count;
+}
+
+/**
+ * Find the index of the first character in data which isn't a space
+ *
+ * If data only contains spaces length is returned
+ */
+size_t scan_find_first_nonspace(const char *data, size_t length)
+{
+        const struct scan_kernels *kernels = scan_get_kernels();
+
+        for (size_t offset = 0; offset < length; offset += SCAN_BLOCK_SIZE) {
+                size_t block_length = MIN(length - offset, (size_t)SCAN_BLOCK_SIZE);
+                uint32_t mask = ~block_space(kernels, data + offset, block_length)
+                        & length_mask(block_length);
+
+                if (mask != 0) {
+                        return offset + scan_mask_first_index(mask);
+                }
+        }
+
+        return length;
+}
+
+/**
+ * Find the index of the last character in data which isn't a space
+ *
+ * If data only contains spaces length is returned
+ */
+size_t scan_find_last_nonspace(const char *data, size_t length)
+{
+        const struct scan_kernels *kernels = scan_get_kernels();
+        size_t offset = length;
+
+        while (offset > 0) {
+                size_t block_length = MIN(offset, (size_t)SCAN_BLOCK_SIZE);
+
+                offset -= block_length;
+
+                uint32_t mask = ~block_space(kernels, data + offset, block_length)
+                        & length_mask(block_length);
+
+                if (mask != 0) {
+                        return offset + highest_bit(mask);
+                }
+        }
+
+        return length;
+}
@@ -0,0 +1,75 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "constants.h"
+#include "error.h"
+
+/**
+ * Byte scanning kernels
+ *
+ * Input is classified SCAN_BLOCK_SIZE bytes at a time into bitmasks, where
+ * bit i of a mask is set when byte i of the block belongs to the class. On
+ * x86 the AVX2 and SSE2 kernels are always built and the widest one the CPU
+ * supports is picked at runtime. Everywhere else a byte at a time loop is used
+ *
+ * The space class matches the same characters as isspace in the "C" locale
+ *
+ * None of the functions read past data + length, so the input does not need
+ * to be null terminated or padded
+ */
+
+#define SCAN_BLOCK_SIZE 32
+
+// Ordered from narrowest to widest
+enum scan_backend {
+        SCAN_BACKEND_SCALAR,
+        SCAN_BACKEND_SSE2,
+        SCAN_BACKEND_AVX2,
+        SCAN_BACKEND_COUNT,
+};
+
+struct scan_masks {
+        uint32_t new_line;
+        uint32_t equal;
+        uint32_t comma;
+        uint32_t array_start;
+        uint32_t array_end;
+        uint32_t quote;
+        uint32_t comment;
+        uint32_t space;
+};
+
+// Index of the lowest set bit in a mask, the mask must not be 0
+static ATTR_INLINE uint32_t scan_mask_first_index(uint32_t mask)
+{
+#if defined __clang__ || defined __GNUC__
+        return (uint32_t)__builtin_ctz(mask);
+#else
+        uint32_t index = 0;
+
+        while ((mask & 1U) == 0) {
+                mask >>= 1U;
+                ++index;
+        }
+
+        return index;
+#endif
+}
+
+bool scan_backend_is_supported(enum scan_backend backend);
+enum natwm_error scan_set_backend(enum scan_backend backend);
+const char *scan_backend_name(void);
+void scan_block(const char *block, size_t length, struct scan_masks *masks);
+uint32_t scan_block_char(const char *block, size_t length, char needle);
+size_t scan_find_char(const char *data, size_t length, char needle);
+size_t scan_find_last_char(const char *data, size_t length, char needle);
+size_t scan_count_char(const char *data, size_t length, char needle);
+size_t scan_find_first_nonspace(const char *data, size_t length);
+size_t scan_find_last_nonspace(const char *data, size_t length);
@@ -6,6 +6,47 @@
 
 #include "stack.h"
 
+// Position in items of the item index places from the head
+static size_t get_buffer_index(const struct stack *stack, size_t index)
+{
+        return (stack->first + index) & (stack->capacity - 1);
+}
+
+static struct stack_item *get_tail(const struct stack *stack)
+{
+        return stack->items[get_buffer_index(stack, stack->length - 1)];
+}
+
+// Double the capacity of the buffer when it is full
+//
+// The items are copied to the start of the new buffer, so they no longer wrap
+// around the end of it
+static enum natwm_error stack_grow(struct stack *stack)
+{
+        if (stack->length < stack->capacity) {
+                return NO_ERROR;
+        }
+
+        size_t new_capacity = (stack->capacity == 0) ? STACK_MIN_CAPACITY : stack->capacity * 2;
+        struct stack_item **new_items = malloc(sizeof(struct stack_item *) * new_capacity);
+
+        if (new_items == NULL) {
+                return MEMORY_ALLOCATION_ERROR;
+        }
+
+        for (size_t i = 0; i < stack->length; ++i) {
+                new_items[i] = stack->items[get_buffer_index(stack, i)];
+        }
+
+        free(stack->items);
+
+        stack->items = new_items;
+        stack->capacity = new_capacity;
+        stack->first = 0;
+
+        return NO_ERROR;
+}
+
 struct stack *stack_create(void)
 {
         struct stack *stack = malloc(sizeof(struct stack));
@@ -16,6 +57,9 @@ struct stack *stack_create(void)
 
         stack->length = 0;
         stack->head = NULL;
+        stack->capacity = 0;
+        stack->first = 0;
+        stack->items = NULL;
 
         return stack;
 }
@@ -39,48 +83,71 @@ bool stack_has_item(const struct stack *stack)
         return stack->head != NULL;
 }
 
-void stack_push_item(struct stack *stack, struct stack_item *item)
+// Add the item at the head. Returns an error when the buffer couldn't grow
+static enum natwm_error stack_insert_head(struct stack *stack, struct stack_item *item)
 {
+        if (stack_grow(stack) != NO_ERROR) {
+                return MEMORY_ALLOCATION_ERROR;
+        }
+
         if (stack_has_item(stack)) {
                 item->next = stack->head;
         }
 
+        stack->first = (stack->first - 1) & (stack->capacity - 1);
+        stack->items[stack->first] = item;
         stack->head = item;
         ++stack->length;
+
+        return NO_ERROR;
 }
 
-enum natwm_error stack_push(struct stack *stack, void *data)
+// Add the item at the tail. Returns an error when the buffer couldn't grow
+static enum natwm_error stack_insert_tail(struct stack *stack, struct stack_item *item)
 {
-        struct stack_item *item = stack_item_create(data);
-
-        if (item == NULL) {
+        if (stack_grow(stack) != NO_ERROR) {
                 return MEMORY_ALLOCATION_ERROR;
         }
 
-        stack_push_item(stack, item);
+        if (stack_has_item(stack)) {
+                get_tail(stack)->next = item;
+        } else {
+                stack->head = item;
+        }
+
+        stack->items[get_buffer_index(stack, stack->length)] = item;
+        ++stack->length;
 
         return NO_ERROR;
 }
 
-void stack_enqueue_item(struct stack *stack, struct stack_item *item)
+// The item is left to the caller when the buffer can't grow to hold it
+enum natwm_error stack_push_item(struct stack *stack, struct stack_item *item)
 {
-        if (!stack_has_item(stack)) {
-                stack->head = item;
-                ++stack->length;
+        return stack_insert_head(stack, item);
+}
 
-                return;
+enum natwm_error stack_push(struct stack *stack, void *data)
+{
+        struct stack_item *item = stack_item_create(data);
+
+        if (item == NULL) {
+                return MEMORY_ALLOCATION_ERROR;
         }
 
-        // Need to find last item
-        struct stack_item *curr = stack->head;
+        if (stack_insert_head(stack, item) != NO_ERROR) {
+                stack_item_destroy(item);
 
-        while (curr != NULL && curr->next != NULL) {
-                curr = curr->next;
+                return MEMORY_ALLOCATION_ERROR;
         }
 
-        // curr should point to the last item now
-        curr->next = item;
-        ++stack->length;
+        return NO_ERROR;
+}
+
+// The item is left to the caller when the buffer can't grow to hold it
+enum natwm_error stack_enqueue_item(struct stack *stack, struct stack_item *item)
+{
+        return stack_insert_tail(stack, item);
 }
 
 enum natwm_error stack_enqueue(struct stack *stack, void *data)
@@ -91,7 +158,11 @@ enum natwm_error stack_enqueue(struct stack *stack, void *data)
                 return MEMORY_ALLOCATION_ERROR;
         }
 
-        stack_enqueue_item(stack, item);
+        if (stack_insert_tail(stack, item) != NO_ERROR) {
+                stack_item_destroy(item);
+
+                return MEMORY_ALLOCATION_ERROR;
+        }
 
         return NO_ERROR;
 }
@@ -104,8 +175,9 @@ struct stack_item *stack_pop(struct stack *stack)
 
         struct stack_item *item = stack->head;
 
-        stack->head = item->next;
+        stack->first = get_buffer_index(stack, 1);
         --stack->length;
+        stack->head = (stack->length > 0) ? stack->items[stack->first] : NULL;
 
         return item;
 }
@@ -116,16 +188,12 @@ const struct stack_item *stack_peek_n(const struct stack *stack, size_t index)
                 return NULL;
         }
 
-        struct stack_item *curr = stack->head;
-        size_t i = 0;
-
-        while (i < index && curr != NULL && curr->next != NULL) {
-                curr = curr->next;
-
-                ++i;
+        // An index equal to the length has always returned the tail
+        if (index == stack->length) {
+                return get_tail(stack);
         }
 
-        return curr;
+        return stack->items[get_buffer_index(stack, index)];
 }
 
 const struct stack_item *stack_peek(const struct stack *stack)
@@ -143,19 +211,13 @@ struct stack_item *stack_dequeue(struct stack *stack)
                 return stack_pop(stack);
         }
 
-        struct stack_item *curr = stack->head;
-        struct stack_item *prev = NULL;
+        struct stack_item *item = get_tail(stack);
 
-        while (curr != NULL && curr->next != NULL) {
-                prev = curr;
-                curr = curr->next;
-        }
-
-        // curr should now point to the last item
-        prev->next = NULL;
         --stack->length;
 
-        return curr;
+        get_tail(stack)->next = NULL;
+
+        return item;
 }
 
 void stack_item_destroy(struct stack_item *item)
@@ -184,6 +246,7 @@ void stack_destroy(struct stack *stack)
                 stack_item_destroy(curr);
         }
 
+        free(stack->items);
         free(stack);
 }
 
@@ -203,5 +266,6 @@ void stack_destroy_callback(struct stack *stack, stack_data_free_function free_f
                 stack_item_destroy(curr);
         }
 
+        free(stack->items);
         free(stack);
 }
@@ -9,6 +9,21 @@
 
 #include "error.h"
 
+/**
+ * A stack of items which can also be used as a queue
+ *
+ * stack_push and stack_pop add and remove items at the head, stack_enqueue
+ * and stack_dequeue at the tail. Besides being linked through next, the items
+ * are indexed by a ring buffer, so every one of these and stack_peek_n is
+ * O(1). The buffer doubles in size when it is full
+ *
+ * Every item is still allocated on its own, since the API hands out items
+ * which stay valid after they are popped. The ring buffer makes indexing and
+ * dequeueing O(1), it doesn't save any allocations
+ */
+
+#define STACK_MIN_CAPACITY 8 // Must be a power of 2
+
 typedef void (*stack_data_free_function)(void *data);
 
 struct stack_item {
@@ -19,6 +34,9 @@ struct stack_item {
 struct stack {
         size_t length;
         struct stack_item *head;
+        size_t capacity; // Always 0 or a power of 2
+        size_t first; // Position of the head in items
+        struct stack_item **items; // Ring buffer of the items from head to tail
 };
 
 #define STACK_FOR_EACH(stack, item)                                                                \
@@ -29,9 +47,9 @@ struct stack_item *stack_item_create(void *data);
 
 bool stack_has_item(const struct stack *stack);
 
-void stack_push_item(struct stack *stack, struct stack_item *item);
+enum natwm_error stack_push_item(struct stack *stack, struct stack_item *item);
 enum natwm_error stack_push(struct stack *stack, void *data);
-void stack_enqueue_item(struct stack *stack, struct stack_item *item);
+enum natwm_error stack_enqueue_item(struct stack *stack, struct stack_item *item);
 enum natwm_error stack_enqueue(struct stack *stack, void *data);
 
 struct stack_item *stack_pop(struct stack *stack);
@@ -5,18 +5,21 @@
 #include <ctype.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "constants.h"
-#include "list.h"
 #include "logger.h"
+#include "scan.h"
 #include "string.h"
 
 /*
  * Duplicates a stack allocated string to a heap allocated string. This allows
  * for mutating/building upon a string with for instance the string_append
- * function
+ * function. Strings which are built up piece by piece should use a
+ * string_builder instead
  */
 ATTR_NONNULL char *string_init(const char *string)
 {
@@ -33,27 +36,40 @@ ATTR_NONNULL char *string_init(const char *string)
         return result;
 }
 
+// Take over a heap allocated string, so it can be appended to with a builder
+static void string_builder_adopt(struct string_builder *builder, char *string)
+{
+        builder->buffer = string;
+        builder->length = strlen(string);
+        builder->capacity = builder->length + 1;
+}
+
 /*
  * Takes a pointer to a heap allocated string and appends another string to the
  * end of it, making sure to add the null terminator to the end. The resulting
  * string is reallocated in place of the first argument, so it must be freed
+ *
+ * This is a compatibility wrapper for callers which only hold a char *. The
+ * capacity of the string isn't stored anywhere, so every call reallocates it.
+ * Callers which append more than once should build the string with a
+ * string_builder instead, which keeps the capacity between appends and grows
+ * it geometrically
  */
 ATTR_NONNULL enum natwm_error string_append(char **destination, const char *append)
 {
-        size_t destination_size = strlen(*destination);
-        size_t append_size = strlen(append) + 1;
-        size_t result_size = destination_size + append_size;
-        char *tmp = realloc(*destination, result_size);
+        struct string_builder builder;
 
-        if (tmp == NULL) {
-                free(*destination);
+        string_builder_adopt(&builder, *destination);
 
-                return MEMORY_ALLOCATION_ERROR;
-        }
+        enum natwm_error err = string_builder_append(&builder, append);
+
+        if (err != NO_ERROR) {
+                string_builder_destroy(&builder);
 
-        *destination = tmp;
+                return err;
+        }
 
-        strncpy(*destination + destination_size, append, append_size);
+        *destination = builder.buffer;
 
         return NO_ERROR;
 }
@@ -62,22 +78,25 @@ ATTR_NONNULL enum natwm_error string_append(char **destination, const char *appe
  * Takes a pointer to a heap allocated string and appends a single char to the
  * end of it, making sure to add a null terminator to the end. The resulting
  * string is reallocated in place of the first argument, so it must be freed
+ *
+ * Like string_append this is a compatibility wrapper which reallocates on
+ * every call. Use string_builder_append_char when appending in a loop
  */
 ATTR_NONNULL enum natwm_error string_append_char(char **destination, char append)
 {
-        size_t destination_size = strlen(*destination);
-        char *tmp = realloc(*destination, destination_size + 2);
+        struct string_builder builder;
 
-        if (tmp == NULL) {
-                free(*destination);
+        string_builder_adopt(&builder, *destination);
 
-                return MEMORY_ALLOCATION_ERROR;
-        }
+        enum natwm_error err = string_builder_append_char(&builder, append);
 
-        *destination = tmp;
+        if (err != NO_ERROR) {
+                string_builder_destroy(&builder);
 
-        (*destination)[destination_size] = append;
-        (*destination)[destination_size + 1] = '\0';
+                return err;
+        }
+
+        *destination = builder.buffer;
 
         return NO_ERROR;
 }
@@ -96,14 +115,10 @@ enum natwm_error string_find_char(const char *haystack, char needle, size_t *ind
                 return INVALID_INPUT_ERROR;
         }
 
-        char ch = '\0';
-        size_t index = 0;
-
-        while ((ch = haystack[index]) != '\0' && ch != needle) {
-                ++index;
-        }
+        size_t length = strlen(haystack);
+        size_t index = scan_find_char(haystack, length, needle);
 
-        if (ch == '\0') {
+        if (index == length) {
                 return NOT_FOUND_ERROR;
         }
 
@@ -125,14 +140,10 @@ enum natwm_error string_find_first_nonspace(const char *string, size_t *index_re
                 return INVALID_INPUT_ERROR;
         }
 
-        char ch = '\0';
-        size_t index = 0;
-
-        while ((ch = string[index]) != '\0' && isspace(ch)) {
-                ++index;
-        }
+        size_t length = strlen(string);
+        size_t index = scan_find_first_nonspace(string, length);
 
-        if (ch == '\0') {
+        if (index == length) {
                 // Reached the end of the line without finding a nonspace char
                 return NOT_FOUND_ERROR;
         }
@@ -155,29 +166,17 @@ enum natwm_error string_find_last_nonspace(const char *string, size_t *index_res
                 return INVALID_INPUT_ERROR;
         }
 
-        char ch = '\0';
-        size_t i = 0;
-        size_t index = 0;
-        bool found = false;
-
-        while ((ch = string[i]) != '\0') {
-                if (!isspace(ch)) {
-                        index = i;
+        size_t length = strlen(string);
+        size_t index = scan_find_last_nonspace(string, length);
 
-                        if (!found) {
-                                found = true;
-                        }
-                }
+        if (index == length) {
+                *index_result = 0;
 
-                ++i;
+                return NOT_FOUND_ERROR;
         }
 
         *index_result = index;
 
-        if (!found) {
-                return NOT_FOUND_ERROR;
-        }
-
         return NO_ERROR;
 }
 
@@ -278,87 +277,51 @@ enum natwm_error string_splice(const char *string, size_t start, size_t end, cha
         return NO_ERROR;
 }
 
+/**
+ * Split a string on every occurrence of delimiter
+ *
+ * Every delimiter separates two items, so "a,,b" has an empty middle item and
+ * "a," an empty last item. Each item is allocated separately and the caller
+ * must free every item as well as the array
+ */
 enum natwm_error string_split(const char *string, char delimiter, char ***result, size_t *length)
 {
-        // We will create a list of each item we find, then push them all
-        // into an array once we find the total number
-        struct list *found_items = list_create();
+        if (string == NULL) {
+                return INVALID_INPUT_ERROR;
+        }
+
+        size_t string_length = strlen(string);
+        size_t count = scan_count_char(string, string_length, delimiter) + 1;
+        char **items = malloc(sizeof(char *) * count);
 
-        if (found_items == NULL) {
+        if (items == NULL) {
                 return MEMORY_ALLOCATION_ERROR;
         }
 
-        enum natwm_error err = GENERIC_ERROR;
-
-        for (;;) {
-                char *item = NULL;
-                size_t delimiter_pos = 0;
-                err = string_get_delimiter(string, delimiter, &item, &delimiter_pos, false);
+        size_t start = 0;
 
-                if (err == NOT_FOUND_ERROR) {
-                        // There are no more delimiters in the string, but we
-                        // still need to consume the last item
-                        char *last_item = string_init(string);
+        for (size_t i = 0; i < count; ++i) {
+                size_t end = start
+                        + scan_find_char(string + start, string_length - start, delimiter);
+                enum natwm_error err = string_splice(string, start, end, &items[i], NULL);
 
-                        if (last_item == NULL) {
-                                goto free_and_error;
+                if (err != NO_ERROR) {
+                        for (size_t j = 0; j < i; ++j) {
+                                free(items[j]);
                         }
 
-                        list_insert(found_items, last_item);
+                        free(items);
 
-                        break;
-                } else if (err != NO_ERROR) {
-                        // We have an actual error
-                        goto free_and_error;
+                        return err;
                 }
 
-                list_insert(found_items, item);
-
-                string += ++delimiter_pos;
-        }
-
-        if (list_is_empty(found_items)) {
-                return NOT_FOUND_ERROR;
-        }
-
-        // We should now have a list of items. We can now make an array of them
-        char **items = malloc(sizeof(char *) * found_items->size);
-
-        if (items == NULL) {
-                goto free_and_error;
-        }
-
-        // Walk the list backwards to store the strings in order
-        size_t items_index = (found_items->size - 1);
-
-        LIST_FOR_EACH(found_items, item)
-        {
-                items[items_index] = (char *)item->data;
-
-                --items_index;
+                start = end + 1;
         }
 
         *result = items;
-        *length = found_items->size;
-
-        // We have no need for this list anymore
-        list_destroy(found_items);
+        *length = count;
 
         return NO_ERROR;
-
-free_and_error:
-        // We need to make sure to cleanup any memory allocated while finding
-        // items before we return an error
-        LIST_FOR_EACH(found_items, item)
-        {
-                if (item && item->data != NULL) {
-                        free((char *)item->data);
-                }
-        }
-
-        list_destroy(found_items);
-
-        return err;
 }
 
 /**
@@ -457,3 +420,166 @@ enum natwm_error string_to_number(const char *number_string, intmax_t *dest)
 
         return NO_ERROR;
 }
+
+void string_builder_init(struct string_builder *builder)
+{
+        builder->buffer = NULL;
+        builder->length = 0;
+        builder->capacity = 0;
+}
+
+/**
+ * Make sure the builder has space for a string of length characters plus the
+ * null terminator
+ *
+ * The capacity is doubled until it fits, so a series of appends only
+ * reallocates O(log n) times. If the allocation fails the builder is left
+ * unchanged
+ */
+enum natwm_error string_builder_reserve(struct string_builder *builder, size_t length)
+{
+        if (length < builder->capacity) {
+                return NO_ERROR;
+        }
+
+        size_t capacity = MAX(builder->capacity, STRING_BUILDER_MIN_CAPACITY);
+
+        while (capacity <= length) {
+                capacity *= 2;
+        }
+
+        char *buffer = realloc(builder->buffer, capacity);
+
+        if (buffer == NULL) {
+                return MEMORY_ALLOCATION_ERROR;
+        }
+
+        if (builder->buffer == NULL) {
+                buffer[0] = '\0';
+        }
+
+        builder->buffer = buffer;
+        builder->capacity = capacity;
+
+        return NO_ERROR;
+}
+
+enum natwm_error string_builder_append(struct string_builder *builder, const char *append)
+{
+        return string_builder_append_n(builder, append, strlen(append));
+}
+
+/**
+ * Append the first length characters of append to the builder
+ *
+ * append does not need to be null terminated
+ */
+enum natwm_error string_builder_append_n(struct string_builder *builder, const char *append,
+                                         size_t length)
+{
+        enum natwm_error err = string_builder_reserve(builder, builder->length + length);
+
+        if (err != NO_ERROR) {
+                return err;
+        }
+
+        memcpy(builder->buffer + builder->length, append, length);
+
+        builder->length += length;
+        builder->buffer[builder->length] = '\0';
+
+        return NO_ERROR;
+}
+
+enum natwm_error string_builder_append_char(struct string_builder *builder, char append)
+{
+        return string_builder_append_n(builder, &append, 1);
+}
+
+/**
+ * Append a printf style formatted string to the builder
+ *
+ * The string is formatted straight into the spare capacity of the builder.
+ * Only when it doesn't fit is the builder grown and the string formatted a
+ * second time
+ */
+enum natwm_error string_builder_append_format(struct string_builder *builder, const char *format,
+                                              ...)
+{
+        enum natwm_error err = string_builder_reserve(builder, builder->length);
+
+        if (err != NO_ERROR) {
+                return err;
+        }
+
+        va_list args;
+        va_list retry_args;
+
+        va_start(args, format);
+        va_copy(retry_args, args);
+
+        size_t available = builder->capacity - builder->length;
+        int written = vsnprintf(builder->buffer + builder->length, available, format, args);
+
+        va_end(args);
+
+        if (written < 0) {
+                err = INVALID_INPUT_ERROR;
+
+                goto end_and_return;
+        }
+
+        if ((size_t)written >= available) {
+                err = string_builder_reserve(builder, builder->length + (size_t)written);
+
+                if (err != NO_ERROR) {
+                        goto end_and_return;
+                }
+
+                vsnprintf(builder->buffer + builder->length,
+                          builder->capacity - builder->length,
+                          format,
+                          retry_args);
+        }
+
+        builder->length += (size_t)written;
+
+end_and_return:
+        va_end(retry_args);
+
+        if (err != NO_ERROR) {
+                // Don't leave any partially formatted output behind
+                builder->buffer[builder->length] = '\0';
+        }
+
+        return err;
+}
+
+/**
+ * Hand the built string over to the caller, who must free it
+ *
+ * A builder which nothing was appended to still produces an empty string.
+ * The builder is reset and can be reused. If allocating an empty string fails
+ * NULL is returned
+ */
+char *string_builder_finish(struct string_builder *builder, size_t *length)
+{
+        if (string_builder_reserve(builder, builder->length) != NO_ERROR) {
+                return NULL;
+        }
+
+        char *result = builder->buffer;
+
+        SET_IF_NON_NULL(length, builder->length);
+
+        string_builder_init(builder);
+
+        return result;
+}
+
+void string_builder_destroy(struct string_builder *builder)
+{
+        free(builder->buffer);
+
+        string_builder_init(builder);
+}
@@ -5,10 +5,28 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#include "constants.h"
 #include "error.h"
 
+#define STRING_BUILDER_MIN_CAPACITY 16
+
+/**
+ * A heap allocated string which tracks its own length and capacity
+ *
+ * The buffer grows geometrically so appending to a builder is amortized O(1)
+ * per byte. Once the string is complete string_builder_finish hands the
+ * buffer over to the caller. The buffer is always null terminated once
+ * anything has been appended
+ */
+struct string_builder {
+        char *buffer;
+        size_t length;
+        size_t capacity; // Includes the null terminator
+};
+
 char *string_init(const char *string);
 enum natwm_error string_append(char **destination, const char *append);
 enum natwm_error string_append_char(char **destination, char append);
@@ -24,3 +42,15 @@ enum natwm_error string_split(const char *string, char delimiter, char ***result
 enum natwm_error string_strip_surrounding_spaces(const char *string, char **dest, size_t *length);
 enum natwm_error string_to_boolean(const char *boolean_string, bool *result);
 enum natwm_error string_to_number(const char *number_string, intmax_t *dest);
+
+void string_builder_init(struct string_builder *builder);
+enum natwm_error string_builder_reserve(struct string_builder *builder, size_t length);
+enum natwm_error string_builder_append(struct string_builder *builder, const char *append);
+enum natwm_error string_builder_append_n(struct string_builder *builder, const char *append,
+                                         size_t length);
+enum natwm_error string_builder_append_char(struct string_builder *builder, char append);
+ATTR_FORMAT_PRINTF(2, 3)
+enum natwm_error string_builder_append_format(struct string_builder *builder, const char *format,
+                                              ...);
+char *string_builder_finish(struct string_builder *builder, size_t *length);
+void string_builder_destroy(struct string_builder *builder);
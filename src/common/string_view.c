@@ -0,0 +1,243 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "constants.h"
+#include "scan.h"
+#include "string_view.h"
+
+struct string_view string_view_create(const char *data, size_t length)
+{
+        struct string_view view = {
+                .data = data,
+                .length = length,
+        };
+
+        return view;
+}
+
+struct string_view string_view_from_string(const char *string)
+{
+        return string_view_create(string, strlen(string));
+}
+
+bool string_view_is_empty(struct string_view view)
+{
+        return view.length == 0;
+}
+
+bool string_view_equal(struct string_view one, struct string_view two)
+{
+        if (one.length != two.length) {
+                return false;
+        }
+
+        return one.length == 0 || memcmp(one.data, two.data, one.length) == 0;
+}
+
+bool string_view_equal_string(struct string_view view, const char *string)
+{
+        return string_view_equal(view, string_view_from_string(string));
+}
+
+/**
+ * Compare a view and a string without considering their case
+ */
+bool string_view_no_case_compare(struct string_view view, const char *string)
+{
+        if (string == NULL || strlen(string) != view.length) {
+                return false;
+        }
+
+        for (size_t i = 0; i < view.length; ++i) {
+                if (tolower((unsigned char)view.data[i]) != tolower((unsigned char)string[i])) {
+                        return false;
+                }
+        }
+
+        return true;
+}
+
+/**
+ * Find the index of the first needle in the view
+ *
+ * If the view does not contain the needle NOT_FOUND_ERROR is returned
+ */
+enum natwm_error string_view_find_char(struct string_view view, char needle, size_t *index)
+{
+        size_t found = scan_find_char(view.data, view.length, needle);
+
+        if (found == view.length) {
+                return NOT_FOUND_ERROR;
+        }
+
+        SET_IF_NON_NULL(index, found);
+
+        return NO_ERROR;
+}
+
+/**
+ * Get the part of a view from start up to (but not including) end
+ */
+struct string_view string_view_slice(struct string_view view, size_t start, size_t end)
+{
+        assert(start <= end && end <= view.length);
+
+        return string_view_create(view.data + start, end - start);
+}
+
+/**
+ * Get the part of a view between the first and last non whitespace
+ * characters. If the view only contains whitespace the result is empty
+ */
+struct string_view string_view_strip_surrounding_spaces(struct string_view view)
+{
+        size_t start = scan_find_first_nonspace(view.data, view.length);
+
+        if (start == view.length) {
+                return string_view_slice(view, start, start);
+        }
+
+        size_t end = scan_find_last_nonspace(view.data, view.length) + 1;
+
+        return string_view_slice(view, start, end);
+}
+
+void string_view_split_init(struct string_view_split *split, struct string_view view,
+                            char delimiter)
+{
+        split->remaining = view;
+        split->delimiter = delimiter;
+        split->done = false;
+}
+
+/**
+ * Place the next part of the split into result
+ *
+ * Returns false once every part has been returned
+ */
+bool string_view_split_next(struct string_view_split *split, struct string_view *result)
+{
+        if (split->done) {
+                return false;
+        }
+
+        size_t index = 0;
+
+        if (string_view_find_char(split->remaining, split->delimiter, &index) != NO_ERROR) {
+                // The last part is everything after the final delimiter
+                *result = split->remaining;
+
+                split->done = true;
+
+                return true;
+        }
+
+        *result = string_view_slice(split->remaining, 0, index);
+
+        split->remaining
+                = string_view_slice(split->remaining, index + 1, split->remaining.length);
+
+        return true;
+}
+
+/**
+ * Resolve a view containing some casing of "true" or "false" into a boolean
+ */
+enum natwm_error string_view_to_boolean(struct string_view view, bool *result)
+{
+        if (string_view_no_case_compare(view, "true")) {
+                *result = true;
+
+                return NO_ERROR;
+        }
+
+        if (string_view_no_case_compare(view, "false")) {
+                *result = false;
+
+                return NO_ERROR;
+        }
+
+        return INVALID_INPUT_ERROR;
+}
+
+/**
+ * Resolve a view containing a base 10 number into an intmax_t
+ *
+ * This accepts the same input as string_to_number - optional leading
+ * whitespace, an optional sign and then only digits. Numbers which don't fit
+ * in an intmax_t are rejected
+ */
+enum natwm_error string_view_to_number(struct string_view view, intmax_t *result)
+{
+        size_t index = 0;
+        bool negative = false;
+
+        while (index < view.length && isspace((unsigned char)view.data[index])) {
+                ++index;
+        }
+
+        if (index < view.length && (view.data[index] == '-' || view.data[index] == '+')) {
+                negative = (view.data[index] == '-');
+
+                ++index;
+        }
+
+        if (index == view.length) {
+                return INVALID_INPUT_ERROR;
+        }
+
+        uintmax_t limit = negative ? (uintmax_t)INTMAX_MAX + 1 : (uintmax_t)INTMAX_MAX;
+        uintmax_t magnitude = 0;
+
+        for (; index < view.length; ++index) {
+                char ch = view.data[index];
+
+                if (!isdigit((unsigned char)ch)) {
+                        return INVALID_INPUT_ERROR;
+                }
+
+                uintmax_t digit = (uintmax_t)(ch - '0');
+
+                if (magnitude > (limit - digit) / 10) {
+                        return INVALID_INPUT_ERROR;
+                }
+
+                magnitude = (magnitude * 10) + digit;
+        }
+
+        if (negative) {
+                // Negate magnitude - 1 so INTMAX_MIN does not overflow
+                *result = (magnitude == 0) ? 0 : -(intmax_t)(magnitude - 1) - 1;
+        } else {
+                *result = (intmax_t)magnitude;
+        }
+
+        return NO_ERROR;
+}
+
+/**
+ * Make an owned, null terminated copy of a view. The caller must free the
+ * result
+ */
+char *string_view_to_string(struct string_view view)
+{
+        char *string = malloc(view.length + 1);
+
+        if (string == NULL) {
+                return NULL;
+        }
+
+        if (view.length > 0) {
+                memcpy(string, view.data, view.length);
+        }
+
+        string[view.length] = '\0';
+
+        return string;
+}
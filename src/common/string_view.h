@@ -0,0 +1,57 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "error.h"
+
+/**
+ * A non owning reference to a run of characters
+ *
+ * A view points into a string owned by someone else, usually the buffer a
+ * config file was read into, and is not null terminated. None of the
+ * string_view functions allocate, string_view_to_string must be used to make
+ * an owned copy once a string needs to outlive the buffer
+ */
+struct string_view {
+        const char *data;
+        size_t length;
+};
+
+/**
+ * Iterates over the parts of a view separated by a delimiter
+ *
+ * Every delimiter separates two parts, so "a,,b" has an empty middle part
+ * and "a," an empty last part
+ */
+struct string_view_split {
+        struct string_view remaining;
+        char delimiter;
+        bool done;
+};
+
+// Used to print a view with printf style functions
+//
+// printf("%.*s", STRING_VIEW_PRINTF_ARGS(view));
+#define STRING_VIEW_PRINTF_ARGS(view) (int)(view).length, (view).data
+
+struct string_view string_view_create(const char *data, size_t length);
+struct string_view string_view_from_string(const char *string);
+bool string_view_is_empty(struct string_view view);
+bool string_view_equal(struct string_view one, struct string_view two);
+bool string_view_equal_string(struct string_view view, const char *string);
+bool string_view_no_case_compare(struct string_view view, const char *string);
+enum natwm_error string_view_find_char(struct string_view view, char needle, size_t *index);
+struct string_view string_view_slice(struct string_view view, size_t start, size_t end);
+struct string_view string_view_strip_surrounding_spaces(struct string_view view);
+void string_view_split_init(struct string_view_split *split, struct string_view view,
+                            char delimiter);
+bool string_view_split_next(struct string_view_split *split, struct string_view *result);
+enum natwm_error string_view_to_boolean(struct string_view view, bool *result);
+enum natwm_error string_view_to_number(struct string_view view, intmax_t *result);
+char *string_view_to_string(struct string_view view);
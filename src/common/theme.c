@@ -8,6 +8,7 @@
 #include <core/config/config.h>
 
 #include "constants.h"
+#include "intern.h"
 #include "logger.h"
 #include "theme.h"
 
@@ -45,6 +46,21 @@ static enum natwm_error string_to_rgb(const char *hex_string, uint32_t *result)
         return NO_ERROR;
 }
 
+// Mirrors the errors of the config_find_* functions for a value which has
+// already been looked up
+static enum natwm_error check_config_value(const struct config_value *value, enum data_types type)
+{
+        if (value == NULL) {
+                return NOT_FOUND_ERROR;
+        }
+
+        if (value->type != type) {
+                return INVALID_INPUT_ERROR;
+        }
+
+        return NO_ERROR;
+}
+
 static enum natwm_error color_value_from_config_value(const struct config_value *config_value,
                                                       struct color_value **result)
 {
@@ -96,64 +112,65 @@ struct color_theme *color_theme_create(void)
         return theme;
 }
 
-struct theme *theme_create(const struct map *config_map)
+bool color_value_has_changed(const struct color_value *value, const char *new_string_value)
 {
-        struct theme *theme = malloc(sizeof(struct theme));
-
-        if (theme == NULL) {
-                return NULL;
+        if (value == NULL || new_string_value == NULL) {
+                return true;
         }
 
-        enum natwm_error err = GENERIC_ERROR;
-
-        err = border_theme_from_config(
-                config_map, WINDOW_BORDER_WIDTH_CONFIG_STRING, &theme->border_width);
+        // A string which has never been interned can't match the current
+        // value, so there is no need to add it to the table
+        return value->string != intern_find(new_string_value);
+}
 
-        if (err != NO_ERROR) {
-                goto handle_error;
+// Color values hold interned strings, so two values are the same color when
+// their strings are the same pointer
+static bool color_value_differs(const struct color_value *previous, const struct color_value *next)
+{
+        if (next == NULL) {
+                return previous != NULL;
         }
 
-        err = color_theme_from_config(config_map, WINDOW_BORDER_COLOR_CONFIG_STRING, &theme->color);
-
-        if (err != NO_ERROR) {
-                goto handle_error;
-        }
+        return color_value_has_changed(previous, next->string);
+}
 
-        err = color_value_from_config(
-                config_map, RESIZE_BACKGROUND_COLOR_CONFIG_STRING, &theme->resize_background_color);
+static bool border_theme_differs(const struct border_theme *previous,
+                                 const struct border_theme *next)
+{
+        return previous->unfocused != next->unfocused || previous->focused != next->focused
+                || previous->urgent != next->urgent || previous->sticky != next->sticky;
+}
 
-        if (err != NO_ERROR) {
-                goto handle_error;
-        }
+static bool color_theme_differs(const struct color_theme *previous, const struct color_theme *next)
+{
+        return color_value_differs(previous->unfocused, next->unfocused)
+                || color_value_differs(previous->focused, next->focused)
+                || color_value_differs(previous->urgent, next->urgent)
+                || color_value_differs(previous->sticky, next->sticky);
+}
 
-        err = color_value_from_config(
-                config_map, RESIZE_BORDER_COLOR_CONFIG_STRING, &theme->resize_border_color);
+/**
+ * Compare two complete themes and report which parts of them differ. Used
+ * when the configuration is reloaded to only update what changed
+ */
+enum theme_change theme_diff(const struct theme *previous, const struct theme *next)
+{
+        enum theme_change change = THEME_UNCHANGED;
 
-        if (err != NO_ERROR) {
-                goto handle_error;
+        if (border_theme_differs(previous->border_width, next->border_width)) {
+                change |= THEME_BORDER_WIDTH_CHANGED;
         }
 
-        return theme;
-
-handle_error:
-        theme_destroy(theme);
-
-        LOG_ERROR(natwm_logger, "Failed to create theme");
-
-        return NULL;
-}
-
-bool color_value_has_changed(struct color_value *value, const char *new_string_value)
-{
-        if (value == NULL || new_string_value == NULL) {
-                return true;
+        if (color_theme_differs(previous->color, next->color)) {
+                change |= THEME_BORDER_COLOR_CHANGED;
         }
 
-        if (strcmp(value->string, new_string_value) == 0) {
-                return false;
+        if (color_value_differs(previous->resize_background_color, next->resize_background_color)
+            || color_value_differs(previous->resize_border_color, next->resize_border_color)) {
+                change |= THEME_RESIZE_COLOR_CHANGED;
         }
 
-        return true;
+        return change;
 }
 
 enum natwm_error color_value_from_string(const char *string, struct color_value **result)
@@ -164,7 +181,6 @@ enum natwm_error color_value_from_string(const char *string, struct color_value
                 return MEMORY_ALLOCATION_ERROR;
         }
 
-        value->string = string;
         value->color_value = 0;
 
         if (string_to_rgb(string, &value->color_value) != NO_ERROR) {
@@ -173,16 +189,23 @@ enum natwm_error color_value_from_string(const char *string, struct color_value
                 return INVALID_INPUT_ERROR;
         }
 
+        value->string = intern_string(string);
+
+        if (value->string == NULL) {
+                free(value);
+
+                return MEMORY_ALLOCATION_ERROR;
+        }
+
         *result = value;
 
         return NO_ERROR;
 }
 
-enum natwm_error color_value_from_config(const struct map *map, const char *key,
-                                         struct color_value **result)
+static enum natwm_error color_value_from_found_value(const struct config_value *config_value,
+                                                     const char *key, struct color_value **result)
 {
-        const char *string = NULL;
-        enum natwm_error err = config_find_string(map, key, &string);
+        enum natwm_error err = check_config_value(config_value, STRING);
 
         if (err != NO_ERROR) {
                 if (err == NOT_FOUND_ERROR) {
@@ -199,7 +222,7 @@ enum natwm_error color_value_from_config(const struct map *map, const char *key,
 
         struct color_value *value = NULL;
 
-        err = color_value_from_string(string, &value);
+        err = color_value_from_string(config_value->data.string, &value);
 
         if (err != NO_ERROR) {
                 LOG_ERROR(natwm_logger, "Failed to retrieve color value from '%s'", key);
@@ -212,11 +235,11 @@ enum natwm_error color_value_from_config(const struct map *map, const char *key,
         return NO_ERROR;
 }
 
-enum natwm_error border_theme_from_config(const struct map *map, const char *key,
-                                          struct border_theme **result)
+static enum natwm_error border_theme_from_found_value(const struct config_value *value,
+                                                      const char *key,
+                                                      struct border_theme **result)
 {
-        const struct config_array *config_value = NULL;
-        enum natwm_error err = config_find_array(map, key, &config_value);
+        enum natwm_error err = check_config_value(value, ARRAY);
 
         if (err != NO_ERROR) {
                 if (err == NOT_FOUND_ERROR) {
@@ -231,6 +254,7 @@ enum natwm_error border_theme_from_config(const struct map *map, const char *key
                 return err;
         }
 
+        const struct config_array *config_value = value->data.array;
         struct border_theme *theme = border_theme_create();
 
         if (theme == NULL) {
@@ -281,14 +305,13 @@ enum natwm_error border_theme_from_config(const struct map *map, const char *key
         return NO_ERROR;
 }
 
-enum natwm_error color_theme_from_config(const struct map *map, const char *key,
-                                         struct color_theme **result)
+static enum natwm_error color_theme_from_found_value(const struct config_value *value,
+                                                     const char *key, struct color_theme **result)
 {
-        const struct config_array *config_value = NULL;
-        enum natwm_error err = config_find_array(map, key, &config_value);
+        enum natwm_error err = check_config_value(value, ARRAY);
 
         if (err != NO_ERROR) {
-                if (NOT_FOUND_ERROR) {
+                if (err == NOT_FOUND_ERROR) {
                         LOG_ERROR(natwm_logger, "Failed to find config item for '%s'", key);
                 } else {
                         LOG_ERROR(natwm_logger, "Invalid color values for config item '%s'", key);
@@ -297,6 +320,8 @@ enum natwm_error color_theme_from_config(const struct map *map, const char *key,
                 return err;
         }
 
+        const struct config_array *config_value = value->data.array;
+
         // TODO: It might be better in the future to leave unset config values
         // as NULL and have a fallback. That way users could just override the
         // values they wanted to change.
@@ -359,6 +384,92 @@ invalid_color_value_error:
         return INVALID_INPUT_ERROR;
 }
 
+enum natwm_error color_value_from_config(const struct map *map, const char *key,
+                                         struct color_value **result)
+{
+        return color_value_from_found_value(config_find(map, key), key, result);
+}
+
+enum natwm_error border_theme_from_config(const struct map *map, const char *key,
+                                          struct border_theme **result)
+{
+        return border_theme_from_found_value(config_find(map, key), key, result);
+}
+
+enum natwm_error color_theme_from_config(const struct map *map, const char *key,
+                                         struct color_theme **result)
+{
+        return color_theme_from_found_value(config_find(map, key), key, result);
+}
+
+// Interned on first use, see config_find_key
+static struct config_key theme_keys[] = {
+        CONFIG_KEY_INIT(WINDOW_BORDER_WIDTH_CONFIG_STRING),
+        CONFIG_KEY_INIT(WINDOW_BORDER_COLOR_CONFIG_STRING),
+        CONFIG_KEY_INIT(RESIZE_BACKGROUND_COLOR_CONFIG_STRING),
+        CONFIG_KEY_INIT(RESIZE_BORDER_COLOR_CONFIG_STRING),
+};
+
+/**
+ * The theme keys are resolved together with config_find_many. Each value is
+ * then validated in the same order the keys were listed, so the first invalid
+ * item is the one which is reported
+ */
+struct theme *theme_create(const struct map *config_map)
+{
+        size_t key_count = sizeof(theme_keys) / sizeof(theme_keys[0]);
+        struct config_value *values[sizeof(theme_keys) / sizeof(theme_keys[0])];
+        struct theme *theme = malloc(sizeof(struct theme));
+
+        if (theme == NULL) {
+                return NULL;
+        }
+
+        theme->border_width = NULL;
+        theme->color = NULL;
+        theme->resize_background_color = NULL;
+        theme->resize_border_color = NULL;
+
+        config_find_many(config_map, theme_keys, key_count, values);
+
+        enum natwm_error err = GENERIC_ERROR;
+
+        err = border_theme_from_found_value(values[0], theme_keys[0].name, &theme->border_width);
+
+        if (err != NO_ERROR) {
+                goto handle_error;
+        }
+
+        err = color_theme_from_found_value(values[1], theme_keys[1].name, &theme->color);
+
+        if (err != NO_ERROR) {
+                goto handle_error;
+        }
+
+        err = color_value_from_found_value(
+                values[2], theme_keys[2].name, &theme->resize_background_color);
+
+        if (err != NO_ERROR) {
+                goto handle_error;
+        }
+
+        err = color_value_from_found_value(
+                values[3], theme_keys[3].name, &theme->resize_border_color);
+
+        if (err != NO_ERROR) {
+                goto handle_error;
+        }
+
+        return theme;
+
+handle_error:
+        theme_destroy(theme);
+
+        LOG_ERROR(natwm_logger, "Failed to create theme");
+
+        return NULL;
+}
+
 void border_theme_destroy(struct border_theme *theme)
 {
         free(theme);
@@ -400,5 +511,13 @@ void theme_destroy(struct theme *theme)
                 color_theme_destroy(theme->color);
         }
 
+        if (theme->resize_background_color != NULL) {
+                color_value_destroy(theme->resize_background_color);
+        }
+
+        if (theme->resize_border_color != NULL) {
+                color_value_destroy(theme->resize_border_color);
+        }
+
         free(theme);
 }
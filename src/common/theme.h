@@ -12,7 +12,7 @@
 #include <common/map.h>
 
 struct color_value {
-        // String representation (useful for diffing)
+        // Interned string representation (diffed by pointer)
         const char *string;
         uint32_t color_value;
 };
@@ -65,11 +65,22 @@ struct theme {
         struct color_value *resize_border_color;
 };
 
+/**
+ * Parts of a theme which differ between two themes
+ */
+enum theme_change {
+        THEME_UNCHANGED = 0,
+        THEME_BORDER_WIDTH_CHANGED = 1U << 0U,
+        THEME_BORDER_COLOR_CHANGED = 1U << 1U,
+        THEME_RESIZE_COLOR_CHANGED = 1U << 2U,
+};
+
 struct border_theme *border_theme_create(void);
 struct color_theme *color_theme_create(void);
 struct theme *theme_create(const struct map *config_map);
 
-bool color_value_has_changed(struct color_value *value, const char *new_string_value);
+bool color_value_has_changed(const struct color_value *value, const char *new_string_value);
+enum theme_change theme_diff(const struct theme *previous, const struct theme *next);
 enum natwm_error color_value_from_string(const char *string, struct color_value **result);
 enum natwm_error border_theme_from_config(const struct map *map, const char *key,
                                           struct border_theme **result);
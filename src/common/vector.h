@@ -0,0 +1,178 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#pragma once
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <common/error.h>
+
+/**
+ * Header only growable array instantiated for a specific element type
+ *
+ * VEC_DEFINE(name, type) defines struct name and the following functions:
+ *
+ * struct name *name_create(void)
+ * enum natwm_error name_reserve(struct name *vector, size_t capacity)
+ * enum natwm_error name_push(struct name *vector, type value)
+ * type name_pop(struct name *vector)
+ * type *name_at(const struct name *vector, size_t index)
+ * enum natwm_error name_swap_remove(struct name *vector, size_t index)
+ * enum natwm_error name_remove(struct name *vector, size_t index)
+ * void name_clear(struct name *vector)
+ * bool name_is_empty(const struct name *vector)
+ * void name_destroy(struct name *vector)
+ *
+ * Elements are stored contiguously and the capacity doubles when full.
+ * Pointers returned by name_at are only valid until the next push. Elements
+ * are never free'd by the vector.
+ *
+ * Index access through name_at is bounds checked and returns NULL when out of
+ * range. name_swap_remove moves the last element into the removed slot, which
+ * is O(1) but does not keep the order, name_remove keeps the order.
+ */
+
+// Iterate over pointers to the elements of a vector
+//
+// Elements must not be added or removed while iterating
+#define VEC_FOR_EACH(vector, type, item)                                                           \
+        for (type * (item) = (vector)->items;                                                      \
+             (item) != NULL && (size_t)((item) - (vector)->items) < (vector)->length;              \
+             ++(item))
+
+// Iterate over the indexes of a vector from the last element to the first
+//
+// The current element can be removed with name_swap_remove or name_remove
+// while iterating, since only elements which were already visited move
+#define VEC_FOR_EACH_REVERSE(vector, index)                                                        \
+        for (size_t (index) = (vector)->length; (index)-- > 0;)
+
+#define VEC_MIN_CAPACITY 4
+
+#define VEC_DEFINE(name, type)                                                                     \
+        struct name {                                                                              \
+                size_t length;                                                                     \
+                size_t capacity;                                                                   \
+                type *items;                                                                       \
+        };                                                                                         \
+                                                                                                   \
+        static inline struct name *name##_create(void)                                             \
+        {                                                                                          \
+                struct name *vector = malloc(sizeof(struct name));                                 \
+                                                                                                   \
+                if (vector == NULL) {                                                              \
+                        return NULL;                                                               \
+                }                                                                                  \
+                                                                                                   \
+                vector->length = 0;                                                                \
+                vector->capacity = 0;                                                              \
+                vector->items = NULL;                                                              \
+                                                                                                   \
+                return vector;                                                                     \
+        }                                                                                          \
+                                                                                                   \
+        static inline enum natwm_error name##_reserve(struct name *vector, size_t capacity)        \
+        {                                                                                          \
+                if (capacity <= vector->capacity) {                                                \
+                        return NO_ERROR;                                                           \
+                }                                                                                  \
+                                                                                                   \
+                type *items = realloc(vector->items, capacity * sizeof(type));                     \
+                                                                                                   \
+                if (items == NULL) {                                                               \
+                        return MEMORY_ALLOCATION_ERROR;                                            \
+                }                                                                                  \
+                                                                                                   \
+                vector->items = items;                                                             \
+                vector->capacity = capacity;                                                       \
+                                                                                                   \
+                return NO_ERROR;                                                                   \
+        }                                                                                          \
+                                                                                                   \
+        static inline enum natwm_error name##_push(struct name *vector, type value)                \
+        {                                                                                          \
+                if (vector->length == vector->capacity) {                                          \
+                        size_t capacity = vector->capacity * 2;                                    \
+                                                                                                   \
+                        if (capacity < VEC_MIN_CAPACITY) {                                         \
+                                capacity = VEC_MIN_CAPACITY;                                       \
+                        }                                                                          \
+                                                                                                   \
+                        enum natwm_error err = name##_reserve(vector, capacity);                   \
+                                                                                                   \
+                        if (err != NO_ERROR) {                                                     \
+                                return err;                                                        \
+                        }                                                                          \
+                }                                                                                  \
+                                                                                                   \
+                vector->items[vector->length++] = value;                                           \
+                                                                                                   \
+                return NO_ERROR;                                                                   \
+        }                                                                                          \
+                                                                                                   \
+        static inline type name##_pop(struct name *vector)                                         \
+        {                                                                                          \
+                assert(vector->length > 0);                                                        \
+                                                                                                   \
+                return vector->items[--vector->length];                                            \
+        }                                                                                          \
+                                                                                                   \
+        static inline type *name##_at(const struct name *vector, size_t index)                     \
+        {                                                                                          \
+                if (index >= vector->length) {                                                     \
+                        return NULL;                                                               \
+                }                                                                                  \
+                                                                                                   \
+                return &vector->items[index];                                                      \
+        }                                                                                          \
+                                                                                                   \
+        static inline enum natwm_error name##_swap_remove(struct name *vector, size_t index)       \
+        {                                                                                          \
+                if (index >= vector->length) {                                                     \
+                        return INVALID_INPUT_ERROR;                                                \
+                }                                                                                  \
+                                                                                                   \
+                vector->items[index] = vector->items[--vector->length];                            \
+                                                                                                   \
+                return NO_ERROR;                                                                   \
+        }                                                                                          \
+                                                                                                   \
+        static inline enum natwm_error name##_remove(struct name *vector, size_t index)            \
+        {                                                                                          \
+                if (index >= vector->length) {                                                     \
+                        return INVALID_INPUT_ERROR;                                                \
+                }                                                                                  \
+                                                                                                   \
+                --vector->length;                                                                  \
+                                                                                                   \
+                memmove(&vector->items[index],                                                     \
+                        &vector->items[index + 1],                                                 \
+                        (vector->length - index) * sizeof(type));                                  \
+                                                                                                   \
+                return NO_ERROR;                                                                   \
+        }                                                                                          \
+                                                                                                   \
+        static inline void name##_clear(struct name *vector)                                       \
+        {                                                                                          \
+                vector->length = 0;                                                                \
+        }                                                                                          \
+                                                                                                   \
+        static inline bool name##_is_empty(const struct name *vector)                              \
+        {                                                                                          \
+                return vector->length == 0;                                                        \
+        }                                                                                          \
+                                                                                                   \
+        static inline void name##_destroy(struct name *vector)                                     \
+        {                                                                                          \
+                if (vector == NULL) {                                                              \
+                        return;                                                                    \
+                }                                                                                  \
+                                                                                                   \
+                free(vector->items);                                                               \
+                free(vector);                                                                      \
+        }
@@ -246,9 +246,12 @@ static void update_stack_mode(const struct natwm_state *state, xcb_window_t wind
         xcb_flush(state->xcb);
 }
 
-struct client *client_create(xcb_window_t window, xcb_rectangle_t rect, xcb_size_hints_t *hints)
+// Clients come and go with every window, so they are allocated from the pool
+// of the workspace list instead of one malloc each
+struct client *client_create(struct pool *pool, xcb_window_t window, xcb_rectangle_t rect,
+                             xcb_size_hints_t *hints)
 {
-        struct client *client = malloc(sizeof(struct client));
+        struct client *client = pool_alloc(pool);
 
         if (client == NULL) {
                 return NULL;
@@ -272,6 +275,9 @@ struct client *client_create(xcb_window_t window, xcb_rectangle_t rect, xcb_size
         client->is_focused = false;
         client->is_fullscreen = false;
         client->state = CLIENT_NORMAL | CLIENT_UNTHEMED;
+        client->workspace = NULL;
+
+        list_link_init(&client->workspace_link);
 
         return client;
 }
@@ -317,7 +323,8 @@ struct client *client_register_window(struct natwm_state *state, xcb_window_t wi
                 return NULL;
         }
 
-        struct client *client = client_create(window, rect, hints);
+        struct client *client
+                = client_create(state->workspace_list->client_pool, window, rect, hints);
 
         if (client == NULL) {
                 return NULL;
@@ -358,7 +365,7 @@ handle_no_register:
         return NULL;
 
 handle_error:
-        client_destroy(client);
+        client_destroy(state->workspace_list->client_pool, client);
 
         return NULL;
 }
@@ -689,7 +696,7 @@ enum natwm_error client_handle_destroy_notify(struct natwm_state *state, xcb_win
 
         xcb_change_save_set(state->xcb, XCB_SET_MODE_DELETE, client->window);
 
-        client_destroy(client);
+        client_destroy(state->workspace_list->client_pool, client);
 
         return NO_ERROR;
 }
@@ -741,6 +748,48 @@ struct color_value *client_get_active_border_color(const struct theme *theme,
         return theme->color->unfocused;
 }
 
+/**
+ * Bring a client in line with the current theme after the theme has been
+ * replaced. Only the border color and width which changed are sent. The
+ * client keeps its size and position, even when a wider border no longer fits
+ * on the monitor, so a theme change never moves or resizes a window
+ */
+void client_apply_theme(const struct natwm_state *state, const struct client *client,
+                        const struct theme *previous_theme)
+{
+        // Fullscreen clients are themed again when they leave fullscreen and
+        // unthemed clients when they are first mapped
+        if (client->is_fullscreen || client->state & CLIENT_UNTHEMED) {
+                return;
+        }
+
+        const struct theme *theme = state->workspace_list->theme;
+        const struct color_value *border_color = client_get_active_border_color(theme, client);
+        const struct color_value *previous_border_color
+                = client_get_active_border_color(previous_theme, client);
+
+        if (color_value_has_changed(previous_border_color, border_color->string)) {
+                xcb_change_window_attributes(state->xcb,
+                                             client->window,
+                                             XCB_CW_BORDER_PIXEL,
+                                             &border_color->color_value);
+        }
+
+        uint16_t border_width = client_get_active_border_width(theme, client);
+
+        if (border_width == client_get_active_border_width(previous_theme, client)) {
+                return;
+        }
+
+        uint32_t values[] = {
+                border_width,
+        };
+
+        xcb_configure_window(state->xcb, client->window, XCB_CONFIG_WINDOW_BORDER_WIDTH, values);
+
+        client_update_hints(state, client, FRAME_EXTENTS);
+}
+
 enum natwm_error client_set_fullscreen(const struct natwm_state *state, struct client *client)
 {
         struct workspace *workspace
@@ -932,11 +981,11 @@ enum natwm_error client_update_hints(const struct natwm_state *state, const stru
         return NO_ERROR;
 }
 
-void client_destroy(struct client *client)
+void client_destroy(struct pool *pool, struct client *client)
 {
         free(client->size_hints);
 
-        free(client);
+        pool_free(pool, client);
 
         client = NULL;
 }
@@ -10,13 +10,16 @@
 #include <xcb/xcb_icccm.h>
 
 #include <common/error.h>
+#include <common/list.h>
 #include <common/map.h>
+#include <common/pool.h>
 #include <common/theme.h>
 
 #include "state.h"
 
 // Provided by workspace.h
 struct monitor;
+struct workspace;
 
 enum client_state {
         CLIENT_URGENT = 1U << 0U,
@@ -41,9 +44,12 @@ struct client {
         bool is_focused;
         bool is_fullscreen;
         enum client_state state;
+        struct workspace *workspace; // Workspace the client is linked into
+        struct list_link workspace_link; // Position in the workspace client list
 };
 
-struct client *client_create(xcb_window_t window, xcb_rectangle_t rect, xcb_size_hints_t *hints);
+struct client *client_create(struct pool *pool, xcb_window_t window, xcb_rectangle_t rect,
+                             xcb_size_hints_t *hints);
 struct client *client_register_window(struct natwm_state *state, xcb_window_t window);
 enum natwm_error client_handle_button_press(struct natwm_state *state,
                                             xcb_button_press_event_t *event);
@@ -63,6 +69,8 @@ enum natwm_error client_handle_destroy_notify(struct natwm_state *state, xcb_win
 uint16_t client_get_active_border_width(const struct theme *theme, const struct client *client);
 struct color_value *client_get_active_border_color(const struct theme *theme,
                                                    const struct client *client);
+void client_apply_theme(const struct natwm_state *state, const struct client *client,
+                        const struct theme *previous_theme);
 enum natwm_error client_unset_fullscreen(const struct natwm_state *state, struct client *client);
 enum natwm_error client_set_fullscreen(const struct natwm_state *state, struct client *client);
 enum natwm_error client_handle_fullscreen_window(struct natwm_state *state,
@@ -77,4 +85,4 @@ enum natwm_error client_send_window_to_workspace(struct natwm_state *state, xcb_
 enum natwm_error client_update_hints(const struct natwm_state *state, const struct client *client,
                                      enum client_hints hints);
 
-void client_destroy(struct client *client);
+void client_destroy(struct pool *pool, struct client *client);
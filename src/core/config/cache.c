@@ -0,0 +1,579 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <common/hash.h>
+#include <common/intern.h>
+#include <common/logger.h>
+#include <common/string.h>
+#include <common/vector.h>
+
+#include "cache.h"
+#include "parser.h"
+#include "value.h"
+
+VEC_DEFINE(config_cache_entry_vector, struct config_cache_entry)
+VEC_DEFINE(config_cache_value_vector, struct config_cache_value)
+
+struct cache_writer {
+        struct config_cache_entry_vector *entries;
+        struct config_cache_value_vector *values;
+        struct string_builder strings;
+};
+
+struct cache_reader {
+        const struct config_cache_header *header;
+        const struct config_cache_entry *entries;
+        const struct config_cache_value *values;
+        const uint32_t *displacements;
+        const char *strings;
+};
+
+static char *append_suffix(const char *path, const char *suffix)
+{
+        struct string_builder builder;
+
+        string_builder_init(&builder);
+
+        if (string_builder_append(&builder, path) != NO_ERROR
+            || string_builder_append(&builder, suffix) != NO_ERROR) {
+                string_builder_destroy(&builder);
+
+                return NULL;
+        }
+
+        return string_builder_finish(&builder, NULL);
+}
+
+/**
+ * The path of the snapshot for the configuration at config_path
+ *
+ * The returned string must be free'd by the caller
+ */
+char *config_cache_path(const char *config_path)
+{
+        return append_suffix(config_path, CONFIG_CACHE_SUFFIX);
+}
+
+/**
+ * Create the key of a configuration file from it's stat and contents
+ */
+void config_cache_key_init(struct config_cache_key *key, const struct stat *file_stat,
+                           const char *buffer)
+{
+        key->size = (uint64_t)file_stat->st_size;
+        key->mtime_sec = (int64_t)file_stat->st_mtim.tv_sec;
+        key->mtime_nsec = (int64_t)file_stat->st_mtim.tv_nsec;
+        key->hash = hash_wyhash_64(buffer, (size_t)file_stat->st_size, CONFIG_CACHE_HASH_SEED);
+}
+
+static bool cache_key_equal(const struct config_cache_key *one, const struct config_cache_key *two)
+{
+        return one->size == two->size && one->mtime_sec == two->mtime_sec
+                && one->mtime_nsec == two->mtime_nsec && one->hash == two->hash;
+}
+
+static struct config_value *cache_read_value(const struct cache_reader *reader, uint32_t index,
+                                             size_t depth)
+{
+        const struct config_cache_value *cache_value = &reader->values[index];
+        uint64_t data = (uint64_t)cache_value->data;
+
+        switch (cache_value->type) {
+        case BOOLEAN:
+                if (data > 1) {
+                        return NULL;
+                }
+
+                return config_value_create_boolean(data == 1);
+        case NUMBER:
+                return config_value_create_number((intmax_t)cache_value->data);
+        case STRING: {
+                // Strings are stored with their null terminator
+                if (data >= reader->header->string_size
+                    || cache_value->length >= reader->header->string_size - data
+                    || reader->strings[data + cache_value->length] != '\0') {
+                        return NULL;
+                }
+
+                const char *string = intern_string_n(reader->strings + data, cache_value->length);
+
+                if (string == NULL) {
+                        return NULL;
+                }
+
+                return config_value_create_string(string);
+        }
+        case ARRAY: {
+                // Items are always stored after their array, which keeps a
+                // damaged snapshot from looping
+                if (depth >= PARSER_ARRAY_MAX_DEPTH || data <= index
+                    || data > reader->header->value_count
+                    || cache_value->length > reader->header->value_count - data) {
+                        return NULL;
+                }
+
+                struct config_value *value = config_value_create_array(cache_value->length);
+
+                if (value == NULL) {
+                        return NULL;
+                }
+
+                for (uint32_t i = 0; i < cache_value->length; ++i) {
+                        value->data.array->values[i]
+                                = cache_read_value(reader, (uint32_t)data + i, depth + 1);
+
+                        if (value->data.array->values[i] == NULL) {
+                                config_value_destroy(value);
+
+                                return NULL;
+                        }
+                }
+
+                return value;
+        }
+        default:
+                return NULL;
+        }
+}
+
+static enum natwm_error cache_read(const char *buffer, size_t size,
+                                   const struct config_cache_key *key, struct map *config_map)
+{
+        if (size < sizeof(struct config_cache_header)) {
+                return INVALID_INPUT_ERROR;
+        }
+
+        const struct config_cache_header *header = (const struct config_cache_header *)buffer;
+
+        if (memcmp(header->magic, CONFIG_CACHE_MAGIC, sizeof(header->magic)) != 0
+            || header->version != CONFIG_CACHE_VERSION
+            || header->byte_order != CONFIG_CACHE_BYTE_ORDER) {
+                return INVALID_INPUT_ERROR;
+        }
+
+        if (!cache_key_equal(&header->key, key)) {
+                return NOT_FOUND_ERROR;
+        }
+
+        uint64_t expected_size = sizeof(struct config_cache_header)
+                + ((uint64_t)header->entry_count * sizeof(struct config_cache_entry))
+                + ((uint64_t)header->value_count * sizeof(struct config_cache_value))
+                + ((uint64_t)header->displacement_count * sizeof(uint32_t)) + header->string_size;
+
+        if (expected_size != size) {
+                return INVALID_INPUT_ERROR;
+        }
+
+        const char *payload = buffer + sizeof(struct config_cache_header);
+        size_t payload_size = size - sizeof(struct config_cache_header);
+
+        if (hash_wyhash_64(payload, payload_size, CONFIG_CACHE_HASH_SEED) != header->payload_hash) {
+                return INVALID_INPUT_ERROR;
+        }
+
+        struct cache_reader reader = {
+                .header = header,
+                .entries = (const struct config_cache_entry *)payload,
+                .values = NULL,
+                .displacements = NULL,
+                .strings = NULL,
+        };
+
+        reader.values = (const struct config_cache_value *)(reader.entries + header->entry_count);
+        reader.displacements = (const uint32_t *)(reader.values + header->value_count);
+        reader.strings = (const char *)(reader.displacements + header->displacement_count);
+
+        // Keys must hash the same way they did when the snapshot was saved
+        if (map_set_hash_seed(config_map, header->map_seed) != 0) {
+                return INVALID_INPUT_ERROR;
+        }
+
+        for (uint32_t i = 0; i < header->entry_count; ++i) {
+                const struct config_cache_entry *entry = &reader.entries[i];
+
+                if (entry->value_index >= header->value_count
+                    || entry->key_offset >= header->string_size
+                    || entry->key_length >= header->string_size - entry->key_offset
+                    || reader.strings[entry->key_offset + entry->key_length] != '\0') {
+                        return INVALID_INPUT_ERROR;
+                }
+
+                const char *config_key
+                        = intern_string_n(reader.strings + entry->key_offset, entry->key_length);
+                struct config_value *value = cache_read_value(&reader, entry->value_index, 0);
+
+                if (config_key == NULL || value == NULL) {
+                        if (value != NULL) {
+                                config_value_destroy(value);
+                        }
+
+                        return INVALID_INPUT_ERROR;
+                }
+
+                if (map_insert(config_map, config_key, value) != NO_ERROR) {
+                        config_value_destroy(value);
+
+                        return INVALID_INPUT_ERROR;
+                }
+        }
+
+        // With the same keys and seed a map which couldn't be frozen when it
+        // was saved can't be frozen now either, so don't try again
+        if (header->displacement_count == 0) {
+                return NO_ERROR;
+        }
+
+        if (map_freeze_with_layout(config_map,
+                                   header->map_salt,
+                                   reader.displacements,
+                                   header->displacement_count)
+            != NO_ERROR) {
+                LOG_DEBUG(natwm_logger, "Configuration cache has an invalid map layout");
+
+                // Still usable, just with slower lookups if this fails
+                map_freeze(config_map);
+        }
+
+        return NO_ERROR;
+}
+
+/**
+ * Load the snapshot at path into config_map
+ *
+ * NOT_FOUND_ERROR is returned when there is no snapshot for key, and
+ * INVALID_INPUT_ERROR when the snapshot is damaged. In both cases the
+ * configuration must be parsed instead. config_map may hold some of the
+ * config items when loading fails
+ *
+ * config_map must be empty. Once loaded it is frozen, unless the map the
+ * snapshot was saved from couldn't be frozen either
+ */
+enum natwm_error config_cache_load(const char *path, const struct config_cache_key *key,
+                                   struct map *config_map)
+{
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0) {
+                return NOT_FOUND_ERROR;
+        }
+
+        struct stat file_stat;
+
+        if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)
+            || (size_t)file_stat.st_size < sizeof(struct config_cache_header)) {
+                close(fd);
+
+                return INVALID_INPUT_ERROR;
+        }
+
+        // Snapshots are only ever replaced with a rename, never rewritten in
+        // place, so the mapped file can't be truncated underneath us
+        size_t size = (size_t)file_stat.st_size;
+        void *buffer = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        close(fd);
+
+        if (buffer == MAP_FAILED) {
+                return INVALID_INPUT_ERROR;
+        }
+
+        enum natwm_error err = cache_read(buffer, size, key, config_map);
+
+        munmap(buffer, size);
+
+        return err;
+}
+
+static enum natwm_error cache_writer_reserve_values(struct cache_writer *writer, size_t count)
+{
+        struct config_cache_value placeholder = {0};
+
+        for (size_t i = 0; i < count; ++i) {
+                enum natwm_error err = config_cache_value_vector_push(writer->values, placeholder);
+
+                if (err != NO_ERROR) {
+                        return err;
+                }
+        }
+
+        return NO_ERROR;
+}
+
+// Append an interned string, along with it's null terminator
+static enum natwm_error cache_writer_add_string(struct cache_writer *writer, const char *string,
+                                                uint32_t *offset, uint32_t *length)
+{
+        size_t string_length = intern_get_length(string);
+
+        if (writer->strings.length + string_length >= UINT32_MAX) {
+                return INVALID_INPUT_ERROR;
+        }
+
+        *offset = (uint32_t)writer->strings.length;
+        *length = (uint32_t)string_length;
+
+        return string_builder_append_n(&writer->strings, string, string_length + 1);
+}
+
+static enum natwm_error cache_writer_add_value(struct cache_writer *writer,
+                                               const struct config_value *value, size_t index)
+{
+        enum natwm_error err = NO_ERROR;
+        struct config_cache_value cache_value = {
+                .type = (uint32_t)value->type,
+                .length = 0,
+                .data = 0,
+        };
+
+        switch (value->type) {
+        case BOOLEAN:
+                cache_value.data = value->data.boolean ? 1 : 0;
+                break;
+        case NUMBER:
+                cache_value.data = (int64_t)value->data.number;
+                break;
+        case STRING: {
+                uint32_t offset = 0;
+
+                err = cache_writer_add_string(
+                        writer, value->data.string, &offset, &cache_value.length);
+                cache_value.data = offset;
+
+                break;
+        }
+        case ARRAY: {
+                const struct config_array *array = value->data.array;
+                size_t first = writer->values->length;
+
+                if (first + array->length >= UINT32_MAX) {
+                        return INVALID_INPUT_ERROR;
+                }
+
+                cache_value.length = (uint32_t)array->length;
+                cache_value.data = (int64_t)first;
+
+                err = cache_writer_reserve_values(writer, array->length);
+
+                for (size_t i = 0; i < array->length && err == NO_ERROR; ++i) {
+                        err = cache_writer_add_value(writer, array->values[i], first + i);
+                }
+
+                break;
+        }
+        }
+
+        if (err != NO_ERROR) {
+                return err;
+        }
+
+        writer->values->items[index] = cache_value;
+
+        return NO_ERROR;
+}
+
+static enum natwm_error cache_writer_add_entries(struct cache_writer *writer,
+                                                 const struct map *config_map)
+{
+        for (uint32_t i = 0; i < config_map->length; ++i) {
+                const struct map_entry *entry = &config_map->entries[i];
+
+                if (entry->key == NULL) {
+                        continue;
+                }
+
+                struct config_cache_entry cache_entry = {
+                        .value_index = (uint32_t)writer->values->length,
+                        .reserved = 0,
+                };
+                enum natwm_error err = cache_writer_add_string(
+                        writer, entry->key, &cache_entry.key_offset, &cache_entry.key_length);
+
+                if (err != NO_ERROR || (err = cache_writer_reserve_values(writer, 1)) != NO_ERROR
+                    || (err = cache_writer_add_value(
+                                writer, entry->value, cache_entry.value_index))
+                            != NO_ERROR
+                    || (err = config_cache_entry_vector_push(writer->entries, cache_entry))
+                            != NO_ERROR) {
+                        return err;
+                }
+        }
+
+        if (writer->values->length >= UINT32_MAX) {
+                return INVALID_INPUT_ERROR;
+        }
+
+        return NO_ERROR;
+}
+
+// Lay the snapshot out in a single buffer, which must be free'd by the caller
+static char *cache_writer_finish(const struct cache_writer *writer,
+                                 const struct config_cache_key *key,
+                                 const struct map *config_map, size_t *size)
+{
+        const struct map_frozen *frozen = config_map->frozen;
+        uint32_t displacement_count = (frozen == NULL) ? 0 : frozen->bucket_count;
+        size_t entries_size = writer->entries->length * sizeof(struct config_cache_entry);
+        size_t values_size = writer->values->length * sizeof(struct config_cache_value);
+        size_t displacements_size = displacement_count * sizeof(uint32_t);
+        size_t payload_size
+                = entries_size + values_size + displacements_size + writer->strings.length;
+        char *buffer = malloc(sizeof(struct config_cache_header) + payload_size);
+
+        if (buffer == NULL) {
+                return NULL;
+        }
+
+        char *payload = buffer + sizeof(struct config_cache_header);
+        char *position = payload;
+
+        if (entries_size > 0) {
+                memcpy(position, writer->entries->items, entries_size);
+        }
+
+        position += entries_size;
+
+        if (values_size > 0) {
+                memcpy(position, writer->values->items, values_size);
+        }
+
+        position += values_size;
+
+        if (displacements_size > 0) {
+                memcpy(position, frozen->displacements, displacements_size);
+        }
+
+        position += displacements_size;
+
+        if (writer->strings.length > 0) {
+                memcpy(position, writer->strings.buffer, writer->strings.length);
+        }
+
+        struct config_cache_header header = {
+                .version = CONFIG_CACHE_VERSION,
+                .byte_order = CONFIG_CACHE_BYTE_ORDER,
+                .key = *key,
+                .payload_hash = hash_wyhash_64(payload, payload_size, CONFIG_CACHE_HASH_SEED),
+                .map_seed = config_map->seed,
+                .map_salt = (frozen == NULL) ? 0 : frozen->salt,
+                .displacement_count = displacement_count,
+                .entry_count = (uint32_t)writer->entries->length,
+                .value_count = (uint32_t)writer->values->length,
+                .string_size = (uint32_t)writer->strings.length,
+                .reserved = 0,
+        };
+
+        memcpy(header.magic, CONFIG_CACHE_MAGIC, sizeof(header.magic));
+        memcpy(buffer, &header, sizeof(header));
+
+        *size = sizeof(struct config_cache_header) + payload_size;
+
+        return buffer;
+}
+
+static enum natwm_error write_file(const char *path, const char *buffer, size_t size)
+{
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+        if (fd < 0) {
+                return GENERIC_ERROR;
+        }
+
+        while (size > 0) {
+                ssize_t written = write(fd, buffer, size);
+
+                if (written < 0) {
+                        if (errno == EINTR) {
+                                continue;
+                        }
+
+                        close(fd);
+
+                        return GENERIC_ERROR;
+                }
+
+                buffer += written;
+                size -= (size_t)written;
+        }
+
+        if (close(fd) != 0) {
+                return GENERIC_ERROR;
+        }
+
+        return NO_ERROR;
+}
+
+/**
+ * Write a snapshot of config_map to path
+ *
+ * The snapshot is written to a temporary file which then replaces the old
+ * one, so a reader never sees a partially written snapshot
+ */
+enum natwm_error config_cache_save(const char *path, const struct config_cache_key *key,
+                                   const struct map *config_map)
+{
+        enum natwm_error err = MEMORY_ALLOCATION_ERROR;
+        struct cache_writer writer = {
+                .entries = config_cache_entry_vector_create(),
+                .values = config_cache_value_vector_create(),
+        };
+        char *buffer = NULL;
+        char *temporary_path = NULL;
+
+        string_builder_init(&writer.strings);
+
+        if (writer.entries == NULL || writer.values == NULL) {
+                goto cleanup;
+        }
+
+        if ((err = cache_writer_add_entries(&writer, config_map)) != NO_ERROR) {
+                goto cleanup;
+        }
+
+        size_t size = 0;
+
+        buffer = cache_writer_finish(&writer, key, config_map, &size);
+        temporary_path = append_suffix(path, ".tmp");
+
+        if (buffer == NULL || temporary_path == NULL) {
+                err = MEMORY_ALLOCATION_ERROR;
+
+                goto cleanup;
+        }
+
+        if ((err = write_file(temporary_path, buffer, size)) != NO_ERROR) {
+                unlink(temporary_path);
+
+                goto cleanup;
+        }
+
+        if (rename(temporary_path, path) != 0) {
+                unlink(temporary_path);
+
+                err = GENERIC_ERROR;
+        }
+
+cleanup:
+        if (writer.entries != NULL) {
+                config_cache_entry_vector_destroy(writer.entries);
+        }
+
+        if (writer.values != NULL) {
+                config_cache_value_vector_destroy(writer.values);
+        }
+
+        string_builder_destroy(&writer.strings);
+        free(buffer);
+        free(temporary_path);
+
+        return err;
+}
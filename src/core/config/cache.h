@@ -0,0 +1,84 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include <common/error.h>
+#include <common/map.h>
+
+/**
+ * Binary snapshot of a parsed configuration
+ *
+ * After a configuration file has been parsed the resolved values are written
+ * next to it. Later loads of the same file read the snapshot instead of
+ * parsing, as long as the size, modification time and contents of the file
+ * still match the ones the snapshot was made from. Variables have already
+ * been resolved, so loading a snapshot only copies values out of it
+ *
+ * The perfect hash of the frozen configuration map is saved as well, along
+ * with the seed the keys were hashed with. Loading rebuilds the same frozen
+ * map without searching for a new perfect hash
+ *
+ * Every reference in the snapshot is an index or offset, so it can be mapped
+ * at any address. The layout is
+ *
+ * header | entries[entry_count] | values[value_count]
+ *        | displacements[displacement_count] | strings[string_size]
+ *
+ * The items of an array are stored next to each other, after the array
+ */
+
+#define CONFIG_CACHE_MAGIC "natwmcfg"
+#define CONFIG_CACHE_VERSION 1
+#define CONFIG_CACHE_BYTE_ORDER 0x01020304U
+#define CONFIG_CACHE_SUFFIX ".cache"
+#define CONFIG_CACHE_HASH_SEED 0x6e6174776d636667ULL
+
+// Identifies the configuration file a snapshot was made from
+struct config_cache_key {
+        uint64_t size;
+        int64_t mtime_sec;
+        int64_t mtime_nsec;
+        uint64_t hash;
+};
+
+struct config_cache_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order; // Snapshots are only read on the same architecture
+        struct config_cache_key key;
+        uint64_t payload_hash; // Hash of everything after the header
+        uint64_t map_seed;
+        uint32_t map_salt;
+        uint32_t displacement_count; // 0 when the map wasn't frozen
+        uint32_t entry_count;
+        uint32_t value_count;
+        uint32_t string_size;
+        uint32_t reserved;
+};
+
+// A top level config item
+struct config_cache_entry {
+        uint32_t key_offset;
+        uint32_t key_length;
+        uint32_t value_index;
+        uint32_t reserved;
+};
+
+struct config_cache_value {
+        uint32_t type;
+        uint32_t length; // Length of a string or an array
+        int64_t data; // Number, boolean, string offset or index of the first array item
+};
+
+char *config_cache_path(const char *config_path);
+void config_cache_key_init(struct config_cache_key *key, const struct stat *file_stat,
+                           const char *buffer);
+enum natwm_error config_cache_load(const char *path, const struct config_cache_key *key,
+                                   struct map *config_map);
+enum natwm_error config_cache_save(const char *path, const struct config_cache_key *key,
+                                   const struct map *config_map);
@@ -3,18 +3,47 @@
 // Refer to the license.txt file included in the root of the project
 
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <pwd.h>
+#include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <common/constants.h>
+#include <common/intern.h>
 #include <common/logger.h>
+#include <common/scan.h>
 #include <common/string.h>
 #include <common/util.h>
 
+#include "cache.h"
 #include "config.h"
 #include "parser.h"
 
+/**
+ * State for parsing a configuration which is read in chunks
+ *
+ * Only complete statements are handed to the parser, the rest of the buffer
+ * is kept until the statement has been read
+ */
+struct config_stream {
+        char *buffer;
+        size_t capacity;
+        size_t length;
+        // Bytes of the buffer which have been scanned for statement ends
+        size_t scanned;
+        // The end of the last complete statement in the buffer
+        size_t statement_end;
+        size_t array_depth;
+        bool in_string;
+        bool in_comment;
+        // New lines before the start of the buffer, for error locations
+        size_t line_count;
+};
+
 static void hashmap_free_callback(void *data)
 {
         struct config_value *value = (struct config_value *)data;
@@ -25,25 +54,22 @@ static void hashmap_free_callback(void *data)
 /**
  * Handle the creation of a config item in the configuration
  *
- * When this function is called the parser position will be pointing to the
- * start of the configuration item in the form of
+ * When this function is called the first token of the configuration item in
+ * the form of
  *
  * config_item = <value>
- * ^
- * |
- * *-(parser->pos)
  *
- * Once the config item has been saved to the parser, the parser position will
- * be updated to point to the '\n' at the end of the current line, which will
- * allow for the next line to be consumed
+ * has just been read. Once the config item has been saved the rest of the
+ * line has been consumed, which will allow for the next line to be read
  */
-static enum natwm_error config_item_create(struct parser *parser, struct map *config_map)
+static enum natwm_error config_item_create(struct parser *parser, struct token token,
+                                           struct map *config_map)
 {
         enum natwm_error err = GENERIC_ERROR;
-        char *key = NULL;
+        const char *key = NULL;
         struct config_value *item = NULL;
 
-        err = parser_read_item(parser, &key, &item);
+        err = parser_read_item(parser, token, &key, &item);
 
         if (err != NO_ERROR) {
                 return err;
@@ -52,8 +78,6 @@ static enum natwm_error config_item_create(struct parser *parser, struct map *co
         err = map_insert(config_map, key, item);
 
         if (err != NO_ERROR) {
-                free(key);
-
                 config_value_destroy(item);
 
                 return err;
@@ -63,258 +87,649 @@ static enum natwm_error config_item_create(struct parser *parser, struct map *co
 }
 
 /**
- * Try to find the configuration file
+ * Try to find the configuration directory
  *
  * Uses a couple common locations and falls back to searching the .confg
- * directory in the users HOME directory
+ * directory in the users HOME directory. The directory is appended to the
+ * supplied builder
  */
-static char *get_config_path(void)
+static enum natwm_error get_config_path(struct string_builder *config_path)
 {
         const char *base_directory = NULL;
-        char *config_path = NULL;
 
         if ((base_directory = getenv("XDG_CONFIG_HOME")) != NULL) {
-                config_path = string_init(base_directory);
-
-                return config_path;
+                return string_builder_append(config_path, base_directory);
         }
 
-        if ((base_directory = getenv("HOME")) != NULL) {
-                config_path = string_init(base_directory);
-                string_append(&config_path, "/.config/");
+        if ((base_directory = getenv("HOME")) == NULL) {
+                // If we still haven't found anything use passwd
+                struct passwd *db = getpwuid(getuid());
+
+                if (db == NULL) {
+                        return NOT_FOUND_ERROR;
+                }
 
-                return config_path;
+                base_directory = db->pw_dir;
         }
 
-        // If we still haven't found anything use passwd
-        struct passwd *db = getpwuid(getuid());
+        enum natwm_error err = string_builder_append(config_path, base_directory);
 
-        if (db == NULL) {
-                return NULL;
+        if (err != NO_ERROR) {
+                return err;
         }
 
-        config_path = string_init(db->pw_dir);
-        string_append(&config_path, "/.config/");
-
-        return config_path;
+        return string_builder_append(config_path, "/.config/");
 }
 
 /**
- * Open a configuration file
+ * Find the path of the configuration file
  *
  * This can either be supplied by the caller (through the first
  * argument) or we can use the default location.
  *
- * If neither open then we return null
+ * If neither exist then we return null. The returned path must be free'd by
+ * the caller
  */
-static FILE *open_config_file(const char *path)
+static char *find_config_file(const char *path)
 {
-        FILE *file = NULL;
-
         // If the user supplies a path use that one
         if (path != NULL) {
-                file = fopen(path, "r");
-
-                if (file == NULL) {
+                if (!path_exists(path)) {
                         LOG_ERROR(natwm_logger, "Failed to find configuration file at %s", path);
 
                         return NULL;
                 }
 
-                return file;
+                return string_init(path);
         }
 
-        char *config_path = get_config_path();
+        struct string_builder builder;
 
-        if (config_path == NULL) {
+        string_builder_init(&builder);
+
+        if (get_config_path(&builder) != NO_ERROR) {
                 LOG_ERROR(natwm_logger, "Failed to find HOME directory");
 
+                string_builder_destroy(&builder);
+
                 return NULL;
         }
 
-        string_append(&config_path, NATWM_CONFIG_FILE);
+        if (string_builder_append(&builder, NATWM_CONFIG_FILE) != NO_ERROR) {
+                string_builder_destroy(&builder);
+
+                return NULL;
+        }
+
+        char *config_path = string_builder_finish(&builder, NULL);
+
+        if (config_path == NULL) {
+                return NULL;
+        }
 
         // Check if the file exists
         if (!path_exists(config_path)) {
                 LOG_ERROR(natwm_logger, "Failed to find configuration file at %s", config_path);
 
-                goto release_config_path_and_error;
+                free(config_path);
+
+                return NULL;
         }
 
-        file = fopen(config_path, "r");
+        return config_path;
+}
 
-        if (file == NULL) {
-                LOG_ERROR(natwm_logger, "Failed to open %s", config_path);
+static struct map *config_map_create(void)
+{
+        struct map *map = map_init();
 
-                goto release_config_path_and_error;
+        if (map == NULL) {
+                LOG_ERROR(natwm_logger, "Failed initializing configuration map");
+
+                return NULL;
         }
 
-        free(config_path);
+        // Setup hash map. Keys are interned, so they are hashed from their
+        // stored hash and compared by pointer
+        map_set_entry_free_function(map, hashmap_free_callback);
+        map_set_hash_function(map, intern_map_hash);
+        map_set_key_size_function(map, intern_map_key_size);
+        map_set_key_compare_function(map, intern_map_key_compare);
+        map_set_setting_flag(map, MAP_FLAG_COLLECT_STATS);
 
-        return file;
+        return map;
+}
 
-release_config_path_and_error:
-        free(config_path);
+/**
+ * Parse every config item in the parser buffer into map
+ */
+static enum natwm_error config_parse_items(struct parser *parser, struct map *map)
+{
+        enum natwm_error err = GENERIC_ERROR;
 
-        return NULL;
+        // Spaces and comments never reach the parser, so every line starts
+        // with a variable, a key or is blank
+        struct token token;
+
+        while ((token = parser_next_token(parser)).kind != TOKEN_END) {
+                switch (token.kind) {
+                case TOKEN_NEW_LINE:
+                        break;
+                case TOKEN_VARIABLE:
+                        if ((err = parser_create_variable(parser, token)) != NO_ERROR) {
+                                return err;
+                        }
+
+                        break;
+                default:
+                        if ((err = config_item_create(parser, token, map)) != NO_ERROR) {
+                                return err;
+                        }
+
+                        break;
+                }
+        }
+
+        return NO_ERROR;
+}
+
+static void config_map_finish(struct map *map)
+{
+        // Once frozen the map is rebuilt into a perfect hash, so this is the
+        // last point where the probe statistics describe the parsed map
+        struct map_stats stats;
+
+        map_get_stats(map, &stats);
+        log_map_stats("Config map", &stats);
+
+        // The configuration never changes once it has been parsed. If the
+        // map can't be frozen it is still usable, just with slower lookups
+        if (map_freeze(map) != NO_ERROR) {
+                LOG_WARNING(natwm_logger, "Failed to freeze configuration map");
+        }
+}
+
+static struct map *config_parse(struct parser *parser)
+{
+        struct map *map = config_map_create();
+
+        if (map == NULL) {
+                return NULL;
+        }
+
+        if (config_parse_items(parser, map) != NO_ERROR) {
+                LOG_ERROR(natwm_logger, "Error reading configuration file!");
+
+                map_destroy(map);
+
+                return NULL;
+        }
+
+        config_map_finish(map);
+
+        return map;
 }
 
 /**
- * Takes an uninitalized string and places the contents of a file into
- * it
+ * Initialize the configuration file using a string
  *
- * The buffer is initialized with file_size + 1 bytes and must be freed
- * by the caller
+ * Takes a string buffer and uses it to return the key value pairs
+ * of the config
+ */
+struct map *config_read_string(const char *string, size_t size)
+{
+        struct parser *parser = parser_create(string, size);
+
+        if (parser == NULL) {
+                return NULL;
+        }
+
+        struct map *map = config_parse(parser);
+
+        parser_destroy(parser);
+
+        if (map == NULL) {
+                return NULL;
+        }
+
+        return map;
+}
+
+/**
+ * Scan the bytes read since the last scan for the end of a statement
  *
- * file_size bytes are read from file and placed in the buffer. The
- * buffer is then appended with a null terminator
+ * A statement ends at a new line which isn't inside of an array. Strings and
+ * comments end at the end of their line, so brackets inside of them are
+ * skipped
  */
-static int read_file_into_buffer(FILE *file, char **buffer, size_t file_size)
+static void config_stream_scan(struct config_stream *stream)
 {
-        *buffer = malloc(file_size + 1);
+        while (stream->scanned < stream->length) {
+                const char *block = stream->buffer + stream->scanned;
+                size_t length = MIN(SCAN_BLOCK_SIZE, stream->length - stream->scanned);
+                struct scan_masks masks;
+
+                scan_block(block, length, &masks);
+
+                uint32_t interesting = masks.new_line | masks.quote | masks.comment
+                        | masks.array_start | masks.array_end;
+
+                while (interesting != 0) {
+                        uint32_t index = scan_mask_first_index(interesting);
+
+                        interesting &= interesting - 1;
+
+                        if (block[index] == '\n') {
+                                stream->in_string = false;
+                                stream->in_comment = false;
+
+                                if (stream->array_depth == 0) {
+                                        stream->statement_end = stream->scanned + index + 1;
+                                }
+
+                                continue;
+                        }
+
+                        if (stream->in_comment) {
+                                continue;
+                        }
+
+                        if (stream->in_string) {
+                                stream->in_string = (block[index] != '"');
+
+                                continue;
+                        }
+
+                        switch (block[index]) {
+                        case '"':
+                                stream->in_string = true;
+                                break;
+                        case '#':
+                                stream->in_comment = true;
+                                break;
+                        case '[':
+                                ++stream->array_depth;
+                                break;
+                        default:
+                                // A stray ']' is left for the parser to
+                                // report
+                                if (stream->array_depth > 0) {
+                                        --stream->array_depth;
+                                }
+
+                                break;
+                        }
+                }
 
-        if (*buffer == NULL) {
-                return -1;
+                stream->scanned += length;
         }
+}
 
-        size_t bytes_read = fread(*buffer, 1, file_size, file);
+/**
+ * Parse the first size bytes of the stream buffer and drop them
+ */
+static enum natwm_error config_stream_parse(struct config_stream *stream, struct parser *parser,
+                                            struct map *map, size_t size)
+{
+        parser_set_buffer(parser, stream->buffer, size, stream->line_count);
 
-        if (bytes_read != file_size) {
-                // Read the wrong amount of bytes
-                free(*buffer);
+        enum natwm_error err = config_parse_items(parser, map);
 
-                return -1;
+        if (err != NO_ERROR) {
+                return err;
         }
 
-        (*buffer)[file_size] = '\0';
+        stream->line_count += scan_count_char(stream->buffer, size, '\n');
+
+        memmove(stream->buffer, stream->buffer + size, stream->length - size);
+
+        stream->length -= size;
+        stream->scanned -= size;
+        stream->statement_end = 0;
 
-        return 0;
+        return NO_ERROR;
 }
 
-static struct map *config_parse(struct parser *parser)
+/**
+ * Read and parse a configuration which isn't a regular file, like a pipe
+ *
+ * The configuration is read chunk_size bytes at a time and every complete
+ * statement is parsed as soon as it has been read. Only the statement being
+ * read is kept, so memory use is bounded by the longest statement rather
+ * than the size of the configuration
+ */
+struct map *config_read_stream(int fd, size_t chunk_size)
 {
-        struct map *map = map_init();
+        struct config_stream stream = {
+                .buffer = NULL,
+                .capacity = MAX(chunk_size, 1),
+                .length = 0,
+                .scanned = 0,
+                .statement_end = 0,
+                .array_depth = 0,
+                .in_string = false,
+                .in_comment = false,
+                .line_count = 0,
+        };
+        struct parser *parser = NULL;
+        struct map *map = config_map_create();
 
         if (map == NULL) {
-                LOG_ERROR(natwm_logger, "Failed initializing configuration map");
-
                 return NULL;
         }
 
-        // Setup hash map
-        map_set_entry_free_function(map, hashmap_free_callback);
-        map_set_setting_flag(map, MAP_FLAG_FREE_ENTRY_KEY);
+        stream.buffer = malloc(stream.capacity);
 
-        char c = '\0';
-        while ((c = parser->buffer[parser->pos]) != '\0') {
-                switch (char_to_token(c)) {
-                case COMMENT_START:
-                        parser_consume_line(parser);
+        if (stream.buffer == NULL || (parser = parser_create(stream.buffer, 0)) == NULL) {
+                goto handle_error;
+        }
 
-                        break;
-                case VARIABLE_START:
-                        if (parser_create_variable(parser) != NO_ERROR) {
+        while (true) {
+                // Only a statement longer than the buffer fills it
+                if (stream.length == stream.capacity) {
+                        char *buffer = realloc(stream.buffer, stream.capacity * 2);
+
+                        if (buffer == NULL) {
                                 goto handle_error;
                         }
 
-                        break;
-                case ALPHA_CHAR:
-                        if (config_item_create(parser, map) != NO_ERROR) {
-                                goto handle_error;
+                        stream.buffer = buffer;
+                        stream.capacity *= 2;
+                }
+
+                ssize_t bytes_read
+                        = read(fd, stream.buffer + stream.length, stream.capacity - stream.length);
+
+                if (bytes_read < 0) {
+                        if (errno == EINTR) {
+                                continue;
                         }
 
-                        break;
-                default:
+                        LOG_ERROR(natwm_logger,
+                                  "Failed to read configuration: %s",
+                                  strerror(errno));
+
+                        goto handle_error;
+                }
+
+                if (bytes_read == 0) {
                         break;
                 }
 
-                parser_increment(parser);
+                stream.length += (size_t)bytes_read;
+
+                config_stream_scan(&stream);
+
+                if (stream.statement_end > 0
+                    && config_stream_parse(&stream, parser, map, stream.statement_end)
+                            != NO_ERROR) {
+                        LOG_ERROR(natwm_logger, "Error reading configuration file!");
+
+                        goto handle_error;
+                }
+        }
+
+        // Whatever is left is the last statement, which doesn't need to end
+        // with a new line
+        if (config_stream_parse(&stream, parser, map, stream.length) != NO_ERROR) {
+                LOG_ERROR(natwm_logger, "Error reading configuration file!");
+
+                goto handle_error;
         }
 
+        parser_destroy(parser);
+        free(stream.buffer);
+
+        config_map_finish(map);
+
         return map;
 
 handle_error:
-        LOG_ERROR(natwm_logger, "Error reading configuration file!");
+        if (parser != NULL) {
+                parser_destroy(parser);
+        }
 
+        free(stream.buffer);
         map_destroy(map);
 
         return NULL;
 }
 
 /**
- * Initialize the configuration file using a string
+ * Read up to size bytes of a regular file into a heap buffer
  *
- * Takes a string buffer and uses it to return the key value pairs
- * of the config
+ * The file is read rather than mapped. An editor which rewrites the file in
+ * place truncates it first, and touching a mapped page past the new end of
+ * the file raises SIGBUS. A read only comes up short, so length is set to the
+ * number of bytes which were actually read
  */
-struct map *config_read_string(const char *string, size_t size)
+static char *config_read_file_buffer(int fd, size_t size, size_t *length)
 {
-        struct parser *parser = parser_create(string, size);
+        char *buffer = malloc(size);
+
+        if (buffer == NULL) {
+                LOG_ERROR(natwm_logger, "Failed to allocate configuration buffer");
 
-        if (parser == NULL) {
                 return NULL;
         }
 
-        struct map *map = config_parse(parser);
+        size_t total = 0;
 
-        parser_destroy(parser);
+        while (total < size) {
+                ssize_t bytes_read = read(fd, buffer + total, size - total);
 
-        if (map == NULL) {
-                return NULL;
+                if (bytes_read < 0) {
+                        if (errno == EINTR) {
+                                continue;
+                        }
+
+                        LOG_ERROR(natwm_logger,
+                                  "Failed to read configuration: %s",
+                                  strerror(errno));
+
+                        free(buffer);
+
+                        return NULL;
+                }
+
+                if (bytes_read == 0) {
+                        break;
+                }
+
+                total += (size_t)bytes_read;
         }
 
-        return map;
+        *length = total;
+
+        return buffer;
 }
 
 /**
- * Initialize the configuration file.
+ * Read the configuration from an open file
  *
- * Takes a path to a configuration file, opens it, reads the contents
- * into a buffer and uses it to return the key value pairs of the config
- * file
+ * Regular files are read whole and parsed in place, since nothing in the
+ * parsed configuration points into the buffer. Anything else (pipes,
+ * terminals, /dev/stdin) is streamed
  */
-struct map *config_initialize_path(const char *path)
+struct map *config_read_fd(int fd)
 {
-        FILE *file = open_config_file(path);
+        struct stat file_stat;
+
+        if (fstat(fd, &file_stat) != 0) {
+                LOG_ERROR(natwm_logger, "Failed to stat configuration: %s", strerror(errno));
 
-        if (file == NULL) {
                 return NULL;
         }
 
-        size_t file_size = 0;
+        if (!S_ISREG(file_stat.st_mode)) {
+                return config_read_stream(fd, CONFIG_STREAM_CHUNK_SIZE);
+        }
+
+        size_t file_size = (size_t)file_stat.st_size;
 
-        if (get_file_size(file, &file_size) != NO_ERROR) {
-                goto close_file_and_error;
+        if (file_size == 0) {
+                return config_read_string("", 0);
         }
 
-        char *file_buffer = NULL;
+        size_t length = 0;
+        char *file_buffer = config_read_file_buffer(fd, file_size, &length);
 
-        if (read_file_into_buffer(file, &file_buffer, file_size) != 0) {
-                goto close_file_and_error;
+        if (file_buffer == NULL) {
+                return NULL;
         }
 
-        struct map *config = config_read_string(file_buffer, file_size);
+        struct map *config = config_read_string(file_buffer, length);
+
+        free(file_buffer);
+
+        return config;
+}
+
+/**
+ * Read a regular configuration file, using it's snapshot when there is one
+ *
+ * The file is read so it can be hashed and checked against the snapshot. It
+ * is only parsed when there is no snapshot for the current contents, after
+ * which a new snapshot is saved for the next load
+ *
+ * A file which comes up short was truncated while it was being read. What
+ * was read is parsed without touching the snapshot, since it doesn't match
+ * the size it was stat'ed with
+ */
+static struct map *config_read_file_cached(int fd, const char *config_path,
+                                           const struct stat *file_stat)
+{
+        size_t file_size = (size_t)file_stat->st_size;
+        size_t length = 0;
+        char *file_buffer = config_read_file_buffer(fd, file_size, &length);
+
+        if (file_buffer == NULL) {
+                return NULL;
+        }
+
+        if (length != file_size) {
+                LOG_DEBUG(natwm_logger, "Configuration changed while it was being read");
+
+                struct map *config = config_read_string(file_buffer, length);
 
-        if (config == NULL) {
                 free(file_buffer);
 
-                goto close_file_and_error;
+                return config;
+        }
+
+        struct config_cache_key key;
+        char *cache_path = config_cache_path(config_path);
+        struct map *config = NULL;
+
+        config_cache_key_init(&key, file_stat, file_buffer);
+
+        if (cache_path != NULL && (config = config_map_create()) != NULL) {
+                enum natwm_error err = config_cache_load(cache_path, &key, config);
+
+                // The cache freezes the map itself
+                if (err == NO_ERROR) {
+                        goto done;
+                }
+
+                if (err == INVALID_INPUT_ERROR) {
+                        LOG_WARNING(natwm_logger,
+                                    "Ignoring damaged configuration cache %s",
+                                    cache_path);
+                }
+
+                map_destroy(config);
+        }
+
+        config = config_read_string(file_buffer, file_size);
+
+        if (config != NULL && cache_path != NULL
+            && config_cache_save(cache_path, &key, config) != NO_ERROR) {
+                // The configuration is still usable, it will be parsed again
+                // on the next load
+                LOG_DEBUG(natwm_logger, "Failed to save configuration cache %s", cache_path);
         }
 
+done:
+        free(cache_path);
         free(file_buffer);
-        fclose(file);
 
         return config;
+}
 
-close_file_and_error:
-        fclose(file);
+/**
+ * Initialize the configuration file.
+ *
+ * Takes a path to a configuration file, opens it and uses it to return the
+ * key value pairs of the config file
+ */
+struct map *config_initialize_path(const char *path)
+{
+        char *config_path = find_config_file(path);
 
-        return NULL;
+        if (config_path == NULL) {
+                return NULL;
+        }
+
+        int fd = open(config_path, O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0) {
+                LOG_ERROR(natwm_logger, "Failed to open %s", config_path);
+
+                free(config_path);
+
+                return NULL;
+        }
+
+        struct stat file_stat;
+        struct map *config = NULL;
+
+        if (fstat(fd, &file_stat) == 0 && S_ISREG(file_stat.st_mode) && file_stat.st_size > 0) {
+                config = config_read_file_cached(fd, config_path, &file_stat);
+        } else {
+                // Pipes and empty files aren't worth caching
+                config = config_read_fd(fd);
+        }
+
+        close(fd);
+        free(config_path);
+
+        return config;
 }
 
 struct config_value *config_find(const struct map *config_map, const char *key)
 {
-        struct map_entry *entry = map_get(config_map, key);
+        if (key == NULL) {
+                return NULL;
+        }
+
+        // Every key in the configuration has been interned, so a key which
+        // hasn't been can't be in the map
+        const char *interned_key = intern_find(key);
+
+        if (interned_key == NULL) {
+                return NULL;
+        }
+
+        struct map_key_handle handle;
+
+        if (map_key_handle_init(config_map, interned_key, &handle) != NO_ERROR) {
+                return NULL;
+        }
+
+        return config_find_prehashed(config_map, &handle);
+}
+
+/**
+ * Find a config value using a key handle
+ *
+ * Callers which look up the same key repeatedly can create the handle once
+ * and skip re-hashing the key on every lookup. The handle must be created
+ * from an interned key
+ */
+struct config_value *config_find_prehashed(const struct map *config_map,
+                                           const struct map_key_handle *handle)
+{
+        struct map_entry *entry = map_get_prehashed(config_map, handle);
 
         if (entry == NULL) {
                 return NULL;
@@ -323,11 +738,82 @@ struct config_value *config_find(const struct map *config_map, const char *key)
         return (struct config_value *)entry->value;
 }
 
-enum natwm_error config_find_array(const struct map *config_map, const char *key,
-                                   const struct config_array **result)
+// Get the interned name of a key, interning it on first use. Every thread
+// interning the same name gets the same pointer, so racing stores agree
+static const char *config_key_intern(struct config_key *key)
 {
-        struct config_value *value = config_find(config_map, key);
+        const char *interned = __atomic_load_n(&key->interned, __ATOMIC_ACQUIRE);
+
+        if (interned != NULL) {
+                return interned;
+        }
 
+        interned = intern_string(key->name);
+
+        if (interned != NULL) {
+                __atomic_store_n(&key->interned, interned, __ATOMIC_RELEASE);
+        }
+
+        return interned;
+}
+
+/**
+ * Find a config value using a static key
+ *
+ * Unlike config_find this doesn't search the intern table on every lookup,
+ * so it should be used for keys which are read while the window manager runs
+ */
+struct config_value *config_find_key(const struct map *config_map, struct config_key *key)
+{
+        const char *interned_key = config_key_intern(key);
+        struct map_key_handle handle;
+
+        if (interned_key == NULL
+            || map_key_handle_init(config_map, interned_key, &handle) != NO_ERROR) {
+                return NULL;
+        }
+
+        return config_find_prehashed(config_map, &handle);
+}
+
+/**
+ * Find the values of many keys at once
+ *
+ * The keys are looked up together with map_get_many. results[i] is set to the
+ * value of keys[i], or NULL when it is missing. Returns the number of keys
+ * which were found
+ */
+size_t config_find_many(const struct map *config_map, struct config_key *keys, size_t count,
+                        struct config_value **results)
+{
+        const void *interned_keys[MAP_GET_MANY_BATCH];
+        struct map_entry *entries[MAP_GET_MANY_BATCH];
+        size_t found = 0;
+
+        for (size_t start = 0; start < count; start += MAP_GET_MANY_BATCH) {
+                size_t batch_size = MIN(count - start, MAP_GET_MANY_BATCH);
+
+                // A key which couldn't be interned is left as NULL, which
+                // map_get_many skips
+                for (size_t i = 0; i < batch_size; ++i) {
+                        interned_keys[i] = config_key_intern(&keys[start + i]);
+                }
+
+                found += map_get_many(config_map, interned_keys, batch_size, entries);
+
+                for (size_t i = 0; i < batch_size; ++i) {
+                        results[start + i] = (entries[i] == NULL)
+                                ? NULL
+                                : (struct config_value *)entries[i]->value;
+                }
+        }
+
+        return found;
+}
+
+static enum natwm_error config_value_to_array(const struct config_value *value,
+                                              const struct config_array **result)
+{
         if (value == NULL) {
                 return NOT_FOUND_ERROR;
         }
@@ -341,6 +827,18 @@ enum natwm_error config_find_array(const struct map *config_map, const char *key
         return NO_ERROR;
 }
 
+enum natwm_error config_find_array(const struct map *config_map, const char *key,
+                                   const struct config_array **result)
+{
+        return config_value_to_array(config_find(config_map, key), result);
+}
+
+enum natwm_error config_find_key_array(const struct map *config_map, struct config_key *key,
+                                       const struct config_array **result)
+{
+        return config_value_to_array(config_find_key(config_map, key), result);
+}
+
 enum natwm_error config_find_number(const struct map *config_map, const char *key, intmax_t *result)
 {
         struct config_value *value = config_find(config_map, key);
@@ -12,12 +12,38 @@
 
 #include "value.h"
 
+#define CONFIG_STREAM_CHUNK_SIZE 65536
+
+/**
+ * A key which is read from every configuration that is loaded
+ *
+ * The name is interned the first time the key is looked up. After that a
+ * lookup only mixes the stored hash of the interned name with the seed of
+ * the map, without searching the intern table or hashing the name again.
+ * Keys are meant to be static and can't be used after intern_destroy
+ */
+struct config_key {
+        const char *name;
+        const char *interned; // Set on first use
+};
+
+#define CONFIG_KEY_INIT(key_name) { .name = (key_name), .interned = NULL }
+
 struct map *config_read_string(const char *config, size_t size);
+struct map *config_read_stream(int fd, size_t chunk_size);
+struct map *config_read_fd(int fd);
 struct map *config_initialize_path(const char *path);
 
 struct config_value *config_find(const struct map *config_map, const char *key);
+struct config_value *config_find_prehashed(const struct map *config_map,
+                                           const struct map_key_handle *handle);
+struct config_value *config_find_key(const struct map *config_map, struct config_key *key);
+size_t config_find_many(const struct map *config_map, struct config_key *keys, size_t count,
+                        struct config_value **results);
 enum natwm_error config_find_array(const struct map *config_map, const char *key,
                                    const struct config_array **result);
+enum natwm_error config_find_key_array(const struct map *config_map, struct config_key *key,
+                                       const struct config_array **result);
 enum natwm_error config_find_number(const struct map *config_map, const char *key,
                                     intmax_t *result);
 intmax_t config_find_number_fallback(const struct map *config_map, const char *key,
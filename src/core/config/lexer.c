@@ -0,0 +1,304 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <common/scan.h>
+
+#include "lexer.h"
+
+static bool is_blank(char c)
+{
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static struct token create_token(enum token_kind kind, size_t offset, size_t length)
+{
+        struct token token = {
+                .kind = kind,
+                .offset = offset,
+                .length = length,
+        };
+
+        return token;
+}
+
+// Find the end of a word starting at offset. Words run until a space or any
+// character with a meaning of its own
+static size_t find_word_end(const struct lexer *lexer, size_t offset)
+{
+        while (offset < lexer->buffer_size) {
+                const char *block = lexer->buffer + offset;
+                size_t block_length = lexer->buffer_size - offset;
+                struct scan_masks masks;
+
+                scan_block(block, block_length, &masks);
+
+                uint32_t ends = masks.space | masks.equal | masks.comma | masks.array_start
+                        | masks.array_end | masks.quote | masks.comment
+                        | scan_block_char(block, block_length, '$');
+
+                if (ends != 0) {
+                        return MIN(offset + scan_mask_first_index(ends), lexer->buffer_size);
+                }
+
+                offset += SCAN_BLOCK_SIZE;
+        }
+
+        return lexer->buffer_size;
+}
+
+// Skip blanks and comments, leaving the position on the next token
+static void skip_ignored(struct lexer *lexer)
+{
+        while (lexer->pos < lexer->buffer_size) {
+                char c = lexer->buffer[lexer->pos];
+
+                if (is_blank(c)) {
+                        ++lexer->pos;
+
+                        continue;
+                }
+
+                if (c == '#') {
+                        // The new line ending the comment is still a token
+                        lexer->pos += scan_find_char(
+                                lexer->buffer + lexer->pos, lexer->buffer_size - lexer->pos, '\n');
+
+                        continue;
+                }
+
+                break;
+        }
+}
+
+static struct token lex_string(struct lexer *lexer, size_t start)
+{
+        const char *contents = lexer->buffer + start + 1;
+        size_t remaining = lexer->buffer_size - start - 1;
+        size_t line_length = scan_find_char(contents, remaining, '\n');
+        size_t quote = scan_find_char(contents, line_length, '"');
+
+        if (quote == line_length) {
+                // Strings can't span lines
+                lexer->pos = start + 1 + line_length;
+
+                return create_token(TOKEN_INVALID, start, line_length + 1);
+        }
+
+        lexer->pos = start + quote + 2;
+
+        return create_token(TOKEN_STRING, start, quote + 2);
+}
+
+void lexer_init(struct lexer *lexer, const char *buffer, size_t buffer_size)
+{
+        lexer->buffer = buffer;
+        // Anything after a '\0' is ignored, in case the buffer is shorter
+        // than buffer_size
+        lexer->buffer_size = strnlen(buffer, buffer_size);
+        lexer->pos = 0;
+        lexer->new_lines = NULL;
+        lexer->new_line_count = 0;
+        lexer->line_base = 0;
+}
+
+/**
+ * Return the next token and move past it
+ *
+ * Once the end of the buffer is reached every call returns TOKEN_END
+ */
+struct token lexer_next(struct lexer *lexer)
+{
+        skip_ignored(lexer);
+
+        size_t start = lexer->pos;
+
+        if (start >= lexer->buffer_size) {
+                return create_token(TOKEN_END, lexer->buffer_size, 0);
+        }
+
+        enum token_kind kind = TOKEN_WORD;
+
+        switch (lexer->buffer[start]) {
+        case '\n':
+                kind = TOKEN_NEW_LINE;
+                break;
+        case '=':
+                kind = TOKEN_EQUAL;
+                break;
+        case ',':
+                kind = TOKEN_COMMA;
+                break;
+        case '[':
+                kind = TOKEN_ARRAY_START;
+                break;
+        case ']':
+                kind = TOKEN_ARRAY_END;
+                break;
+        case '"':
+                return lex_string(lexer, start);
+        case '$': {
+                size_t end = find_word_end(lexer, start + 1);
+
+                lexer->pos = end;
+
+                if (end == start + 1) {
+                        return create_token(TOKEN_INVALID, start, 1);
+                }
+
+                return create_token(TOKEN_VARIABLE, start, end - start);
+        }
+        default:
+                lexer->pos = find_word_end(lexer, start);
+
+                return create_token(TOKEN_WORD, start, lexer->pos - start);
+        }
+
+        lexer->pos = start + 1;
+
+        return create_token(kind, start, 1);
+}
+
+/**
+ * Return the next token without moving past it
+ */
+struct token lexer_peek(struct lexer *lexer)
+{
+        size_t pos = lexer->pos;
+        struct token token = lexer_next(lexer);
+
+        lexer->pos = pos;
+
+        return token;
+}
+
+/**
+ * Continue lexing from offset
+ */
+void lexer_seek(struct lexer *lexer, size_t offset)
+{
+        lexer->pos = MIN(offset, lexer->buffer_size);
+}
+
+struct string_view lexer_token_view(const struct lexer *lexer, struct token token)
+{
+        return string_view_create(lexer->buffer + token.offset, token.length);
+}
+
+// The offset of a view into the lexer buffer
+size_t lexer_get_offset(const struct lexer *lexer, struct string_view view)
+{
+        return (size_t)(view.data - lexer->buffer);
+}
+
+static int build_new_line_index(struct lexer *lexer)
+{
+        size_t count = scan_count_char(lexer->buffer, lexer->buffer_size, '\n');
+
+        if (count == 0) {
+                return 0;
+        }
+
+        lexer->new_lines = malloc(sizeof(size_t) * count);
+
+        if (lexer->new_lines == NULL) {
+                return -1;
+        }
+
+        size_t offset = 0;
+
+        for (size_t i = 0; i < count; ++i) {
+                offset += scan_find_char(
+                        lexer->buffer + offset, lexer->buffer_size - offset, '\n');
+
+                lexer->new_lines[i] = offset++;
+        }
+
+        lexer->new_line_count = count;
+
+        return 0;
+}
+
+/**
+ * Find the line and column of an offset in the buffer, both starting at 1
+ *
+ * If the new line index can't be built the lines are counted directly
+ */
+void lexer_get_location(struct lexer *lexer, size_t offset, size_t *line, size_t *column)
+{
+        offset = MIN(offset, lexer->buffer_size);
+
+        if (lexer->new_lines == NULL && build_new_line_index(lexer) != 0) {
+                size_t line_start = 0;
+                size_t count = scan_count_char(lexer->buffer, offset, '\n');
+
+                if (count > 0) {
+                        line_start = scan_find_last_char(lexer->buffer, offset, '\n') + 1;
+                }
+
+                *line = lexer->line_base + count + 1;
+                *column = offset - line_start + 1;
+
+                return;
+        }
+
+        // Count the new lines before offset
+        size_t low = 0;
+        size_t high = lexer->new_line_count;
+
+        while (low < high) {
+                size_t middle = low + ((high - low) / 2);
+
+                if (lexer->new_lines[middle] < offset) {
+                        low = middle + 1;
+                } else {
+                        high = middle;
+                }
+        }
+
+        size_t line_start = (low == 0) ? 0 : lexer->new_lines[low - 1] + 1;
+
+        *line = lexer->line_base + low + 1;
+        *column = offset - line_start + 1;
+}
+
+const char *lexer_token_kind_name(enum token_kind kind)
+{
+        switch (kind) {
+        case TOKEN_WORD:
+                return "word";
+        case TOKEN_VARIABLE:
+                return "variable";
+        case TOKEN_STRING:
+                return "string";
+        case TOKEN_EQUAL:
+                return "'='";
+        case TOKEN_COMMA:
+                return "','";
+        case TOKEN_ARRAY_START:
+                return "'['";
+        case TOKEN_ARRAY_END:
+                return "']'";
+        case TOKEN_NEW_LINE:
+                return "new line";
+        case TOKEN_END:
+                return "end of file";
+        case TOKEN_INVALID:
+                return "invalid token";
+        }
+
+        return "unknown";
+}
+
+void lexer_destroy(struct lexer *lexer)
+{
+        free(lexer->new_lines);
+
+        lexer->new_lines = NULL;
+        lexer->new_line_count = 0;
+}
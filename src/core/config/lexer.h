@@ -0,0 +1,63 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#pragma once
+
+#include <stddef.h>
+
+#include <common/string_view.h>
+
+/**
+ * Splits a configuration buffer into tokens
+ *
+ * Tokens are an offset and length into the buffer, so lexing never copies or
+ * allocates. Spaces and comments are skipped, new lines are kept since they
+ * end config items
+ *
+ * Line and column numbers are only needed for error messages, so they aren't
+ * tracked while lexing. The first lookup builds an index of the new lines in
+ * the buffer which later lookups binary search
+ */
+
+enum token_kind {
+        TOKEN_WORD, // Keys, numbers and booleans
+        TOKEN_VARIABLE, // $name
+        TOKEN_STRING, // "string" including the quotes
+        TOKEN_EQUAL,
+        TOKEN_COMMA,
+        TOKEN_ARRAY_START,
+        TOKEN_ARRAY_END,
+        TOKEN_NEW_LINE,
+        TOKEN_END,
+        TOKEN_INVALID, // An unterminated string or a lone '$'
+};
+
+struct token {
+        enum token_kind kind;
+        size_t offset;
+        size_t length;
+};
+
+struct lexer {
+        const char *buffer;
+        size_t buffer_size;
+        size_t pos;
+        // Offsets of every new line in the buffer, built on the first
+        // location lookup
+        size_t *new_lines;
+        size_t new_line_count;
+        // Lines before the start of the buffer, when a configuration is
+        // lexed in pieces
+        size_t line_base;
+};
+
+void lexer_init(struct lexer *lexer, const char *buffer, size_t buffer_size);
+struct token lexer_next(struct lexer *lexer);
+struct token lexer_peek(struct lexer *lexer);
+void lexer_seek(struct lexer *lexer, size_t offset);
+struct string_view lexer_token_view(const struct lexer *lexer, struct token token);
+size_t lexer_get_offset(const struct lexer *lexer, struct string_view view);
+void lexer_get_location(struct lexer *lexer, size_t offset, size_t *line, size_t *column);
+const char *lexer_token_kind_name(enum token_kind kind);
+void lexer_destroy(struct lexer *lexer);
@@ -7,11 +7,10 @@
 #include <string.h>
 
 #include <common/constants.h>
-#include <common/list.h>
+#include <common/intern.h>
 #include <common/logger.h>
 #include <common/map.h>
-#include <common/stack.h>
-#include <common/string.h>
+#include <common/string_view.h>
 
 #include "parser.h"
 
@@ -22,341 +21,185 @@ static void hashmap_free_callback(void *data)
         config_value_destroy(value);
 }
 
-/**
- * This is a array context aware delimiter search. We need to find delimiters
- * as they relate to the outer array context.
- *
- * If we were searching for the first ',' char in an array items string like:
- *
- * [1, 2, 3],[4, 5, 6],[7, 8, 9]
- *
- * ---------^
- *
- * we would not want to find the first ',' in the first nested array, but the
- * first ',' splitting the arrays
- */
-static enum natwm_error array_context_get_delimiter(const char *string, char delimiter,
-                                                    char **result, size_t *length, bool consume)
+// The line of an offset in the buffer, used when reporting errors
+static size_t parser_get_line(struct parser *parser, size_t offset)
 {
-        enum natwm_error err = GENERIC_ERROR;
-        struct stack *stack = stack_create();
-        size_t index = 0;
-        char ch = '\0';
-
-        while ((ch = string[index]) != '\0') {
-                enum parser_token token = char_to_token(ch);
-
-                if (token == ARRAY_START) {
-                        stack_push(stack, &index);
-                }
-
-                if (token == ARRAY_END) {
-                        // We just need to delete this
-                        struct stack_item *stack_item = stack_pop(stack);
-
-                        if (stack_item != NULL) {
-                                stack_item_destroy(stack_item);
-                        }
-                }
-
-                if (ch != delimiter) {
-                        ++index;
-
-                        continue;
-                }
-
-                // We found the delimiter - check if the stack is empty.
-                if (!stack_has_item(stack)) {
-                        // If we want to include the delimiter in the final
-                        // string increment the index
-                        if (consume) {
-                                ++index;
-                        }
-
-                        ++index;
-
-                        break;
-                }
-
-                // We found the delimiter, but we are not in the correct
-                // context, so just incremement the index and continue
-                ++index;
-
-                continue;
-        }
-
-        if (ch == '\0') {
-                // We did not find anything
-                stack_destroy(stack);
+        size_t line = 0;
+        size_t column = 0;
 
-                return NOT_FOUND_ERROR;
-        }
+        lexer_get_location(&parser->lexer, offset, &line, &column);
 
-        char *resulting_string = NULL;
-        size_t string_length = 0;
+        return line;
+}
 
-        err = string_splice(string, 0, index - 1, &resulting_string, &string_length);
+static size_t parser_get_view_line(struct parser *parser, struct string_view view)
+{
+        return parser_get_line(parser, lexer_get_offset(&parser->lexer, view));
+}
 
-        if (err != NO_ERROR) {
-                stack_destroy(stack);
+// The variable map is keyed by interned names
+static const struct config_value *parser_get_variable(const struct parser *parser,
+                                                      const char *interned_key)
+{
+        struct map_entry *entry = map_get(parser->variables, interned_key);
 
-                return err;
+        if (entry == NULL) {
+                return NULL;
         }
 
-        *result = resulting_string;
-        *length = string_length;
-
-        stack_destroy(stack);
-
-        return NO_ERROR;
+        return (const struct config_value *)entry->value;
 }
 
 /**
- * Given the start of an array string we need to find the closing ARRAY_END
- * for the first ARRAY_START char. This is made more complicated because of the
- * potential presence of nested arrays
- *
- * For a string that looks like this:
- *
- * [[1,2,3],[4,5,6],[7,8,9]]
+ * Resolve a variable found in the configuration file
  *
- * ---(Expected result)----^
+ * Once we have read and parsed a configuration item pointing to a variable
+ * we need to resolve the variable.
  *
- *  We will return the array string and index position of the closing
- *  ARRAY_END char
+ * First we find the variable in the parser's variable map then we copy the
+ * value.
  */
-static enum natwm_error get_array_string(const char *string, char **result, size_t *index_pos)
+static struct config_value *parser_resolve_variable(struct parser *parser,
+                                                    struct string_view variable_key)
 {
-        enum natwm_error err = GENERIC_ERROR;
-        char *raw_array_string = NULL;
-        size_t raw_string_length = 0;
-
-        err = array_context_get_delimiter(string, ']', &raw_array_string, &raw_string_length, true);
+        // A variable name which has never been interned can't have been
+        // defined, so the lookup doesn't need to copy the name
+        const char *key = intern_find_n(variable_key.data, variable_key.length);
+        const struct config_value *variable = NULL;
 
-        if (err != NO_ERROR) {
-                return err;
+        if (key != NULL) {
+                variable = parser_get_variable(parser, key);
         }
 
-        char *array_string = NULL;
-        size_t array_string_length = 0;
-
-        err = string_strip_surrounding_spaces(
-                raw_array_string, &array_string, &array_string_length);
-
-        if (err != NO_ERROR) {
-                free(raw_array_string);
+        if (variable == NULL) {
+                LOG_ERROR(natwm_logger,
+                          "'%.*s' is not defined - Line: %zu",
+                          STRING_VIEW_PRINTF_ARGS(variable_key),
+                          parser_get_view_line(parser, variable_key));
 
-                return err;
+                return NULL;
         }
 
-        free(raw_array_string);
+        struct config_value *new = config_value_duplicate(variable);
 
-        *result = array_string;
-        *index_pos = raw_string_length - 1;
+        if (new == NULL) {
+                LOG_ERROR(natwm_logger,
+                          "Failed to resolve variable '%s' - Line: %zu",
+                          key,
+                          parser_get_view_line(parser, variable_key));
 
-        return NO_ERROR;
+                return NULL;
+        }
+
+        return new;
 }
 
 /**
- * This is an array context aware array split. It splits the inner values
- * of an array keeping in mind that there might be nested arrays. Instead of
- * splitting on each ',' (which would happen if we used string_split) we keep
- * track of our position on the array (and nested arrays) and only return the
- * top level items.
+ * Here we will handle the creation of a simple boolean value of the form:
+ *
+ * "true" or "false"
  *
- * Firstly we build a list of top level value items. This allows us to figure
- * out the number of value items dynamically. Then we do a single allocation
- * for the returned array and destroy the intermediate list.
+ * The casing of the above values does not matter, just that they are
+ * alphabetically equal
  *
- * The provided char array is populated with the result, and the provided
- * length pointer is populated with the number of value items we found
+ * No other "falsey" values will be parsed as boolean.
  */
-static enum natwm_error array_split_value_items_string(const char *string, char ***result,
-                                                       size_t *length)
+static struct config_value *parser_parse_boolean(struct parser *parser, struct string_view value)
 {
-        struct list *list = list_create();
-
-        if (list == NULL) {
-                return MEMORY_ALLOCATION_ERROR;
-        }
-
-        size_t current_index = 0;
-
-        for (;;) {
-                char *item = NULL;
-                size_t end_pos = 0;
-                enum natwm_error err = array_context_get_delimiter(
-                        string + current_index, ',', &item, &end_pos, false);
-
-                if (err == NOT_FOUND_ERROR) {
-                        char *last_item = string_init(string + current_index);
-
-                        if (last_item == NULL) {
-                                goto free_and_error;
-                        }
-
-                        list_insert(list, last_item);
-
-                        break;
-                }
-
-                if (err != NO_ERROR) {
-                        goto free_and_error;
-                }
-
-                list_insert(list, item);
-
-                string += (end_pos + 1);
-        }
-
-        char **array_items = malloc(sizeof(char *) * list->size);
-
-        if (array_items == NULL) {
-                goto free_and_error;
-        }
-
-        // Walk the list backwards to insert in the correct position
-        size_t array_item_index = (list->size - 1);
-
-        LIST_FOR_EACH(list, item)
-        {
-                char *list_item = (char *)item->data;
-
-                array_items[array_item_index] = list_item;
-
-                --array_item_index;
-        }
-
-        *result = array_items;
-        *length = list->size;
-
-        list_destroy(list);
+        bool boolean = false;
+        enum natwm_error err = string_view_to_boolean(value, &boolean);
 
-        return NO_ERROR;
+        if (err != NO_ERROR) {
+                LOG_ERROR(natwm_logger,
+                          "Invalid boolean value '%.*s' found - Line %zu",
+                          STRING_VIEW_PRINTF_ARGS(value),
+                          parser_get_view_line(parser, value));
 
-free_and_error:
-        LIST_FOR_EACH(list, item)
-        {
-                if (item && item->data) {
-                        free((char *)item->data);
-                }
+                return NULL;
         }
 
-        list_destroy(list);
-
-        return GENERIC_ERROR;
+        return config_value_create_boolean(boolean);
 }
 
 /**
- * Take a value string which we know contains an array and return a string
- * containing all of the array value items.
- *
- * We allow arrays to span multiple lines so this function has to take that
- * into account and reparse the value string if we don't find an ARRAY_END
- * character at the end of the passed string
- *
- * The parser position is kept up to date in the case of a multiline value
+ * Here we will handle the create of a simple numeric value
  */
-static enum natwm_error array_find_value_items_string(struct parser *parser, char *string,
-                                                      char **result, size_t *length)
+static struct config_value *parser_parse_number(struct parser *parser, struct string_view value)
 {
-        // An array value string in the format
-        // [<value>,<value>]
-        char *array_value_string = NULL;
-
-        if (char_to_token(string[strlen(string) - 1]) != ARRAY_END) {
-                size_t end_pos = 0;
-                const char *line = parser->buffer + parser->pos;
-
-                enum natwm_error err = get_array_string(line, &array_value_string, &end_pos);
-
-                if (err != NO_ERROR) {
-                        LOG_ERROR(natwm_logger,
-                                  "Could not find ']' in array value string - "
-                                  "Line %zu",
-                                  parser->line_num);
-
-                        return INVALID_INPUT_ERROR;
-                }
-
-                // We found a valid multiline array value string. But now we
-                // need to update the parser position to point to the end of the
-                // array value string
-                parser_move(parser, end_pos);
-        } else {
-                // Our array exists on a single line
-                array_value_string = string_init(string);
-        }
-
-        // From our value string we need to get the array items list
-        // <value>,<value>
-        char *array_value_items_string = NULL;
-        size_t array_value_items_string_size = 0;
-        enum natwm_error err = string_splice(array_value_string,
-                                             1,
-                                             strlen(array_value_string) - 1,
-                                             &array_value_items_string,
-                                             &array_value_items_string_size);
+        intmax_t number = 0;
+        enum natwm_error err = string_view_to_number(value, &number);
 
         if (err != NO_ERROR) {
-                free(array_value_string);
+                LOG_ERROR(natwm_logger,
+                          "Invalid numeric value '%.*s' found - Line %zu",
+                          STRING_VIEW_PRINTF_ARGS(value),
+                          parser_get_view_line(parser, value));
 
-                return err;
+                return NULL;
         }
 
-        free(array_value_string);
-
-        *result = array_value_items_string;
-        *length = array_value_items_string_size;
+        return config_value_create_number(number);
+}
 
-        return NO_ERROR;
+/**
+ * Here we will handle the parsing and creation of a variable value
+ */
+static struct config_value *parser_parse_variable(struct parser *parser, struct string_view value)
+{
+        // we need to take the value (minus VARIABLE_START) and look it up
+        // in the variable map. If it's found we need to duplicate it and store
+        // it in a config item with the key passed in
+        return parser_resolve_variable(parser, string_view_slice(value, 1, value.length));
 }
 
 /**
- * Given an array of array value items we need to parse their values or resolve
- * the variables into values.
+ * Here we will handle the creation of a simple string value
  *
- * We just take the value item and complete the same process as if we had found
- * a top level value string starting with "parser_parse_value"
+ * String values are interned, so repeated values such as colors are only
+ * stored once
  */
-static struct config_value *parser_resolve_array_values(struct parser *parser, char **value_items,
-                                                        size_t value_items_length)
+static struct config_value *parser_parse_string(struct parser *parser, struct string_view string)
 {
-        struct config_value *config_value = config_value_create_array(value_items_length);
+        // We first need to strip off the surrounding quotes from the string
+        if (string.length < 2 || char_to_token(string.data[string.length - 1]) != QUOTE) {
+                LOG_ERROR(natwm_logger,
+                          "Invalid string '%.*s' found - Line %zu",
+                          STRING_VIEW_PRINTF_ARGS(string),
+                          parser_get_view_line(parser, string));
 
-        if (config_value == NULL) {
                 return NULL;
         }
 
-        // Resolve and insert config_values into the array
-        for (size_t i = 0; i < value_items_length; ++i) {
-                struct config_value *item = parser_parse_value(parser, value_items[i]);
+        struct string_view contents = string_view_slice(string, 1, string.length - 1);
+        const char *interned_string = intern_string_n(contents.data, contents.length);
 
-                if (item == NULL) {
-                        for (size_t j = i; j < value_items_length; ++j) {
-                                free(value_items[j]);
-                        }
+        if (interned_string == NULL) {
+                return NULL;
+        }
 
-                        config_value_destroy(config_value);
+        return config_value_create_string(interned_string);
+}
 
-                        return NULL;
-                }
+// Array values can be split over lines, so new lines are skipped
+static struct token parser_next_array_token(struct parser *parser)
+{
+        struct token token;
 
-                config_value->data.array->values[i] = item;
+        while ((token = lexer_next(&parser->lexer)).kind == TOKEN_NEW_LINE) {
         }
 
-        return config_value;
+        return token;
 }
 
+static struct config_value *parser_parse_token(struct parser *parser, struct token token,
+                                               size_t depth);
+
 /**
  * Here we will handle parsing arrays
  *
- * Arrays are different in that they support multi line value strings. The
- * string we are going to receive into this function will terminate at the
- * first '\n' so we need to create our own "array value string" from the
- * parser
- *
- * That "array value string" will resemble something like this:
+ * When this function is called the ARRAY_START token has just been read.
+ * Arrays can span multiple lines, so an array will resemble something like
+ * this:
  *
  * [<value>,<value>,<value>]
  *
@@ -369,253 +212,135 @@ static struct config_value *parser_resolve_array_values(struct parser *parser, c
  * ]
  *
  * Both of which should be treated the same and return the same result.
+ *
+ * Each value is parsed as it is read, nested arrays recurse, so the array is
+ * built in a single pass over the tokens. Items are collected on the parser
+ * item stack, which every level of nesting shares, and copied into the array
+ * once its length is known
  */
-static struct config_value *parser_parse_array(struct parser *parser, char *string)
+static struct config_value *parser_parse_array(struct parser *parser, struct token start,
+                                               size_t depth)
 {
-        char *value_items_string = NULL;
-        size_t value_items_string_length = 0;
-        enum natwm_error err = GENERIC_ERROR;
-
-        err = array_find_value_items_string(
-                parser, string, &value_items_string, &value_items_string_length);
-
-        if (err != NO_ERROR) {
-                return NULL;
-        }
-
-        // We should now have a valid string containing the string
-        // representation of the array values
-        //
-        // We now need to normalize it
-        char **value_items = NULL;
-        size_t value_items_length = 0;
-
-        err = array_split_value_items_string(value_items_string, &value_items, &value_items_length);
-
-        if (err != NO_ERROR) {
+        if (depth >= PARSER_ARRAY_MAX_DEPTH) {
                 LOG_ERROR(natwm_logger,
-                          "Failed to parse array value items string - Line %zu",
-                          parser->line_num);
-
-                free(value_items_string);
+                          "Arrays can't be nested more than %d deep - Line %zu",
+                          PARSER_ARRAY_MAX_DEPTH,
+                          parser_get_line(parser, start.offset));
 
                 return NULL;
         }
 
-        // Remove spaces around the items
-        for (size_t i = 0; i < value_items_length; ++i) {
-                char *value_item = NULL;
-                err = string_strip_surrounding_spaces(value_items[i], &value_item, NULL);
+        struct config_value_vector *items = parser->array_items;
+        size_t first_item = items->length;
 
-                // If we encounter an '' (empty string) as the last item in the
-                // array we have two senarios:
-                //
-                // 1) The array is empty and there are no values
-                // 2) There was a trailing comma
-                //
-                // In both cases we should free the string, decrement the array
-                // length, and terminate the loop
-                if (err == NOT_FOUND_ERROR && (i == value_items_length - 1)) {
-                        free(value_items[i]);
-
-                        value_items_length -= 1;
+        for (;;) {
+                struct token token = parser_next_array_token(parser);
 
+                // An empty array or a trailing comma
+                if (token.kind == TOKEN_ARRAY_END) {
                         break;
                 }
 
-                if (err != NO_ERROR) {
+                if (token.kind == TOKEN_END) {
                         LOG_ERROR(natwm_logger,
-                                  "Failed to parse array value item '%s' - "
-                                  "Line %zu",
-                                  value_items[i],
-                                  parser->line_num);
+                                  "Could not find ']' in array value string - Line %zu",
+                                  parser_get_line(parser, start.offset));
 
                         goto free_and_error;
                 }
 
-                free(value_items[i]);
+                struct config_value *item = parser_parse_token(parser, token, depth + 1);
 
-                value_items[i] = value_item;
-        }
-
-        // Now we should have an array of stripped items
-        // Last step is to parse them into a new config_value
-        struct config_value *config_value
-                = parser_resolve_array_values(parser, value_items, value_items_length);
-
-        if (config_value == NULL) {
-                free(value_items_string);
-                free(value_items);
-
-                return NULL;
-        }
-
-        free(string);
-        free(value_items_string);
-        free(value_items);
-
-        return config_value;
+                if (item == NULL) {
+                        goto free_and_error;
+                }
 
-free_and_error:
-        // We need to free up our intermediate strings and the array of array
-        // values we allocated
-        free(value_items_string);
-        free(value_items);
+                if (config_value_vector_push(items, item) != NO_ERROR) {
+                        config_value_destroy(item);
 
-        return NULL;
-}
-
-/**
- * Resolve a variable found in the configuration file
- *
- * Once we have read and parsed a configuration item pointing to a variable
- * we need to resolve the variable.
- *
- * First we find the variable in the parser's variable map then we copy the
- * value.
- */
-static struct config_value *parser_resolve_variable(const struct parser *parser,
-                                                    const char *variable_key)
-{
-        const struct config_value *variable = parser_find_variable(parser, variable_key);
+                        goto free_and_error;
+                }
 
-        if (variable == NULL) {
-                LOG_ERROR(natwm_logger,
-                          "'%s' is not defined - Line: %zu",
-                          variable_key,
-                          parser->line_num);
+                token = parser_next_array_token(parser);
 
-                return NULL;
-        }
-
-        struct config_value *new = config_value_duplicate(variable);
+                if (token.kind == TOKEN_ARRAY_END) {
+                        break;
+                }
 
-        if (new == NULL) {
-                LOG_ERROR(natwm_logger,
-                          "Failed to resolve variable '%s' - Line: %zu",
-                          variable_key,
-                          parser->line_num);
+                if (token.kind != TOKEN_COMMA) {
+                        LOG_ERROR(natwm_logger,
+                                  "Expected ',' or ']' but found %s - Line %zu",
+                                  lexer_token_kind_name(token.kind),
+                                  parser_get_line(parser, token.offset));
 
-                return NULL;
+                        goto free_and_error;
+                }
         }
 
-        return new;
-}
+        size_t length = items->length - first_item;
+        struct config_value *config_value = config_value_create_array(length);
 
-/**
- * Here we will handle the creation of a simple boolean value of the form:
- *
- * "true" or "false"
- *
- * The casing of the above values does not matter, just that they are
- * alphabetically equal
- *
- * No other "falsey" values will be parsed as boolean.
- */
-static struct config_value *parser_parse_boolean(const struct parser *parser, char *value)
-{
-        bool boolean = false;
-        enum natwm_error err = string_to_boolean(value, &boolean);
-
-        if (err != NO_ERROR) {
-                LOG_ERROR(natwm_logger,
-                          "Invalid boolean value '%s' found - Line %zu",
-                          value,
-                          parser->line_num);
-
-                return NULL;
+        if (config_value == NULL) {
+                goto free_and_error;
         }
 
-        struct config_value *config_value = config_value_create_boolean(boolean);
-
-        if (config_value == NULL) {
-                return NULL;
+        if (length > 0) {
+                memcpy(config_value->data.array->values,
+                       &items->items[first_item],
+                       sizeof(struct config_value *) * length);
         }
 
-        free(value);
+        items->length = first_item;
 
         return config_value;
-}
-
-/**
- * Here we will handle the create of a simple numeric value
- */
-static struct config_value *parser_parse_number(const struct parser *parser, char *value)
-{
-        intmax_t number = 0;
-        enum natwm_error err = string_to_number(value, &number);
-
-        if (err != NO_ERROR) {
-                LOG_ERROR(natwm_logger,
-                          "Invalid numeric value '%s' found - Line %zu",
-                          value,
-                          parser->line_num);
 
-                return NULL;
-        }
-
-        struct config_value *config_value = config_value_create_number(number);
-
-        if (config_value == NULL) {
-                return NULL;
+free_and_error:
+        while (items->length > first_item) {
+                config_value_destroy(config_value_vector_pop(items));
         }
 
-        // We no longer need this value
-        free(value);
-
-        return config_value;
+        return NULL;
 }
 
 /**
- * Here we will handle the parsing and creation of a variable value
+ * Here we will handle the parsing of a generic value.
+ *
+ * The value is only read, so it can point straight into the parser buffer.
+ * The depth is the number of arrays the value is nested in
  */
-static struct config_value *parser_parse_variable(const struct parser *parser, char *value)
+static struct config_value *parser_parse_token(struct parser *parser, struct token token,
+                                               size_t depth)
 {
-        // we need to take the value (minus VARIABLE_START) and look it up
-        // in the variable map. If it's found we need to duplicate it and store
-        // it in a config item with the key passed in
-        struct config_value *config_value = parser_resolve_variable(parser, value + 1);
+        struct string_view value = lexer_token_view(&parser->lexer, token);
 
-        if (config_value == NULL) {
-                return NULL;
-        }
-
-        // We no longer need this value since we only needed it for the
-        // variable lookup
-        free(value);
+        switch (token.kind) {
+        case TOKEN_WORD:
+                if (char_to_token(value.data[0]) == NUMERIC_CHAR) {
+                        return parser_parse_number(parser, value);
+                }
 
-        return config_value;
-}
+                return parser_parse_boolean(parser, value);
+        case TOKEN_STRING:
+                return parser_parse_string(parser, value);
+        case TOKEN_VARIABLE:
+                return parser_parse_variable(parser, value);
+        case TOKEN_ARRAY_START:
+                return parser_parse_array(parser, token, depth);
+        default: {
+                size_t line = 0;
+                size_t column = 0;
 
-/**
- * Here we will handle the creation of a simple string value
- */
-static struct config_value *parser_parse_string(const struct parser *parser, char *string)
-{
-        // We first need to strip off the surrounding quotes from the string
-        size_t string_len = strlen(string);
-        char *stripped_string = NULL;
+                lexer_get_location(&parser->lexer, token.offset, &line, &column);
 
-        if (string_splice(string, 1, string_len - 1, &stripped_string, NULL) != NO_ERROR) {
                 LOG_ERROR(natwm_logger,
-                          "Invalid string '%s' found - Line %zu",
-                          string,
-                          parser->line_num);
+                          "Found invalid item value %s - Line %zu Col: %zu",
+                          lexer_token_kind_name(token.kind),
+                          line,
+                          column);
 
                 return NULL;
         }
-
-        struct config_value *config_value = config_value_create_string(stripped_string);
-
-        if (config_value == NULL) {
-                free(stripped_string);
-
-                return NULL;
         }
-
-        free(string);
-
-        return config_value;
 }
 
 enum parser_token char_to_token(char c)
@@ -651,7 +376,7 @@ enum parser_token char_to_token(char c)
 /**
  * Initialize the parser with the file buffer.
  *
- * This will be used to track the position of the parser in the file.
+ * The buffer is only read, values point into it until they are stored
  */
 struct parser *parser_create(const char *buffer, size_t buffer_size)
 {
@@ -661,15 +386,13 @@ struct parser *parser_create(const char *buffer, size_t buffer_size)
                 return NULL;
         }
 
-        parser->buffer = buffer;
-        parser->buffer_size = buffer_size;
-        parser->pos = 0;
-        parser->line_num = 1;
-        parser->col_num = 1;
+        lexer_init(&parser->lexer, buffer, buffer_size);
+
         parser->variables = map_init();
+        parser->array_items = config_value_vector_create();
 
-        if (parser->variables == NULL) {
-                free(parser);
+        if (parser->variables == NULL || parser->array_items == NULL) {
+                parser_destroy(parser);
 
                 return NULL;
         }
@@ -677,7 +400,10 @@ struct parser *parser_create(const char *buffer, size_t buffer_size)
         // Set up hashmap
         map_set_entry_free_function(parser->variables, hashmap_free_callback);
 
-        map_set_setting_flag(parser->variables, MAP_FLAG_FREE_ENTRY_KEY);
+        // Variable names are interned so the map never owns them
+        map_set_hash_function(parser->variables, intern_map_hash);
+        map_set_key_size_function(parser->variables, intern_map_key_size);
+        map_set_key_compare_function(parser->variables, intern_map_key_compare);
 
         return parser;
 }
@@ -685,28 +411,26 @@ struct parser *parser_create(const char *buffer, size_t buffer_size)
 /**
  * Handle the creation of a variable
  *
- * When this function is called the parser will be pointing to the
- * start of a variable declaration in the form of
+ * When this function is called the VARIABLE token of a variable declaration
+ * in the form of
  *
  * $variable_name = <variable_value>
- * ^
- * |
- * *-(parser->pos)
  *
- * Once the variable has been saved to the parser, the parser positon
- * should also be updated to point to the '\n' of the current
- * line, so that the next line can be consumed
+ * has just been read. Once the variable has been saved to the parser the
+ * rest of the line has been consumed
  */
-enum natwm_error parser_create_variable(struct parser *parser)
+enum natwm_error parser_create_variable(struct parser *parser, struct token token)
 {
-        // Skip VARIABLE_START
-        parser_increment(parser);
-
         enum natwm_error err = GENERIC_ERROR;
-        char *key = NULL;
+        const char *key = NULL;
         struct config_value *value = NULL;
 
-        err = parser_read_item(parser, &key, &value);
+        // Skip VARIABLE_START, the rest is read like any other key
+        token.kind = TOKEN_WORD;
+        ++token.offset;
+        --token.length;
+
+        err = parser_read_item(parser, token, &key, &value);
 
         if (err != NO_ERROR) {
                 return err;
@@ -715,7 +439,6 @@ enum natwm_error parser_create_variable(struct parser *parser)
         err = map_insert(parser->variables, key, value);
 
         if (err != NO_ERROR) {
-                free(key);
                 config_value_destroy(value);
 
                 return err;
@@ -729,174 +452,81 @@ enum natwm_error parser_create_variable(struct parser *parser)
  */
 const struct config_value *parser_find_variable(const struct parser *parser, const char *key)
 {
-        struct map_entry *entry = map_get(parser->variables, key);
+        const char *interned_key = intern_find(key);
 
-        if (entry == NULL) {
+        if (interned_key == NULL) {
                 return NULL;
         }
 
-        struct config_value *value = (struct config_value *)entry->value;
-
-        return value;
+        return parser_get_variable(parser, interned_key);
 }
 
 /**
- * Here we will handle the parsing of a generic value.
- */
-struct config_value *parser_parse_value(struct parser *parser, char *value)
-{
-        switch (char_to_token(value[0])) {
-        case ALPHA_CHAR:
-                return parser_parse_boolean(parser, value);
-        case ARRAY_START:
-                return parser_parse_array(parser, value);
-        case NUMERIC_CHAR:
-                return parser_parse_number(parser, value);
-        case QUOTE:
-                return parser_parse_string(parser, value);
-        case VARIABLE_START:
-                return parser_parse_variable(parser, value);
-        default:
-                return NULL;
-        }
-}
-
-/**
- * Read a key from the current parser buffer
+ * Read a key from a token
  *
- * The parser buffer will be pointing to the beginning of a string something
- * like this:
+ * The token is the first word of a line something like this:
  *
  * key = value
  *
- * We must pull out the key and then point the buffer to the EQUAL_CHAR
+ * The EQUAL token following the key is consumed as well.
+ *
+ * The key is returned interned, so it stays valid after the parser buffer
+ * is gone and can be compared by pointer
  */
-enum natwm_error parser_read_key(struct parser *parser, char **result, size_t *length)
+enum natwm_error parser_read_key(struct parser *parser, struct token token, const char **result)
 {
-        enum natwm_error err = GENERIC_ERROR;
-        const char *line = parser->buffer + parser->pos;
-
-        if (char_to_token(line[0]) != ALPHA_CHAR) {
-                LOG_ERROR(natwm_logger,
-                          "Invalid Key: '%c' - Line: %zu Col: %zu",
-                          line[0],
-                          parser->line_num,
-                          parser->col_num);
-
-                return INVALID_INPUT_ERROR;
-        }
+        struct string_view key = lexer_token_view(&parser->lexer, token);
 
-        // Find the EQUAL_CHAR which will allows us to know the bounds of the
-        // key
-        size_t equal_pos = 0;
-        char *key = NULL;
+        if (token.kind != TOKEN_WORD || char_to_token(key.data[0]) != ALPHA_CHAR) {
+                size_t line = 0;
+                size_t column = 0;
 
-        err = string_get_delimiter(line, '=', &key, &equal_pos, false);
+                lexer_get_location(&parser->lexer, token.offset, &line, &column);
 
-        if (err != NO_ERROR) {
-                LOG_ERROR(natwm_logger, "Missing '=' - Line: %zu", parser->line_num);
+                LOG_ERROR(natwm_logger,
+                          "Invalid Key: '%.*s' - Line: %zu Col: %zu",
+                          STRING_VIEW_PRINTF_ARGS(key),
+                          line,
+                          column);
 
                 return INVALID_INPUT_ERROR;
         }
 
-        // We should now be able to strip the spaces around the key which will
-        // leave us with a valid key
-        char *stripped_key = NULL;
-        size_t stripped_key_length = 0;
-
-        err = string_strip_surrounding_spaces(key, &stripped_key, &stripped_key_length);
-
-        if (err != NO_ERROR) {
-                LOG_ERROR(natwm_logger, "Invalid config value - Line %zu", parser->line_num);
-
-                free(key);
-                free(stripped_key);
+        if (lexer_next(&parser->lexer).kind != TOKEN_EQUAL) {
+                LOG_ERROR(natwm_logger,
+                          "Missing '=' - Line: %zu",
+                          parser_get_line(parser, token.offset));
 
                 return INVALID_INPUT_ERROR;
         }
 
-        // Cleanup the intermediate key
-        free(key);
-
-        // Update the buffer position to the equal pos
-        parser_move(parser, equal_pos);
+        const char *key_string = intern_string_n(key.data, key.length);
 
-        // Now we can return our valid key and key length
-        *result = stripped_key;
+        if (key_string == NULL) {
+                return MEMORY_ALLOCATION_ERROR;
+        }
 
-        SET_IF_NON_NULL(length, stripped_key_length);
+        *result = key_string;
 
         return NO_ERROR;
 }
 
 /**
- * Read a value from the parser buffer
- *
- * The parser buffer will be pointing to the beginning of a string something
- * like this:
- *
- * = <value>
+ * Here we will handle the parsing of a generic value.
  *
- * We will need to ignore the EQUAL_CHAR and stripped the spaces around the
- * value. We will then return the string back to the caller who can deal with
- * turning it into a config_value
+ * The token is the first token of the value, for arrays the rest of the
+ * array is read as well
  */
-enum natwm_error parser_read_value(struct parser *parser, char **result, size_t *length)
+struct config_value *parser_parse_value(struct parser *parser, struct token token)
 {
-        enum natwm_error err = GENERIC_ERROR;
-        // We need to ignore the EQUAL_CHAR
-        const char *line = (parser->buffer + parser->pos) + 1;
-        char *value = NULL;
-        size_t end_pos = 0;
-
-        err = string_get_delimiter(line, '\n', &value, &end_pos, false);
-
-        if (err != NO_ERROR) {
-                LOG_ERROR(natwm_logger,
-                          "Failed to read item value - Line %zu Col: %zu",
-                          parser->line_num,
-                          parser->col_num);
-
-                return INVALID_INPUT_ERROR;
-        }
-
-        // Now we need to strip the surrounding spaces to be left with the value
-        // string
-
-        char *value_stripped = NULL;
-        size_t value_stripped_length = 0;
-
-        err = string_strip_surrounding_spaces(value, &value_stripped, &value_stripped_length);
-
-        if (err != NO_ERROR) {
-                LOG_ERROR(natwm_logger,
-                          "Found invalid item value - Line %zu Col: %zu",
-                          parser->line_num,
-                          parser->col_num);
-
-                free(value);
-
-                return INVALID_INPUT_ERROR;
-        }
-
-        // Free intermediate values
-        free(value);
-
-        // Update the parser position to the end of the line
-        parser_move(parser, end_pos);
-
-        *result = value_stripped;
-
-        SET_IF_NON_NULL(length, value_stripped_length);
-
-        return NO_ERROR;
+        return parser_parse_token(parser, token, 0);
 }
 
 /**
- * Handle creating a config_value from a string
+ * Handle creating a config_value from a line
  *
- * The parser will be pointing to the beginning of a line containing a
- * config value in the format:
+ * The key token will be the first token of a line containing a config value
+ * in the format:
  *
  * config_key = config_value
  *
@@ -909,43 +539,47 @@ enum natwm_error parser_read_value(struct parser *parser, char **result, size_t
  *
  * If the value starts with VARIABLE_START then  a lookup is performed
  * in the existing variables. If something is found then the value is
- * replaced by what was found - otherwise -1 is returned
+ * replaced by what was found - otherwise an error is returned
  *
- * These are used to create the returned config_value. If there is an
- * error while parsing then NULL is returned and no memory is left
- * allocated
+ * The value must be the last thing on the line. If there is an error while
+ * parsing then no memory is left allocated
  */
-enum natwm_error parser_read_item(struct parser *parser, char **key_result,
-                                  struct config_value **value_result)
+enum natwm_error parser_read_item(struct parser *parser, struct token key_token,
+                                  const char **key_result, struct config_value **value_result)
 {
         enum natwm_error err = GENERIC_ERROR;
-        char *key = NULL;
+        const char *key = NULL;
 
-        err = parser_read_key(parser, &key, NULL);
+        err = parser_read_key(parser, key_token, &key);
 
         if (err != NO_ERROR) {
                 return err;
         }
 
-        char *value = NULL;
-
-        err = parser_read_value(parser, &value, NULL);
+        struct config_value *config_value
+                = parser_parse_value(parser, lexer_next(&parser->lexer));
 
-        if (err != NO_ERROR) {
-                free(key);
+        if (config_value == NULL) {
+                LOG_ERROR(natwm_logger,
+                          "Failed to save '%s' - Line %zu",
+                          key,
+                          parser_get_line(parser, key_token.offset));
 
-                return err;
+                return GENERIC_ERROR;
         }
 
-        struct config_value *config_value = parser_parse_value(parser, value);
+        struct token end = lexer_next(&parser->lexer);
 
-        if (config_value == NULL) {
-                LOG_ERROR(natwm_logger, "Failed to save '%s' - Line %zu", key, parser->line_num);
+        if (end.kind != TOKEN_NEW_LINE && end.kind != TOKEN_END) {
+                LOG_ERROR(natwm_logger,
+                          "Unexpected %s after '%s' - Line %zu",
+                          lexer_token_kind_name(end.kind),
+                          key,
+                          parser_get_line(parser, end.offset));
 
-                free(key);
-                free(value);
+                config_value_destroy(config_value);
 
-                return GENERIC_ERROR;
+                return INVALID_INPUT_ERROR;
         }
 
         *key_result = key;
@@ -955,47 +589,27 @@ enum natwm_error parser_read_item(struct parser *parser, char **key_result,
 }
 
 /**
- * Increment the parser position one step. If the current position of
- * the parser is a new line make sure to update the column and line
- * numbers to represent the new location
+ * Read the next token of the configuration
  */
-void parser_increment(struct parser *parser)
+struct token parser_next_token(struct parser *parser)
 {
-        if (parser->pos > parser->buffer_size) {
-                return;
-        }
-
-        if (parser->buffer[parser->pos] == '\n') {
-                ++parser->line_num;
-                parser->col_num = 1;
-        } else {
-                ++parser->col_num;
-        }
-
-        ++parser->pos;
+        return lexer_next(&parser->lexer);
 }
 
 /**
- * Move the parser position forward a specified number of bytes
+ * Continue parsing from a new buffer
  *
- * This makes sure that the parser positioning stays intact
+ * Variables are kept, so a configuration can be parsed a piece at a time.
+ * line_base is the number of lines before the buffer, which keeps the line
+ * numbers in error messages relative to the whole configuration
  */
-void parser_move(struct parser *parser, size_t new_pos)
+void parser_set_buffer(struct parser *parser, const char *buffer, size_t buffer_size,
+                       size_t line_base)
 {
-        for (size_t i = 0; i < new_pos; ++i) {
-                parser_increment(parser);
-        }
-}
+        lexer_destroy(&parser->lexer);
+        lexer_init(&parser->lexer, buffer, buffer_size);
 
-/**
- * Consume the rest of a line in the configuration file.
- */
-void parser_consume_line(struct parser *parser)
-{
-        char c = '\0';
-        while ((c = parser->buffer[parser->pos]) != '\n' && c != '\0') {
-                parser_increment(parser);
-        }
+        parser->lexer.line_base = line_base;
 }
 
 void parser_destroy(struct parser *parser)
@@ -1004,5 +618,11 @@ void parser_destroy(struct parser *parser)
                 map_destroy(parser->variables);
         }
 
+        if (parser->array_items != NULL) {
+                config_value_vector_destroy(parser->array_items);
+        }
+
+        lexer_destroy(&parser->lexer);
+
         free(parser);
 }
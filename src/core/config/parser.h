@@ -7,16 +7,21 @@
 #include <stddef.h>
 
 #include <common/error.h>
+#include <common/string_view.h>
+#include <common/vector.h>
 
+#include "lexer.h"
 #include "value.h"
 
+#define PARSER_ARRAY_MAX_DEPTH 64
+
+VEC_DEFINE(config_value_vector, struct config_value *)
+
 struct parser {
-        const char *buffer;
-        size_t buffer_size;
-        size_t pos;
-        size_t line_num;
-        size_t col_num;
+        struct lexer lexer;
         struct map *variables;
+        // Items of the arrays being parsed, shared by every level of nesting
+        struct config_value_vector *array_items;
 };
 
 enum parser_token {
@@ -35,14 +40,13 @@ enum parser_token {
 enum parser_token char_to_token(char c);
 
 struct parser *parser_create(const char *buffer, size_t buffer_size);
-enum natwm_error parser_create_variable(struct parser *parser);
+enum natwm_error parser_create_variable(struct parser *parser, struct token token);
 const struct config_value *parser_find_variable(const struct parser *parser, const char *key);
-struct config_value *parser_parse_value(struct parser *parser, char *value);
-enum natwm_error parser_read_key(struct parser *parser, char **result, size_t *length);
-enum natwm_error parser_read_value(struct parser *parser, char **result, size_t *length);
-enum natwm_error parser_read_item(struct parser *parser, char **key_result,
-                                  struct config_value **value_result);
-void parser_increment(struct parser *parser);
-void parser_move(struct parser *parser, size_t new_pos);
-void parser_consume_line(struct parser *parser);
+struct config_value *parser_parse_value(struct parser *parser, struct token token);
+enum natwm_error parser_read_key(struct parser *parser, struct token token, const char **result);
+enum natwm_error parser_read_item(struct parser *parser, struct token key_token,
+                                  const char **key_result, struct config_value **value_result);
+struct token parser_next_token(struct parser *parser);
+void parser_set_buffer(struct parser *parser, const char *buffer, size_t buffer_size,
+                       size_t line_base);
 void parser_destroy(struct parser *parser);
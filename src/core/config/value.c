@@ -6,7 +6,6 @@
 #include <string.h>
 
 #include <common/logger.h>
-#include <common/string.h>
 
 #include "value.h"
 
@@ -119,7 +118,7 @@ struct config_value *config_value_create_number(intmax_t number)
         return value;
 }
 
-struct config_value *config_value_create_string(char *string)
+struct config_value *config_value_create_string(const char *string)
 {
         struct config_value *value = malloc(sizeof(struct config_value));
 
@@ -157,11 +156,8 @@ struct config_value *config_value_duplicate(const struct config_value *value)
 
                 break;
         case STRING:
-                new_value->data.string = string_init(value->data.string);
-
-                if (new_value->data.string == NULL) {
-                        goto free_and_error;
-                }
+                // Interned strings are shared rather than copied
+                new_value->data.string = value->data.string;
 
                 break;
         case NUMBER:
@@ -182,11 +178,6 @@ free_and_error:
 
 void config_value_destroy(struct config_value *value)
 {
-        if (value->type == STRING) {
-                // For strings we need to free the data as well
-                free(value->data.string);
-        }
-
         if (value->type == ARRAY && value->data.array != NULL) {
                 config_array_destroy(value->data.array);
         }
@@ -37,8 +37,8 @@ struct config_value {
         union {
                 bool boolean;
                 intmax_t number;
-                // Heap allocated - must be free'd
-                char *string;
+                // Interned - compare by pointer, never free'd
+                const char *string;
                 struct config_array *array;
         } data;
 };
@@ -48,7 +48,7 @@ void config_array_destroy(struct config_array *array);
 struct config_value *config_value_create_array(size_t length);
 struct config_value *config_value_create_boolean(bool boolean);
 struct config_value *config_value_create_number(intmax_t number);
-struct config_value *config_value_create_string(char *string);
+struct config_value *config_value_create_string(const char *string);
 struct config_value *config_value_duplicate(const struct config_value *value);
 
 void config_value_destroy(struct config_value *value);
@@ -13,6 +13,7 @@
 #include <core/client.h>
 #include <core/ewmh.h>
 #include <core/monitor.h>
+#include <core/reload.h>
 
 #include "event.h"
 #include "randr-event.h"
@@ -66,6 +67,8 @@ static enum natwm_error event_handle_client_message(struct natwm_state *state,
                 if (state_atom == state->ewmh->_NET_WM_STATE_FULLSCREEN) {
                         return client_handle_fullscreen_window(state, action, window);
                 }
+        } else if (event->type == state->config_reload->atom) {
+                config_reload_request(state);
         }
 
         return NO_ERROR;
@@ -176,13 +176,12 @@ void ewmh_update_active_window(const struct natwm_state *state, xcb_window_t win
 
 void ewmh_update_desktop_viewport(const struct natwm_state *state, const struct monitor_list *list)
 {
-        size_t num_monitors = list->monitors->size;
+        size_t num_monitors = list->monitors->length;
         xcb_ewmh_coordinates_t viewports[num_monitors];
         size_t index = 0;
 
-        LIST_FOR_EACH(list->monitors, monitor_item)
+        VEC_FOR_EACH(list->monitors, struct monitor, monitor)
         {
-                struct monitor *monitor = (struct monitor *)monitor_item->data;
                 xcb_rectangle_t rect = monitor_get_offset_rect(monitor);
 
                 viewports[index].x = (uint32_t)rect.x;
@@ -19,71 +19,83 @@
 #include "randr.h"
 #include "xinerama.h"
 
-static void monitors_destroy(struct list *monitors)
-{
-        LIST_FOR_EACH(monitors, item)
-        {
-                struct monitor *monitor = (struct monitor *)item->data;
-
-                monitor_destroy(monitor);
-        }
-}
-
-static void monitor_list_set_offsets(const struct natwm_state *state,
-                                     struct monitor_list *monitor_list)
+static struct config_key offsets_key = CONFIG_KEY_INIT("monitor.offsets");
+
+/**
+ * Find the 'monitor.offsets' array. Returns NULL when there are no offsets to
+ * apply to the monitors
+ */
+static const struct config_array *find_offset_array(const struct map *config,
+                                                    const struct monitor_list *monitor_list)
 {
         const struct config_array *offset_array = NULL;
 
-        config_find_array(state->config, "monitor.offsets", &offset_array);
+        config_find_key_array(config, &offsets_key, &offset_array);
 
         if (offset_array == NULL || offset_array->length == 0) {
                 // Nothing to do here
-                return;
-        } else if (monitor_list->monitors->size > offset_array->length) {
+                return NULL;
+        } else if (monitor_list->monitors->length > offset_array->length) {
                 LOG_WARNING(natwm_logger,
                             "Encountered more monitors than items in "
                             "'monitor.offsets' array. Ignoring offsets");
 
-                return;
+                return NULL;
         }
 
-        size_t index = 0;
+        return offset_array;
+}
 
-        LIST_FOR_EACH(monitor_list->monitors, monitor_item)
-        {
-                struct monitor *monitor = (struct monitor *)monitor_item->data;
-                // By default we will have no offset
-                struct box_sizes offsets = {
-                        .top = 0,
-                        .right = 0,
-                        .bottom = 0,
-                        .left = 0,
-                };
+// Resolve the offsets of the monitor at index. Monitors without a valid offset
+// get no offset
+static struct box_sizes monitor_offsets_from_config(const struct config_array *offset_array,
+                                                    size_t index)
+{
+        struct box_sizes offsets = {
+                .top = 0,
+                .right = 0,
+                .bottom = 0,
+                .left = 0,
+        };
 
-                const struct config_value *offset_array_value = offset_array->values[index];
+        if (offset_array == NULL) {
+                return offsets;
+        }
 
-                if (offset_array_value->type != ARRAY) {
-                        LOG_WARNING(natwm_logger, "Skipping invalid monitor offset value");
-                        continue;
-                }
+        const struct config_value *offset_array_value = offset_array->values[index];
 
-                enum natwm_error err
-                        = config_array_to_box_sizes(offset_array_value->data.array, &offsets);
+        if (offset_array_value->type != ARRAY
+            || config_array_to_box_sizes(offset_array_value->data.array, &offsets) != NO_ERROR) {
+                LOG_WARNING(natwm_logger, "Skipping invalid monitor offset value");
+        }
 
-                if (err != NO_ERROR) {
-                        LOG_WARNING(natwm_logger, "Skipping invalid monitor offset value");
-                        break;
-                }
+        return offsets;
+}
 
-                monitor->offsets = offsets;
+static void monitor_list_set_offsets(const struct natwm_state *state,
+                                     struct monitor_list *monitor_list)
+{
+        const struct config_array *offset_array = find_offset_array(state->config, monitor_list);
+        size_t index = 0;
+
+        VEC_FOR_EACH(monitor_list->monitors, struct monitor, monitor)
+        {
+                monitor->offsets = monitor_offsets_from_config(offset_array, index);
 
                 ++index;
         }
 }
 
-static enum natwm_error monitors_from_randr(const struct natwm_state *state, struct list **result)
+static bool box_sizes_equal(struct box_sizes one, struct box_sizes two)
 {
-        struct list *monitor_list = list_create();
+        return one.top == two.top && one.right == two.right && one.bottom == two.bottom
+                && one.left == two.left;
+}
+
+static enum natwm_error monitors_from_randr(const struct natwm_state *state,
+                                            struct monitor_vector **result)
+{
+        struct monitor_vector *monitor_list = monitor_vector_create();
 
         if (monitor_list == NULL) {
                 return MEMORY_ALLOCATION_ERROR;
@@ -94,7 +106,7 @@ static enum natwm_error monitors_from_randr(const struct natwm_state *state, str
         enum natwm_error err = randr_get_screens(state, &monitors, &monitor_length);
 
         if (err != NO_ERROR) {
-                list_destroy(monitor_list);
+                monitor_vector_destroy(monitor_list);
 
                 return err;
         }
@@ -109,19 +121,23 @@ static enum natwm_error monitors_from_randr(const struct natwm_state *state, str
                         continue;
                 }
 
-                struct monitor *monitor
-                        = monitor_create(randr_monitor->id, randr_monitor->rect, NULL);
+                err = monitor_vector_add(monitor_list, randr_monitor->id, randr_monitor->rect);
 
-                if (monitor == NULL) {
-                        monitors_destroy(monitor_list);
-                        list_destroy(monitor_list);
+                randr_monitor_destroy(randr_monitor);
 
-                        return MEMORY_ALLOCATION_ERROR;
-                }
+                if (err != NO_ERROR) {
+                        // Release the monitors we haven't reached yet
+                        for (size_t j = i + 1; j < monitor_length; ++j) {
+                                if (monitors[j] != NULL) {
+                                        randr_monitor_destroy(monitors[j]);
+                                }
+                        }
 
-                list_insert(monitor_list, monitor);
+                        free(monitors);
+                        monitor_vector_destroy(monitor_list);
 
-                randr_monitor_destroy(randr_monitor);
+                        return err;
+                }
         }
 
         free(monitors);
@@ -132,9 +148,9 @@ static enum natwm_error monitors_from_randr(const struct natwm_state *state, str
 }
 
 static enum natwm_error monitors_from_xinerama(const struct natwm_state *state,
-                                               struct list **result)
+                                               struct monitor_vector **result)
 {
-        struct list *monitor_list = list_create();
+        struct monitor_vector *monitor_list = monitor_vector_create();
 
         if (monitor_list == NULL) {
                 return MEMORY_ALLOCATION_ERROR;
@@ -145,23 +161,22 @@ static enum natwm_error monitors_from_xinerama(const struct natwm_state *state,
         enum natwm_error err = xinerama_get_screens(state, &rects, &monitor_length);
 
         if (err != NO_ERROR) {
-                list_destroy(monitor_list);
+                monitor_vector_destroy(monitor_list);
 
                 return err;
         }
 
-        for (size_t i = 0; i < monitor_length; ++i) {
-                struct monitor *monitor = monitor_create((uint32_t)i, rects[i], NULL);
+        err = monitor_vector_reserve(monitor_list, monitor_length);
 
-                if (monitor == NULL) {
-                        monitors_destroy(monitor_list);
-                        list_destroy(monitor_list);
-                        free(rects);
+        for (size_t i = 0; i < monitor_length && err == NO_ERROR; ++i) {
+                err = monitor_vector_add(monitor_list, (uint32_t)i, rects[i]);
+        }
 
-                        return MEMORY_ALLOCATION_ERROR;
-                }
+        if (err != NO_ERROR) {
+                monitor_vector_destroy(monitor_list);
+                free(rects);
 
-                list_insert(monitor_list, monitor);
+                return err;
         }
 
         free(rects);
@@ -171,9 +186,10 @@ static enum natwm_error monitors_from_xinerama(const struct natwm_state *state,
         return NO_ERROR;
 }
 
-static enum natwm_error monitor_from_x(const struct natwm_state *state, struct list **result)
+static enum natwm_error monitor_from_x(const struct natwm_state *state,
+                                       struct monitor_vector **result)
 {
-        struct list *monitor_list = list_create();
+        struct monitor_vector *monitor_list = monitor_vector_create();
 
         if (monitor_list == NULL) {
                 return MEMORY_ALLOCATION_ERROR;
@@ -186,16 +202,12 @@ static enum natwm_error monitor_from_x(const struct natwm_state *state, struct l
                 .height = state->screen->height_in_pixels,
         };
 
-        struct monitor *monitor = monitor_create(0, rect, NULL);
-
-        if (monitor == NULL) {
-                list_destroy(monitor_list);
+        if (monitor_vector_add(monitor_list, 0, rect) != NO_ERROR) {
+                monitor_vector_destroy(monitor_list);
 
                 return MEMORY_ALLOCATION_ERROR;
         }
 
-        list_insert(monitor_list, monitor);
-
         *result = monitor_list;
 
         return NO_ERROR;
@@ -249,7 +261,8 @@ const char *server_extension_to_string(enum server_extension_type extension)
         }
 }
 
-struct monitor_list *monitor_list_create(struct server_extension *extension, struct list *monitors)
+struct monitor_list *monitor_list_create(struct server_extension *extension,
+                                         struct monitor_vector *monitors)
 {
         struct monitor_list *list = malloc(sizeof(struct monitor_list));
 
@@ -265,10 +278,8 @@ struct monitor_list *monitor_list_create(struct server_extension *extension, str
 
 struct monitor *monitor_list_get_active_monitor(const struct monitor_list *monitor_list)
 {
-        LIST_FOR_EACH(monitor_list->monitors, monitor_item)
+        VEC_FOR_EACH(monitor_list->monitors, struct monitor, monitor)
         {
-                struct monitor *monitor = (struct monitor *)monitor_item->data;
-
                 if (monitor->workspace != NULL && monitor->workspace->is_focused) {
                         return monitor;
                 }
@@ -284,10 +295,8 @@ struct monitor *monitor_list_get_workspace_monitor(const struct monitor_list *mo
                 return NULL;
         }
 
-        LIST_FOR_EACH(monitor_list->monitors, monitor_item)
+        VEC_FOR_EACH(monitor_list->monitors, struct monitor, monitor)
         {
-                struct monitor *monitor = (struct monitor *)monitor_item->data;
-
                 if (monitor->workspace == NULL) {
                         continue;
                 }
@@ -300,19 +309,23 @@ struct monitor *monitor_list_get_workspace_monitor(const struct monitor_list *mo
         return NULL;
 }
 
-struct monitor *monitor_create(uint32_t id, xcb_rectangle_t rect, struct workspace *workspace)
+// Add a monitor without offsets or a workspace to the end of monitors
+enum natwm_error monitor_vector_add(struct monitor_vector *monitors, uint32_t id,
+                                    xcb_rectangle_t rect)
 {
-        struct monitor *monitor = malloc(sizeof(struct monitor));
-
-        if (monitor == NULL) {
-                return NULL;
-        }
-
-        monitor->id = id;
-        monitor->rect = rect;
-        monitor->workspace = workspace;
+        struct monitor monitor = {
+                .id = id,
+                .rect = rect,
+                .offsets = {
+                        .top = 0,
+                        .right = 0,
+                        .bottom = 0,
+                        .left = 0,
+                },
+                .workspace = NULL,
+        };
 
-        return monitor;
+        return monitor_vector_push(monitors, monitor);
 }
 
 enum natwm_error monitor_setup(const struct natwm_state *state, struct monitor_list **result)
@@ -323,10 +336,10 @@ enum natwm_error monitor_setup(const struct natwm_state *state, struct monitor_l
                 return MEMORY_ALLOCATION_ERROR;
         }
 
-        // Resolve monitors from any extension into a linked list of generic
+        // Resolve monitors from any extension into a vector of generic
         // monitors.
         enum natwm_error err = GENERIC_ERROR;
-        struct list *monitors = NULL;
+        struct monitor_vector *monitors = NULL;
 
         if (extension->type == RANDR) {
                 err = monitors_from_randr(state, &monitors);
@@ -346,12 +359,13 @@ enum natwm_error monitor_setup(const struct natwm_state *state, struct monitor_l
                 return err;
         }
 
-        if (monitors->size == 0) {
+        if (monitor_vector_is_empty(monitors)) {
                 LOG_ERROR(natwm_logger,
                           "Failed to find a %s screen",
                           server_extension_to_string(extension->type));
 
                 free(extension);
+                monitor_vector_destroy(monitors);
 
                 return INVALID_INPUT_ERROR;
         }
@@ -360,7 +374,7 @@ enum natwm_error monitor_setup(const struct natwm_state *state, struct monitor_l
 
         if (monitor_list == NULL) {
                 free(extension);
-                list_destroy(monitors);
+                monitor_vector_destroy(monitors);
 
                 return MEMORY_ALLOCATION_ERROR;
         }
@@ -375,6 +389,44 @@ enum natwm_error monitor_setup(const struct natwm_state *state, struct monitor_l
         return NO_ERROR;
 }
 
+/**
+ * Read the monitor offsets again after the configuration has been replaced.
+ * Only monitors whose offsets changed have the clients of their workspace
+ * clamped again. Returns true when any offsets changed
+ */
+bool monitor_list_update_offsets(const struct natwm_state *state,
+                                 struct monitor_list *monitor_list)
+{
+        const struct config_array *offset_array = find_offset_array(state->config, monitor_list);
+        size_t index = 0;
+        bool has_changed = false;
+
+        VEC_FOR_EACH(monitor_list->monitors, struct monitor, monitor)
+        {
+                struct box_sizes offsets = monitor_offsets_from_config(offset_array, index);
+
+                ++index;
+
+                if (box_sizes_equal(monitor->offsets, offsets)) {
+                        continue;
+                }
+
+                monitor->offsets = offsets;
+
+                if (monitor->workspace != NULL) {
+                        workspace_clamp_clients(state, monitor->workspace, monitor);
+                }
+
+                has_changed = true;
+        }
+
+        if (has_changed) {
+                ewmh_update_desktop_viewport(state, monitor_list);
+        }
+
+        return has_changed;
+}
+
 xcb_rectangle_t monitor_clamp_client_rect(const struct monitor *monitor,
                                           xcb_rectangle_t client_rect)
 {
@@ -454,12 +506,6 @@ xcb_rectangle_t monitor_get_offset_rect(const struct monitor *monitor)
 void monitor_list_destroy(struct monitor_list *monitor_list)
 {
         free(monitor_list->extension);
-        monitors_destroy(monitor_list->monitors);
-        list_destroy(monitor_list->monitors);
+        monitor_vector_destroy(monitor_list->monitors);
         free(monitor_list);
 }
-
-void monitor_destroy(struct monitor *monitor)
-{
-        free(monitor);
-}
@@ -4,10 +4,11 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include <xcb/xcb.h>
 
-#include <common/list.h>
 #include <common/types.h>
+#include <common/vector.h>
 
 #include "state.h"
 #include "workspace.h"
@@ -35,22 +36,32 @@ struct monitor {
         struct workspace *workspace;
 };
 
+VEC_DEFINE(monitor_vector, struct monitor)
+
+/**
+ * Monitors are stored by value in the order they were reported by the
+ * extension. The vector is only filled during setup, so pointers to monitors
+ * stay valid for the lifetime of the monitor list
+ */
 struct monitor_list {
         struct server_extension *extension;
-        struct list *monitors;
+        struct monitor_vector *monitors;
 };
 
 struct server_extension *server_extension_detect(xcb_connection_t *connection);
 const char *server_extension_to_string(enum server_extension_type extension);
 
-struct monitor_list *monitor_list_create(struct server_extension *extension, struct list *monitors);
+struct monitor_list *monitor_list_create(struct server_extension *extension,
+                                         struct monitor_vector *monitors);
 struct monitor *monitor_list_get_active_monitor(const struct monitor_list *monitor_list);
 struct monitor *monitor_list_get_workspace_monitor(const struct monitor_list *monitor_list,
                                                    const struct workspace *workspace);
-struct monitor *monitor_create(uint32_t id, xcb_rectangle_t rect, struct workspace *workspace);
+enum natwm_error monitor_vector_add(struct monitor_vector *monitors, uint32_t id,
+                                    xcb_rectangle_t rect);
 enum natwm_error monitor_setup(const struct natwm_state *state, struct monitor_list **result);
+bool monitor_list_update_offsets(const struct natwm_state *state,
+                                 struct monitor_list *monitor_list);
 xcb_rectangle_t monitor_clamp_client_rect(const struct monitor *monitor,
                                           xcb_rectangle_t client_rect);
 xcb_rectangle_t monitor_get_offset_rect(const struct monitor *monitor);
 void monitor_list_destroy(struct monitor_list *monitor_list);
-void monitor_destroy(struct monitor *monitor);
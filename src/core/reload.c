@@ -0,0 +1,247 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <common/constants.h>
+#include <common/int_map.h>
+#include <common/logger.h>
+#include <common/theme.h>
+
+#include "config/config.h"
+#include "monitor.h"
+#include "reload.h"
+#include "workspace.h"
+
+// A configuration read from a pipe has been consumed and can't be read again
+static bool is_reloadable_path(const char *path)
+{
+        struct stat path_stat;
+
+        if (path == NULL) {
+                // The default configuration file
+                return true;
+        }
+
+        return stat(path, &path_stat) == 0 && S_ISREG(path_stat.st_mode);
+}
+
+static void *config_reload_thread(void *passed_state)
+{
+        struct natwm_state *state = (struct natwm_state *)passed_state;
+        struct config_reload *reload = state->config_reload;
+        struct map *config = config_initialize_path(state->config_path);
+
+        pthread_mutex_lock(&reload->mutex);
+
+        reload->config = config;
+        reload->is_finished = true;
+
+        pthread_mutex_unlock(&reload->mutex);
+
+        return NULL;
+}
+
+struct config_reload *config_reload_create(xcb_connection_t *connection)
+{
+        xcb_intern_atom_cookie_t cookie = xcb_intern_atom(connection,
+                                                          0,
+                                                          (uint16_t)strlen(NATWM_RELOAD_ATOM_NAME),
+                                                          NATWM_RELOAD_ATOM_NAME);
+        xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(connection, cookie, NULL);
+
+        if (reply == NULL) {
+                return NULL;
+        }
+
+        struct config_reload *reload = malloc(sizeof(struct config_reload));
+
+        if (reload == NULL) {
+                free(reply);
+
+                return NULL;
+        }
+
+        reload->atom = reply->atom;
+
+        free(reply);
+
+        if (pthread_mutex_init(&reload->mutex, NULL) != 0) {
+                free(reload);
+
+                return NULL;
+        }
+
+        reload->is_loading = false;
+        reload->is_finished = false;
+        reload->is_requested = false;
+        reload->config = NULL;
+
+        return reload;
+}
+
+/**
+ * Start reading the configuration on a separate thread. When a reload is
+ * already in progress another one is started once it finishes, since the
+ * file may have changed after it was read
+ */
+void config_reload_request(struct natwm_state *state)
+{
+        struct config_reload *reload = state->config_reload;
+
+        if (!is_reloadable_path(state->config_path)) {
+                LOG_WARNING(natwm_logger,
+                            "Unable to reload configuration from '%s'",
+                            state->config_path);
+
+                return;
+        }
+
+        pthread_mutex_lock(&reload->mutex);
+
+        if (reload->is_loading) {
+                reload->is_requested = true;
+
+                pthread_mutex_unlock(&reload->mutex);
+
+                return;
+        }
+
+        reload->is_loading = true;
+        reload->is_finished = false;
+
+        if (pthread_create(&reload->thread, NULL, config_reload_thread, state) != 0) {
+                LOG_ERROR(natwm_logger, "Failed to start configuration reload");
+
+                reload->is_loading = false;
+        }
+
+        pthread_mutex_unlock(&reload->mutex);
+}
+
+/**
+ * Called from the event loop. Once the reload thread has finished its
+ * configuration is applied on the event loop thread, which owns the state
+ */
+void config_reload_poll(struct natwm_state *state)
+{
+        struct config_reload *reload = state->config_reload;
+
+        pthread_mutex_lock(&reload->mutex);
+
+        if (!reload->is_finished) {
+                pthread_mutex_unlock(&reload->mutex);
+
+                return;
+        }
+
+        struct map *config = reload->config;
+        bool is_requested = reload->is_requested;
+
+        reload->config = NULL;
+        reload->is_loading = false;
+        reload->is_finished = false;
+        reload->is_requested = false;
+
+        pthread_mutex_unlock(&reload->mutex);
+
+        pthread_join(reload->thread, NULL);
+
+        if (config == NULL) {
+                LOG_ERROR(natwm_logger,
+                          "Failed to reload configuration - Keeping the current configuration");
+        } else {
+                config_reload_apply(state, config);
+        }
+
+        if (is_requested) {
+                config_reload_request(state);
+        }
+}
+
+/**
+ * Replace the current configuration with config, which is owned by the state
+ * afterwards
+ *
+ * The new theme is created before anything is replaced, so a configuration
+ * with an invalid theme leaves everything as it was. After the swap each part
+ * of the configuration is compared with what is applied:
+ *
+ * - Theme: Clients whose border color or width changed get only those
+ *   attributes updated. No client is moved, resized or mapped
+ * - Monitor offsets: Clients on monitors whose offsets changed are clamped to
+ *   the new offsets
+ * - Workspace names: The desktop names are updated
+ */
+enum natwm_error config_reload_apply(struct natwm_state *state, struct map *config)
+{
+        struct theme *theme = theme_create(config);
+
+        if (theme == NULL) {
+                LOG_ERROR(natwm_logger,
+                          "Failed to reload configuration - Keeping the current configuration");
+
+                config_destroy(config);
+
+                return INVALID_INPUT_ERROR;
+        }
+
+        struct map *previous_config = (struct map *)state->config;
+        struct theme *previous_theme = state->workspace_list->theme;
+
+        natwm_state_lock(state);
+
+        state->config = config;
+        state->workspace_list->theme = theme;
+
+        natwm_state_unlock(state);
+
+        enum theme_change theme_change = theme_diff(previous_theme, theme);
+
+        // The resize colors are read each time a resize starts, so there is
+        // nothing to send when only they changed
+        if (theme_change & (THEME_BORDER_WIDTH_CHANGED | THEME_BORDER_COLOR_CHANGED)) {
+                workspace_list_apply_theme(state, state->workspace_list, previous_theme);
+        }
+
+        bool offsets_changed = monitor_list_update_offsets(state, state->monitor_list);
+        bool names_changed = workspace_list_update_names(state, state->workspace_list);
+
+        LOG_INFO(natwm_logger,
+                 "Reloaded configuration (theme %s, monitor offsets %s, workspace names %s)",
+                 (theme_change != THEME_UNCHANGED) ? "changed" : "unchanged",
+                 offsets_changed ? "changed" : "unchanged",
+                 names_changed ? "changed" : "unchanged");
+
+        struct map_stats client_stats;
+
+        int_map_get_stats(state->workspace_list->client_map, &client_stats);
+        log_map_stats("Client map", &client_stats);
+
+        // Everything which outlives a configuration is copied or interned, so
+        // nothing refers to the previous one anymore
+        theme_destroy(previous_theme);
+        config_destroy(previous_config);
+
+        xcb_flush(state->xcb);
+
+        return NO_ERROR;
+}
+
+void config_reload_destroy(struct config_reload *reload)
+{
+        if (reload->is_loading) {
+                pthread_join(reload->thread, NULL);
+        }
+
+        if (reload->config != NULL) {
+                config_destroy(reload->config);
+        }
+
+        pthread_mutex_destroy(&reload->mutex);
+
+        free(reload);
+}
@@ -0,0 +1,42 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <xcb/xcb.h>
+
+#include <common/error.h>
+#include <common/map.h>
+
+#include "state.h"
+
+/**
+ * Reloading the configuration while running
+ *
+ * A reload is requested with SIGHUP or a _NATWM_RELOAD client message sent to
+ * the root window. The configuration is read and parsed on a separate thread
+ * so the event loop keeps handling events. Once it is ready the event loop
+ * swaps it in and compares the result with what is currently applied, only
+ * sending requests to the X server for the parts that changed
+ *
+ * A configuration which can't be read or doesn't produce a valid theme is
+ * discarded and the current configuration stays in place
+ */
+struct config_reload {
+        xcb_atom_t atom; // _NATWM_RELOAD
+        pthread_mutex_t mutex;
+        pthread_t thread;
+        bool is_loading;
+        bool is_finished; // The thread is done and can be joined
+        bool is_requested; // Another reload was requested while loading
+        struct map *config; // Result of the finished thread
+};
+
+struct config_reload *config_reload_create(xcb_connection_t *connection);
+void config_reload_request(struct natwm_state *state);
+void config_reload_poll(struct natwm_state *state);
+enum natwm_error config_reload_apply(struct natwm_state *state, struct map *config);
+void config_reload_destroy(struct config_reload *reload);
@@ -7,6 +7,7 @@
 #include "config/config.h"
 #include "ewmh.h"
 #include "monitor.h"
+#include "reload.h"
 #include "workspace.h"
 
 struct natwm_state *natwm_state_create(void)
@@ -26,6 +27,7 @@ struct natwm_state *natwm_state_create(void)
         state->workspace_list = NULL;
         state->config = NULL;
         state->config_path = NULL;
+        state->config_reload = NULL;
 
         // Initialize mutex
         if (pthread_mutex_init(&state->mutex, NULL) != 0) {
@@ -64,6 +66,12 @@ void natwm_state_destroy(struct natwm_state *state)
                 button_state_destroy(state);
         }
 
+        // A reload in progress has to finish before the configuration it
+        // would replace is destroyed
+        if (state->config_reload != NULL) {
+                config_reload_destroy(state->config_reload);
+        }
+
         if (state->workspace_list != NULL) {
                 workspace_list_destroy(state->workspace_list);
         }
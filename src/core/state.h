@@ -13,6 +13,7 @@
 
 // Forward declare needed types
 struct button_state;
+struct config_reload;
 struct monitor_list;
 struct workspace_list;
 
@@ -26,6 +27,7 @@ struct natwm_state {
         struct workspace_list *workspace_list;
         const struct map *config;
         const char *config_path;
+        struct config_reload *config_reload;
         pthread_mutex_t mutex;
 };
 
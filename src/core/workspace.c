@@ -4,10 +4,10 @@
 
 #include <assert.h>
 #include <stdlib.h>
-#include <string.h>
 #include <xcb/xcb.h>
 
 #include <common/constants.h>
+#include <common/intern.h>
 #include <common/logger.h>
 
 #include "config/config.h"
@@ -28,26 +28,11 @@ static const char *DEFAULT_WORKSPACE_NAMES[10] = {
         "ten",
 };
 
-static size_t get_client_list_key_size(const void *window)
-{
-        UNUSED_FUNCTION_PARAM(window);
-
-        return sizeof(xcb_window_t *);
-}
+static struct config_key workspace_names_key = CONFIG_KEY_INIT("workspaces");
 
-static bool compare_windows(const void *one, const void *two, size_t key_size)
+static struct client *get_client_from_link(struct list_link *link)
 {
-        UNUSED_FUNCTION_PARAM(key_size);
-
-        xcb_window_t window_one = *(xcb_window_t *)one;
-        xcb_window_t window_two = *(xcb_window_t *)two;
-
-        return window_one == window_two;
-}
-
-static struct client *get_client_from_client_node(struct node *client_node)
-{
-        return (struct client *)client_node->data;
+        return INTRUSIVE_LIST_ENTRY(link, struct client, workspace_link);
 }
 
 /**
@@ -61,10 +46,8 @@ static struct client *get_client_from_client_node(struct node *client_node)
 static void attach_to_monitors(struct monitor_list *monitor_list,
                                struct workspace_list *workspace_list)
 {
-        size_t index = 0;
-        LIST_FOR_EACH(monitor_list->monitors, monitor_item)
-        {
-                struct monitor *monitor = (struct monitor *)monitor_item->data;
+        for (size_t index = 0; index < monitor_list->monitors->length; ++index) {
+                struct monitor *monitor = monitor_vector_at(monitor_list->monitors, index);
                 struct workspace *workspace = workspace_list_get_workspace(workspace_list, index);
 
                 if (workspace == NULL) {
@@ -81,22 +64,21 @@ static void attach_to_monitors(struct monitor_list *monitor_list,
 
                 workspace->is_visible = true;
                 monitor->workspace = workspace;
-
-                ++index;
         }
 }
 
 /**
  * Given a list of workspace names attempt to find a user specified workspace
- * name and initialize a new workspace with that name. If there is no name, or
- * it is invalid then create a new workspace with the default name
+ * name for the workspace at index. If there is no name, or it is invalid then
+ * return the default name
  */
-static struct workspace *workspace_init(const struct config_array *workspace_names, size_t index)
+static const char *workspace_name_from_config(const struct config_array *workspace_names,
+                                              size_t index)
 {
         const char *name = DEFAULT_WORKSPACE_NAMES[index];
 
         if (workspace_names == NULL || index >= workspace_names->length) {
-                goto create_default_named_workspace;
+                return name;
         }
 
         const struct config_value *name_value = workspace_names->values[index];
@@ -104,24 +86,24 @@ static struct workspace *workspace_init(const struct config_array *workspace_nam
         if (name_value == NULL || name_value->type != STRING) {
                 LOG_WARNING(natwm_logger, "Ignoring invalid workspace name", name);
 
-                goto create_default_named_workspace;
+                return name;
         }
 
-        if (strlen(name_value->data.string) > NATWM_WORKSPACE_NAME_MAX_LEN) {
+        if (intern_get_length(name_value->data.string) > NATWM_WORKSPACE_NAME_MAX_LEN) {
                 LOG_WARNING(natwm_logger,
                             "Workspace name '%s' is too long. Max length is %zu",
                             name_value->data.string,
                             NATWM_WORKSPACE_NAME_MAX_LEN);
 
-                goto create_default_named_workspace;
+                return name;
         }
 
-        return workspace_create(name_value->data.string, index);
+        return name_value->data.string;
+}
 
-create_default_named_workspace:
-        // We couldn't find a valid user specified workspace name - fall back
-        // to using one from DEFAULT_WORKSPACE_NAMES
-        return workspace_create(name, index);
+static struct workspace *workspace_init(const struct config_array *workspace_names, size_t index)
+{
+        return workspace_create(workspace_name_from_config(workspace_names, index), index);
 }
 
 static void client_show(const struct natwm_state *state, const struct monitor *monitor,
@@ -136,11 +118,11 @@ static void client_show(const struct natwm_state *state, const struct monitor *m
 static void workspace_send_to_monitor(struct natwm_state *state, struct workspace *workspace,
                                       struct monitor *monitor)
 {
-        LIST_FOR_EACH(workspace->clients, node)
+        INTRUSIVE_LIST_FOR_EACH(&workspace->clients, link)
         {
-                struct client *client = get_client_from_client_node(node);
+                struct client *client = get_client_from_link(link);
 
-                if (client == NULL || client->state & CLIENT_HIDDEN) {
+                if (client->state & CLIENT_HIDDEN) {
                         continue;
                 }
 
@@ -172,11 +154,11 @@ static void workspace_hide(const struct natwm_state *state, struct workspace *wo
         workspace->is_focused = false;
         workspace->is_visible = false;
 
-        LIST_FOR_EACH(workspace->clients, node)
+        INTRUSIVE_LIST_FOR_EACH(&workspace->clients, link)
         {
-                struct client *client = get_client_from_client_node(node);
+                struct client *client = get_client_from_link(link);
 
-                if (client == NULL || client->state & CLIENT_HIDDEN) {
+                if (client->state & CLIENT_HIDDEN) {
                         continue;
                 }
 
@@ -184,21 +166,16 @@ static void workspace_hide(const struct natwm_state *state, struct workspace *wo
         }
 }
 
-static struct node *get_client_node_from_client(struct list *client_list, struct client *client)
+// Check if a client is in the client list of a workspace without walking the
+// list
+static bool workspace_has_client(const struct natwm_state *state,
+                                 const struct workspace *workspace, const struct client *client)
 {
-        LIST_FOR_EACH(client_list, node)
-        {
-                struct client *client_item = get_client_from_client_node(node);
-
-                if (client->window == client_item->window) {
-                        return node;
-                }
-        }
-
-        return NULL;
+        return client->workspace == workspace
+                && int_map_get(state->workspace_list->client_map, client->window) == client;
 }
 
-static void focus_client(struct natwm_state *state, struct workspace *workspace, struct node *node,
+static void focus_client(struct natwm_state *state, struct workspace *workspace,
                          struct client *client)
 {
         if (workspace->active_client) {
@@ -207,7 +184,7 @@ static void focus_client(struct natwm_state *state, struct workspace *workspace,
 
         workspace->active_client = client;
 
-        list_move_node_to_head(workspace->clients, node);
+        intrusive_list_move_to_head(&workspace->clients, &client->workspace_link);
 
         client_set_focused(state, client);
 }
@@ -229,19 +206,23 @@ struct workspace *workspace_create(const char *name, size_t index)
                 return NULL;
         }
 
-        workspace->name = name;
-        workspace->index = index;
-        workspace->is_visible = false;
-        workspace->is_focused = false;
-        workspace->clients = list_create();
-        workspace->active_client = NULL;
+        // Names are interned so they outlive the configuration they came
+        // from and can be compared by pointer
+        workspace->name = intern_string(name);
 
-        if (workspace->clients == NULL) {
+        if (workspace->name == NULL) {
                 free(workspace);
 
                 return NULL;
         }
 
+        workspace->index = index;
+        workspace->is_visible = false;
+        workspace->is_focused = false;
+        workspace->active_client = NULL;
+
+        intrusive_list_init(&workspace->clients);
+
         return workspace;
 }
 
@@ -255,7 +236,7 @@ struct workspace_list *workspace_list_create(size_t count)
 
         workspace_list->count = count;
         workspace_list->theme = NULL;
-        workspace_list->client_map = map_init();
+        workspace_list->client_map = int_map_create();
 
         if (workspace_list->client_map == NULL) {
                 free(workspace_list);
@@ -263,13 +244,21 @@ struct workspace_list *workspace_list_create(size_t count)
                 return NULL;
         }
 
-        map_set_key_compare_function(workspace_list->client_map, compare_windows);
-        map_set_key_size_function(workspace_list->client_map, get_client_list_key_size);
+        workspace_list->client_pool = pool_create(sizeof(struct client), POOL_DEFAULT_CHUNK_LENGTH);
+
+        if (workspace_list->client_pool == NULL) {
+                int_map_destroy(workspace_list->client_map);
+
+                free(workspace_list);
+
+                return NULL;
+        }
 
         workspace_list->workspaces = calloc(count, sizeof(struct workspace *));
 
         if (workspace_list->workspaces == NULL) {
-                map_destroy(workspace_list->client_map);
+                pool_destroy(workspace_list->client_pool);
+                int_map_destroy(workspace_list->client_map);
 
                 free(workspace_list);
 
@@ -285,7 +274,7 @@ enum natwm_error workspace_list_init(const struct natwm_state *state,
         // First get the list of workspace names
         const struct config_array *workspace_names = NULL;
 
-        config_find_array(state->config, "workspaces", &workspace_names);
+        config_find_key_array(state->config, &workspace_names_key, &workspace_names);
 
         struct workspace_list *workspace_list = workspace_list_create(NATWM_WORKSPACE_COUNT);
 
@@ -317,6 +306,95 @@ enum natwm_error workspace_list_init(const struct natwm_state *state,
         return NO_ERROR;
 }
 
+/**
+ * Rename the workspaces after the configuration has been replaced. Names are
+ * interned, so only a pointer comparison is needed to find the ones which
+ * changed. Returns true when any workspace was renamed
+ */
+bool workspace_list_update_names(const struct natwm_state *state, struct workspace_list *list)
+{
+        const struct config_array *workspace_names = NULL;
+        bool has_changed = false;
+
+        config_find_key_array(state->config, &workspace_names_key, &workspace_names);
+
+        for (size_t i = 0; i < list->count; ++i) {
+                const char *name = intern_string(workspace_name_from_config(workspace_names, i));
+
+                if (name == NULL) {
+                        LOG_WARNING(natwm_logger, "Failed to rename workspace %zu", i);
+
+                        continue;
+                }
+
+                if (name != list->workspaces[i]->name) {
+                        list->workspaces[i]->name = name;
+
+                        has_changed = true;
+                }
+        }
+
+        if (has_changed) {
+                ewmh_update_desktop_names(state, list);
+        }
+
+        return has_changed;
+}
+
+// Apply a replaced theme to every client, including the ones which are not
+// currently on a monitor
+void workspace_list_apply_theme(const struct natwm_state *state, const struct workspace_list *list,
+                                const struct theme *previous_theme)
+{
+        for (size_t i = 0; i < list->count; ++i) {
+                INTRUSIVE_LIST_FOR_EACH(&list->workspaces[i]->clients, link)
+                {
+                        client_apply_theme(state, get_client_from_link(link), previous_theme);
+                }
+        }
+}
+
+/**
+ * Clamp the clients of a workspace to its monitor again after the offsets of
+ * the monitor changed. Only clients which no longer fit are moved, and they
+ * are not mapped again
+ */
+void workspace_clamp_clients(const struct natwm_state *state, struct workspace *workspace,
+                             const struct monitor *monitor)
+{
+        const struct theme *theme = state->workspace_list->theme;
+
+        INTRUSIVE_LIST_FOR_EACH(&workspace->clients, link)
+        {
+                struct client *client = get_client_from_link(link);
+
+                if (client->state & CLIENT_HIDDEN || client->is_fullscreen) {
+                        continue;
+                }
+
+                xcb_rectangle_t rect = monitor_clamp_client_rect(monitor, client->rect);
+
+                if (rect.x == client->rect.x && rect.y == client->rect.y
+                    && rect.width == client->rect.width && rect.height == client->rect.height) {
+                        continue;
+                }
+
+                client->rect = rect;
+
+                xcb_rectangle_t new_rect = {
+                        (int16_t)(rect.x + monitor->rect.x),
+                        (int16_t)(rect.y + monitor->rect.y),
+                        rect.width,
+                        rect.height,
+                };
+
+                client_configure_window_rect(state->xcb,
+                                             client->window,
+                                             new_rect,
+                                             client_get_active_border_width(theme, client));
+        }
+}
+
 void workspace_set_focused(const struct natwm_state *state, struct workspace *workspace)
 {
         if (workspace->is_focused) {
@@ -357,7 +435,7 @@ void workspace_reset_focus(struct natwm_state *state, struct workspace *workspac
 
         // If there are no more clients on this workspace then focus on the
         // root window
-        if (list_is_empty(workspace->clients)) {
+        if (intrusive_list_is_empty(&workspace->clients)) {
                 reset_input_focus(state);
 
                 return;
@@ -378,15 +456,15 @@ void workspace_reset_focus(struct natwm_state *state, struct workspace *workspac
         }
 
         // Focus on the next visible client
-        LIST_FOR_EACH(workspace->clients, node)
+        INTRUSIVE_LIST_FOR_EACH(&workspace->clients, link)
         {
-                struct client *client = get_client_from_client_node(node);
+                struct client *client = get_client_from_link(link);
 
-                if (client == NULL || client->state & CLIENT_HIDDEN) {
+                if (client->state & CLIENT_HIDDEN) {
                         continue;
                 }
 
-                focus_client(state, workspace, node, client);
+                focus_client(state, workspace, client);
 
                 return;
         }
@@ -405,13 +483,11 @@ enum natwm_error workspace_focus_client(struct natwm_state *state, struct worksp
                 return INVALID_INPUT_ERROR;
         }
 
-        struct node *client_node = get_client_node_from_client(workspace->clients, client);
-
-        if (client_node == NULL) {
+        if (!workspace_has_client(state, workspace, client)) {
                 return NOT_FOUND_ERROR;
         }
 
-        focus_client(state, workspace, client_node, client);
+        focus_client(state, workspace, client);
 
         if (!workspace->is_focused) {
                 workspace_set_focused(state, workspace);
@@ -423,24 +499,21 @@ enum natwm_error workspace_focus_client(struct natwm_state *state, struct worksp
 enum natwm_error workspace_unfocus_client(struct natwm_state *state, struct workspace *workspace,
                                           struct client *client)
 {
-        struct node *client_node = get_client_node_from_client(workspace->clients, client);
-
-        if (client_node == NULL) {
+        if (!workspace_has_client(state, workspace, client)) {
                 return NOT_FOUND_ERROR;
-        } else if (client_node->next == NULL) {
+        } else if (client->workspace_link.next == NULL) {
                 return INVALID_INPUT_ERROR;
         }
 
         natwm_state_lock(state);
 
         if (client->is_focused) {
-                struct node *next_node = client_node->next;
-                struct client *next_client = get_client_from_client_node(next_node);
+                struct client *next_client = get_client_from_link(client->workspace_link.next);
 
                 workspace_focus_client(state, workspace, next_client);
         }
 
-        list_move_node_to_tail(workspace->clients, client_node);
+        intrusive_list_move_to_tail(&workspace->clients, &client->workspace_link);
 
         natwm_state_unlock(state);
 
@@ -490,14 +563,17 @@ enum natwm_error workspace_add_client(struct natwm_state *state, struct workspac
         // We will be modifying the state - need to lock until done
         natwm_state_lock(state);
 
-        if (list_insert(workspace->clients, client) == NULL) {
+        // Cache the client of the window. Nothing has been linked yet, so
+        // there is nothing to undo if this fails
+        if (int_map_insert(list->client_map, client->window, client) != NO_ERROR) {
                 natwm_state_unlock(state);
 
                 return MEMORY_ALLOCATION_ERROR;
         }
 
-        // Cache which workspace this client is currenty active on
-        map_insert(list->client_map, &client->window, &workspace->index);
+        intrusive_list_insert(&workspace->clients, &client->workspace_link);
+
+        client->workspace = workspace;
 
         // Update active_client
         if (workspace->active_client) {
@@ -514,17 +590,15 @@ enum natwm_error workspace_add_client(struct natwm_state *state, struct workspac
 enum natwm_error workspace_remove_client(struct natwm_state *state, struct workspace *workspace,
                                          struct client *client)
 {
-        struct node *client_node = get_client_node_from_client(workspace->clients, client);
-
-        if (client_node == NULL) {
+        if (!workspace_has_client(state, workspace, client)) {
                 return NOT_FOUND_ERROR;
         }
 
-        list_remove(workspace->clients, client_node);
+        intrusive_list_remove(&workspace->clients, &client->workspace_link);
 
-        node_destroy(client_node);
+        int_map_delete(state->workspace_list->client_map, client->window);
 
-        map_delete(state->workspace_list->client_map, &client->window);
+        client->workspace = NULL;
 
         if (workspace->active_client == client) {
                 workspace->active_client = NULL;
@@ -537,13 +611,9 @@ enum natwm_error workspace_remove_client(struct natwm_state *state, struct works
 
 struct client *workspace_find_window_client(const struct workspace *workspace, xcb_window_t window)
 {
-        LIST_FOR_EACH(workspace->clients, node)
+        INTRUSIVE_LIST_FOR_EACH(&workspace->clients, link)
         {
-                struct client *client = get_client_from_client_node(node);
-
-                if (client == NULL) {
-                        continue;
-                }
+                struct client *client = get_client_from_link(link);
 
                 if (client->window == window) {
                         return client;
@@ -570,36 +640,27 @@ struct workspace *workspace_list_get_workspace(const struct workspace_list *list
 struct workspace *workspace_list_find_window_workspace(const struct workspace_list *list,
                                                        xcb_window_t window)
 {
-        struct map_entry *entry = map_get(list->client_map, &window);
+        struct client *client = int_map_get(list->client_map, window);
 
-        if (entry == NULL) {
+        if (client == NULL) {
                 return NULL;
         }
 
-        size_t index = *(size_t *)entry->value;
-
-        return workspace_list_get_workspace(list, index);
+        return client->workspace;
 }
 
 struct workspace *workspace_list_find_client_workspace(const struct workspace_list *list,
                                                        const struct client *client)
 {
-        return workspace_list_find_window_workspace(list, client->window);
+        UNUSED_FUNCTION_PARAM(list);
+
+        return client->workspace;
 }
 
 struct client *workspace_list_find_window_client(const struct workspace_list *list,
                                                  xcb_window_t window)
 {
-        for (size_t i = 0; i < list->count; ++i) {
-                struct workspace *workspace = list->workspaces[i];
-                struct client *client = workspace_find_window_client(workspace, window);
-
-                if (client != NULL) {
-                        return client;
-                }
-        }
-
-        return NULL;
+        return int_map_get(list->client_map, window);
 }
 
 enum natwm_error workspace_list_switch_to_workspace(struct natwm_state *state, size_t index)
@@ -701,29 +762,27 @@ void workspace_list_destroy(struct workspace_list *workspace_list)
                 theme_destroy(workspace_list->theme);
         }
 
-        map_destroy(workspace_list->client_map);
+        int_map_destroy(workspace_list->client_map);
 
         for (size_t i = 0; i < workspace_list->count; ++i) {
                 if (workspace_list->workspaces[i] != NULL) {
-                        workspace_destroy(workspace_list->workspaces[i]);
+                        workspace_destroy(workspace_list->workspaces[i],
+                                          workspace_list->client_pool);
                 }
         }
 
+        pool_destroy(workspace_list->client_pool);
+
         free(workspace_list->workspaces);
         free(workspace_list);
 }
 
-void workspace_destroy(struct workspace *workspace)
+void workspace_destroy(struct workspace *workspace, struct pool *client_pool)
 {
-        if (workspace->clients != NULL) {
-                LIST_FOR_EACH(workspace->clients, node)
-                {
-                        struct client *client = get_client_from_client_node(node);
-
-                        client_destroy(client);
-                }
-
-                list_destroy(workspace->clients);
+        // Clients are free'd along with their link
+        INTRUSIVE_LIST_FOR_EACH_SAFE(&workspace->clients, link, next_link)
+        {
+                client_destroy(client_pool, get_client_from_link(link));
         }
 
         free(workspace);
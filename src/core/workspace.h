@@ -8,8 +8,9 @@
 #include <xcb/xcb.h>
 
 #include <common/error.h>
+#include <common/int_map.h>
 #include <common/list.h>
-#include <common/map.h>
+#include <common/pool.h>
 #include <common/theme.h>
 
 #include "client.h"
@@ -19,16 +20,17 @@ struct workspace_list {
         size_t count;
         size_t active_index;
         struct theme *theme;
-        struct map *client_map;
+        struct int_map *client_map; // Window -> client
+        struct pool *client_pool; // Every client is allocated from here
         struct workspace **workspaces;
 };
 
 struct workspace {
-        const char *name;
+        const char *name; // Interned
         size_t index;
         bool is_visible;
         bool is_focused;
-        struct list *clients;
+        struct intrusive_list clients; // Linked through client->workspace_link
         struct client *active_client;
 };
 
@@ -40,6 +42,11 @@ enum natwm_error workspace_add_client(struct natwm_state *state, struct workspac
                                       struct client *client);
 enum natwm_error workspace_remove_client(struct natwm_state *state, struct workspace *workspace,
                                          struct client *client);
+bool workspace_list_update_names(const struct natwm_state *state, struct workspace_list *list);
+void workspace_list_apply_theme(const struct natwm_state *state, const struct workspace_list *list,
+                                const struct theme *previous_theme);
+void workspace_clamp_clients(const struct natwm_state *state, struct workspace *workspace,
+                             const struct monitor *monitor);
 struct client *workspace_find_window_client(const struct workspace *workspace, xcb_window_t window);
 void workspace_set_focused(const struct natwm_state *state, struct workspace *workspace);
 void workspace_set_unfocused(const struct natwm_state *state, struct workspace *workspace);
@@ -62,4 +69,4 @@ enum natwm_error workspace_list_switch_to_workspace(struct natwm_state *state,
 enum natwm_error workspace_list_send_to_workspace(struct natwm_state *state, struct client *client,
                                                   size_t index);
 void workspace_list_destroy(struct workspace_list *workspace_list);
-void workspace_destroy(struct workspace *workspace);
+void workspace_destroy(struct workspace *workspace, struct pool *client_pool);
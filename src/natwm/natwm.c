@@ -2,6 +2,7 @@
 // Licensed under BSD-3-Clause
 // Refer to the license.txt file included in the root of the project
 
+#include <errno.h>
 #include <getopt.h>
 #include <pthread.h>
 #include <signal.h>
@@ -13,6 +14,7 @@
 #include <xcb/xcb_util.h>
 
 #include <common/constants.h>
+#include <common/intern.h>
 #include <common/logger.h>
 #include <common/map.h>
 #include <common/theme.h>
@@ -23,6 +25,7 @@
 #include <core/events/event.h>
 #include <core/ewmh.h>
 #include <core/monitor.h>
+#include <core/reload.h>
 #include <core/state.h>
 #include <core/workspace.h>
 
@@ -32,6 +35,9 @@
 // Program status
 static volatile sig_atomic_t status = STOPPED;
 
+// Set by SIGHUP, the event loop starts a configuration reload
+static volatile sig_atomic_t reload_requested = 0;
+
 struct argument_options {
         const char *config_path;
         const char *screen;
@@ -100,7 +106,11 @@ static xcb_screen_t *find_default_screen(xcb_connection_t *connection, int scree
 
 static void signal_handler(int signum)
 {
-        UNUSED_FUNCTION_PARAM(signum);
+        if (signum == SIGHUP) {
+                reload_requested = 1;
+
+                return;
+        }
 
         status = STOPPED;
 }
@@ -150,6 +160,14 @@ static void *wm_event_loop(void *passed_state)
         };
 
         while (status == RUNNING) {
+                if (reload_requested) {
+                        reload_requested = 0;
+
+                        config_reload_request(state);
+                }
+
+                config_reload_poll(state);
+
                 FD_ZERO(&fds);
                 FD_SET(xcb_fd, &fds);
 
@@ -167,6 +185,11 @@ static void *wm_event_loop(void *passed_state)
                 }
 
                 if (num < 0) {
+                        if (errno == EINTR) {
+                                // Interrupted by a signal
+                                continue;
+                        }
+
                         LOG_ERROR(natwm_logger, "pselect failed");
 
                         goto handle_error;
@@ -235,7 +258,7 @@ static struct argument_options *parse_arguments(int argc, char **argv)
                         break;
                 case 'h':
                         printf("%s\n", NATWM_VERSION_STRING);
-                        printf("-c <file>, Set the config file\n");
+                        printf("-c <file>, Set the config file (can be a pipe)\n");
                         printf("-h,        Print this help message\n");
                         printf("-s,        Specify specific screen for X\n");
                         printf("-v,        Print version information\n");
@@ -385,6 +408,14 @@ int main(int argc, char **argv)
                 goto free_and_error;
         }
 
+        state->config_reload = config_reload_create(state->xcb);
+
+        if (state->config_reload == NULL) {
+                LOG_ERROR(natwm_logger, "Failed to initialize configuration reloading");
+
+                goto free_and_error;
+        }
+
         status = RUNNING;
 
         // Start wm thread
@@ -400,6 +431,7 @@ int main(int argc, char **argv)
 
         free(arg_options);
         natwm_state_destroy(state);
+        intern_destroy();
         destroy_logger(natwm_logger);
 
         return EXIT_SUCCESS;
@@ -409,6 +441,7 @@ free_and_error:
 
         free(arg_options);
         natwm_state_destroy(state);
+        intern_destroy();
         destroy_logger(natwm_logger);
 
         return EXIT_FAILURE;
@@ -5,14 +5,17 @@
 #include <setjmp.h>
 #include <stdarg.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <cmocka.h>
 
 #include <common/constants.h>
 #include <common/logger.h>
 #include <core/config/config.h>
+#include <core/config/parser.h>
 
 /**
  * Since config uses logs we need to silence them
@@ -387,6 +390,125 @@ static void test_config_array_invalid(void **state)
         assert_null(config_map);
 }
 
+static void test_config_array_empty_item(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *config_string = "invalid = [1, , 2]\n";
+        size_t config_length = strlen(config_string);
+        struct map *config_map = config_read_string(config_string, config_length);
+
+        assert_null(config_map);
+}
+
+static void test_config_array_missing_comma(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *config_string = "invalid = [1 2]\n";
+        size_t config_length = strlen(config_string);
+        struct map *config_map = config_read_string(config_string, config_length);
+
+        assert_null(config_map);
+}
+
+static void test_config_array_unterminated(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *config_string = "invalid = [1, [2, 3]\nother = 4\n";
+        size_t config_length = strlen(config_string);
+        struct map *config_map = config_read_string(config_string, config_length);
+
+        assert_null(config_map);
+}
+
+static void test_config_array_comments(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *expected_key = "commented.array";
+        const char *config_string = "commented.array = [ # The first line\n"
+                                    "\t1, # One\n"
+                                    "\t# Nothing\n"
+                                    "\t2\n"
+                                    "]\n";
+        size_t config_length = strlen(config_string);
+        struct map *config_map = config_read_string(config_string, config_length);
+
+        assert_non_null(config_map);
+
+        struct config_value *value = config_find(config_map, expected_key);
+
+        assert_non_null(value);
+        assert_int_equal(ARRAY, value->type);
+        assert_int_equal(2, value->data.array->length);
+        assert_int_equal(1, value->data.array->values[0]->data.number);
+        assert_int_equal(2, value->data.array->values[1]->data.number);
+
+        config_destroy(config_map);
+}
+
+static char *create_nested_array_config(size_t depth)
+{
+        // "deep = " + depth * "[" + "1" + depth * "]" + "\n"
+        size_t length = 7 + depth + 1 + depth + 1;
+        char *config_string = malloc(length + 1);
+
+        assert_non_null(config_string);
+
+        memcpy(config_string, "deep = ", 7);
+        memset(config_string + 7, '[', depth);
+
+        config_string[7 + depth] = '1';
+
+        memset(config_string + 7 + depth + 1, ']', depth);
+
+        config_string[length - 1] = '\n';
+        config_string[length] = '\0';
+
+        return config_string;
+}
+
+static void test_config_array_deeply_nested(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        size_t depth = PARSER_ARRAY_MAX_DEPTH;
+        char *config_string = create_nested_array_config(depth);
+        struct map *config_map = config_read_string(config_string, strlen(config_string));
+
+        assert_non_null(config_map);
+
+        struct config_value *value = config_find(config_map, "deep");
+
+        for (size_t i = 0; i < depth; ++i) {
+                assert_non_null(value);
+                assert_int_equal(ARRAY, value->type);
+                assert_int_equal(1, value->data.array->length);
+
+                value = value->data.array->values[0];
+        }
+
+        assert_int_equal(NUMBER, value->type);
+        assert_int_equal(1, value->data.number);
+
+        config_destroy(config_map);
+        free(config_string);
+}
+
+static void test_config_array_too_deeply_nested(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        char *config_string = create_nested_array_config(PARSER_ARRAY_MAX_DEPTH + 1);
+        struct map *config_map = config_read_string(config_string, strlen(config_string));
+
+        assert_null(config_map);
+
+        free(config_string);
+}
+
 static void test_config_array_trailing_comma(void **state)
 {
         UNUSED_FUNCTION_PARAM(state);
@@ -563,6 +685,69 @@ static void test_config_comment(void **state)
         config_destroy(config_map);
 }
 
+static void test_config_trailing_comment(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *expected_key = "test";
+        intmax_t expected_value = 2;
+        const char *config_string = "  test = 2 # An example comment\n";
+        size_t config_length = strlen(config_string);
+        struct map *config_map = config_read_string(config_string, config_length);
+
+        assert_non_null(config_map);
+
+        struct config_value *value = config_find(config_map, expected_key);
+
+        assert_non_null(value);
+        assert_int_equal(NUMBER, value->type);
+        assert_int_equal(expected_value, value->data.number);
+
+        config_destroy(config_map);
+}
+
+static void test_config_no_final_new_line(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *expected_key = "test";
+        const char *config_string = "other = true\ntest = [1,\n2]";
+        size_t config_length = strlen(config_string);
+        struct map *config_map = config_read_string(config_string, config_length);
+
+        assert_non_null(config_map);
+
+        struct config_value *value = config_find(config_map, expected_key);
+
+        assert_non_null(value);
+        assert_int_equal(ARRAY, value->type);
+        assert_int_equal(2, value->data.array->length);
+
+        config_destroy(config_map);
+}
+
+static void test_config_invalid_trailing_value(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *config_string = "test = \"first\" \"second\"\n";
+        size_t config_length = strlen(config_string);
+        struct map *config_map = config_read_string(config_string, config_length);
+
+        assert_null(config_map);
+}
+
+static void test_config_invalid_unterminated_string(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *config_string = "test = \"first\nother = 1\n";
+        size_t config_length = strlen(config_string);
+        struct map *config_map = config_read_string(config_string, config_length);
+
+        assert_null(config_map);
+}
+
 static void test_config_double_definition(void **state)
 {
         UNUSED_FUNCTION_PARAM(state);
@@ -861,6 +1046,183 @@ static void test_config_find_string_fallback_found(void **state)
         config_destroy(config_map);
 }
 
+static void test_config_find_many(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *config_string = "first = 1\nsecond = \"Hello\"\n";
+        size_t config_length = strlen(config_string);
+        struct map *config_map = config_read_string(config_string, config_length);
+
+        assert_non_null(config_map);
+
+        struct config_key keys[] = {
+                CONFIG_KEY_INIT("first"),
+                CONFIG_KEY_INIT("missing"),
+                CONFIG_KEY_INIT("second"),
+        };
+        struct config_value *results[3];
+
+        assert_int_equal(2, config_find_many(config_map, keys, 3, results));
+
+        assert_non_null(results[0]);
+        assert_int_equal(NUMBER, results[0]->type);
+        assert_int_equal(1, results[0]->data.number);
+        assert_null(results[1]);
+        assert_non_null(results[2]);
+        assert_string_equal("Hello", results[2]->data.string);
+
+        config_destroy(config_map);
+}
+
+static void test_config_find_key(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *config_string = "found = \"Hello\"\n";
+        size_t config_length = strlen(config_string);
+        struct map *first_map = config_read_string(config_string, config_length);
+        struct map *second_map = config_read_string(config_string, config_length);
+        struct config_key key = CONFIG_KEY_INIT("found");
+        struct config_key missing_key = CONFIG_KEY_INIT("missing");
+
+        assert_non_null(first_map);
+        assert_non_null(second_map);
+
+        // The key is interned once and then used with every map
+        assert_string_equal("Hello", config_find_key(first_map, &key)->data.string);
+        assert_ptr_equal(config_find(first_map, "found")->data.string,
+                         config_find_key(first_map, &key)->data.string);
+        assert_non_null(key.interned);
+        assert_string_equal("Hello", config_find_key(second_map, &key)->data.string);
+        assert_null(config_find_key(first_map, &missing_key));
+
+        const struct config_array *array = NULL;
+
+        assert_int_equal(INVALID_INPUT_ERROR, config_find_key_array(first_map, &key, &array));
+        assert_int_equal(NOT_FOUND_ERROR, config_find_key_array(first_map, &missing_key, &array));
+
+        config_destroy(first_map);
+        config_destroy(second_map);
+}
+
+// A temporary file holding contents, removed once it is closed
+static FILE *create_config_file(const char *contents)
+{
+        FILE *file = tmpfile();
+
+        assert_non_null(file);
+        assert_int_equal(fwrite(contents, 1, strlen(contents), file), strlen(contents));
+        assert_int_equal(fflush(file), 0);
+
+        rewind(file);
+
+        return file;
+}
+
+static void test_config_read_fd_file(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        FILE *file = create_config_file("$size = 5\nname = \"John\"\nsize = $size\n");
+        struct map *config_map = config_read_fd(fileno(file));
+
+        assert_non_null(config_map);
+        assert_string_equal(config_find_string_fallback(config_map, "name", ""), "John");
+        assert_int_equal(config_find_number_fallback(config_map, "size", 0), 5);
+
+        config_destroy(config_map);
+        fclose(file);
+}
+
+static void test_config_read_fd_empty_file(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        FILE *file = create_config_file("");
+        struct map *config_map = config_read_fd(fileno(file));
+
+        assert_non_null(config_map);
+        assert_null(config_find(config_map, "name"));
+
+        config_destroy(config_map);
+        fclose(file);
+}
+
+static void test_config_read_fd_pipe(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *config_string = "name = \"John\"\nsizes = [\n  1,\n  2,\n]\n";
+        size_t config_length = strlen(config_string);
+        int fds[2];
+
+        // Small enough to fit in the pipe buffer, so it can be written up
+        // front
+        assert_int_equal(pipe(fds), 0);
+        assert_int_equal(write(fds[1], config_string, config_length), config_length);
+        close(fds[1]);
+
+        struct map *config_map = config_read_fd(fds[0]);
+        const struct config_array *sizes = NULL;
+
+        close(fds[0]);
+
+        assert_non_null(config_map);
+        assert_string_equal(config_find_string_fallback(config_map, "name", ""), "John");
+        assert_int_equal(config_find_array(config_map, "sizes", &sizes), NO_ERROR);
+        assert_int_equal(sizes->length, 2);
+
+        config_destroy(config_map);
+}
+
+static void test_config_read_stream_chunks(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        // Brackets inside of strings and comments don't start arrays
+        FILE *file = create_config_file("$name = \"[John]\"\n"
+                                        "# Comment ]] [\n"
+                                        "names = [\n"
+                                        "  $name, # [\n"
+                                        "  \"#[\",\n"
+                                        "  [1, 2],\n"
+                                        "]\n"
+                                        "size = 10");
+
+        // Every chunk size splits statements in a different place
+        for (size_t chunk_size = 1; chunk_size <= 64; ++chunk_size) {
+                assert_int_equal(lseek(fileno(file), 0, SEEK_SET), 0);
+
+                struct map *config_map = config_read_stream(fileno(file), chunk_size);
+                const struct config_array *names = NULL;
+
+                assert_non_null(config_map);
+                assert_int_equal(config_find_array(config_map, "names", &names), NO_ERROR);
+                assert_int_equal(names->length, 3);
+                assert_string_equal(names->values[0]->data.string, "[John]");
+                assert_string_equal(names->values[1]->data.string, "#[");
+                assert_int_equal(names->values[2]->type, ARRAY);
+                assert_int_equal(config_find_number_fallback(config_map, "size", 0), 10);
+
+                config_destroy(config_map);
+        }
+
+        fclose(file);
+}
+
+static void test_config_read_stream_invalid(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        FILE *file = create_config_file("name = \"John\"\nsize = [1, 2\ncount = 3\n");
+        struct map *config_map = config_read_stream(fileno(file), 4);
+
+        assert_null(config_map);
+
+        fclose(file);
+}
+
 int main(void)
 {
         const struct CMUnitTest tests[] = {
@@ -873,6 +1235,12 @@ int main(void)
                 cmocka_unit_test(test_config_array_variable),
                 cmocka_unit_test(test_config_array_empty),
                 cmocka_unit_test(test_config_array_invalid),
+                cmocka_unit_test(test_config_array_empty_item),
+                cmocka_unit_test(test_config_array_missing_comma),
+                cmocka_unit_test(test_config_array_unterminated),
+                cmocka_unit_test(test_config_array_comments),
+                cmocka_unit_test(test_config_array_deeply_nested),
+                cmocka_unit_test(test_config_array_too_deeply_nested),
                 cmocka_unit_test(test_config_array_trailing_comma),
                 cmocka_unit_test(test_config_array_trailing_comma_multiline),
                 cmocka_unit_test(test_config_boolean),
@@ -880,6 +1248,10 @@ int main(void)
                 cmocka_unit_test(test_config_number_variable),
                 cmocka_unit_test(test_config_string_variable),
                 cmocka_unit_test(test_config_comment),
+                cmocka_unit_test(test_config_trailing_comment),
+                cmocka_unit_test(test_config_no_final_new_line),
+                cmocka_unit_test(test_config_invalid_trailing_value),
+                cmocka_unit_test(test_config_invalid_unterminated_string),
                 cmocka_unit_test(test_config_double_definition),
                 cmocka_unit_test(test_config_unset_variable),
                 cmocka_unit_test(test_config_invalid_number),
@@ -899,6 +1271,13 @@ int main(void)
                 cmocka_unit_test(test_config_find_string_not_found),
                 cmocka_unit_test(test_config_find_string_fallback),
                 cmocka_unit_test(test_config_find_string_fallback_found),
+                cmocka_unit_test(test_config_find_many),
+                cmocka_unit_test(test_config_find_key),
+                cmocka_unit_test(test_config_read_fd_file),
+                cmocka_unit_test(test_config_read_fd_empty_file),
+                cmocka_unit_test(test_config_read_fd_pipe),
+                cmocka_unit_test(test_config_read_stream_chunks),
+                cmocka_unit_test(test_config_read_stream_invalid),
         };
 
         return cmocka_run_group_tests(tests, global_test_setup, global_test_teardown);
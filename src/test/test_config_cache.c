@@ -0,0 +1,282 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cmocka.h>
+
+#include <common/constants.h>
+#include <common/intern.h>
+#include <common/logger.h>
+#include <common/util.h>
+#include <core/config/cache.h>
+#include <core/config/config.h>
+
+#define TEST_PATH_SIZE 64
+
+static const char *test_config = "$color = \"#ffffff\"\n"
+                                 "theme.color = $color\n"
+                                 "theme.width = 4\n"
+                                 "theme.sticky = true\n"
+                                 "names = [\"one\", [1, 2], []]\n";
+
+static const struct config_cache_key test_key = {
+        .size = 1,
+        .mtime_sec = 2,
+        .mtime_nsec = 3,
+        .hash = 4,
+};
+
+static int global_test_setup(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        initialize_logger(false);
+
+        set_logging_quiet(natwm_logger, true);
+
+        return EXIT_SUCCESS;
+}
+
+static int global_test_teardown(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        destroy_logger(natwm_logger);
+
+        return EXIT_SUCCESS;
+}
+
+static void free_value(void *data)
+{
+        config_value_destroy((struct config_value *)data);
+}
+
+// An empty map set up the same way as a configuration map
+static struct map *create_config_map(void)
+{
+        struct map *map = map_init();
+
+        assert_non_null(map);
+
+        map_set_entry_free_function(map, free_value);
+        map_set_hash_function(map, intern_map_hash);
+        map_set_key_size_function(map, intern_map_key_size);
+        map_set_key_compare_function(map, intern_map_key_compare);
+
+        return map;
+}
+
+static void write_file(const char *path, const char *contents)
+{
+        FILE *file = fopen(path, "w");
+
+        assert_non_null(file);
+        assert_int_equal(fwrite(contents, 1, strlen(contents), file), strlen(contents));
+        assert_int_equal(fclose(file), 0);
+}
+
+static void create_test_file(char *path, const char *contents)
+{
+        strcpy(path, "/tmp/natwm_cache_test_XXXXXX");
+
+        int fd = mkstemp(path);
+
+        assert_true(fd >= 0);
+
+        close(fd);
+
+        write_file(path, contents);
+}
+
+static void remove_test_file(const char *path)
+{
+        char *cache_path = config_cache_path(path);
+
+        assert_non_null(cache_path);
+
+        unlink(path);
+        unlink(cache_path);
+
+        free(cache_path);
+}
+
+static void assert_test_config(const struct map *config_map)
+{
+        const struct config_array *names = NULL;
+
+        assert_non_null(config_map);
+        assert_string_equal(config_find_string_fallback(config_map, "theme.color", ""), "#ffffff");
+        assert_int_equal(config_find_number_fallback(config_map, "theme.width", 0), 4);
+        assert_true(config_find(config_map, "theme.sticky")->data.boolean);
+        assert_int_equal(config_find_array(config_map, "names", &names), NO_ERROR);
+        assert_int_equal(names->length, 3);
+        assert_string_equal(names->values[0]->data.string, "one");
+        assert_int_equal(names->values[1]->data.array->length, 2);
+        assert_int_equal(names->values[1]->data.array->values[1]->data.number, 2);
+        assert_int_equal(names->values[2]->data.array->length, 0);
+}
+
+static void test_config_cache_save_load(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        char path[TEST_PATH_SIZE];
+        struct map *config_map = config_read_string(test_config, strlen(test_config));
+        struct map *loaded_map = create_config_map();
+
+        create_test_file(path, "");
+
+        assert_int_equal(config_cache_save(path, &test_key, config_map), NO_ERROR);
+        assert_int_equal(config_cache_load(path, &test_key, loaded_map), NO_ERROR);
+        assert_test_config(loaded_map);
+
+        // Strings are interned, so they are shared with the parsed map
+        assert_ptr_equal(config_find(config_map, "theme.color")->data.string,
+                         config_find(loaded_map, "theme.color")->data.string);
+
+        config_destroy(config_map);
+        config_destroy(loaded_map);
+        remove_test_file(path);
+}
+
+static void test_config_cache_key_mismatch(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        char path[TEST_PATH_SIZE];
+        struct config_cache_key key = test_key;
+        struct map *config_map = config_read_string(test_config, strlen(test_config));
+        struct map *loaded_map = create_config_map();
+
+        create_test_file(path, "");
+
+        key.hash = 5;
+
+        assert_int_equal(config_cache_save(path, &test_key, config_map), NO_ERROR);
+        assert_int_equal(config_cache_load(path, &key, loaded_map), NOT_FOUND_ERROR);
+
+        config_destroy(config_map);
+        config_destroy(loaded_map);
+        remove_test_file(path);
+}
+
+static void test_config_cache_damaged(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        char path[TEST_PATH_SIZE];
+        struct map *config_map = config_read_string(test_config, strlen(test_config));
+        struct map *loaded_map = create_config_map();
+
+        create_test_file(path, "");
+
+        assert_int_equal(config_cache_save(path, &test_key, config_map), NO_ERROR);
+
+        // Flip the last byte of the strings
+        FILE *file = fopen(path, "r+");
+
+        assert_non_null(file);
+        assert_int_equal(fseek(file, -1, SEEK_END), 0);
+        assert_int_equal(fputc('x', file), 'x');
+        assert_int_equal(fclose(file), 0);
+
+        assert_int_equal(config_cache_load(path, &test_key, loaded_map), INVALID_INPUT_ERROR);
+
+        config_destroy(config_map);
+        config_destroy(loaded_map);
+        remove_test_file(path);
+}
+
+static void test_config_cache_truncated(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        char path[TEST_PATH_SIZE];
+        struct map *config_map = config_read_string(test_config, strlen(test_config));
+        struct map *loaded_map = create_config_map();
+
+        create_test_file(path, "");
+
+        assert_int_equal(config_cache_save(path, &test_key, config_map), NO_ERROR);
+        assert_int_equal(truncate(path, sizeof(struct config_cache_header) + 4), 0);
+        assert_int_equal(config_cache_load(path, &test_key, loaded_map), INVALID_INPUT_ERROR);
+
+        config_destroy(config_map);
+        config_destroy(loaded_map);
+        remove_test_file(path);
+}
+
+static void test_config_cache_missing(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct map *loaded_map = create_config_map();
+
+        assert_int_equal(config_cache_load("/tmp/natwm_cache_test_missing", &test_key, loaded_map),
+                         NOT_FOUND_ERROR);
+
+        config_destroy(loaded_map);
+}
+
+static void test_config_cache_initialize_path(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        char path[TEST_PATH_SIZE];
+
+        create_test_file(path, test_config);
+
+        char *cache_path = config_cache_path(path);
+
+        assert_non_null(cache_path);
+
+        // The first load parses the configuration and saves the cache, which
+        // the second load reads
+        struct map *parsed_map = config_initialize_path(path);
+
+        assert_test_config(parsed_map);
+        assert_true(path_exists(cache_path));
+
+        struct map *cached_map = config_initialize_path(path);
+
+        assert_test_config(cached_map);
+
+        config_destroy(parsed_map);
+        config_destroy(cached_map);
+
+        // Once the configuration changes the cache is ignored and replaced
+        write_file(path, "theme.width = 8\n");
+
+        struct map *changed_map = config_initialize_path(path);
+
+        assert_non_null(changed_map);
+        assert_int_equal(config_find_number_fallback(changed_map, "theme.width", 0), 8);
+        assert_null(config_find(changed_map, "names"));
+
+        config_destroy(changed_map);
+
+        free(cache_path);
+        remove_test_file(path);
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_config_cache_save_load),
+                cmocka_unit_test(test_config_cache_key_mismatch),
+                cmocka_unit_test(test_config_cache_damaged),
+                cmocka_unit_test(test_config_cache_truncated),
+                cmocka_unit_test(test_config_cache_missing),
+                cmocka_unit_test(test_config_cache_initialize_path),
+        };
+
+        return cmocka_run_group_tests(tests, global_test_setup, global_test_teardown);
+}
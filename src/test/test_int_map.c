@@ -0,0 +1,219 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <cmocka.h>
+
+#include <common/constants.h>
+#include <common/int_map.h>
+
+static int test_setup(void **state)
+{
+        struct int_map *map = int_map_create();
+
+        if (map == NULL) {
+                return EXIT_FAILURE;
+        }
+
+        *state = map;
+
+        return EXIT_SUCCESS;
+}
+
+static int test_teardown(void **state)
+{
+        int_map_destroy(*(struct int_map **)state);
+
+        return EXIT_SUCCESS;
+}
+
+static void test_int_map_create_succeeds(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct int_map *map = int_map_create();
+
+        assert_non_null(map);
+        assert_int_equal(INT_MAP_MIN_LENGTH, map->length);
+        assert_int_equal(0, map->count);
+
+        int_map_destroy(map);
+}
+
+static void test_int_map_insert_and_get(void **state)
+{
+        struct int_map *map = *(struct int_map **)state;
+        int value = 10;
+
+        assert_int_equal(NO_ERROR, int_map_insert(map, 0x200001, &value));
+
+        assert_int_equal(1, map->count);
+        assert_ptr_equal(&value, int_map_get(map, 0x200001));
+        assert_true(int_map_contains(map, 0x200001));
+}
+
+static void test_int_map_insert_zero_key(void **state)
+{
+        struct int_map *map = *(struct int_map **)state;
+        int value = 10;
+
+        assert_int_equal(NO_ERROR, int_map_insert(map, 0, &value));
+
+        assert_ptr_equal(&value, int_map_get(map, 0));
+}
+
+static void test_int_map_insert_replaces_value(void **state)
+{
+        struct int_map *map = *(struct int_map **)state;
+        int one = 1;
+        int two = 2;
+
+        assert_int_equal(NO_ERROR, int_map_insert(map, 42, &one));
+        assert_int_equal(NO_ERROR, int_map_insert(map, 42, &two));
+
+        assert_int_equal(1, map->count);
+        assert_ptr_equal(&two, int_map_get(map, 42));
+}
+
+static void test_int_map_get_missing(void **state)
+{
+        struct int_map *map = *(struct int_map **)state;
+        int value = 10;
+
+        assert_null(int_map_get(map, 42));
+
+        int_map_insert(map, 42, &value);
+
+        assert_null(int_map_get(map, 43));
+        assert_false(int_map_contains(map, 43));
+}
+
+static void test_int_map_delete(void **state)
+{
+        struct int_map *map = *(struct int_map **)state;
+        int value = 10;
+
+        int_map_insert(map, 42, &value);
+
+        assert_int_equal(NO_ERROR, int_map_delete(map, 42));
+
+        assert_int_equal(0, map->count);
+        assert_null(int_map_get(map, 42));
+}
+
+static void test_int_map_delete_missing(void **state)
+{
+        struct int_map *map = *(struct int_map **)state;
+
+        assert_int_equal(NOT_FOUND_ERROR, int_map_delete(map, 42));
+}
+
+static void test_int_map_resize(void **state)
+{
+        struct int_map *map = *(struct int_map **)state;
+        int value = 10;
+
+        for (uint32_t i = 0; i < INT_MAP_MIN_LENGTH; ++i) {
+                int_map_insert(map, i, &value);
+        }
+
+        assert_true(map->length > INT_MAP_MIN_LENGTH);
+        assert_int_equal(INT_MAP_MIN_LENGTH, map->count);
+
+        for (uint32_t i = 0; i < INT_MAP_MIN_LENGTH; ++i) {
+                assert_ptr_equal(&value, int_map_get(map, i));
+        }
+}
+
+static void test_int_map_insert_and_delete_many(void **state)
+{
+        struct int_map *map = *(struct int_map **)state;
+        size_t count = 4096;
+        uintptr_t *values = malloc(count * sizeof(uintptr_t));
+
+        assert_non_null(values);
+
+        // Window ids are allocated sequentially from a per-client base
+        for (size_t i = 0; i < count; ++i) {
+                values[i] = i;
+
+                assert_int_equal(NO_ERROR,
+                                 int_map_insert(map, 0x400000 + (uint32_t)i, &values[i]));
+        }
+
+        assert_int_equal(count, map->count);
+
+        // Remove every other key, which exercises the backward shift
+        for (size_t i = 0; i < count; i += 2) {
+                assert_int_equal(NO_ERROR, int_map_delete(map, 0x400000 + (uint32_t)i));
+        }
+
+        assert_int_equal(count / 2, map->count);
+
+        for (size_t i = 0; i < count; ++i) {
+                uintptr_t *value = int_map_get(map, 0x400000 + (uint32_t)i);
+
+                if (i % 2 == 0) {
+                        assert_null(value);
+                } else {
+                        assert_ptr_equal(&values[i], value);
+                }
+        }
+
+        free(values);
+}
+
+static void test_int_map_get_stats(void **state)
+{
+        struct int_map *map = *(struct int_map **)state;
+        struct map_stats stats;
+        int value = 10;
+
+        for (uint32_t i = 0; i < 100; ++i) {
+                int_map_insert(map, 0x400000 + i, &value);
+        }
+
+        int_map_get_stats(map, &stats);
+
+        uint32_t histogram_total = 0;
+
+        for (size_t i = 0; i < MAP_STATS_HISTOGRAM_SIZE; ++i) {
+                histogram_total += stats.dib_histogram[i];
+        }
+
+        assert_int_equal(100, stats.entry_count);
+        assert_int_equal(100, histogram_total);
+        assert_int_equal(map->resize_count, stats.resize_up_count);
+        assert_true(stats.resize_up_count > 0);
+        assert_true(stats.mean_dib <= stats.max_dib);
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_int_map_create_succeeds),
+                cmocka_unit_test_setup_teardown(
+                        test_int_map_insert_and_get, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_int_map_insert_zero_key, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_int_map_insert_replaces_value, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_int_map_get_missing, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_int_map_delete, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_int_map_delete_missing, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_int_map_resize, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_int_map_insert_and_delete_many, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_int_map_get_stats, test_setup, test_teardown),
+        };
+
+        return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,286 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+
+#include <common/constants.h>
+#include <common/intern.h>
+#include <common/map.h>
+
+static int test_teardown(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        intern_destroy();
+
+        return 0;
+}
+
+static void test_intern_string(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        char key[] = "window.border_width";
+        const char *result = intern_string(key);
+
+        assert_non_null(result);
+        assert_ptr_not_equal(key, result);
+        assert_string_equal(key, result);
+        assert_int_equal(strlen(key), intern_get_length(result));
+        assert_int_equal(1, intern_get_count());
+}
+
+static void test_intern_string_same_pointer(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        char first[] = "workspaces";
+        char second[] = "workspaces";
+        const char *first_result = intern_string(first);
+        const char *second_result = intern_string(second);
+
+        assert_ptr_equal(first_result, second_result);
+        assert_int_equal(intern_get_hash(first_result), intern_get_hash(second_result));
+        assert_int_equal(1, intern_get_count());
+}
+
+static void test_intern_string_different(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *first = intern_string("window.focused");
+        const char *second = intern_string("window.unfocused");
+        const char *empty = intern_string("");
+
+        assert_ptr_not_equal(first, second);
+        assert_ptr_not_equal(first, empty);
+        assert_string_equal("", empty);
+        assert_int_equal(0, intern_get_length(empty));
+        assert_int_equal(3, intern_get_count());
+}
+
+static void test_intern_string_n(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *buffer = "border_width = 2";
+        const char *result = intern_string_n(buffer, 12);
+
+        assert_string_equal("border_width", result);
+        assert_int_equal(12, intern_get_length(result));
+        assert_ptr_equal(result, intern_string("border_width"));
+}
+
+static void test_intern_find(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        assert_null(intern_find("missing"));
+
+        const char *result = intern_string("present");
+
+        assert_ptr_equal(result, intern_find("present"));
+        assert_ptr_equal(result, intern_find_n("present_not", 7));
+        assert_null(intern_find("missing"));
+        assert_int_equal(1, intern_get_count());
+}
+
+static void test_intern_many_strings(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const size_t count = 4096;
+        const char **results = malloc(sizeof(char *) * count);
+        char buffer[32];
+
+        assert_non_null(results);
+
+        for (size_t i = 0; i < count; ++i) {
+                snprintf(buffer, sizeof(buffer), "client_%zu.window", i);
+
+                results[i] = intern_string(buffer);
+
+                assert_non_null(results[i]);
+                // Interned strings keep the alignment of their header
+                assert_int_equal(0, ((uintptr_t)results[i]) % sizeof(uint64_t));
+        }
+
+        assert_int_equal(count, intern_get_count());
+
+        // Strings never move as the table grows
+        for (size_t i = 0; i < count; ++i) {
+                snprintf(buffer, sizeof(buffer), "client_%zu.window", i);
+
+                assert_ptr_equal(results[i], intern_find(buffer));
+                assert_string_equal(buffer, results[i]);
+        }
+
+        free(results);
+}
+
+static void test_intern_large_string(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *small = intern_string("small");
+        size_t length = INTERN_CHUNK_SIZE * 2;
+        char *large = malloc(length + 1);
+
+        assert_non_null(large);
+
+        memset(large, 'x', length);
+
+        large[length] = '\0';
+
+        const char *result = intern_string(large);
+
+        assert_non_null(result);
+        assert_int_equal(length, intern_get_length(result));
+        assert_string_equal(large, result);
+
+        // The chunk in use before the large string is still used afterwards
+        const char *after = intern_string("after");
+
+        assert_ptr_equal(small, intern_find("small"));
+        assert_ptr_equal(after, intern_find("after"));
+        assert_ptr_equal(result, intern_find(large));
+
+        free(large);
+}
+
+static void test_intern_destroy(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        intern_string("first");
+        intern_string("second");
+
+        assert_int_equal(2, intern_get_count());
+
+        intern_destroy();
+
+        assert_int_equal(0, intern_get_count());
+        assert_null(intern_find("first"));
+        assert_non_null(intern_string("first"));
+        assert_int_equal(1, intern_get_count());
+}
+
+#define INTERN_STABLE_COUNT 64
+#define INTERN_GROW_COUNT 8192
+
+static void *intern_grow_thread(void *data)
+{
+        UNUSED_FUNCTION_PARAM(data);
+
+        char key[32];
+
+        for (size_t i = 0; i < INTERN_GROW_COUNT; ++i) {
+                snprintf(key, sizeof(key), "grow%zu", i);
+
+                if (intern_string(key) == NULL) {
+                        return (void *)1;
+                }
+        }
+
+        return NULL;
+}
+
+static void test_intern_find_while_interning(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *stable[INTERN_STABLE_COUNT];
+        char key[32];
+        pthread_t thread;
+        void *result = NULL;
+
+        for (size_t i = 0; i < INTERN_STABLE_COUNT; ++i) {
+                snprintf(key, sizeof(key), "stable%zu", i);
+
+                stable[i] = intern_string(key);
+
+                assert_non_null(stable[i]);
+        }
+
+        assert_int_equal(0, pthread_create(&thread, NULL, intern_grow_thread, NULL));
+
+        // The table grows several times while it is being read
+        for (size_t round = 0; round < 64; ++round) {
+                for (size_t i = 0; i < INTERN_STABLE_COUNT; ++i) {
+                        snprintf(key, sizeof(key), "stable%zu", i);
+
+                        assert_ptr_equal(stable[i], intern_find(key));
+                }
+        }
+
+        assert_int_equal(0, pthread_join(thread, &result));
+        assert_null(result);
+
+        for (size_t i = 0; i < INTERN_GROW_COUNT; ++i) {
+                snprintf(key, sizeof(key), "grow%zu", i);
+
+                assert_non_null(intern_find(key));
+        }
+
+        assert_int_equal(INTERN_STABLE_COUNT + INTERN_GROW_COUNT, intern_get_count());
+}
+
+static void test_intern_map(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct map *map = map_init();
+
+        assert_non_null(map);
+
+        map_set_hash_function(map, intern_map_hash);
+        map_set_key_size_function(map, intern_map_key_size);
+        map_set_key_compare_function(map, intern_map_key_compare);
+
+        const char *key = intern_string("window.border_width");
+        const char *other_key = intern_string("window.sticky");
+        char lookup[] = "window.border_width";
+        int value = 2;
+
+        assert_int_equal(NO_ERROR, map_insert(map, key, &value));
+
+        struct map_entry *entry = map_get(map, intern_find(lookup));
+
+        assert_non_null(entry);
+        assert_ptr_equal(&value, entry->value);
+        assert_null(map_get(map, other_key));
+
+        // Equal contents at a different address are a different key
+        assert_false(intern_map_key_compare(key, lookup, sizeof(lookup) - 1));
+
+        map_destroy(map);
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test_teardown(test_intern_string, test_teardown),
+                cmocka_unit_test_teardown(test_intern_string_same_pointer, test_teardown),
+                cmocka_unit_test_teardown(test_intern_string_different, test_teardown),
+                cmocka_unit_test_teardown(test_intern_string_n, test_teardown),
+                cmocka_unit_test_teardown(test_intern_find, test_teardown),
+                cmocka_unit_test_teardown(test_intern_many_strings, test_teardown),
+                cmocka_unit_test_teardown(test_intern_large_string, test_teardown),
+                cmocka_unit_test_teardown(test_intern_destroy, test_teardown),
+                cmocka_unit_test_teardown(test_intern_map, test_teardown),
+                cmocka_unit_test_teardown(test_intern_find_while_interning, test_teardown),
+        };
+
+        return cmocka_run_group_tests(tests, NULL, NULL);
+}
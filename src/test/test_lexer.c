@@ -0,0 +1,180 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <cmocka.h>
+
+#include <common/constants.h>
+#include <core/config/lexer.h>
+
+static void assert_token(struct lexer *lexer, enum token_kind expected_kind,
+                         const char *expected_text)
+{
+        struct token token = lexer_next(lexer);
+        struct string_view view = lexer_token_view(lexer, token);
+
+        assert_int_equal(expected_kind, token.kind);
+        assert_true(string_view_equal_string(view, expected_text));
+}
+
+static void test_lexer_item(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *input = "  window.border_width\t= 2 # comment\n";
+        struct lexer lexer;
+
+        lexer_init(&lexer, input, strlen(input));
+
+        assert_token(&lexer, TOKEN_WORD, "window.border_width");
+        assert_token(&lexer, TOKEN_EQUAL, "=");
+        assert_token(&lexer, TOKEN_WORD, "2");
+        assert_token(&lexer, TOKEN_NEW_LINE, "\n");
+        assert_token(&lexer, TOKEN_END, "");
+        assert_token(&lexer, TOKEN_END, "");
+
+        lexer_destroy(&lexer);
+}
+
+static void test_lexer_array(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *input = "$names = [\"one\",$two, [true]]";
+        struct lexer lexer;
+
+        lexer_init(&lexer, input, strlen(input));
+
+        assert_token(&lexer, TOKEN_VARIABLE, "$names");
+        assert_token(&lexer, TOKEN_EQUAL, "=");
+        assert_token(&lexer, TOKEN_ARRAY_START, "[");
+        assert_token(&lexer, TOKEN_STRING, "\"one\"");
+        assert_token(&lexer, TOKEN_COMMA, ",");
+        assert_token(&lexer, TOKEN_VARIABLE, "$two");
+        assert_token(&lexer, TOKEN_COMMA, ",");
+        assert_token(&lexer, TOKEN_ARRAY_START, "[");
+        assert_token(&lexer, TOKEN_WORD, "true");
+        assert_token(&lexer, TOKEN_ARRAY_END, "]");
+        assert_token(&lexer, TOKEN_ARRAY_END, "]");
+        assert_token(&lexer, TOKEN_END, "");
+
+        lexer_destroy(&lexer);
+}
+
+static void test_lexer_string(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        // Strings may contain characters with a meaning of their own
+        const char *input = "\"# [a, b] = $c\"";
+        struct lexer lexer;
+
+        lexer_init(&lexer, input, strlen(input));
+
+        assert_token(&lexer, TOKEN_STRING, input);
+        assert_token(&lexer, TOKEN_END, "");
+
+        lexer_destroy(&lexer);
+}
+
+static void test_lexer_invalid(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        // Strings can't span lines
+        const char *input = "\"open\nkey $ =";
+        struct lexer lexer;
+
+        lexer_init(&lexer, input, strlen(input));
+
+        assert_token(&lexer, TOKEN_INVALID, "\"open");
+        assert_token(&lexer, TOKEN_NEW_LINE, "\n");
+        assert_token(&lexer, TOKEN_WORD, "key");
+        assert_token(&lexer, TOKEN_INVALID, "$");
+        assert_token(&lexer, TOKEN_EQUAL, "=");
+
+        lexer_destroy(&lexer);
+}
+
+static void test_lexer_peek_seek(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *input = "one two\0three";
+        struct lexer lexer;
+
+        // Anything after a '\0' is ignored
+        lexer_init(&lexer, input, 13);
+
+        assert_int_equal(TOKEN_WORD, lexer_peek(&lexer).kind);
+        assert_token(&lexer, TOKEN_WORD, "one");
+
+        lexer_seek(&lexer, 0);
+
+        assert_token(&lexer, TOKEN_WORD, "one");
+        assert_token(&lexer, TOKEN_WORD, "two");
+        assert_token(&lexer, TOKEN_END, "");
+
+        lexer_destroy(&lexer);
+}
+
+static void test_lexer_get_location(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *input = "a = 1\n\nbc = 2\n  d";
+        size_t line = 0;
+        size_t column = 0;
+        struct lexer lexer;
+
+        lexer_init(&lexer, input, strlen(input));
+
+        lexer_get_location(&lexer, 0, &line, &column);
+
+        assert_int_equal(1, line);
+        assert_int_equal(1, column);
+
+        // The new line itself is the last column of its line
+        lexer_get_location(&lexer, 5, &line, &column);
+
+        assert_int_equal(1, line);
+        assert_int_equal(6, column);
+
+        lexer_get_location(&lexer, 6, &line, &column);
+
+        assert_int_equal(2, line);
+        assert_int_equal(1, column);
+
+        lexer_get_location(&lexer, 10, &line, &column);
+
+        assert_int_equal(3, line);
+        assert_int_equal(4, column);
+
+        lexer_get_location(&lexer, strlen(input) - 1, &line, &column);
+
+        assert_int_equal(4, line);
+        assert_int_equal(3, column);
+
+        lexer_destroy(&lexer);
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_lexer_item),
+                cmocka_unit_test(test_lexer_array),
+                cmocka_unit_test(test_lexer_string),
+                cmocka_unit_test(test_lexer_invalid),
+                cmocka_unit_test(test_lexer_peek_seek),
+                cmocka_unit_test(test_lexer_get_location),
+        };
+
+        return cmocka_run_group_tests(tests, NULL, NULL);
+}
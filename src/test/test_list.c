@@ -391,6 +391,147 @@ static void test_list_empty_succeeds(void **state)
         node_destroy(third);
 }
 
+struct test_item {
+        int value;
+        struct list_link link;
+};
+
+static void test_intrusive_list_insert(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct intrusive_list list;
+        struct test_item first = {.value = 1};
+        struct test_item second = {.value = 2};
+        struct test_item third = {.value = 3};
+
+        intrusive_list_init(&list);
+
+        assert_true(intrusive_list_is_empty(&list));
+
+        intrusive_list_insert(&list, &second.link);
+        intrusive_list_insert(&list, &first.link);
+        intrusive_list_insert_end(&list, &third.link);
+
+        assert_int_equal(3, list.size);
+        assert_false(intrusive_list_is_empty(&list));
+        assert_ptr_equal(&first.link, list.head);
+        assert_ptr_equal(&third.link, list.tail);
+        assert_null(list.head->previous);
+        assert_null(list.tail->next);
+
+        int expected = 1;
+
+        INTRUSIVE_LIST_FOR_EACH(&list, link)
+        {
+                struct test_item *item = INTRUSIVE_LIST_ENTRY(link, struct test_item, link);
+
+                assert_int_equal(expected, item->value);
+
+                ++expected;
+        }
+
+        assert_int_equal(4, expected);
+}
+
+static void test_intrusive_list_move(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct intrusive_list list;
+        struct test_item first = {.value = 1};
+        struct test_item second = {.value = 2};
+        struct test_item third = {.value = 3};
+
+        intrusive_list_init(&list);
+        intrusive_list_insert_end(&list, &first.link);
+        intrusive_list_insert_end(&list, &second.link);
+        intrusive_list_insert_end(&list, &third.link);
+
+        intrusive_list_move_to_head(&list, &third.link);
+
+        assert_ptr_equal(&third.link, list.head);
+        assert_ptr_equal(&first.link, third.link.next);
+        assert_ptr_equal(&second.link, list.tail);
+
+        intrusive_list_move_to_tail(&list, &third.link);
+
+        assert_ptr_equal(&first.link, list.head);
+        assert_ptr_equal(&third.link, list.tail);
+        assert_ptr_equal(&second.link, third.link.previous);
+        assert_int_equal(3, list.size);
+
+        // Moving the head to the head (or tail to the tail) does nothing
+        intrusive_list_move_to_head(&list, &first.link);
+        intrusive_list_move_to_tail(&list, &third.link);
+
+        assert_ptr_equal(&first.link, list.head);
+        assert_ptr_equal(&third.link, list.tail);
+}
+
+static void test_intrusive_list_remove(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct intrusive_list list;
+        struct test_item first = {.value = 1};
+        struct test_item second = {.value = 2};
+        struct test_item third = {.value = 3};
+
+        intrusive_list_init(&list);
+        intrusive_list_insert_end(&list, &first.link);
+        intrusive_list_insert_end(&list, &second.link);
+        intrusive_list_insert_end(&list, &third.link);
+
+        intrusive_list_remove(&list, &second.link);
+
+        assert_int_equal(2, list.size);
+        assert_null(second.link.next);
+        assert_null(second.link.previous);
+        assert_ptr_equal(&third.link, first.link.next);
+        assert_ptr_equal(&first.link, third.link.previous);
+
+        intrusive_list_remove(&list, &first.link);
+
+        assert_ptr_equal(&third.link, list.head);
+        assert_ptr_equal(&third.link, list.tail);
+
+        intrusive_list_remove(&list, &third.link);
+
+        assert_true(intrusive_list_is_empty(&list));
+        assert_null(list.head);
+        assert_null(list.tail);
+}
+
+static void test_intrusive_list_for_each_safe(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct intrusive_list list;
+
+        intrusive_list_init(&list);
+
+        for (int i = 0; i < 4; ++i) {
+                struct test_item *item = malloc(sizeof(struct test_item));
+
+                assert_non_null(item);
+
+                item->value = i;
+
+                intrusive_list_insert(&list, &item->link);
+        }
+
+        // Links can be free'd while iterating
+        INTRUSIVE_LIST_FOR_EACH_SAFE(&list, link, next_link)
+        {
+                intrusive_list_remove(&list, link);
+
+                free(INTRUSIVE_LIST_ENTRY(link, struct test_item, link));
+        }
+
+        assert_true(intrusive_list_is_empty(&list));
+}
+
 int main(void)
 {
         const struct CMUnitTest tests[] = {
@@ -428,6 +569,10 @@ int main(void)
                         test_list_is_empty_succeeds, test_setup, test_teardown),
                 cmocka_unit_test_setup_teardown(
                         test_list_empty_succeeds, test_setup, test_teardown),
+                cmocka_unit_test(test_intrusive_list_insert),
+                cmocka_unit_test(test_intrusive_list_move),
+                cmocka_unit_test(test_intrusive_list_remove),
+                cmocka_unit_test(test_intrusive_list_for_each_safe),
         };
 
         return cmocka_run_group_tests(tests, NULL, NULL);
@@ -2,10 +2,12 @@
 // Licensed under BSD-3-Clause
 // Refer to the license.txt file included in the root of the project
 
+#include <pthread.h>
 #include <setjmp.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -13,6 +15,7 @@
 
 #include <common/constants.h>
 #include <common/error.h>
+#include <common/hash.h>
 #include <common/map.h>
 
 /*
@@ -37,6 +40,80 @@ static bool non_trivial_key_compare_function(const void *one, const void *two, s
         return *(size_t *)one == *(size_t *)two;
 }
 
+static size_t counting_compare_calls = 0;
+
+static bool counting_key_compare_function(const void *one, const void *two, size_t key_size)
+{
+        UNUSED_FUNCTION_PARAM(key_size);
+
+        ++counting_compare_calls;
+
+        return strcmp(one, two) == 0;
+}
+
+#define CONCURRENT_STABLE_KEY_COUNT 64
+#define CONCURRENT_CHURN_KEY_COUNT 20000
+
+struct concurrent_reader {
+        struct map *map;
+        bool stop;
+        size_t reads;
+        size_t failures;
+};
+
+static void *concurrent_reader_thread(void *data)
+{
+        struct concurrent_reader *reader = data;
+        char key[32];
+
+        while (!__atomic_load_n(&reader->stop, __ATOMIC_ACQUIRE)) {
+                for (size_t i = 0; i < CONCURRENT_STABLE_KEY_COUNT; ++i) {
+                        void *value = NULL;
+
+                        snprintf(key, sizeof(key), "stable%zu", i);
+
+                        map_read_begin(reader->map);
+
+                        if (map_read_value(reader->map, key, &value) != NO_ERROR
+                            || *(size_t *)value != i) {
+                                ++reader->failures;
+                        }
+
+                        map_read_end(reader->map);
+
+                        ++reader->reads;
+                }
+        }
+
+        return NULL;
+}
+
+static char *test_key_init(const char *prefix, size_t index)
+{
+        char *key = malloc(32);
+
+        if (key == NULL) {
+                return NULL;
+        }
+
+        snprintf(key, 32, "%s%zu", prefix, index);
+
+        return key;
+}
+
+static size_t *test_index_init(size_t index)
+{
+        size_t *value = malloc(sizeof(size_t));
+
+        if (value == NULL) {
+                return NULL;
+        }
+
+        *value = index;
+
+        return value;
+}
+
 static struct test_value *test_value_init(void)
 {
         struct test_value *value = malloc(sizeof(struct test_value));
@@ -521,74 +598,1163 @@ static void test_map_get_and_delete(void **state)
         assert_string_equal("7", result->value);
 }
 
-static void test_map_destroy_null(void **state)
+static void test_map_insert_and_delete_many(void **state)
 {
         UNUSED_FUNCTION_PARAM(state);
 
-        map_destroy(NULL);
+        struct map *map = map_init();
+
+        assert_non_null(map);
+
+        map_set_key_size_function(map, determine_number_key_size);
+        map_set_key_compare_function(map, non_trivial_key_compare_function);
+
+        size_t key_count = 1000;
+        size_t *keys = malloc(sizeof(size_t) * key_count);
+
+        assert_non_null(keys);
+
+        for (size_t i = 0; i < key_count; ++i) {
+                keys[i] = i * 7;
+
+                assert_int_equal(NO_ERROR, map_insert(map, &keys[i], &keys[i]));
+        }
+
+        assert_int_equal(key_count, map->bucket_count);
+
+        // Remove every other key - this will shift entries backwards
+        for (size_t i = 0; i < key_count; i += 2) {
+                assert_int_equal(NO_ERROR, map_delete(map, &keys[i]));
+        }
+
+        assert_int_equal(key_count / 2, map->bucket_count);
+
+        for (size_t i = 0; i < key_count; ++i) {
+                struct map_entry *entry = map_get(map, &keys[i]);
+
+                if (i % 2 == 0) {
+                        assert_null(entry);
+
+                        continue;
+                }
+
+                assert_non_null(entry);
+                assert_true(entry >= map->entries && entry < map->entries + map->length);
+                assert_ptr_equal(&keys[i], entry->value);
+        }
+
+        map_destroy(map);
+        free(keys);
 }
 
-static void test_map_destroy_use_free(void **state)
+static void test_map_delete_free_func(void **state)
 {
         struct map *map = *(struct map **)state;
-        const char *expected_key = "test";
-        size_t value_length = 5;
-        size_t *allocated_value = malloc(sizeof(size_t) * value_length);
+        struct test_value *allocated_value = test_value_init();
 
         assert_non_null(allocated_value);
 
-        for (size_t i = 0; i < value_length; ++i) {
-                allocated_value[i] = i;
+        map_set_entry_free_function(map, test_value_destroy);
+
+        assert_int_equal(NO_ERROR, map_insert(map, "test", allocated_value));
+        assert_int_equal(NO_ERROR, map_delete(map, "test"));
+        assert_int_equal(0, map->bucket_count);
+        assert_null(map_get(map, "test"));
+}
+
+static void test_map_delete_shrink(void **state)
+{
+        struct map *map = *(struct map **)state;
+        char keys[64][16];
+
+        map_remove_setting_flag(map, MAP_FLAG_IGNORE_THRESHOLDS_EMPTY);
+
+        for (size_t i = 0; i < 64; ++i) {
+                snprintf(keys[i], sizeof(keys[i]), "key%zu", i);
+
+                assert_int_equal(NO_ERROR, map_insert(map, keys[i], keys[i]));
         }
 
-        map->setting_flags |= MAP_FLAG_USE_FREE;
+        uint32_t grown_length = map->length;
 
-        map_insert(map, expected_key, allocated_value);
+        for (size_t i = 0; i < 60; ++i) {
+                assert_int_equal(NO_ERROR, map_delete(map, keys[i]));
+        }
+
+        assert_int_equal(4, map->bucket_count);
+        assert_true(map->length < grown_length);
+        assert_true(map->length >= MAP_MIN_LENGTH);
+        assert_true(map->resize_down_count > 0);
+
+        for (size_t i = 60; i < 64; ++i) {
+                struct map_entry *entry = map_get(map, keys[i]);
+
+                assert_non_null(entry);
+                assert_ptr_equal(keys[i], entry->value);
+        }
 }
 
-static void test_map_destroy_free_func(void **state)
+static void test_map_delete_no_shrink(void **state)
 {
         struct map *map = *(struct map **)state;
-        const char *expected_key = "test";
-        struct test_value *allocated_value = test_value_init();
+        char keys[64][16];
 
-        assert_non_null(allocated_value);
+        for (size_t i = 0; i < 64; ++i) {
+                snprintf(keys[i], sizeof(keys[i]), "key%zu", i);
 
-        map_set_entry_free_function(map, test_value_destroy);
+                assert_int_equal(NO_ERROR, map_insert(map, keys[i], keys[i]));
+        }
 
-        map_insert(map, expected_key, allocated_value);
+        uint32_t grown_length = map->length;
+
+        for (size_t i = 0; i < 64; ++i) {
+                assert_int_equal(NO_ERROR, map_delete(map, keys[i]));
+        }
+
+        // Maps keep their length unless MAP_FLAG_IGNORE_THRESHOLDS_EMPTY is
+        // removed
+        assert_int_equal(grown_length, map->length);
+        assert_int_equal(0, map->resize_down_count);
 }
 
-int main(void)
+static void test_map_group_probing_delete_shrink(void **state)
 {
-        const struct CMUnitTest tests[] = {
-                cmocka_unit_test_setup_teardown(test_map_init, test_setup, test_teardown),
-                cmocka_unit_test_setup_teardown(test_map_insert, test_setup, test_teardown),
-                cmocka_unit_test_setup_teardown(
-                        test_map_insert_null_value, test_setup, test_teardown),
-                cmocka_unit_test_setup_teardown(
-                        test_map_insert_null_key, test_setup, test_teardown),
-                cmocka_unit_test(test_map_insert_non_string_key),
-                cmocka_unit_test(test_map_insert_multiple_non_string_key),
-                cmocka_unit_test(test_map_insert_duplicate_non_string_key),
-                cmocka_unit_test(test_map_complex_key_compare),
-                cmocka_unit_test(test_map_complex_key_compare_insert_duplicate),
-                cmocka_unit_test_setup_teardown(
-                        test_map_insert_load_factor_disabled, test_setup, test_teardown),
-                cmocka_unit_test_setup_teardown(
-                        test_map_insert_load_factor, test_setup, test_teardown),
-                cmocka_unit_test_setup_teardown(
-                        test_map_insert_duplicate, test_setup, test_teardown),
-                cmocka_unit_test_setup_teardown(test_map_get, test_setup, test_teardown),
-                cmocka_unit_test_setup_teardown(test_map_get_empty, test_setup, test_teardown),
-                cmocka_unit_test_setup_teardown(test_map_get_null, test_setup, test_teardown),
-                cmocka_unit_test_setup_teardown(test_map_get_duplicate, test_setup, test_teardown),
-                cmocka_unit_test_setup_teardown(test_map_delete, test_setup, test_teardown),
-                cmocka_unit_test_setup_teardown(test_map_delete_null, test_setup, test_teardown),
-                cmocka_unit_test_setup_teardown(test_map_delete_unknown, test_setup, test_teardown),
-                cmocka_unit_test_setup_teardown(
-                        test_map_delete_duplicate, test_setup, test_teardown),
-                cmocka_unit_test_setup_teardown(test_map_get_and_delete, test_setup, test_teardown),
+        struct map *map = *(struct map **)state;
+        char keys[128][16];
+
+        assert_int_equal(0, map_enable_group_probing(map));
+
+        map_remove_setting_flag(map, MAP_FLAG_IGNORE_THRESHOLDS_EMPTY);
+
+        for (size_t i = 0; i < 128; ++i) {
+                snprintf(keys[i], sizeof(keys[i]), "key%zu", i);
+
+                assert_int_equal(NO_ERROR, map_insert(map, keys[i], keys[i]));
+        }
+
+        uint32_t grown_length = map->length;
+
+        for (size_t i = 0; i < 120; ++i) {
+                assert_int_equal(NO_ERROR, map_delete(map, keys[i]));
+        }
+
+        assert_true(map->length < grown_length);
+        assert_true(map->length >= MAP_GROUP_WIDTH);
+
+        for (size_t i = 120; i < 128; ++i) {
+                struct map_entry *entry = map_get(map, keys[i]);
+
+                assert_non_null(entry);
+                assert_ptr_equal(keys[i], entry->value);
+        }
+}
+
+static void test_map_group_probing_enable(void **state)
+{
+        struct map *map = *(struct map **)state;
+
+        assert_int_equal(0, map_enable_group_probing(map));
+        assert_true(map->setting_flags & MAP_FLAG_GROUP_PROBING);
+        assert_int_equal(MAP_GROUP_WIDTH, map->length);
+        assert_non_null(map->control);
+
+        for (uint32_t i = 0; i < map->length; ++i) {
+                assert_int_equal(MAP_CONTROL_EMPTY, map->control[i]);
+        }
+}
+
+static void test_map_group_probing_enable_non_empty(void **state)
+{
+        struct map *map = *(struct map **)state;
+
+        map_insert(map, "test", "value");
+
+        assert_int_equal(-1, map_enable_group_probing(map));
+        assert_false(map->setting_flags & MAP_FLAG_GROUP_PROBING);
+}
+
+static void test_map_group_probing_insert_and_get(void **state)
+{
+        struct map *map = *(struct map **)state;
+        struct map_entry *result = NULL;
+
+        assert_int_equal(0, map_enable_group_probing(map));
+
+        assert_int_equal(NO_ERROR, map_insert(map, "one", "1"));
+        assert_int_equal(NO_ERROR, map_insert(map, "two", "2"));
+        assert_int_equal(NO_ERROR, map_insert(map, "two", "two"));
+
+        assert_int_equal(2, map->bucket_count);
+
+        result = map_get(map, "one");
+
+        assert_non_null(result);
+        assert_string_equal("one", result->key);
+        assert_string_equal("1", result->value);
+
+        result = map_get(map, "two");
+
+        assert_non_null(result);
+        assert_string_equal("two", result->key);
+        assert_string_equal("two", result->value);
+
+        assert_null(map_get(map, "three"));
+}
+
+static void test_map_group_probing_insert_and_delete_many(void **state)
+{
+        struct map *map = *(struct map **)state;
+        size_t key_count = 2000;
+        size_t *keys = malloc(sizeof(size_t) * key_count);
+
+        assert_non_null(keys);
+
+        map_set_key_size_function(map, determine_number_key_size);
+        map_set_key_compare_function(map, non_trivial_key_compare_function);
+
+        assert_int_equal(0, map_enable_group_probing(map));
+
+        for (size_t i = 0; i < key_count; ++i) {
+                keys[i] = i * 31;
+
+                assert_int_equal(NO_ERROR, map_insert(map, &keys[i], &keys[i]));
+        }
+
+        assert_int_equal(key_count, map->bucket_count);
+        assert_true(map->bucket_count < map->length * MAP_LOAD_FACTOR_HIGH);
+
+        for (size_t i = 0; i < key_count; i += 2) {
+                assert_int_equal(NO_ERROR, map_delete(map, &keys[i]));
+        }
+
+        assert_int_equal(key_count / 2, map->bucket_count);
+
+        for (size_t i = 0; i < key_count; ++i) {
+                struct map_entry *entry = map_get(map, &keys[i]);
+
+                if (i % 2 == 0) {
+                        assert_null(entry);
+
+                        continue;
+                }
+
+                assert_non_null(entry);
+                assert_ptr_equal(&keys[i], entry->value);
+        }
+
+        // Re-inserting should be able to reuse deleted slots
+        for (size_t i = 0; i < key_count; i += 2) {
+                assert_int_equal(NO_ERROR, map_insert(map, &keys[i], &keys[i]));
+        }
+
+        assert_int_equal(key_count, map->bucket_count);
+
+        for (size_t i = 0; i < key_count; ++i) {
+                assert_non_null(map_get(map, &keys[i]));
+        }
+
+        free(keys);
+}
+
+static void test_map_group_probing_load_factor_disabled(void **state)
+{
+        struct map *map = *(struct map **)state;
+        char keys[MAP_GROUP_WIDTH + 1][8];
+
+        assert_int_equal(0, map_enable_group_probing(map));
+
+        map->setting_flags |= MAP_FLAG_IGNORE_THRESHOLDS;
+
+        for (size_t i = 0; i < MAP_GROUP_WIDTH; ++i) {
+                snprintf(keys[i], sizeof(keys[i]), "key%zu", i);
+
+                assert_int_equal(NO_ERROR, map_insert(map, keys[i], "value"));
+        }
+
+        assert_int_equal(MAP_GROUP_WIDTH, map->length);
+
+        snprintf(keys[MAP_GROUP_WIDTH], sizeof(keys[MAP_GROUP_WIDTH]), "key%d", MAP_GROUP_WIDTH);
+
+        assert_int_equal(CAPACITY_ERROR, map_insert(map, keys[MAP_GROUP_WIDTH], "value"));
+}
+
+static void test_map_incremental_resize_enable(void **state)
+{
+        struct map *map = *(struct map **)state;
+
+        assert_int_equal(0, map_enable_incremental_resize(map));
+
+        // Incremental resizing and group probing can't be combined
+        assert_int_equal(-1, map_enable_group_probing(map));
+}
+
+static void test_map_incremental_resize_bounded_work(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct map *map = map_init();
+
+        assert_non_null(map);
+
+        map_set_key_size_function(map, determine_number_key_size);
+        map_set_key_compare_function(map, non_trivial_key_compare_function);
+
+        assert_int_equal(0, map_enable_incremental_resize(map));
+
+        size_t key_count = 100000;
+        size_t *keys = malloc(sizeof(size_t) * key_count);
+        uint32_t max_migrated = 0;
+        size_t migrating_inserts = 0;
+
+        assert_non_null(keys);
+
+        for (size_t i = 0; i < key_count; ++i) {
+                keys[i] = i * 7;
+
+                assert_int_equal(NO_ERROR, map_insert(map, &keys[i], &keys[i]));
+
+                max_migrated = MAX(max_migrated, map->migrated_last);
+
+                if (map->old_entries != NULL) {
+                        ++migrating_inserts;
+                }
+
+                // Entries must be reachable while they are split across the
+                // old and new entries
+                struct map_entry *entry = map_get(map, &keys[i / 2]);
+
+                assert_non_null(entry);
+                assert_ptr_equal(&keys[i / 2], entry->value);
+        }
+
+        assert_int_equal(key_count, map->bucket_count);
+        assert_true(migrating_inserts > 0);
+
+        // A full rehash at this size touches tens of thousands of slots
+        assert_int_equal(MAP_MIGRATE_STEP, max_migrated);
+
+        for (size_t i = 0; i < key_count; ++i) {
+                assert_non_null(map_get(map, &keys[i]));
+        }
+
+        map_destroy(map);
+        free(keys);
+}
+
+static void test_map_incremental_resize_delete_during_migration(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct map *map = map_init();
+
+        assert_non_null(map);
+
+        map_set_key_size_function(map, determine_number_key_size);
+        map_set_key_compare_function(map, non_trivial_key_compare_function);
+        map_enable_incremental_resize(map);
+
+        size_t key_count = 1000;
+        size_t *keys = malloc(sizeof(size_t) * key_count);
+        size_t inserted = 0;
+
+        assert_non_null(keys);
+
+        // Insert until the map is in the middle of a migration
+        for (; inserted < key_count; ++inserted) {
+                keys[inserted] = inserted * 7;
+
+                map_insert(map, &keys[inserted], &keys[inserted]);
+
+                if (map->old_entries != NULL && map->length >= 256) {
+                        ++inserted;
+
+                        break;
+                }
+        }
+
+        assert_non_null(map->old_entries);
+
+        for (size_t i = 0; i < inserted; i += 2) {
+                assert_int_equal(NO_ERROR, map_delete(map, &keys[i]));
+        }
+
+        for (size_t i = 0; i < inserted; ++i) {
+                struct map_entry *entry = map_get(map, &keys[i]);
+
+                if (i % 2 == 0) {
+                        assert_null(entry);
+                } else {
+                        assert_non_null(entry);
+                        assert_ptr_equal(&keys[i], entry->value);
+                }
+        }
+
+        assert_int_equal(inserted / 2, map->bucket_count);
+
+        map_destroy(map);
+        free(keys);
+}
+
+// Where the old entries are laid out depends on the seed, so deleting
+// during a migration is repeated for a range of fixed seeds
+static void test_map_incremental_resize_delete_during_migration_seeds(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        size_t keys[300];
+
+        for (size_t i = 0; i < 300; ++i) {
+                keys[i] = i * 7;
+        }
+
+        for (uint64_t seed = 0; seed < 256; ++seed) {
+                struct map *map = map_init();
+
+                assert_non_null(map);
+                assert_int_equal(0, map_set_hash_seed(map, seed));
+
+                map_set_key_size_function(map, determine_number_key_size);
+                map_set_key_compare_function(map, non_trivial_key_compare_function);
+                map_enable_incremental_resize(map);
+
+                size_t inserted = 0;
+
+                while (inserted < 300 && (map->old_entries == NULL || map->length < 256)) {
+                        map_insert(map, &keys[inserted], &keys[inserted]);
+
+                        ++inserted;
+                }
+
+                assert_non_null(map->old_entries);
+
+                for (size_t i = 0; i < inserted; i += 2) {
+                        assert_int_equal(NO_ERROR, map_delete(map, &keys[i]));
+                }
+
+                for (size_t i = 0; i < inserted; ++i) {
+                        struct map_entry *entry = map_get(map, &keys[i]);
+
+                        if (i % 2 == 0) {
+                                assert_null(entry);
+                        } else {
+                                assert_non_null(entry);
+                        }
+                }
+
+                map_destroy(map);
+        }
+}
+
+static void test_map_concurrent_reads_enable(void **state)
+{
+        struct map *map = *(struct map **)state;
+
+        assert_int_equal(0, map_enable_concurrent_reads(map));
+        assert_true(map->setting_flags & MAP_FLAG_CONCURRENT_READS);
+
+        assert_int_equal(-1, map_enable_group_probing(map));
+        assert_int_equal(-1, map_enable_incremental_resize(map));
+
+        void *value = NULL;
+
+        assert_int_equal(NO_ERROR, map_insert(map, "key", "value"));
+        assert_int_equal(NO_ERROR, map_read_value(map, "key", &value));
+        assert_string_equal("value", value);
+        assert_int_equal(NOT_FOUND_ERROR, map_read_value(map, "missing", &value));
+}
+
+static void test_map_concurrent_reads_while_writing(void **state)
+{
+        struct map *map = *(struct map **)state;
+        struct concurrent_reader readers[2];
+        pthread_t threads[2];
+
+        map_set_setting_flag(map, MAP_FLAG_FREE_ENTRY_KEY | MAP_FLAG_USE_FREE);
+
+        assert_int_equal(0, map_enable_concurrent_reads(map));
+
+        for (size_t i = 0; i < CONCURRENT_STABLE_KEY_COUNT; ++i) {
+                assert_int_equal(NO_ERROR,
+                                 map_insert(map, test_key_init("stable", i), test_index_init(i)));
+        }
+
+        for (size_t i = 0; i < 2; ++i) {
+                readers[i].map = map;
+                readers[i].stop = false;
+                readers[i].reads = 0;
+                readers[i].failures = 0;
+
+                assert_int_equal(0,
+                                 pthread_create(&threads[i], NULL, concurrent_reader_thread,
+                                                &readers[i]));
+        }
+
+        // Grow the map several times, replace values and shrink the number of
+        // entries again while the readers are running
+        for (size_t i = 0; i < CONCURRENT_CHURN_KEY_COUNT; ++i) {
+                assert_int_equal(NO_ERROR,
+                                 map_insert(map, test_key_init("churn", i), test_index_init(i)));
+        }
+
+        for (size_t i = 0; i < CONCURRENT_STABLE_KEY_COUNT; ++i) {
+                assert_int_equal(NO_ERROR,
+                                 map_insert(map, test_key_init("stable", i), test_index_init(i)));
+        }
+
+        for (size_t i = 0; i < CONCURRENT_CHURN_KEY_COUNT; ++i) {
+                char key[32];
+
+                snprintf(key, sizeof(key), "churn%zu", i);
+
+                assert_int_equal(NO_ERROR, map_delete(map, key));
+        }
+
+        for (size_t i = 0; i < 2; ++i) {
+                __atomic_store_n(&readers[i].stop, true, __ATOMIC_RELEASE);
+
+                pthread_join(threads[i], NULL);
+
+                assert_true(readers[i].reads > 0);
+                assert_int_equal(0, readers[i].failures);
+        }
+
+        assert_int_equal(CONCURRENT_STABLE_KEY_COUNT, map->bucket_count);
+}
+
+static void test_map_concurrent_reads_bounded_retired(void **state)
+{
+        struct map *map = *(struct map **)state;
+        struct concurrent_reader readers[2];
+        pthread_t threads[2];
+
+        map_set_setting_flag(map, MAP_FLAG_FREE_ENTRY_KEY | MAP_FLAG_USE_FREE);
+
+        assert_int_equal(0, map_enable_concurrent_reads(map));
+
+        for (size_t i = 0; i < CONCURRENT_STABLE_KEY_COUNT; ++i) {
+                assert_int_equal(NO_ERROR,
+                                 map_insert(map, test_key_init("stable", i), test_index_init(i)));
+        }
+
+        for (size_t i = 0; i < 2; ++i) {
+                readers[i].map = map;
+                readers[i].stop = false;
+                readers[i].reads = 0;
+                readers[i].failures = 0;
+
+                assert_int_equal(0,
+                                 pthread_create(&threads[i], NULL, concurrent_reader_thread,
+                                                &readers[i]));
+        }
+
+        // Every delete retires a key and a value while the readers keep
+        // overlapping each other
+        for (size_t i = 0; i < CONCURRENT_CHURN_KEY_COUNT; ++i) {
+                char key[32];
+
+                snprintf(key, sizeof(key), "churn%zu", i % 64);
+
+                char *allocated_key = test_key_init("churn", i % 64);
+
+                assert_int_equal(NO_ERROR, map_insert(map, allocated_key, test_index_init(i)));
+                assert_int_equal(NO_ERROR, map_delete(map, key));
+                assert_true(map->retired->length < MAP_RETIRE_MAX_LENGTH);
+        }
+
+        for (size_t i = 0; i < 2; ++i) {
+                __atomic_store_n(&readers[i].stop, true, __ATOMIC_RELEASE);
+
+                pthread_join(threads[i], NULL);
+
+                assert_int_equal(0, readers[i].failures);
+        }
+}
+
+static void test_map_key_handle_init(void **state)
+{
+        struct map *map = *(struct map **)state;
+        struct map_key_handle handle;
+
+        assert_int_equal(NO_ERROR, map_key_handle_init(map, "key", &handle));
+
+        assert_string_equal("key", handle.key);
+        assert_int_equal(3, handle.size);
+        assert_int_equal(map->hash_function("key", 3, map->seed), handle.hash);
+
+        assert_int_equal(GENERIC_ERROR, map_key_handle_init(map, NULL, &handle));
+}
+
+static void test_map_prehashed_insert_and_get(void **state)
+{
+        struct map *map = *(struct map **)state;
+        struct map_key_handle handle;
+
+        map_key_handle_init(map, "key", &handle);
+
+        assert_int_equal(NO_ERROR, map_insert_prehashed(map, &handle, "value"));
+
+        struct map_entry *entry = map_get_prehashed(map, &handle);
+
+        assert_non_null(entry);
+        assert_string_equal("value", entry->value);
+
+        // The regular API sees the same entry
+        assert_ptr_equal(entry, map_get(map, "key"));
+
+        map_key_handle_init(map, "missing", &handle);
+
+        assert_null(map_get_prehashed(map, &handle));
+}
+
+static void test_map_prehashed_same_pointer_skips_compare(void **state)
+{
+        struct map *map = *(struct map **)state;
+        struct map_key_handle handle;
+        char key[] = "key";
+        char copy[] = "key";
+
+        map_set_key_compare_function(map, counting_key_compare_function);
+        map_key_handle_init(map, key, &handle);
+        map_insert_prehashed(map, &handle, "value");
+
+        counting_compare_calls = 0;
+
+        assert_non_null(map_get_prehashed(map, &handle));
+        assert_int_equal(0, counting_compare_calls);
+
+        // A different pointer with the same contents still needs a compare
+        assert_non_null(map_get(map, copy));
+        assert_int_equal(1, counting_compare_calls);
+}
+
+static void test_map_freeze(void **state)
+{
+        struct map *map = *(struct map **)state;
+        size_t key_count = 1000;
+        char key[32];
+
+        map_set_setting_flag(map, MAP_FLAG_FREE_ENTRY_KEY | MAP_FLAG_USE_FREE);
+
+        for (size_t i = 0; i < key_count; ++i) {
+                char *new_key = test_key_init("config.key", i);
+
+                assert_int_equal(NO_ERROR, map_insert(map, new_key, test_index_init(i)));
+        }
+
+        assert_int_equal(NO_ERROR, map_freeze(map));
+
+        assert_true(map->setting_flags & MAP_FLAG_FROZEN);
+        assert_int_equal(key_count, map->length);
+        assert_int_equal(key_count, map->bucket_count);
+        assert_int_equal(0, (uintptr_t)map->entries % MAP_FROZEN_ALIGNMENT);
+
+        for (size_t i = 0; i < key_count; ++i) {
+                snprintf(key, sizeof(key), "config.key%zu", i);
+
+                struct map_entry *entry = map_get(map, key);
+
+                assert_non_null(entry);
+                assert_int_equal(i, *(size_t *)entry->value);
+        }
+
+        for (size_t i = 0; i < key_count; ++i) {
+                snprintf(key, sizeof(key), "missing%zu", i);
+
+                assert_null(map_get(map, key));
+        }
+
+        // Freezing twice does nothing
+        assert_int_equal(NO_ERROR, map_freeze(map));
+}
+
+static void test_map_freeze_read_only(void **state)
+{
+        struct map *map = *(struct map **)state;
+
+        map_insert(map, "key", "value");
+
+        assert_int_equal(NO_ERROR, map_freeze(map));
+
+        assert_int_equal(GENERIC_ERROR, map_insert(map, "other", "value"));
+        assert_int_equal(GENERIC_ERROR, map_delete(map, "key"));
+        assert_int_equal(-1, map_enable_concurrent_reads(map));
+
+        assert_string_equal("value", map_get(map, "key")->value);
+}
+
+static void test_map_freeze_empty(void **state)
+{
+        struct map *map = *(struct map **)state;
+
+        assert_int_equal(NO_ERROR, map_freeze(map));
+
+        assert_int_equal(0, map->length);
+        assert_null(map_get(map, "key"));
+}
+
+static void test_map_freeze_during_migration(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct map *map = map_init();
+        size_t keys[64];
+
+        assert_non_null(map);
+
+        map_set_key_size_function(map, determine_number_key_size);
+        map_set_key_compare_function(map, non_trivial_key_compare_function);
+        map_enable_incremental_resize(map);
+
+        for (size_t i = 0; i < 64; ++i) {
+                keys[i] = i;
+
+                map_insert(map, &keys[i], &keys[i]);
+        }
+
+        assert_int_equal(NO_ERROR, map_freeze(map));
+
+        assert_null(map->old_entries);
+
+        for (size_t i = 0; i < 64; ++i) {
+                struct map_entry *entry = map_get(map, &keys[i]);
+
+                assert_non_null(entry);
+                assert_ptr_equal(&keys[i], entry->value);
+        }
+
+        map_destroy(map);
+}
+
+static void test_map_freeze_with_layout(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct map *frozen_map = map_init();
+        struct map *map = map_init();
+        size_t keys[1000];
+
+        assert_non_null(frozen_map);
+        assert_non_null(map);
+
+        map_set_key_size_function(frozen_map, determine_number_key_size);
+        map_set_key_compare_function(frozen_map, non_trivial_key_compare_function);
+        map_set_key_size_function(map, determine_number_key_size);
+        map_set_key_compare_function(map, non_trivial_key_compare_function);
+        map_set_hash_seed(frozen_map, 42);
+        map_set_hash_seed(map, 42);
+
+        for (size_t i = 0; i < 1000; ++i) {
+                keys[i] = i;
+
+                map_insert(frozen_map, &keys[i], &keys[i]);
+        }
+
+        // Inserted in a different order, the layout only depends on the keys
+        for (size_t i = 1000; i-- > 0;) {
+                map_insert(map, &keys[i], &keys[i]);
+        }
+
+        assert_int_equal(NO_ERROR, map_freeze(frozen_map));
+        assert_int_equal(NO_ERROR,
+                         map_freeze_with_layout(map,
+                                                frozen_map->frozen->salt,
+                                                frozen_map->frozen->displacements,
+                                                frozen_map->frozen->bucket_count));
+
+        assert_true(map->setting_flags & MAP_FLAG_FROZEN);
+        assert_int_equal(1000, map->length);
+
+        for (size_t i = 0; i < 1000; ++i) {
+                struct map_entry *entry = map_get(map, &keys[i]);
+
+                assert_non_null(entry);
+                assert_ptr_equal(&keys[i], entry->value);
+                assert_ptr_equal(entry, map_get(frozen_map, &keys[i]) - frozen_map->entries
+                                         + map->entries);
+        }
+
+        map_destroy(frozen_map);
+        map_destroy(map);
+}
+
+static void test_map_freeze_with_layout_mismatch(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct map *frozen_map = map_init();
+        struct map *map = map_init();
+        size_t keys[200];
+
+        assert_non_null(frozen_map);
+        assert_non_null(map);
+
+        map_set_key_size_function(frozen_map, determine_number_key_size);
+        map_set_key_compare_function(frozen_map, non_trivial_key_compare_function);
+        map_set_key_size_function(map, determine_number_key_size);
+        map_set_key_compare_function(map, non_trivial_key_compare_function);
+
+        for (size_t i = 0; i < 200; ++i) {
+                keys[i] = i;
+
+                if (i < 100) {
+                        map_insert(frozen_map, &keys[i], &keys[i]);
+                }
+
+                map_insert(map, &keys[i], &keys[i]);
+        }
+
+        assert_int_equal(NO_ERROR, map_freeze(frozen_map));
+
+        // Made for a different number of keys
+        assert_int_equal(INVALID_INPUT_ERROR,
+                         map_freeze_with_layout(map,
+                                                frozen_map->frozen->salt,
+                                                frozen_map->frozen->displacements,
+                                                frozen_map->frozen->bucket_count));
+
+        // Displacements past the largest one map_freeze tries
+        uint32_t displacements[(200 / MAP_FROZEN_BUCKET_SIZE) + 1];
+
+        for (size_t i = 0; i < (200 / MAP_FROZEN_BUCKET_SIZE) + 1; ++i) {
+                displacements[i] = MAP_FROZEN_MAX_DISPLACEMENT;
+        }
+
+        assert_int_equal(
+                INVALID_INPUT_ERROR,
+                map_freeze_with_layout(map, 0, displacements, (200 / MAP_FROZEN_BUCKET_SIZE) + 1));
+
+        // The map is left as it was
+        assert_null(map->frozen);
+        assert_int_equal(NO_ERROR, map_insert(map, &keys[0], &keys[1]));
+        assert_ptr_equal(&keys[1], map_get(map, &keys[0])->value);
+
+        map_destroy(frozen_map);
+        map_destroy(map);
+}
+
+static void test_map_get_stats(void **state)
+{
+        struct map *map = *(struct map **)state;
+        struct map_stats stats;
+        char keys[64][16];
+
+        map_set_setting_flag(map, MAP_FLAG_COLLECT_STATS);
+
+        for (size_t i = 0; i < 64; ++i) {
+                snprintf(keys[i], sizeof(keys[i]), "key%zu", i);
+
+                map_insert(map, keys[i], "value");
+        }
+
+        map_get_stats(map, &stats);
+
+        uint32_t histogram_total = 0;
+
+        for (size_t i = 0; i < MAP_STATS_HISTOGRAM_SIZE; ++i) {
+                histogram_total += stats.dib_histogram[i];
+        }
+
+        assert_int_equal(64, stats.entry_count);
+        assert_int_equal(map->length, stats.length);
+        assert_int_equal(64, histogram_total);
+        assert_true(stats.mean_dib <= stats.max_dib);
+        // 4 -> 8 -> 16 -> 32 -> 64 -> 128
+        assert_int_equal(5, stats.resize_up_count);
+        assert_int_equal(0, stats.resize_down_count);
+        assert_true(stats.resize_time_ns > 0);
+        assert_int_equal(0, stats.tombstone_count);
+        assert_int_equal(sizeof(struct map) + (map->length * sizeof(struct map_entry)),
+                         stats.bytes_allocated);
+}
+
+static void test_map_get_stats_empty(void **state)
+{
+        struct map *map = *(struct map **)state;
+        struct map_stats stats;
+
+        map_get_stats(map, &stats);
+
+        assert_int_equal(0, stats.entry_count);
+        assert_int_equal(0, stats.max_dib);
+        assert_true(stats.mean_dib == 0.0);
+        assert_int_equal(0, stats.resize_time_ns);
+}
+
+#define GET_MANY_KEY_COUNT 50 // More than a single batch
+
+static void check_get_many(struct map *map, char keys[][16])
+{
+        const void *lookups[GET_MANY_KEY_COUNT + 2];
+        struct map_entry *results[GET_MANY_KEY_COUNT + 2];
+
+        for (size_t i = 0; i < GET_MANY_KEY_COUNT; ++i) {
+                lookups[i] = keys[i];
+        }
+
+        lookups[GET_MANY_KEY_COUNT] = "missing";
+        lookups[GET_MANY_KEY_COUNT + 1] = NULL;
+
+        assert_int_equal(GET_MANY_KEY_COUNT,
+                         map_get_many(map, lookups, GET_MANY_KEY_COUNT + 2, results));
+
+        for (size_t i = 0; i < GET_MANY_KEY_COUNT; ++i) {
+                assert_non_null(results[i]);
+                assert_ptr_equal(keys[i], results[i]->value);
+        }
+
+        assert_null(results[GET_MANY_KEY_COUNT]);
+        assert_null(results[GET_MANY_KEY_COUNT + 1]);
+}
+
+static void test_map_get_many(void **state)
+{
+        struct map *map = *(struct map **)state;
+        struct map *group_map = map_init();
+        char keys[GET_MANY_KEY_COUNT][16];
+
+        assert_non_null(group_map);
+        assert_int_equal(0, map_enable_group_probing(group_map));
+
+        for (size_t i = 0; i < GET_MANY_KEY_COUNT; ++i) {
+                snprintf(keys[i], sizeof(keys[i]), "key_%zu", i);
+
+                map_insert(map, keys[i], keys[i]);
+                map_insert(group_map, keys[i], keys[i]);
+        }
+
+        check_get_many(map, keys);
+        check_get_many(group_map, keys);
+
+        assert_int_equal(NO_ERROR, map_freeze(map));
+
+        check_get_many(map, keys);
+
+        assert_int_equal(0, map_get_many(map, NULL, 0, NULL));
+
+        map_destroy(group_map);
+}
+
+static size_t uint32_key_size_function(const void *key)
+{
+        UNUSED_FUNCTION_PARAM(key);
+
+        return sizeof(uint32_t);
+}
+
+static bool uint32_key_compare_function(const void *one, const void *two, size_t key_size)
+{
+        return memcmp(one, two, key_size) == 0;
+}
+
+static void test_map_hash_seeded_per_map(void **state)
+{
+        struct map *map = *(struct map **)state;
+        struct map *other_map = map_init();
+
+        assert_non_null(other_map);
+
+        assert_true(map->seed != other_map->seed);
+        assert_int_equal(map->hash_function("key", 3, map->seed),
+                         map_hash_wyhash("key", 3, map->seed));
+        assert_true(map_hash_wyhash("key", 3, map->seed)
+                    != map_hash_wyhash("key", 3, other_map->seed));
+
+        map_destroy(other_map);
+}
+
+static void test_map_set_hash_seed(void **state)
+{
+        struct map *map = *(struct map **)state;
+        struct map_key_handle handle;
+
+        assert_int_equal(0, map_set_hash_seed(map, 42));
+        assert_int_equal(42, map->seed);
+
+        map_key_handle_init(map, "key", &handle);
+
+        assert_int_equal(map_hash_wyhash("key", 3, 42), handle.hash);
+
+        map_insert(map, "key", "value");
+
+        // The seed can't change once there are entries
+        assert_int_equal(-1, map_set_hash_seed(map, 7));
+        assert_int_equal(42, map->seed);
+}
+
+static void test_map_hash_wyhash_lengths(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        // Cover the short, medium and long (> 48 bytes) paths. Every prefix
+        // of the buffer should hash differently
+        const char *data = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789+/";
+        size_t length = strlen(data);
+        uint64_t hashes[64] = {0};
+
+        for (size_t i = 0; i <= length && i < 64; ++i) {
+                hashes[i] = hash_wyhash_64(data, i, 0);
+
+                assert_true(hash_wyhash_64(data, i, 0) == hashes[i]);
+                assert_true(hash_wyhash_64(data, i, 1) != hashes[i]);
+
+                for (size_t j = 0; j < i; ++j) {
+                        assert_true(hashes[j] != hashes[i]);
+                }
+        }
+}
+
+static void test_map_hash_integer(void **state)
+{
+        struct map *map = *(struct map **)state;
+        uint32_t keys[64] = {0};
+
+        assert_int_equal(0, map_set_hash_function(map, map_hash_integer));
+        assert_int_equal(0, map_set_key_size_function(map, uint32_key_size_function));
+        assert_int_equal(0, map_set_key_compare_function(map, uint32_key_compare_function));
+
+        for (uint32_t i = 0; i < 64; ++i) {
+                // Shaped like X window ids
+                keys[i] = 0x1e00001 + i;
+
+                assert_int_equal(NO_ERROR, map_insert(map, &keys[i], &keys[i]));
+        }
+
+        for (uint32_t i = 0; i < 64; ++i) {
+                uint32_t key = 0x1e00001 + i;
+                struct map_entry *entry = map_get(map, &key);
+
+                assert_non_null(entry);
+                assert_ptr_equal(&keys[i], entry->value);
+        }
+
+        // 4 byte keys are hashed with a bijection
+        uint32_t one = 1;
+        uint32_t two = 2;
+
+        assert_true(map_hash_integer(&one, sizeof(one), map->seed)
+                    != map_hash_integer(&two, sizeof(two), map->seed));
+}
+
+static void test_map_destroy_null(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        map_destroy(NULL);
+}
+
+static void test_map_destroy_use_free(void **state)
+{
+        struct map *map = *(struct map **)state;
+        const char *expected_key = "test";
+        size_t value_length = 5;
+        size_t *allocated_value = malloc(sizeof(size_t) * value_length);
+
+        assert_non_null(allocated_value);
+
+        for (size_t i = 0; i < value_length; ++i) {
+                allocated_value[i] = i;
+        }
+
+        map->setting_flags |= MAP_FLAG_USE_FREE;
+
+        map_insert(map, expected_key, allocated_value);
+}
+
+static void test_map_destroy_free_func(void **state)
+{
+        struct map *map = *(struct map **)state;
+        const char *expected_key = "test";
+        struct test_value *allocated_value = test_value_init();
+
+        assert_non_null(allocated_value);
+
+        map_set_entry_free_function(map, test_value_destroy);
+
+        map_insert(map, expected_key, allocated_value);
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test_setup_teardown(test_map_init, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_map_insert, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_insert_null_value, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_insert_null_key, test_setup, test_teardown),
+                cmocka_unit_test(test_map_insert_non_string_key),
+                cmocka_unit_test(test_map_insert_multiple_non_string_key),
+                cmocka_unit_test(test_map_insert_duplicate_non_string_key),
+                cmocka_unit_test(test_map_complex_key_compare),
+                cmocka_unit_test(test_map_complex_key_compare_insert_duplicate),
+                cmocka_unit_test_setup_teardown(
+                        test_map_insert_load_factor_disabled, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_insert_load_factor, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_insert_duplicate, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_map_get, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_map_get_empty, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_map_get_null, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_map_get_duplicate, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_map_delete, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_map_delete_null, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_map_delete_unknown, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_delete_duplicate, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_map_get_and_delete, test_setup, test_teardown),
+                cmocka_unit_test(test_map_insert_and_delete_many),
+                cmocka_unit_test_setup_teardown(
+                        test_map_delete_free_func, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_map_delete_shrink, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_delete_no_shrink, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_group_probing_enable, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_group_probing_enable_non_empty, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_group_probing_insert_and_get, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_group_probing_insert_and_delete_many, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_group_probing_load_factor_disabled, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_group_probing_delete_shrink, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_incremental_resize_enable, test_setup, test_teardown),
+                cmocka_unit_test(test_map_incremental_resize_bounded_work),
+                cmocka_unit_test(test_map_incremental_resize_delete_during_migration),
+                cmocka_unit_test(test_map_incremental_resize_delete_during_migration_seeds),
+                cmocka_unit_test_setup_teardown(
+                        test_map_concurrent_reads_enable, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_concurrent_reads_while_writing, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_concurrent_reads_bounded_retired, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_key_handle_init, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_prehashed_insert_and_get, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_prehashed_same_pointer_skips_compare, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_map_freeze, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_freeze_read_only, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_map_freeze_empty, test_setup, test_teardown),
+                cmocka_unit_test(test_map_freeze_during_migration),
+                cmocka_unit_test(test_map_freeze_with_layout),
+                cmocka_unit_test(test_map_freeze_with_layout_mismatch),
+                cmocka_unit_test_setup_teardown(test_map_get_stats, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_get_stats_empty, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_map_get_many, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_hash_seeded_per_map, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_map_set_hash_seed, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_map_hash_wyhash_lengths, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_map_hash_integer, test_setup, test_teardown),
                 cmocka_unit_test_setup_teardown(test_map_destroy_null, test_setup, test_teardown),
                 cmocka_unit_test_setup_teardown(
                         test_map_destroy_use_free, test_setup, test_teardown),
@@ -0,0 +1,159 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+
+#include <common/constants.h>
+#include <common/pool.h>
+
+#define TEST_CHUNK_LENGTH 4
+
+struct test_object {
+        uint64_t one;
+        uint64_t two;
+        uint8_t three;
+};
+
+static int test_setup(void **state)
+{
+        struct pool *pool = pool_create(sizeof(struct test_object), TEST_CHUNK_LENGTH);
+
+        if (pool == NULL) {
+                return EXIT_FAILURE;
+        }
+
+        *state = pool;
+
+        return EXIT_SUCCESS;
+}
+
+static int test_teardown(void **state)
+{
+        pool_destroy(*(struct pool **)state);
+
+        return EXIT_SUCCESS;
+}
+
+static void test_pool_create(void **state)
+{
+        struct pool *pool = *(struct pool **)state;
+
+        assert_int_equal(0, pool->object_size % POOL_ALIGNMENT);
+        assert_true(pool->object_size >= sizeof(struct test_object));
+        assert_int_equal(TEST_CHUNK_LENGTH, pool->chunk_length);
+        assert_int_equal(0, pool->used_count);
+        assert_int_equal(0, pool->chunk_count);
+        assert_null(pool_create(0, TEST_CHUNK_LENGTH));
+}
+
+static void test_pool_create_default_chunk_length(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct pool *pool = pool_create(1, 0);
+
+        assert_non_null(pool);
+        assert_int_equal(POOL_DEFAULT_CHUNK_LENGTH, pool->chunk_length);
+
+        // Objects are always big enough to be placed on the free list
+        assert_true(pool->object_size >= sizeof(struct pool_free_object));
+
+        pool_destroy(pool);
+}
+
+static void test_pool_alloc_is_contiguous(void **state)
+{
+        struct pool *pool = *(struct pool **)state;
+        char *objects[TEST_CHUNK_LENGTH] = {0};
+
+        for (size_t i = 0; i < TEST_CHUNK_LENGTH; ++i) {
+                objects[i] = pool_alloc(pool);
+
+                assert_non_null(objects[i]);
+                assert_int_equal(0, (uintptr_t)objects[i] % POOL_ALIGNMENT);
+
+                memset(objects[i], 0xFF, sizeof(struct test_object));
+        }
+
+        // Objects from the same chunk are allocated in address order
+        for (size_t i = 1; i < TEST_CHUNK_LENGTH; ++i) {
+                assert_ptr_equal(objects[i - 1] + pool->object_size, objects[i]);
+        }
+
+        assert_int_equal(1, pool->chunk_count);
+        assert_int_equal(TEST_CHUNK_LENGTH, pool->used_count);
+
+        // The next allocation needs a new chunk
+        assert_non_null(pool_alloc(pool));
+        assert_int_equal(2, pool->chunk_count);
+}
+
+static void test_pool_free_reuses_objects(void **state)
+{
+        struct pool *pool = *(struct pool **)state;
+        void *first = pool_alloc(pool);
+        void *second = pool_alloc(pool);
+
+        pool_free(pool, first);
+
+        assert_int_equal(1, pool->used_count);
+        assert_ptr_equal(first, pool_alloc(pool));
+
+        pool_free(pool, second);
+        pool_free(pool, NULL);
+
+        assert_int_equal(1, pool->used_count);
+        assert_int_equal(1, pool->chunk_count);
+}
+
+static void test_pool_release(void **state)
+{
+        struct pool *pool = *(struct pool **)state;
+
+        for (size_t i = 0; i < TEST_CHUNK_LENGTH * 3; ++i) {
+                assert_non_null(pool_alloc(pool));
+        }
+
+        assert_int_equal(3, pool->chunk_count);
+
+        pool_release(pool);
+
+        assert_int_equal(0, pool->used_count);
+        assert_int_equal(0, pool->chunk_count);
+        assert_null(pool->chunks);
+
+        // The pool is still usable
+        assert_non_null(pool_alloc(pool));
+        assert_int_equal(1, pool->used_count);
+}
+
+static void test_pool_destroy_null(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        pool_destroy(NULL);
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test_setup_teardown(test_pool_create, test_setup, test_teardown),
+                cmocka_unit_test(test_pool_create_default_chunk_length),
+                cmocka_unit_test_setup_teardown(
+                        test_pool_alloc_is_contiguous, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_pool_free_reuses_objects, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_pool_release, test_setup, test_teardown),
+                cmocka_unit_test(test_pool_destroy_null),
+        };
+
+        return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,212 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+
+#include <common/constants.h>
+#include <common/scan.h>
+
+// Long enough for a couple of full blocks and a partial block, with bytes
+// from every class
+static const char *test_input = "key = value\n"
+                                "array = [1, [2, 3], \"four\"] # comment\n"
+                                "\t\v\f\r  trailing   \n";
+
+static bool reference_is_space(char c)
+{
+        return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+static uint32_t reference_mask(const char *block, size_t length, char needle)
+{
+        uint32_t mask = 0;
+
+        for (size_t i = 0; i < length && i < SCAN_BLOCK_SIZE; ++i) {
+                if (block[i] == needle) {
+                        mask |= 1U << i;
+                }
+        }
+
+        return mask;
+}
+
+static uint32_t reference_space_mask(const char *block, size_t length)
+{
+        uint32_t mask = 0;
+
+        for (size_t i = 0; i < length && i < SCAN_BLOCK_SIZE; ++i) {
+                if (reference_is_space(block[i])) {
+                        mask |= 1U << i;
+                }
+        }
+
+        return mask;
+}
+
+static void test_scan_block(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        size_t length = strlen(test_input);
+
+        // Every starting offset and every partial length
+        for (size_t offset = 0; offset < length; ++offset) {
+                const char *block = test_input + offset;
+                size_t block_length = length - offset;
+                struct scan_masks masks;
+
+                scan_block(block, block_length, &masks);
+
+                assert_int_equal(reference_mask(block, block_length, '\n'), masks.new_line);
+                assert_int_equal(reference_mask(block, block_length, '='), masks.equal);
+                assert_int_equal(reference_mask(block, block_length, ','), masks.comma);
+                assert_int_equal(reference_mask(block, block_length, '['), masks.array_start);
+                assert_int_equal(reference_mask(block, block_length, ']'), masks.array_end);
+                assert_int_equal(reference_mask(block, block_length, '"'), masks.quote);
+                assert_int_equal(reference_mask(block, block_length, '#'), masks.comment);
+                assert_int_equal(reference_space_mask(block, block_length), masks.space);
+        }
+}
+
+static void test_scan_block_char_partial(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        char block[SCAN_BLOCK_SIZE];
+
+        memset(block, 'a', sizeof(block));
+
+        // Bytes past the length are never matched, even when searching for
+        // the padding
+        assert_int_equal(0x1F, scan_block_char(block, 5, 'a'));
+        assert_int_equal(0, scan_block_char(block, 5, '\0'));
+        assert_int_equal(UINT32_MAX, scan_block_char(block, SCAN_BLOCK_SIZE, 'a'));
+}
+
+static void test_scan_block_high_bytes(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        char block[SCAN_BLOCK_SIZE];
+        struct scan_masks masks;
+
+        // Bytes above 0x7F must not be taken for whitespace
+        for (size_t i = 0; i < SCAN_BLOCK_SIZE; ++i) {
+                block[i] = (char)(0x80 + (i * 4));
+        }
+
+        scan_block(block, SCAN_BLOCK_SIZE, &masks);
+
+        assert_int_equal(0, masks.space);
+}
+
+static void test_scan_find_char(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        char buffer[100];
+
+        memset(buffer, 'a', sizeof(buffer));
+
+        for (size_t i = 0; i < sizeof(buffer); ++i) {
+                buffer[i] = '=';
+
+                assert_int_equal(i, scan_find_char(buffer, sizeof(buffer), '='));
+                assert_int_equal(i, scan_find_last_char(buffer, sizeof(buffer), '='));
+                assert_int_equal(1, scan_count_char(buffer, sizeof(buffer), '='));
+
+                // The match is past the searched length
+                assert_int_equal(i, scan_find_char(buffer, i, '='));
+
+                buffer[i] = 'a';
+        }
+
+        assert_int_equal(0, scan_find_char(NULL, 0, '='));
+}
+
+static void test_scan_find_last_char(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        size_t length = strlen(test_input);
+        const char *last = strrchr(test_input, '\n');
+
+        assert_int_equal(last - test_input, scan_find_last_char(test_input, length, '\n'));
+        assert_int_equal(length, scan_find_last_char(test_input, length, '@'));
+}
+
+static void test_scan_count_char(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        size_t length = strlen(test_input);
+
+        assert_int_equal(3, scan_count_char(test_input, length, '\n'));
+        assert_int_equal(2, scan_count_char(test_input, length, '='));
+        assert_int_equal(0, scan_count_char(test_input, length, '@'));
+}
+
+static void test_scan_find_nonspace(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        char buffer[80];
+
+        memset(buffer, ' ', sizeof(buffer));
+
+        assert_int_equal(sizeof(buffer), scan_find_first_nonspace(buffer, sizeof(buffer)));
+        assert_int_equal(sizeof(buffer), scan_find_last_nonspace(buffer, sizeof(buffer)));
+
+        buffer[40] = 'x';
+        buffer[70] = 'y';
+
+        assert_int_equal(40, scan_find_first_nonspace(buffer, sizeof(buffer)));
+        assert_int_equal(70, scan_find_last_nonspace(buffer, sizeof(buffer)));
+        assert_int_equal(40, scan_find_last_nonspace(buffer, 70));
+        assert_int_equal(30, scan_find_first_nonspace(buffer, 30));
+}
+
+static void test_scan_set_backend(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        // The byte at a time loop can always be used
+        assert_true(scan_backend_is_supported(SCAN_BACKEND_SCALAR));
+        assert_false(scan_backend_is_supported(SCAN_BACKEND_COUNT));
+        assert_int_equal(INVALID_INPUT_ERROR, scan_set_backend(SCAN_BACKEND_COUNT));
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_scan_block),
+                cmocka_unit_test(test_scan_block_char_partial),
+                cmocka_unit_test(test_scan_block_high_bytes),
+                cmocka_unit_test(test_scan_find_char),
+                cmocka_unit_test(test_scan_find_last_char),
+                cmocka_unit_test(test_scan_count_char),
+                cmocka_unit_test(test_scan_find_nonspace),
+                cmocka_unit_test(test_scan_set_backend),
+        };
+        int failed = 0;
+
+        // Run every backend the CPU supports against the same tests
+        for (size_t i = 0; i < SCAN_BACKEND_COUNT; ++i) {
+                if (scan_set_backend((enum scan_backend)i) != NO_ERROR) {
+                        continue;
+                }
+
+                failed += cmocka_run_group_tests_name(scan_backend_name(), tests, NULL, NULL);
+        }
+
+        return failed;
+}
@@ -486,6 +486,87 @@ static void test_stack_destroy_callback_multiple(void **state)
         stack_destroy_callback(stack, stack_data_destroy_callback);
 }
 
+static void test_stack_ring_buffer(void **state)
+{
+        struct stack *stack = *(struct stack **)state;
+        size_t values[STACK_MIN_CAPACITY * 4];
+        size_t count = sizeof(values) / sizeof(values[0]);
+
+        // Enqueue the second half and push the first half in reverse, so the
+        // head wraps around the start of the buffer while it grows
+        for (size_t i = 0; i < count / 2; ++i) {
+                values[i] = i;
+                values[count / 2 + i] = count / 2 + i;
+
+                assert_int_equal(NO_ERROR, stack_enqueue(stack, &values[count / 2 + i]));
+                assert_int_equal(NO_ERROR, stack_push(stack, &values[count / 2 - i - 1]));
+        }
+
+        assert_int_equal(count, stack->length);
+
+        size_t index = 0;
+
+        STACK_FOR_EACH(stack, item)
+        {
+                assert_ptr_equal(item, stack_peek_n(stack, index));
+                assert_int_equal(index, *(const size_t *)item->data);
+
+                ++index;
+        }
+
+        assert_int_equal(count, index);
+
+        // Remove from both ends and refill, which wraps the tail around
+        for (size_t i = 0; i < count / 4; ++i) {
+                struct stack_item *head = stack_pop(stack);
+                struct stack_item *tail = stack_dequeue(stack);
+
+                assert_int_equal(i, *(const size_t *)head->data);
+                assert_int_equal(count - i - 1, *(const size_t *)tail->data);
+                assert_null(tail->next);
+
+                stack_item_destroy(head);
+                stack_item_destroy(tail);
+        }
+
+        for (size_t i = 0; i < count / 4; ++i) {
+                assert_int_equal(NO_ERROR, stack_enqueue(stack, &values[i]));
+        }
+
+        assert_int_equal(count * 3 / 4, stack->length);
+        assert_int_equal(count / 4, *(const size_t *)stack_peek(stack)->data);
+        assert_int_equal(count / 4 - 1,
+                         *(const size_t *)stack_peek_n(stack, stack->length - 1)->data);
+        assert_null(stack_peek_n(stack, stack->length - 1)->next);
+}
+
+static void test_stack_peek_n_length(void **state)
+{
+        struct stack *stack = *(struct stack **)state;
+        size_t first = 1;
+        size_t second = 2;
+
+        assert_int_equal(NO_ERROR, stack_push(stack, &first));
+        assert_int_equal(NO_ERROR, stack_push(stack, &second));
+
+        // Peeking at the length gives the tail, past it there is nothing
+        assert_int_equal(first, *(const size_t *)stack_peek_n(stack, 2)->data);
+        assert_null(stack_peek_n(stack, 3));
+}
+
+static void test_stack_item_grow(void **state)
+{
+        struct stack *stack = *(struct stack **)state;
+
+        // Both ends grow the buffer past its initial capacity
+        for (size_t i = 0; i < STACK_MIN_CAPACITY * 2; ++i) {
+                assert_int_equal(NO_ERROR, stack_push_item(stack, stack_item_create(NULL)));
+                assert_int_equal(NO_ERROR, stack_enqueue_item(stack, stack_item_create(NULL)));
+        }
+
+        assert_int_equal(STACK_MIN_CAPACITY * 4, stack->length);
+}
+
 int main(void)
 {
         const struct CMUnitTest tests[] = {
@@ -521,6 +602,10 @@ int main(void)
                         test_stack_dequeue_empty, test_setup, test_teardown),
                 cmocka_unit_test(test_stack_destroy_callback),
                 cmocka_unit_test(test_stack_destroy_callback_multiple),
+                cmocka_unit_test_setup_teardown(test_stack_ring_buffer, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_stack_peek_n_length, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_stack_item_grow, test_setup, test_teardown),
         };
 
         return cmocka_run_group_tests(tests, NULL, NULL);
@@ -822,6 +822,116 @@ static void test_string_to_number_double(void **state)
         assert_int_equal(INVALID_INPUT_ERROR, string_to_number(input, &destination));
 }
 
+static void test_string_builder_append(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct string_builder builder;
+
+        string_builder_init(&builder);
+
+        assert_int_equal(NO_ERROR, string_builder_append(&builder, "Test"));
+        assert_int_equal(NO_ERROR, string_builder_append_char(&builder, ' '));
+        assert_int_equal(NO_ERROR, string_builder_append_n(&builder, "Stringxxx", 6));
+        assert_int_equal(11, builder.length);
+        assert_int_equal(STRING_BUILDER_MIN_CAPACITY, builder.capacity);
+        assert_string_equal("Test String", builder.buffer);
+
+        string_builder_destroy(&builder);
+
+        assert_null(builder.buffer);
+        assert_int_equal(0, builder.length);
+}
+
+static void test_string_builder_grows_geometrically(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct string_builder builder;
+        size_t reallocations = 0;
+        size_t previous_capacity = 0;
+
+        string_builder_init(&builder);
+
+        for (size_t i = 0; i < 4096; ++i) {
+                assert_int_equal(NO_ERROR, string_builder_append_char(&builder, 'a'));
+
+                if (builder.capacity != previous_capacity) {
+                        ++reallocations;
+                }
+
+                previous_capacity = builder.capacity;
+        }
+
+        assert_int_equal(4096, builder.length);
+        assert_int_equal(4096, strlen(builder.buffer));
+        assert_true(builder.capacity > builder.length);
+        assert_true(reallocations <= 10);
+
+        string_builder_destroy(&builder);
+}
+
+static void test_string_builder_append_format(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct string_builder builder;
+        const char *long_string = "a string which is longer than the minimum capacity";
+
+        string_builder_init(&builder);
+
+        assert_int_equal(NO_ERROR, string_builder_append_format(&builder, "%d-%s", 14, "test"));
+        assert_string_equal("14-test", builder.buffer);
+
+        // Does not fit in the spare capacity and must be formatted again
+        assert_int_equal(NO_ERROR, string_builder_append_format(&builder, " %s", long_string));
+        assert_int_equal(8 + strlen(long_string), builder.length);
+        assert_string_equal("14-test a string which is longer than the minimum capacity",
+                            builder.buffer);
+
+        string_builder_destroy(&builder);
+}
+
+static void test_string_builder_finish(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct string_builder builder;
+        size_t length = 0;
+
+        string_builder_init(&builder);
+
+        assert_int_equal(NO_ERROR, string_builder_append(&builder, "Test"));
+
+        char *result = string_builder_finish(&builder, &length);
+
+        assert_string_equal("Test", result);
+        assert_int_equal(4, length);
+        assert_null(builder.buffer);
+        assert_int_equal(0, builder.length);
+        assert_int_equal(0, builder.capacity);
+
+        free(result);
+}
+
+static void test_string_builder_finish_empty(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct string_builder builder;
+        size_t length = 14;
+
+        string_builder_init(&builder);
+
+        char *result = string_builder_finish(&builder, &length);
+
+        assert_non_null(result);
+        assert_string_equal("", result);
+        assert_int_equal(0, length);
+
+        free(result);
+}
+
 int main(void)
 {
         const struct CMUnitTest tests[] = {
@@ -832,6 +942,11 @@ int main(void)
                 cmocka_unit_test(test_string_append_char_succeeds),
                 cmocka_unit_test(test_string_append_char_empty_append),
                 cmocka_unit_test(test_string_append_char_empty_destination),
+                cmocka_unit_test(test_string_builder_append),
+                cmocka_unit_test(test_string_builder_grows_geometrically),
+                cmocka_unit_test(test_string_builder_append_format),
+                cmocka_unit_test(test_string_builder_finish),
+                cmocka_unit_test(test_string_builder_finish_empty),
                 cmocka_unit_test(test_string_find_char),
                 cmocka_unit_test(test_string_find_char_not_found),
                 cmocka_unit_test(test_string_find_char_empty_string),
@@ -0,0 +1,236 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmocka.h>
+
+#include <common/constants.h>
+#include <common/error.h>
+#include <common/string_view.h>
+
+static void test_string_view_from_string(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *string = "Test String";
+        struct string_view view = string_view_from_string(string);
+
+        assert_ptr_equal(string, view.data);
+        assert_int_equal(11, view.length);
+        assert_false(string_view_is_empty(view));
+        assert_true(string_view_is_empty(string_view_from_string("")));
+}
+
+static void test_string_view_equal(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct string_view view = string_view_create("Test String", 4);
+
+        assert_true(string_view_equal_string(view, "Test"));
+        assert_false(string_view_equal_string(view, "Test String"));
+        assert_false(string_view_equal_string(view, "Tes"));
+        assert_false(string_view_equal_string(view, "test"));
+        assert_true(string_view_equal(string_view_create(NULL, 0), string_view_from_string("")));
+}
+
+static void test_string_view_no_case_compare(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct string_view view = string_view_create("TRUE = 1", 4);
+
+        assert_true(string_view_no_case_compare(view, "true"));
+        assert_true(string_view_no_case_compare(view, "TrUe"));
+        assert_false(string_view_no_case_compare(view, "true "));
+        assert_false(string_view_no_case_compare(view, "fals"));
+        assert_false(string_view_no_case_compare(view, NULL));
+}
+
+static void test_string_view_find_char(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        // The view ends before the second '='
+        struct string_view view = string_view_create("key = value = 1", 11);
+        size_t index = 0;
+
+        assert_int_equal(NO_ERROR, string_view_find_char(view, '=', &index));
+        assert_int_equal(4, index);
+        assert_int_equal(NOT_FOUND_ERROR, string_view_find_char(view, '1', &index));
+        assert_int_equal(NOT_FOUND_ERROR,
+                         string_view_find_char(string_view_create(NULL, 0), '=', &index));
+}
+
+static void test_string_view_strip_surrounding_spaces(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct string_view view = string_view_from_string(" \t key value \n");
+        struct string_view stripped = string_view_strip_surrounding_spaces(view);
+
+        assert_true(string_view_equal_string(stripped, "key value"));
+        assert_ptr_equal(view.data + 3, stripped.data);
+}
+
+static void test_string_view_strip_surrounding_spaces_all_spaces(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct string_view view = string_view_from_string("   \t ");
+
+        assert_true(string_view_is_empty(string_view_strip_surrounding_spaces(view)));
+}
+
+static void test_string_view_split(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *expected[] = {"one", "", "two", "three", ""};
+        struct string_view_split split;
+        struct string_view item;
+        size_t count = 0;
+
+        string_view_split_init(&split, string_view_from_string("one,,two,three,"), ',');
+
+        while (string_view_split_next(&split, &item)) {
+                assert_true(count < 5);
+                assert_true(string_view_equal_string(item, expected[count]));
+
+                ++count;
+        }
+
+        assert_int_equal(5, count);
+        assert_false(string_view_split_next(&split, &item));
+}
+
+static void test_string_view_split_single(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct string_view_split split;
+        struct string_view item;
+
+        string_view_split_init(&split, string_view_from_string("one"), ',');
+
+        assert_true(string_view_split_next(&split, &item));
+        assert_true(string_view_equal_string(item, "one"));
+        assert_false(string_view_split_next(&split, &item));
+}
+
+static void test_string_view_to_boolean(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        bool result = false;
+
+        assert_int_equal(NO_ERROR,
+                         string_view_to_boolean(string_view_from_string("True"), &result));
+        assert_true(result);
+        assert_int_equal(NO_ERROR,
+                         string_view_to_boolean(string_view_create("FALSE\n", 5), &result));
+        assert_false(result);
+        assert_int_equal(INVALID_INPUT_ERROR,
+                         string_view_to_boolean(string_view_from_string("yes"), &result));
+}
+
+static void test_string_view_to_number(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        intmax_t result = 0;
+
+        // The view stops before the trailing characters
+        assert_int_equal(NO_ERROR, string_view_to_number(string_view_create("1234x", 4), &result));
+        assert_int_equal(1234, result);
+        assert_int_equal(NO_ERROR, string_view_to_number(string_view_from_string("-56"), &result));
+        assert_int_equal(-56, result);
+        assert_int_equal(NO_ERROR, string_view_to_number(string_view_from_string(" +7"), &result));
+        assert_int_equal(7, result);
+}
+
+static void test_string_view_to_number_limits(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        intmax_t result = 0;
+
+        assert_int_equal(
+                NO_ERROR,
+                string_view_to_number(string_view_from_string("9223372036854775807"), &result));
+        assert_true(result == INTMAX_MAX);
+        assert_int_equal(
+                NO_ERROR,
+                string_view_to_number(string_view_from_string("-9223372036854775808"), &result));
+        assert_true(result == INTMAX_MIN);
+        assert_int_equal(
+                INVALID_INPUT_ERROR,
+                string_view_to_number(string_view_from_string("9223372036854775808"), &result));
+        assert_int_equal(
+                INVALID_INPUT_ERROR,
+                string_view_to_number(string_view_from_string("-9223372036854775809"), &result));
+}
+
+static void test_string_view_to_number_invalid(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        const char *inputs[] = {"", "-", "e", "55.5", "5 ", "1e3"};
+        intmax_t result = 14;
+
+        for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i) {
+                struct string_view view = string_view_from_string(inputs[i]);
+
+                assert_int_equal(INVALID_INPUT_ERROR, string_view_to_number(view, &result));
+        }
+
+        assert_int_equal(14, result);
+}
+
+static void test_string_view_to_string(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct string_view view = string_view_create("key = value", 3);
+        char *string = string_view_to_string(view);
+
+        assert_non_null(string);
+        assert_string_equal("key", string);
+
+        free(string);
+
+        string = string_view_to_string(string_view_create(NULL, 0));
+
+        assert_non_null(string);
+        assert_string_equal("", string);
+
+        free(string);
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test(test_string_view_from_string),
+                cmocka_unit_test(test_string_view_equal),
+                cmocka_unit_test(test_string_view_no_case_compare),
+                cmocka_unit_test(test_string_view_find_char),
+                cmocka_unit_test(test_string_view_strip_surrounding_spaces),
+                cmocka_unit_test(test_string_view_strip_surrounding_spaces_all_spaces),
+                cmocka_unit_test(test_string_view_split),
+                cmocka_unit_test(test_string_view_split_single),
+                cmocka_unit_test(test_string_view_to_boolean),
+                cmocka_unit_test(test_string_view_to_number),
+                cmocka_unit_test(test_string_view_to_number_limits),
+                cmocka_unit_test(test_string_view_to_number_invalid),
+                cmocka_unit_test(test_string_view_to_string),
+        };
+
+        return cmocka_run_group_tests(tests, NULL, NULL);
+}
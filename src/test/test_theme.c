@@ -48,6 +48,36 @@ static void config_map_free_callback(void *data)
         config_value_destroy(value);
 }
 
+static const char *test_theme_config = "window.border_width = [1, 2, 3, 4]\n"
+                                      "window.border_color = [\n"
+                                      "\t\"#ffffff\",\n"
+                                      "\t\"#cc0000\",\n"
+                                      "\t\"#000000\",\n"
+                                      "\t\"#cccccc\",\n"
+                                      "]\n"
+                                      "resize.background_color = \"#111111\"\n"
+                                      "resize.border_color = \"#222222\"\n";
+
+// Create a theme from test_theme_config followed by overrides
+static struct theme *create_test_theme(const char *overrides)
+{
+        size_t config_length = strlen(test_theme_config) + strlen(overrides);
+        char config_string[config_length + 1];
+
+        strcpy(config_string, test_theme_config);
+        strcat(config_string, overrides);
+
+        struct map *config_map = config_read_string(config_string, config_length);
+
+        assert_non_null(config_map);
+
+        struct theme *theme = theme_create(config_map);
+
+        config_destroy(config_map);
+
+        return theme;
+}
+
 static void test_color_value_from_string(void **state)
 {
         UNUSED_FUNCTION_PARAM(state);
@@ -535,6 +565,93 @@ static void test_color_value_has_changed_null_string(void **state)
         color_value_destroy(value);
 }
 
+static void test_theme_create(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct theme *theme = create_test_theme("");
+
+        assert_non_null(theme);
+        assert_int_equal(2, theme->border_width->focused);
+        assert_string_equal("#cc0000", theme->color->focused->string);
+        assert_string_equal("#111111", theme->resize_background_color->string);
+        assert_string_equal("#222222", theme->resize_border_color->string);
+
+        theme_destroy(theme);
+}
+
+static void test_theme_create_invalid_config(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        // Later items fail after the border widths have been created
+        assert_null(create_test_theme("window.border_color = []\n"));
+        assert_null(create_test_theme("resize.border_color = \"Invalid\"\n"));
+}
+
+static void test_theme_diff_unchanged(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct theme *previous = create_test_theme("");
+        struct theme *next = create_test_theme("");
+
+        assert_non_null(previous);
+        assert_non_null(next);
+        assert_int_equal(THEME_UNCHANGED, theme_diff(previous, next));
+
+        theme_destroy(previous);
+        theme_destroy(next);
+}
+
+static void test_theme_diff_border_width(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct theme *previous = create_test_theme("");
+        struct theme *next = create_test_theme("window.border_width = [1, 2, 3, 5]\n");
+
+        assert_non_null(previous);
+        assert_non_null(next);
+        assert_int_equal(THEME_BORDER_WIDTH_CHANGED, theme_diff(previous, next));
+
+        theme_destroy(previous);
+        theme_destroy(next);
+}
+
+static void test_theme_diff_border_color(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct theme *previous = create_test_theme("");
+        struct theme *next = create_test_theme(
+                "window.border_color = [\"#ffffff\", \"#00cc00\", \"#000000\", \"#cccccc\"]\n");
+
+        assert_non_null(previous);
+        assert_non_null(next);
+        assert_int_equal(THEME_BORDER_COLOR_CHANGED, theme_diff(previous, next));
+
+        theme_destroy(previous);
+        theme_destroy(next);
+}
+
+static void test_theme_diff_resize_color(void **state)
+{
+        UNUSED_FUNCTION_PARAM(state);
+
+        struct theme *previous = create_test_theme("");
+        struct theme *next = create_test_theme("resize.border_color = \"#333333\"\n"
+                                               "window.border_width = [0, 2, 3, 4]\n");
+
+        assert_non_null(previous);
+        assert_non_null(next);
+        assert_int_equal(THEME_RESIZE_COLOR_CHANGED | THEME_BORDER_WIDTH_CHANGED,
+                         theme_diff(previous, next));
+
+        theme_destroy(previous);
+        theme_destroy(next);
+}
+
 int main(void)
 {
         const struct CMUnitTest tests[] = {
@@ -559,6 +676,12 @@ int main(void)
                 cmocka_unit_test(test_color_value_has_changed_not_changed),
                 cmocka_unit_test(test_color_value_has_changed_null_value),
                 cmocka_unit_test(test_color_value_has_changed_null_string),
+                cmocka_unit_test(test_theme_create),
+                cmocka_unit_test(test_theme_create_invalid_config),
+                cmocka_unit_test(test_theme_diff_unchanged),
+                cmocka_unit_test(test_theme_diff_border_width),
+                cmocka_unit_test(test_theme_diff_border_color),
+                cmocka_unit_test(test_theme_diff_resize_color),
         };
 
         return cmocka_run_group_tests(tests, global_test_setup, global_test_teardown);
@@ -0,0 +1,218 @@
+// Copyright 2020 Chris Frank
+// Licensed under BSD-3-Clause
+// Refer to the license.txt file included in the root of the project
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <cmocka.h>
+
+#include <common/constants.h>
+#include <common/vector.h>
+
+VEC_DEFINE(int_vector, int)
+
+static int test_setup(void **state)
+{
+        struct int_vector *vector = int_vector_create();
+
+        if (vector == NULL) {
+                return EXIT_FAILURE;
+        }
+
+        *state = vector;
+
+        return EXIT_SUCCESS;
+}
+
+static int test_teardown(void **state)
+{
+        int_vector_destroy(*(struct int_vector **)state);
+
+        return EXIT_SUCCESS;
+}
+
+static void test_vector_push_and_at(void **state)
+{
+        struct int_vector *vector = *(struct int_vector **)state;
+
+        assert_true(int_vector_is_empty(vector));
+
+        assert_int_equal(NO_ERROR, int_vector_push(vector, 1));
+        assert_int_equal(NO_ERROR, int_vector_push(vector, 2));
+
+        assert_int_equal(2, vector->length);
+        assert_int_equal(1, *int_vector_at(vector, 0));
+        assert_int_equal(2, *int_vector_at(vector, 1));
+        assert_null(int_vector_at(vector, 2));
+}
+
+static void test_vector_push_grows(void **state)
+{
+        struct int_vector *vector = *(struct int_vector **)state;
+
+        for (int i = 0; i < 100; ++i) {
+                assert_int_equal(NO_ERROR, int_vector_push(vector, i));
+        }
+
+        assert_int_equal(100, vector->length);
+        assert_true(vector->capacity >= 100);
+
+        for (int i = 0; i < 100; ++i) {
+                assert_int_equal(i, *int_vector_at(vector, (size_t)i));
+        }
+}
+
+static void test_vector_pop(void **state)
+{
+        struct int_vector *vector = *(struct int_vector **)state;
+
+        int_vector_push(vector, 1);
+        int_vector_push(vector, 2);
+
+        assert_int_equal(2, int_vector_pop(vector));
+        assert_int_equal(1, int_vector_pop(vector));
+        assert_true(int_vector_is_empty(vector));
+}
+
+static void test_vector_reserve(void **state)
+{
+        struct int_vector *vector = *(struct int_vector **)state;
+
+        assert_int_equal(NO_ERROR, int_vector_reserve(vector, 32));
+
+        assert_int_equal(32, vector->capacity);
+        assert_int_equal(0, vector->length);
+
+        // Reserving less than the current capacity does nothing
+        assert_int_equal(NO_ERROR, int_vector_reserve(vector, 8));
+        assert_int_equal(32, vector->capacity);
+}
+
+static void test_vector_clear(void **state)
+{
+        struct int_vector *vector = *(struct int_vector **)state;
+
+        int_vector_push(vector, 1);
+        int_vector_clear(vector);
+
+        assert_true(int_vector_is_empty(vector));
+        assert_true(vector->capacity > 0);
+}
+
+static void test_vector_swap_remove(void **state)
+{
+        struct int_vector *vector = *(struct int_vector **)state;
+
+        for (int i = 0; i < 4; ++i) {
+                int_vector_push(vector, i);
+        }
+
+        assert_int_equal(NO_ERROR, int_vector_swap_remove(vector, 1));
+
+        // The last element takes the place of the removed one
+        assert_int_equal(3, vector->length);
+        assert_int_equal(0, *int_vector_at(vector, 0));
+        assert_int_equal(3, *int_vector_at(vector, 1));
+        assert_int_equal(2, *int_vector_at(vector, 2));
+
+        assert_int_equal(NO_ERROR, int_vector_swap_remove(vector, 2));
+        assert_int_equal(2, vector->length);
+
+        assert_int_equal(INVALID_INPUT_ERROR, int_vector_swap_remove(vector, 2));
+        assert_int_equal(2, vector->length);
+}
+
+static void test_vector_remove(void **state)
+{
+        struct int_vector *vector = *(struct int_vector **)state;
+
+        for (int i = 0; i < 4; ++i) {
+                int_vector_push(vector, i);
+        }
+
+        assert_int_equal(NO_ERROR, int_vector_remove(vector, 1));
+
+        // The order is kept
+        assert_int_equal(3, vector->length);
+        assert_int_equal(0, *int_vector_at(vector, 0));
+        assert_int_equal(2, *int_vector_at(vector, 1));
+        assert_int_equal(3, *int_vector_at(vector, 2));
+
+        assert_int_equal(INVALID_INPUT_ERROR, int_vector_remove(vector, 3));
+}
+
+static void test_vector_for_each(void **state)
+{
+        struct int_vector *vector = *(struct int_vector **)state;
+        int count = 0;
+
+        // An empty vector has no items array yet
+        VEC_FOR_EACH(vector, int, item)
+        {
+                ++count;
+        }
+
+        assert_int_equal(0, count);
+
+        for (int i = 0; i < 10; ++i) {
+                int_vector_push(vector, i);
+        }
+
+        VEC_FOR_EACH(vector, int, item)
+        {
+                assert_int_equal(count, *item);
+
+                *item *= 2;
+
+                ++count;
+        }
+
+        assert_int_equal(10, count);
+        assert_int_equal(18, *int_vector_at(vector, 9));
+}
+
+static void test_vector_for_each_reverse_remove(void **state)
+{
+        struct int_vector *vector = *(struct int_vector **)state;
+
+        for (int i = 0; i < 10; ++i) {
+                int_vector_push(vector, i);
+        }
+
+        // Remove every even number while iterating
+        VEC_FOR_EACH_REVERSE(vector, index)
+        {
+                if (*int_vector_at(vector, index) % 2 == 0) {
+                        int_vector_swap_remove(vector, index);
+                }
+        }
+
+        assert_int_equal(5, vector->length);
+
+        VEC_FOR_EACH(vector, int, item)
+        {
+                assert_int_equal(1, *item % 2);
+        }
+}
+
+int main(void)
+{
+        const struct CMUnitTest tests[] = {
+                cmocka_unit_test_setup_teardown(test_vector_push_and_at, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_vector_push_grows, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_vector_pop, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_vector_reserve, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_vector_clear, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_vector_swap_remove, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_vector_remove, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(test_vector_for_each, test_setup, test_teardown),
+                cmocka_unit_test_setup_teardown(
+                        test_vector_for_each_reverse_remove, test_setup, test_teardown),
+        };
+
+        return cmocka_run_group_tests(tests, NULL, NULL);
+}